@@ -37,6 +37,8 @@
 #include <bspacm/periph/uart.h>
 #include <bspacm/periph/gpio.h>
 #include <bspacm/internal/utility/fifo.h>
+#include <bspacm/utility/event.h>
+#include <bspacm/utility/task.h>
 #include <em_cmu.h>
 #include <em_gpio.h>
 #include <em_usart.h>
@@ -115,7 +117,9 @@ usart_configure_as_uart (sBSPACMperiphUARTstate * usp,
     usart->IEN = USART_IF_RXDATAV;
     NVIC_ClearPendingIRQ(devcfgp->rx_irqn);
     NVIC_ClearPendingIRQ(devcfgp->tx_irqn);
+    NVIC_SetPriority(devcfgp->rx_irqn, BSPACM_CORE_PRIORITY_DRIVER);
     NVIC_EnableIRQ(devcfgp->rx_irqn);
+    NVIC_SetPriority(devcfgp->tx_irqn, BSPACM_CORE_PRIORITY_DRIVER);
     NVIC_EnableIRQ(devcfgp->tx_irqn);
 
     /* Configuration complete; enable the USART */
@@ -155,10 +159,10 @@ usart_hw_txien (sBSPACMperiphUARTstate * usp,
 static int
 usart_fifo_state (sBSPACMperiphUARTstate * usp)
 {
-  BSPACM_CORE_SAVED_INTERRUPT_STATE(istate);
+  BSPACM_CORE_SAVED_PRIORITY_MASK(pmask);
   USART_TypeDef * const usart = (USART_TypeDef *)usp->uart;
   int rv = 0;
-  BSPACM_CORE_DISABLE_INTERRUPT();
+  BSPACM_CORE_MASK_PRIORITY();
   do {
     if (! (usart->STATUS & USART_STATUS_TXC)) {
       rv |= eBSPACMperiphUARTfifoState_HWTX;
@@ -173,7 +177,7 @@ usart_fifo_state (sBSPACMperiphUARTstate * usp)
       rv |= eBSPACMperiphUARTfifoState_SWRX;
     }
   } while (0);
-  BSPACM_CORE_REENABLE_INTERRUPT(istate);
+  BSPACM_CORE_RESTORE_PRIORITY_MASK(pmask);
   return rv;
 }
 
@@ -201,11 +205,11 @@ const sBSPACMperiphUARToperations xBSPACMdeviceEFM32periphUARToperations = {
 void
 vBSPACMdeviceEFM32periphUSARTrxirqhandler (sBSPACMperiphUARTstate * const usp)
 {
-  BSPACM_CORE_SAVED_INTERRUPT_STATE(istate);
+  BSPACM_CORE_SAVED_PRIORITY_MASK(pmask);
   USART_TypeDef * const usart = (USART_TypeDef *)usp->uart;
 
   if (USART_STATUS_RXDATAV & usart->STATUS) {
-    BSPACM_CORE_DISABLE_INTERRUPT();
+    BSPACM_CORE_MASK_PRIORITY();
     while (USART_STATUS_RXDATAV & usart->STATUS) {
       uint16_t rxdatax = usart->RXDATAX;
       if (0 == ((USART_RXDATAX_PERR | USART_RXDATAX_FERR) & rxdatax)) {
@@ -214,6 +218,7 @@ vBSPACMdeviceEFM32periphUSARTrxirqhandler (sBSPACMperiphUARTstate * const usp)
           usp->rx_dropped_errors += 1;
         }
         usp->rx_count += 1;
+        vBSPACMeventPost(&xBSPACMeventSystem, BSPACM_EVENT_UART_RX);
       } else {
         if (USART_RXDATAX_PERR & rxdatax) {
           usp->rx_parity_errors += 1;
@@ -223,19 +228,22 @@ vBSPACMdeviceEFM32periphUSARTrxirqhandler (sBSPACMperiphUARTstate * const usp)
         }
       }
     };
+    if (usp->rx_task) {
+      (void)iBSPACMtaskPost(usp->rx_task);
+    }
   }
-  BSPACM_CORE_REENABLE_INTERRUPT(istate);
+  BSPACM_CORE_RESTORE_PRIORITY_MASK(pmask);
 }
 
 void
 vBSPACMdeviceEFM32periphUSARTtxirqhandler (sBSPACMperiphUARTstate * const usp)
 {
-  BSPACM_CORE_SAVED_INTERRUPT_STATE(istate);
+  BSPACM_CORE_SAVED_PRIORITY_MASK(pmask);
   USART_TypeDef * const usart = (USART_TypeDef *)usp->uart;
 
   if (usp->tx_fifo_ni_
       && (USART_STATUS_TXBL & usart->STATUS)) {
-    BSPACM_CORE_DISABLE_INTERRUPT();
+    BSPACM_CORE_MASK_PRIORITY();
     while ((USART_STATUS_TXBL & usart->STATUS)
            && (! fifo_empty(usp->tx_fifo_ni_))) {
       usart->TXDATA = fifo_pop_tail(usp->tx_fifo_ni_, 0);
@@ -243,9 +251,10 @@ vBSPACMdeviceEFM32periphUSARTtxirqhandler (sBSPACMperiphUARTstate * const usp)
     }
     if (fifo_empty(usp->tx_fifo_ni_)) {
       usart->IEN &= ~USART_IF_TXBL;
+      vBSPACMeventPost(&xBSPACMeventSystem, BSPACM_EVENT_UART_TX);
     }
   }
-  BSPACM_CORE_REENABLE_INTERRUPT(istate);
+  BSPACM_CORE_RESTORE_PRIORITY_MASK(pmask);
 }
 
 static int
@@ -314,6 +323,7 @@ leuart_configure (sBSPACMperiphUARTstate * usp,
     leuart->IFC = _LEUART_IF_MASK;
     leuart->IEN = LEUART_IF_RXDATAV;
     NVIC_ClearPendingIRQ(devcfgp->irqn);
+    NVIC_SetPriority(devcfgp->irqn, BSPACM_CORE_PRIORITY_DRIVER);
     NVIC_EnableIRQ(devcfgp->irqn);
 
     /* Configuration complete; enable the LEUART, and release the
@@ -358,11 +368,11 @@ leuart_hw_txien (sBSPACMperiphUARTstate * usp,
 static int
 leuart_fifo_state (sBSPACMperiphUARTstate * usp)
 {
-  BSPACM_CORE_SAVED_INTERRUPT_STATE(istate);
+  BSPACM_CORE_SAVED_PRIORITY_MASK(pmask);
   LEUART_TypeDef * const leuart = (LEUART_TypeDef *)usp->uart;
   int rv = 0;
 
-  BSPACM_CORE_DISABLE_INTERRUPT();
+  BSPACM_CORE_MASK_PRIORITY();
   do {
     if (! (leuart->STATUS & LEUART_STATUS_TXC)) {
       rv |= eBSPACMperiphUARTfifoState_HWTX;
@@ -377,7 +387,7 @@ leuart_fifo_state (sBSPACMperiphUARTstate * usp)
       rv |= eBSPACMperiphUARTfifoState_SWRX;
     }
   } while (0);
-  BSPACM_CORE_REENABLE_INTERRUPT(istate);
+  BSPACM_CORE_RESTORE_PRIORITY_MASK(pmask);
   return rv;
 }
 
@@ -391,10 +401,10 @@ const sBSPACMperiphUARToperations xBSPACMdeviceEFM32periphLEUARToperations = {
 void
 vBSPACMdeviceEFM32periphLEUARTirqhandler (sBSPACMperiphUARTstate * const usp)
 {
-  BSPACM_CORE_SAVED_INTERRUPT_STATE(istate);
+  BSPACM_CORE_SAVED_PRIORITY_MASK(pmask);
   LEUART_TypeDef * const leuart = (LEUART_TypeDef *)usp->uart;
 
-  BSPACM_CORE_DISABLE_INTERRUPT();
+  BSPACM_CORE_MASK_PRIORITY();
   if (LEUART_STATUS_RXDATAV & leuart->STATUS) {
     while (LEUART_STATUS_RXDATAV & leuart->STATUS) {
       uint16_t rxdatax = leuart->RXDATAX;
@@ -404,6 +414,7 @@ vBSPACMdeviceEFM32periphLEUARTirqhandler (sBSPACMperiphUARTstate * const usp)
           usp->rx_dropped_errors += 1;
         }
         usp->rx_count += 1;
+        vBSPACMeventPost(&xBSPACMeventSystem, BSPACM_EVENT_UART_RX);
       } else {
         if (LEUART_RXDATAX_PERR & rxdatax) {
           usp->rx_parity_errors += 1;
@@ -413,6 +424,9 @@ vBSPACMdeviceEFM32periphLEUARTirqhandler (sBSPACMperiphUARTstate * const usp)
         }
       }
     };
+    if (usp->rx_task) {
+      (void)iBSPACMtaskPost(usp->rx_task);
+    }
   }
   if (usp->tx_fifo_ni_
       && (LEUART_STATUS_TXBL & leuart->STATUS)) {
@@ -423,7 +437,8 @@ vBSPACMdeviceEFM32periphLEUARTirqhandler (sBSPACMperiphUARTstate * const usp)
     }
     if (fifo_empty(usp->tx_fifo_ni_)) {
       leuart->IEN &= ~LEUART_IF_TXBL;
+      vBSPACMeventPost(&xBSPACMeventSystem, BSPACM_EVENT_UART_TX);
     }
   }
-  BSPACM_CORE_REENABLE_INTERRUPT(istate);
+  BSPACM_CORE_RESTORE_PRIORITY_MASK(pmask);
 }
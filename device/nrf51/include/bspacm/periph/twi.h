@@ -35,8 +35,18 @@
  *
  * Nordic calls this "TWI", but it's I2C so that's what the API uses.
  *
+ * Transfers are interrupt driven.  Each transfer is described by a
+ * sBSPACMi2cTransaction which is queued on the bus with
+ * iBSPACMi2cSubmit(); the bus works through its queue from the TWI
+ * interrupt and invokes a per-transaction callback as each
+ * completes, so the core is free to sleep during I2C traffic.
+ * iBSPACMi2cRead() and iBSPACMi2cWrite() are blocking wrappers that
+ * submit a transaction and sleep until it completes.
+ *
  * @note The implementation depends on <bspacm/utility/hires.h> and
- * <bspacm/utility/uptime.h>
+ * <bspacm/utility/uptime.h>.  The uptime clock must be running, and
+ * if #BSPACM_NRF_APPLY_PAN_56 is enabled so must the high-resolution
+ * timer.
  *
  * @homepage http://github.com/pabigot/bspacm
  * @copyright Copyright 2015, Peter A. Bigot.  Licensed under <a href="http://www.opensource.org/licenses/BSD-3-Clause">BSD-3-Clause</a>
@@ -46,6 +56,8 @@
 #define BSPACM_DEVICE_NRF51_INTERNAL_PERIPH_TWI_H
 
 #include <bspacm/core.h>
+#include <bspacm/utility/hires.h>
+#include <bspacm/utility/uptime.h>
 
 /* Certain negative error codes convey information.  For those cases,
  * the absolute value is taken from the ERRORSRC register augmented by
@@ -99,6 +111,70 @@
  * in microseconds. */
 #define BSPACM_I2C_MINIMUM_BUS_TIMEOUT_us 100
 
+/* Forward declaration */
+struct sBSPACMi2cTransaction;
+
+/** Type for a transaction completion callback.
+ *
+ * It is explicitly permitted to invoke iBSPACMi2cSubmit() from within
+ * the callback, including to resubmit the completed transaction.
+ *
+ * @param xp pointer to the transaction structure, with
+ * sBSPACMi2cTransaction::result set.  This may be embedded in a
+ * larger structure to pass context to the callback.
+ *
+ * @note The callback is invoked from an interrupt handler and is
+ * subject to all the usual caveats about what should be done in that
+ * context.
+ *
+ * @note After the callback returns the handler posts
+ * #BSPACM_EVENT_I2C to #xBSPACMeventSystem. */
+typedef void (* vBSPACMi2cTransactionCallback_flih) (struct sBSPACMi2cTransaction * xp);
+
+/** Description of one I2C transaction.
+ *
+ * A transaction writes #tx_len bytes, then reads #rx_len bytes from
+ * the same device using a repeated start.  Either length may be zero,
+ * but not both. */
+typedef struct sBSPACMi2cTransaction {
+  /** An optional callback, invoked from the handler when the
+   * transaction completes. */
+  vBSPACMi2cTransactionCallback_flih callback_flih;
+
+  /** An optional task, posted from the handler after invoking
+   * #callback_flih. */
+  struct sBSPACMtask * task;
+
+  /** The data to be written */
+  const uint8_t * tx;
+
+  /** The number of bytes to be written */
+  size_t tx_len;
+
+  /** Where data read should be stored */
+  uint8_t * rx;
+
+  /** The number of bytes to be read */
+  size_t rx_len;
+
+  /** The 7-bit address of the device, exclusive of the RW bit. */
+  uint8_t addr;
+
+  /** Set when the transaction has completed.  Managed by the bus. */
+  volatile bool completed;
+
+  /** Valid when #completed is set: #tx_len + #rx_len on success,
+   * otherwise a negative error code as returned by
+   * iBSPACMi2cRead(). */
+  volatile int result;
+
+  /** Link for the bus transaction queue.  Managed by the bus. */
+  struct sBSPACMi2cTransaction * next_;
+} sBSPACMi2cTransaction;
+
+/** A handle to an I2C transaction */
+typedef sBSPACMi2cTransaction * hBSPACMi2cTransaction;
+
 typedef struct sBSPACMi2cBus {
   /** The NRF TWI peripheral used for this configuration. */
   NRF_TWI_Type * twi;
@@ -125,7 +201,13 @@ typedef struct sBSPACMi2cBus {
    * whichever is larger.
    *
    * In any case where a timeout is detected the TWI peripheral will
-   * be power-cycled in accordance with the PAN #56 workaround.
+   * be power-cycled in accordance with the PAN #56 workaround, and
+   * the bus will be cleared, before the next queued transaction
+   * starts.  Recovery is a sequence of uptime alarm steps, so it does
+   * not busy-wait in the interrupt handler.
+   *
+   * The timeout is an uptime alarm, so no CPU time is spent waiting
+   * for it.
    */
   unsigned int timeout_utt;
 
@@ -144,10 +226,62 @@ typedef struct sBSPACMi2cBus {
    * workaround. */
   int8_t ppi_chidx;
 #endif /* BSPACM_NRF_APPLY_PAN_36 */
+
+#if (BSPACM_NRF_APPLY_PAN_56 - 0)
+  /** Two periods of the bus clock, in microseconds.  PAN #56
+   * requires this delay between reading RXD and resuming.  It is
+   * timed by #resume_alarm_ rather than by a busy-wait. */
+  uint8_t resume_delay_us;
+
+  /** Alarm that issues the delayed RESUME task.  Managed by the
+   * bus. */
+  sBSPACMhiresAlarm resume_alarm_;
+#endif /* BSPACM_NRF_APPLY_PAN_56 */
+
+  /** Alarm that detects bus timeouts.  Managed by the bus. */
+  sBSPACMuptimeAlarm timeout_alarm_;
+
+  /** The uptime at which the transaction in progress last transferred
+   * a byte.  The timeout alarm is pushed back from this rather than
+   * being rescheduled on every byte.  Managed by the bus. */
+  unsigned int progress_utt_;
+
+  /** The transaction in progress, followed by those waiting.  Managed
+   * by the bus. */
+  hBSPACMi2cTransaction volatile head_;
+
+  /** The last transaction in the queue.  Managed by the bus. */
+  hBSPACMi2cTransaction tail_;
+
+  /** Bytes written and read so far in the transaction in progress.
+   * Managed by the bus. */
+  size_t tx_idx_;
+  size_t rx_idx_;
+
+  /** Set when the peripheral reports an error in the transaction in
+   * progress.  Managed by the bus. */
+  bool error_;
+
+  /** Alarm that steps bus recovery after an error or timeout.
+   * Managed by the bus. */
+  sBSPACMuptimeAlarm recovery_alarm_;
+
+  /** Error flags for the transaction whose failure triggered
+   * recovery.  It completes when recovery does.  Managed by the
+   * bus. */
+  int recovery_rv_;
+
+  /** The recovery step awaiting #recovery_alarm_, or zero if the bus
+   * is not recovering.  Managed by the bus. */
+  volatile uint8_t recovery_step_;
+
+  /** SCL half-cycles remaining in a recovery bus clear.  Managed by
+   * the bus. */
+  uint8_t recovery_toggles_;
 } sBSPACMi2cBus;
 
 /** A handle for a bus configuration */
-typedef const sBSPACMi2cBus * hBSPACMi2cBus;
+typedef sBSPACMi2cBus * hBSPACMi2cBus;
 
 /** Configure the I2C bus structure.
  *
@@ -178,7 +312,7 @@ typedef const sBSPACMi2cBus * hBSPACMi2cBus;
  * or #RXDREADY from a follower device.  This relates to
  * #BSPACM_NRF_APPLY_PAN_56 but has the specified effect even if that
  * PAN is not enabled.  The timeout is reset on each successful byte
- * transfer, and is implemented as a busy-wait.  Remember to account
+ * transfer, and is implemented as an uptime alarm.  Remember to account
  * for clock stretching.  Values less than
  * #BSPACM_I2C_MINIMUM_BUS_TIMEOUT_us are adjusted to meet that
  * minimum.
@@ -197,6 +331,9 @@ hBSPACMi2cConfigureBus (sBSPACMi2cBus * tpp,
                         unsigned int timeout_us);
 
 /** Enable or disable the TWI bus configuration.
+ *
+ * Enabling the bus also enables its interrupt.  Disabling the bus
+ * completes any queued transactions with an error.
  *
  * @return Zero if enable (or disable) was successful, otherwise a
  * negative error code.  Errors can occur when failing to gain control
@@ -205,7 +342,41 @@ int
 iBSPACMi2cSetEnabled (hBSPACMi2cBus tpp,
                       bool enabled);
 
+/** Queue a transaction on the I2C bus.
+ *
+ * The transaction starts immediately if the bus is idle, otherwise
+ * when the transactions ahead of it complete.  This does not block,
+ * and may be invoked from interrupt handlers.
+ *
+ * @param tpp the bus to use
+ *
+ * @param xp the transaction.  The structure and its buffers must
+ * remain valid until sBSPACMi2cTransaction::completed is set.
+ *
+ * @return 0 if the transaction was queued, or a negative error code
+ * if the transaction is invalid or already queued, or a required
+ * clock is not running. */
+int
+iBSPACMi2cSubmit (hBSPACMi2cBus tpp,
+                  hBSPACMi2cTransaction xp);
+
+/** Service the TWI interrupt for a bus.
+ *
+ * This is invoked from the <tt>SPI0_TWI0_IRQHandler()</tt> and
+ * <tt>SPI1_TWI1_IRQHandler()</tt> supplied with the TWI
+ * implementation.  Those handlers are linked with the TWI driver, so
+ * an application that uses the same instance for SPI cannot use this
+ * driver as well.
+ *
+ * @param tpp the bus associated with the interrupt */
+void
+vBSPACMi2cIRQHandler (hBSPACMi2cBus tpp);
+
 /** Read data from the I2C bus.
+ *
+ * This submits a transaction and sleeps until it completes.  It must
+ * not be invoked from an interrupt handler that would prevent the TWI
+ * interrupt from being serviced.
  *
  * @param tpp the bus to use
  *
@@ -225,6 +396,9 @@ iBSPACMi2cRead (hBSPACMi2cBus tpp,
                 size_t len);
 
 /** Write data to the I2C bus.
+ *
+ * This submits a transaction and sleeps until it completes; see
+ * iBSPACMi2cRead().
  *
  * @param tpp the bus to use
  *
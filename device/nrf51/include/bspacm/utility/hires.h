@@ -36,8 +36,15 @@
  * Timer #BSPACM_HIRES_TIMER is reserved for use by BSPACM to support
  * short-duration sleeps and high-precision timing.
  *
- * Capture/compare register 0 is reserved for timed sleeps via
- * vBSPACMhiresSleep_us().
+ * Capture/compare register 0 is reserved for reading the counter via
+ * uiBSPACMhires(); nothing compares against it, so a read from any
+ * context cannot disturb a pending deadline.  Capture/compare register
+ * #BSPACM_HIRES_OVERFLOW_CCIDX is reserved to extend the counter
+ * beyond the hardware width for ullBSPACMhires().  Capture/compare
+ * register #BSPACM_HIRES_ALARM_CCIDX is reserved for alarms scheduled
+ * with iBSPACMhiresAlarmSchedule() and vBSPACMhiresSleep_us().
+ * Capture/compare register
+ * #BSPACM_HIRES_CAPTURE_CCIDX is used by iBSPACMhiresCaptureStart().
  *
  * Other capture/compare registers may be used for high-precision
  * timing by the application by issuing a capture task then (at an
@@ -60,8 +67,11 @@ extern "C" {
 /** The integral address of the TIMER peripheral to be used for BSPACM
  * high-resolution timing.
  *
- * You probably don't want this to be NRF_TIMER0_BASE, because that's
- * used by soft devices. */
+ * Use NRF_TIMER0_BASE if no soft device is present.  Only TIMER0 has
+ * a 32-bit counter; on TIMER1 and TIMER2 the 16-bit counter wraps
+ * every 4.096 ms at 16 MHz, and each wrap interrupts the core (see
+ * #BSPACM_HIRES_OVERFLOW_CCIDX).  The default avoids TIMER0 because
+ * soft devices reserve it. */
 #define BSPACM_HIRES_TIMER_BASE NRF_TIMER1_BASE
 #endif /* BSPACM_HIRES_TIMER_BASE */
 
@@ -83,6 +93,93 @@ extern "C" {
 #error Unrecognized high-resolution timer
 #endif /* BSPACM_HIRES_TIMER_BASE */
 
+/** The number of bits in the hardware counter of
+ * #BSPACM_HIRES_TIMER.  Only TIMER0 supports a 32-bit counter. */
+#if (NRF_TIMER0_BASE == BSPACM_HIRES_TIMER_BASE)
+#define BSPACM_HIRES_COUNTER_BITS 32
+#else /* BSPACM_HIRES_TIMER_BASE */
+#define BSPACM_HIRES_COUNTER_BITS 16
+#endif /* BSPACM_HIRES_TIMER_BASE */
+
+/** Mask selecting the bits of the hardware counter of
+ * #BSPACM_HIRES_TIMER. */
+#define BSPACM_HIRES_COUNTER_MASK ((unsigned int)((1ULL << BSPACM_HIRES_COUNTER_BITS) - 1))
+
+#ifndef BSPACM_HIRES_OVERFLOW_CCIDX
+/** The #BSPACM_HIRES_TIMER capture/compare register used to detect
+ * counter overflow.  It is held at zero so its compare event marks
+ * each wrap of the hardware counter.
+ *
+ * The compare interrupt is enabled while the timer runs, so that
+ * ullBSPACMhires() can count wraps.  With a 16-bit counter (TIMER1
+ * or TIMER2) this wakes the core every 65536 timer ticks: 4.096 ms
+ * at 16 MHz, 65.536 ms at 1 MHz.  That defeats low-power idle; use
+ * TIMER0, where the 32-bit counter wraps every 268 s at 16 MHz, or
+ * stop the timer with iBSPACMhiresSetEnabled() while idle.
+ *
+ * This must not be 0, and must not be #BSPACM_PROFILE_HIRES_CC when
+ * profiling from the hires timer.
+ *
+ * @cppflag
+ * @defaulted */
+#define BSPACM_HIRES_OVERFLOW_CCIDX 1
+#endif /* BSPACM_HIRES_OVERFLOW_CCIDX */
+
+#if (0 == BSPACM_HIRES_OVERFLOW_CCIDX)
+#error BSPACM_HIRES_OVERFLOW_CCIDX is not valid
+#endif /* BSPACM_HIRES_OVERFLOW_CCIDX */
+
+#ifndef BSPACM_HIRES_ALARM_CCIDX
+/** The #BSPACM_HIRES_TIMER capture/compare register programmed for
+ * the earliest alarm scheduled with iBSPACMhiresAlarmSchedule().
+ *
+ * This must be neither 0 nor #BSPACM_HIRES_OVERFLOW_CCIDX, and must
+ * not be #BSPACM_PROFILE_HIRES_CC when profiling from the hires
+ * timer.
+ *
+ * @cppflag
+ * @defaulted */
+#define BSPACM_HIRES_ALARM_CCIDX 2
+#endif /* BSPACM_HIRES_ALARM_CCIDX */
+
+#if (0 == BSPACM_HIRES_ALARM_CCIDX) || (BSPACM_HIRES_OVERFLOW_CCIDX == BSPACM_HIRES_ALARM_CCIDX)
+#error BSPACM_HIRES_ALARM_CCIDX is not valid
+#endif /* BSPACM_HIRES_ALARM_CCIDX */
+
+#ifndef BSPACM_HIRES_CAPTURE_CCIDX
+/** The #BSPACM_HIRES_TIMER capture/compare register into which
+ * iBSPACMhiresCaptureStart() directs hardware captures.
+ *
+ * This must be distinct from 0, #BSPACM_HIRES_OVERFLOW_CCIDX and
+ * #BSPACM_HIRES_ALARM_CCIDX, and must not be #BSPACM_PROFILE_HIRES_CC
+ * when profiling from the hires timer.
+ *
+ * @cppflag
+ * @defaulted */
+#define BSPACM_HIRES_CAPTURE_CCIDX 3
+#endif /* BSPACM_HIRES_CAPTURE_CCIDX */
+
+#if (0 == BSPACM_HIRES_CAPTURE_CCIDX) || (BSPACM_HIRES_OVERFLOW_CCIDX == BSPACM_HIRES_CAPTURE_CCIDX) || (BSPACM_HIRES_ALARM_CCIDX == BSPACM_HIRES_CAPTURE_CCIDX)
+#error BSPACM_HIRES_CAPTURE_CCIDX is not valid
+#endif /* BSPACM_HIRES_CAPTURE_CCIDX */
+
+/** @def BSPACM_HIRES_Hz
+ *
+ * If defined, the frequency the application passes to
+ * iBSPACMhiresInitialize().  The conversion functions then shift by a
+ * constant fixed at compile time, rather than reading the timer
+ * prescaler register on every call.
+ *
+ * @cppflag */
+
+/** @cond DOXYGEN_EXCLUDE */
+#if defined(BSPACM_HIRES_Hz)
+#define BSPACM_HIRES_PRESCALER_() ((unsigned int)iBSPACMbitsFindFirstSet(16000000U / (BSPACM_HIRES_Hz)))
+#else /* BSPACM_HIRES_Hz */
+#define BSPACM_HIRES_PRESCALER_() (BSPACM_HIRES_TIMER->PRESCALER)
+#endif /* BSPACM_HIRES_Hz */
+/** @endcond */
+
 /** Initialize #BSPACM_HIRES_TIMER to run at the specified frequency.
  *
  * @param freq_Hz the desired high-resolution frequency.  The 16 MHz
@@ -102,6 +199,9 @@ bool
 bBSPACMhiresEnabled (void);
 
 /** Enable or disable the high-resolution timer.
+ *
+ * Disabling the timer discards any alarms scheduled with
+ * iBSPACMhiresAlarmSchedule().
  *
  * @param enabled if true, enable the timer; if false, disable it.
  *
@@ -111,13 +211,33 @@ bBSPACMhiresEnabled (void);
 int
 iBSPACMhiresSetEnabled (bool enabled);
 
+/** The current state of the high-resolution timer.
+ *
+ * This is global to allow access from inline functions.  User
+ * application should never inspect nor mutate any of these fields. */
+typedef struct sBSPACMhiresState {
+  /** Counts the number of times the hardware counter has wrapped
+   * since the timer was enabled. */
+  volatile unsigned int overflows;
+} sBSPACMhiresState;
+
+/** @cond DOXYGEN_EXCLUDE */
+/* This doesn't exist. */
+extern sBSPACMhiresState xBSPACMhiresState_;
+/** @endcond */
+
 /** Read the counter of the high-resolution timer.
+ *
+ * The counter is captured into capture/compare register 0, which is
+ * used for nothing else.  This may be invoked from any context: if
+ * an interrupt handler reads the counter between the capture and the
+ * read here, the value returned is merely a few ticks later.
  *
  * @warning When calculating durations, be aware that the timer may
  * not support a 32-bit counter, resulting in unexpected behavior if
  * unsigned integer arithmetic involves an underflow or overflow.  You
  * may get better results by casting operands to @c uint16_t before
- * subtracting to obtain a duration. */
+ * subtracting to obtain a duration, or by using ullBSPACMhires(). */
 inline
 unsigned int
 uiBSPACMhires (void)
@@ -126,13 +246,51 @@ uiBSPACMhires (void)
   return BSPACM_HIRES_TIMER->CC[0];
 }
 
+/** Read the high-resolution timer extended to 64 bits.
+ *
+ * The hardware counter is extended by the number of times it has
+ * wrapped, which the timer interrupt counts using capture/compare
+ * register #BSPACM_HIRES_OVERFLOW_CCIDX.  The extended value does not
+ * wrap for at least 2^48 ticks (203 days at 16 MHz), so intervals of
+ * any practical length can be measured at full resolution on any
+ * timer instance.
+ *
+ * The value is consistent even when invoked with interrupts disabled
+ * or from an interrupt handler that preempts the timer handler,
+ * provided the timer interrupt is not held off for longer than half
+ * a counter wrap (2.048 ms for a 16-bit counter at 16 MHz).
+ *
+ * @note The count restarts at zero when the timer is enabled. */
+inline
+unsigned long long
+ullBSPACMhires (void)
+{
+  unsigned int ofl;
+  unsigned int ctr;
+  bool wrapped;
+
+  /* Get a consistent pair of counter and overflow values.  A wrap
+   * that has happened but not yet been counted by the handler shows
+   * as a pending compare event; it belongs to this reading only if
+   * the captured counter is in the lower half of its range. */
+  do {
+    ofl = xBSPACMhiresState_.overflows;
+    ctr = uiBSPACMhires();
+    wrapped = BSPACM_HIRES_TIMER->EVENTS_COMPARE[BSPACM_HIRES_OVERFLOW_CCIDX];
+  } while (ofl != xBSPACMhiresState_.overflows);
+  if (wrapped && (0 == (ctr >> (BSPACM_HIRES_COUNTER_BITS - 1)))) {
+    ++ofl;
+  }
+  return (((unsigned long long)ofl) << BSPACM_HIRES_COUNTER_BITS) | ctr;
+}
+
 /** Convert from ticks of the 16 MHz core system clock to ticks of
  * #BSPACM_HIRES_TIMER */
 inline
 unsigned int
 uiBSPACMhiresConvert_hfclk_hrt (unsigned int dur_hfclk)
 {
-  return dur_hfclk >> BSPACM_HIRES_TIMER->PRESCALER;
+  return dur_hfclk >> BSPACM_HIRES_PRESCALER_();
 }
 
 /** Convert from ticks of #BSPACM_HIRES_TIMER to ticks of the 16 MHz
@@ -141,7 +299,7 @@ inline
 unsigned int
 uiBSPACMhiresConvert_hrt_hfclk (unsigned int dur_hrt)
 {
-  return dur_hrt << BSPACM_HIRES_TIMER->PRESCALER;
+  return dur_hrt << BSPACM_HIRES_PRESCALER_();
 }
 
 /** Convert from microseconds to ticks of the 16 MHz core system clock. */
@@ -157,7 +315,7 @@ inline
 unsigned int
 uiBSPACMhiresConvert_us_hrt (unsigned int dur_us)
 {
-  int shift = 4 - (int)BSPACM_HIRES_TIMER->PRESCALER;
+  int shift = 4 - (int)BSPACM_HIRES_PRESCALER_();
   if (0 < shift) {
     return dur_us << shift;
   }
@@ -169,13 +327,184 @@ inline
 unsigned int
 uiBSPACMhiresConvert_hrt_us (unsigned int dur_hrt)
 {
-  int shift = 4 - (int)BSPACM_HIRES_TIMER->PRESCALER;
+  int shift = 4 - (int)BSPACM_HIRES_PRESCALER_();
   if (0 < shift) {
     return dur_hrt >> shift;
   }
   return dur_hrt << -shift;
 }
 
+/* Forward declaration */
+struct sBSPACMhiresAlarm;
+
+/** Type for a hires alarm callback function.
+ *
+ * It is explicitly permitted to invoke iBSPACMhiresAlarmSchedule()
+ * and bBSPACMhiresAlarmCancel() from within the callback.
+ *
+ * @param ap pointer to the alarm structure.  This may be embedded in
+ * a larger structure to pass context to the callback.
+ *
+ * @note The callback is invoked from the #BSPACM_HIRES_TIMER
+ * interrupt handler and is subject to all the usual caveats about
+ * what should be done in that context.  In particular it must not
+ * invoke vBSPACMhiresSleep_us().
+ *
+ * @note After the callback returns the handler posts
+ * #BSPACM_EVENT_HIRES_ALARM to #xBSPACMeventSystem. */
+typedef void (* vBSPACMhiresAlarmCallback_flih) (struct sBSPACMhiresAlarm * ap);
+
+/** State for an alarm driven by the high-resolution timer. */
+typedef struct sBSPACMhiresAlarm {
+  /** An optional callback, invoked from the handler after applying
+   * #interval_hrt. */
+  vBSPACMhiresAlarmCallback_flih callback_flih;
+
+  /** An optional interval between repeated alarms, in hires ticks.
+   *
+   * If the value is not zero the alarm is rescheduled for @p
+   * interval_hrt ticks after the time it was due, before the callback
+   * is invoked.  Repetitions therefore do not accumulate handler
+   * latency. */
+  unsigned int interval_hrt;
+
+  /** An optional task, posted from the handler after invoking
+   * #callback_flih. */
+  struct sBSPACMtask * task;
+
+  /** The value of ullBSPACMhires() at which the alarm is due.  When
+   * the callback is invoked this is the time the alarm was due, or if
+   * #interval_hrt is non-zero the time of the next repetition. */
+  unsigned long long when_hrt;
+
+  /** True while the alarm is in the alarm queue.  Managed by the
+   * hires infrastructure. */
+  volatile bool scheduled_;
+
+  /** Link for the alarm queue, which is sorted by #when_hrt.  Managed
+   * by the hires infrastructure. */
+  struct sBSPACMhiresAlarm * next_;
+} sBSPACMhiresAlarm;
+
+/** A handle to a hires alarm structure */
+typedef sBSPACMhiresAlarm * hBSPACMhiresAlarm;
+
+/** Schedule an alarm on the high-resolution timer.
+ *
+ * Any number of alarms may be scheduled.  They are kept in a queue
+ * sorted by due time, and capture/compare register
+ * #BSPACM_HIRES_ALARM_CCIDX is programmed for the earliest.  Alarms
+ * due beyond the range of the hardware counter are reached through
+ * intermediate compares every half counter range.  Scheduling takes
+ * time linear in the number of alarms due earlier; expiry takes
+ * constant time.
+ *
+ * Unlike vBSPACMhiresSleep_us() this does not block, and it may be
+ * invoked from interrupt handlers.
+ *
+ * @param when_hrt the time at which the alarm is due, as a value of
+ * ullBSPACMhires().  If this time has passed the alarm fires as soon
+ * as possible.
+ *
+ * @param ap a pointer to the alarm structure
+ *
+ * @return 0 if successfully scheduled, or a negative error code if
+ * the timer is not enabled or the alarm is already scheduled. */
+int
+iBSPACMhiresAlarmSchedule (unsigned long long when_hrt,
+                           hBSPACMhiresAlarm ap);
+
+/** Remove an alarm from the hires alarm queue.
+ *
+ * @param ap a pointer to the alarm structure
+ *
+ * @return @c true if the alarm was scheduled and has been removed,
+ * @c false if it was not scheduled. */
+bool
+bBSPACMhiresAlarmCancel (hBSPACMhiresAlarm ap);
+
+/** Begin timestamping edges on a GPIO pin.
+ *
+ * A GPIOTE channel detects the edge and a PPI channel routes the
+ * event to the #BSPACM_HIRES_TIMER capture task, so the timestamp is
+ * latched in #BSPACM_HIRES_CAPTURE_CCIDX by hardware at the edge with
+ * single-tick precision, regardless of interrupt latency or what the
+ * CPU is doing.  The GPIOTE interrupt then extends the captured
+ * value to the ullBSPACMhires() time base and appends it to a ring
+ * buffer, from which the application retrieves it with
+ * bBSPACMhiresCaptureGet().
+ *
+ * The nRF51 TIMER has no DMA, so the interrupt is still needed per
+ * edge to move the latched value before the next edge overwrites it.
+ * An edge that arrives before the previous one has been moved
+ * replaces it.  Both that lost edge and an edge that arrives when the
+ * ring is full are counted by uiBSPACMhiresCaptureDropped().  A loss
+ * can go uncounted only when three edges arrive within the few
+ * cycles the handler takes to read the capture register twice.
+ *
+ * Only one capture may be active at a time.
+ *
+ * @note GPIOTE has a single interrupt shared by all channels, so
+ * this module does not define <tt>GPIOTE_IRQHandler()</tt>.  The
+ * application must define it and call vBSPACMhiresCaptureIRQHandler()
+ * from it.
+ *
+ * @param pin the GPIO pin number, which must already be configured
+ * as an input
+ *
+ * @param polarity the edge to capture, as a
+ * <tt>GPIOTE_CONFIG_POLARITY_</tt> value (@c LoToHi, @c HiToLo, or
+ * @c Toggle)
+ *
+ * @param gpiote_chidx the GPIOTE channel to use
+ *
+ * @param ppi_chidx the PPI channel to use
+ *
+ * @param ring storage for captured timestamps
+ *
+ * @param ring_len the number of entries in @p ring.  This must be a
+ * power of two.
+ *
+ * @return 0 if the capture was started, or a negative error code if
+ * the timer is not enabled, a capture is already active, or the
+ * parameters are invalid. */
+int
+iBSPACMhiresCaptureStart (unsigned int pin,
+                          unsigned int polarity,
+                          unsigned int gpiote_chidx,
+                          unsigned int ppi_chidx,
+                          unsigned long long * ring,
+                          unsigned int ring_len);
+
+/** Stop timestamping and release the GPIOTE and PPI channels.
+ * Timestamps already in the ring remain available to
+ * bBSPACMhiresCaptureGet(). */
+void
+vBSPACMhiresCaptureStop (void);
+
+/** Remove the oldest timestamp from the capture ring.
+ *
+ * @param hrtp where to store the timestamp, as a value of
+ * ullBSPACMhires()
+ *
+ * @return @c true if a timestamp was stored, @c false if the ring
+ * is empty. */
+bool
+bBSPACMhiresCaptureGet (unsigned long long * hrtp);
+
+/** Return the number of edges discarded since
+ * iBSPACMhiresCaptureStart(), because the capture ring was full or
+ * the timestamp was overwritten by a following edge before the
+ * handler moved it. */
+unsigned int
+uiBSPACMhiresCaptureDropped (void);
+
+/** Service the capture GPIOTE channel.  The application must invoke
+ * this from its <tt>GPIOTE_IRQHandler()</tt> while a capture is
+ * active. */
+void
+vBSPACMhiresCaptureIRQHandler (void);
+
 /** Sleep for the desired duration.
  *
  * This will enter basic sleep mode if the duration is long enough;
@@ -183,21 +512,24 @@ uiBSPACMhiresConvert_hrt_us (unsigned int dur_hrt)
  * to extending too long due to processed interrupts; the duration
  * when sleeping will be more accurate.
  *
+ * The sleep is an internal alarm in the iBSPACMhiresAlarmSchedule()
+ * queue, so it is measured against ullBSPACMhires() and is not
+ * limited by the width of the hardware counter.  Its expiry does not
+ * post #BSPACM_EVENT_HIRES_ALARM.
+ *
  * @param count_us the duration to sleep, expressed in microseconds
  *
  * @warning The infrastructure does not check for overflow in
- * converting @p count_us to hires clock ticks.  Unless you are using
- * TIMER0, the timer has only 16 bits and will overflow at
- * divisor*4.096 ms.  This means the maximum delay for a 1 MHz timer
- * is 65.535 ms.
+ * converting @p count_us to a 32-bit count of hires clock ticks.  At
+ * 16 MHz the maximum delay is 268 s.
  *
  * @warning If you invoke this when bBSPACMhiresEnabled() returns
  * false it will hang.  This is a bigger clue that your program is
  * incorrect than any other reasonable behavior.
  *
- * @warning Do not invoke this from first-level interrupt handlers.
- * Even if PAN #6 is fixed in your hardware, you may be overwriting
- * the deadline for a user-level delay. */
+ * @warning Do not invoke this from first-level interrupt handlers,
+ * nor with interrupts disabled: the sleep ends only when the
+ * #BSPACM_HIRES_TIMER interrupt handler runs. */
 void
 vBSPACMhiresSleep_us (unsigned long count_us);
 
@@ -92,6 +92,16 @@ extern "C" {
 #error Unrecognized uptime RTC
 #endif /* BSPACM_UPTIME_RTC_BASE */
 
+/** The capture/compare register that drives alarms scheduled with
+ * iBSPACMuptimeAlarmSchedule().  This register is not available to
+ * iBSPACMuptimeAlarmSet().
+ *
+ * @cppflag
+ * @defaulted */
+#ifndef BSPACM_UPTIME_TIMER_CCIDX
+#define BSPACM_UPTIME_TIMER_CCIDX (BSPACM_UPTIME_CC_COUNT - 1)
+#endif /* BSPACM_UPTIME_TIMER_CCIDX */
+
 /** The frequency of the BSPACM_UPTIME_RTC peripheral in Hz. */
 #define BSPACM_UPTIME_Hz 32768U
 
@@ -99,38 +109,117 @@ extern "C" {
  * bBSPACMuptimeSleep() to actually sleep. */
 #define BSPACM_UPTIME_SLEEP_MINIMUM 2
 
-/** Convert a time from microseconds to uptime ticks, rounding up. */
+/* The conversions below divide by multiplying with precomputed
+ * reciprocals, which are valid only for this frequency. */
+#if (32768U != BSPACM_UPTIME_Hz)
+#error Uptime conversions assume a 32 KiHz uptime clock
+#endif /* BSPACM_UPTIME_Hz */
+
+/** Convert a time from microseconds to uptime ticks, rounding up.
+ *
+ * 1 utt = 10^6/2^15 us = 15625/512 us.  The input is split into
+ * whole multiples of 15625 us and a remainder so that no
+ * intermediate overflows; each part is divided by multiplying with a
+ * reciprocal.  The result is exact for every 32-bit input. */
 inline
 unsigned int
 uiBSPACMuptimeConvert_us_utt (unsigned int dur_us)
 {
-  const unsigned int us_per_s = 1000000U;
-  return (dur_us * BSPACM_UPTIME_Hz + us_per_s - 1) / us_per_s;
+  /* q = floor(dur_us / 15625) for all 32-bit dur_us */
+  unsigned int const q = ((unsigned long long)dur_us * 1125899907U) >> 44;
+  unsigned int const r = dur_us - 15625U * q;
+  /* ceil(r * 512 / 15625) for r < 15625 */
+  return (q << 9) + (unsigned int)(((unsigned long long)((r << 9) + 15624U) * 17592187U) >> 38);
 }
 
-/** Convert a time from milliseconds to uptime ticks, rounding up. */
+/** Convert a time from milliseconds to uptime ticks, rounding up.
+ *
+ * 1 utt = 1000/2^15 ms = 125/4096 ms.  The result is exact for every
+ * input where it fits in 32 bits, i.e. durations up to 131071999
+ * ms. */
 inline
 unsigned int
 uiBSPACMuptimeConvert_ms_utt (unsigned int dur_ms)
 {
-  const unsigned int ms_per_s = 1000U;
-  return (dur_ms * BSPACM_UPTIME_Hz + ms_per_s - 1) / ms_per_s;
+  /* q = floor(dur_ms / 125) for all 32-bit dur_ms */
+  unsigned int const q = ((unsigned long long)dur_ms * 274877907U) >> 35;
+  unsigned int const r = dur_ms - 125U * q;
+  /* ceil(r * 4096 / 125) for r < 125 */
+  return (q << 12) + (unsigned int)(((unsigned long long)((r << 12) + 124U) * 536871U) >> 26);
 }
 
-/** Convert a time from uptime ticks to microseconds, rounding up. */
+/** Convert a time from uptime ticks to microseconds, rounding up.
+ *
+ * This uses only 32-bit arithmetic.  The result is exact for every
+ * input where it fits in 32 bits, i.e. durations up to 140737488
+ * ticks.  Use ullBSPACMuptimeConvert_utt_us() for longer
+ * durations. */
 inline
 unsigned int
 uiBSPACMuptimeConvert_utt_us (unsigned int dur_utt)
 {
-  return ((1000000ULL * dur_utt) + BSPACM_UPTIME_Hz - 1) / BSPACM_UPTIME_Hz;
+  return 15625U * (dur_utt >> 9) + (((dur_utt & 0x1FF) * 15625U + 0x1FF) >> 9);
 }
 
-/** Convert a time from uptime ticks to milliseconds, rounding up. */
+/** Convert a time from uptime ticks to milliseconds, rounding up.
+ *
+ * This uses only 32-bit arithmetic and is exact for every 32-bit
+ * input. */
 inline
 unsigned int
 uiBSPACMuptimeConvert_utt_ms (unsigned int dur_utt)
 {
-  return ((1000ULL * dur_utt) + BSPACM_UPTIME_Hz - 1) / BSPACM_UPTIME_Hz;
+  return 125U * (dur_utt >> 12) + (((dur_utt & 0xFFF) * 125U + 0xFFF) >> 12);
+}
+
+/** Convert a time from uptime ticks to microseconds, rounding up.
+ *
+ * The result is exact over the full 56-bit range of
+ * ullBSPACMuptime(). */
+inline
+unsigned long long
+ullBSPACMuptimeConvert_utt_us (unsigned long long dur_utt)
+{
+  return 15625ULL * (dur_utt >> 9) + ((((unsigned int)dur_utt & 0x1FF) * 15625U + 0x1FF) >> 9);
+}
+
+/** Convert a time from uptime ticks to milliseconds, rounding up.
+ *
+ * The result is exact over the full 56-bit range of
+ * ullBSPACMuptime(). */
+inline
+unsigned long long
+ullBSPACMuptimeConvert_utt_ms (unsigned long long dur_utt)
+{
+  return 125ULL * (dur_utt >> 12) + ((((unsigned int)dur_utt & 0xFFF) * 125U + 0xFFF) >> 12);
+}
+
+/** The largest magnitude of rate correction accepted by
+ * llBSPACMuptimeRateCorrection_us(), in units of 2<sup>-32</sup>.
+ * This is about 976 ppm, far beyond the tolerance of any usable 32
+ * KiHz crystal or calibrated RC oscillator. */
+#define BSPACM_UPTIME_RATE_LIMIT_Q32 (1L << 22)
+
+/** Calculate a rate correction to a duration.
+ *
+ * @param dur_us a duration in microseconds, e.g. from
+ * ullBSPACMuptimeConvert_utt_us()
+ *
+ * @param rate_q32 the fractional rate error, in units of
+ * 2<sup>-32</sup>.  The magnitude must not exceed
+ * #BSPACM_UPTIME_RATE_LIMIT_Q32.
+ *
+ * @return @p dur_us * @p rate_q32 * 2<sup>-32</sup>, rounded toward
+ * negative infinity.  The duration is split so that no intermediate
+ * overflows for any duration representable by the uptime clock. */
+inline
+long long
+llBSPACMuptimeRateCorrection_us (unsigned long long dur_us,
+                                 long rate_q32)
+{
+  long long hi = (long long)(dur_us >> 20) * rate_q32;
+  long long lo = (long long)(dur_us & 0xFFFFF) * rate_q32;
+  return (hi >> 12) + (lo >> 32);
 }
 
 /* Forward declaration */
@@ -150,7 +239,11 @@ struct sBSPACMuptimeAlarm;
  *
  * @note If the registered alarm is scheduled for repeated invocation,
  * the corresponding compare register will have been updated to the
- * next alarm time prior to invoking the callback. */
+ * next alarm time prior to invoking the callback.
+ *
+ * @note After the callback returns the handler posts
+ * #BSPACM_EVENT_UPTIME_ALARM to #xBSPACMeventSystem, so a main loop
+ * blocked in uiBSPACMeventWait() need not install a callback. */
 typedef void (* vBSPACMuptimeAlarmCallback_flih) (int ccidx,
                                                   struct sBSPACMuptimeAlarm * ap);
 
@@ -168,6 +261,27 @@ typedef struct sBSPACMuptimeAlarm {
    * applied before the callback is invoked, so the callback may
    * override that behavior. */
   unsigned int interval_utt;
+
+  /** An optional task, posted from the handler after invoking
+   * #callback_flih.  Work that need not be done at interrupt priority
+   * belongs here. */
+  struct sBSPACMtask * task;
+
+  /** For alarms scheduled with iBSPACMuptimeAlarmSchedule(), the
+   * uptime at which the alarm is due.  When the callback is invoked
+   * this is the time the alarm was due, or if #interval_utt is
+   * non-zero the time of the next repetition. */
+  unsigned int when_utt;
+
+  /** True while the alarm is in the software alarm queue.  Managed
+   * by the uptime infrastructure. */
+  volatile bool scheduled_;
+
+  /** Links for the software alarm queue, which is a pairing heap.
+   * Managed by the uptime infrastructure. */
+  struct sBSPACMuptimeAlarm * child_;
+  struct sBSPACMuptimeAlarm * next_;
+  struct sBSPACMuptimeAlarm * prev_;
 } sBSPACMuptimeAlarm;
 
 /** A handle to an uptime alarm structure */
@@ -198,6 +312,27 @@ typedef struct sBSPACMuptimeState {
   /** Pointer to alarms that fire from the uptime clock. */
   hBSPACMuptimeAlarm volatile alarm[BSPACM_UPTIME_CC_COUNT];
 
+  /** The root of the software alarm queue, which is the alarm due
+   * soonest. */
+  hBSPACMuptimeAlarm timers;
+
+  /** Uptime ticks spent in uiBSPACMuptimeIdle() since
+   * #idle_epoch_utt. */
+  unsigned long long idle_asleep_utt;
+
+  /** The uptime at which idle statistics were last reset. */
+  unsigned long long idle_epoch_utt;
+
+  /** The number of uiBSPACMuptimeIdle() calls since
+   * #idle_epoch_utt. */
+  unsigned int idle_count;
+
+  /** The fractional rate by which an uptime tick is longer than
+   * nominal, as measured against the high-frequency clock by
+   * iBSPACMuptimeCalibrationStart(), in units of 2<sup>-32</sup>.
+   * Zero if no calibration has completed. */
+  volatile long calibration_q32;
+
   /** True iff the timer has been initialized and is running */
   bool enabled;
 } sBSPACMuptimeState;
@@ -212,7 +347,8 @@ extern sBSPACMuptimeState xBSPACMuptimeState_;
  * @param ccidx the capture/compare register to use for the alarm.  If
  * the passed value is not valid for the RTC peripheral being used as
  * #BSPACM_UPTIME_RTC, or if there is already an alarm attached to the
- * register, the call returns an error.  Note that ccidx 0 is reserved.
+ * register, the call returns an error.  Note that ccidx 0 and
+ * #BSPACM_UPTIME_TIMER_CCIDX are reserved.
  *
  * @param when_utt the absolute time at which the alarm should go off.
  * @note Alarm times are limited by the 24-bit resolution of the RTC.
@@ -227,6 +363,44 @@ iBSPACMuptimeAlarmSet (int ccidx,
                        unsigned int when_utt,
                        hBSPACMuptimeAlarm ap);
 
+/** Schedule an alarm in the software alarm queue.
+ *
+ * Any number of alarms may be scheduled this way.  They share
+ * capture/compare register #BSPACM_UPTIME_TIMER_CCIDX, which is
+ * always programmed for the alarm that is due soonest.  Scheduling
+ * takes constant time; removing the earliest alarm when it fires
+ * takes amortized logarithmic time in the number of scheduled
+ * alarms.
+ *
+ * Times are compared modulo 2^32, so every scheduled alarm must be
+ * due within 2^31 ticks (about 18 hours) of the current time.  The
+ * 24-bit RTC counter wrap is handled internally.
+ *
+ * The alarm callback is invoked with @p ccidx
+ * #BSPACM_UPTIME_TIMER_CCIDX.  It may schedule or cancel any alarm,
+ * including the one that fired.
+ *
+ * @param when_utt the time at which the alarm is due, as a value of
+ * uiBSPACMuptime().  If this time has passed the alarm fires as soon
+ * as possible.
+ *
+ * @param ap a pointer to the alarm structure
+ *
+ * @return 0 if successfully scheduled, or a negative error code if
+ * the clock is not running or the alarm is already scheduled. */
+int
+iBSPACMuptimeAlarmSchedule (unsigned int when_utt,
+                            hBSPACMuptimeAlarm ap);
+
+/** Remove an alarm from the software alarm queue.
+ *
+ * @param ap a pointer to the alarm structure
+ *
+ * @return @c true if the alarm was scheduled and has been removed,
+ * @c false if it was not scheduled. */
+bool
+bBSPACMuptimeAlarmCancel (hBSPACMuptimeAlarm ap);
+
 /** Remove an alarm from the uptime clock
  *
  * @param ccidx the capture/compare register from which the alarm
@@ -308,6 +482,139 @@ vBSPACMuptimeSleepCancel (void);
 bool
 bBSPACMuptimeSleep (unsigned int duration_utt);
 
+/** Determine when the next uptime alarm is due.
+ *
+ * This considers both alarms attached to a capture/compare register
+ * with iBSPACMuptimeAlarmSet() and the earliest alarm in the
+ * software queue.
+ *
+ * @param when_uttp where to store the time the alarm is due, as a
+ * value of uiBSPACMuptime().  Not modified if no alarm is pending.
+ *
+ * @return @c true iff an alarm is pending */
+bool
+bBSPACMuptimeNextAlarm (unsigned int * when_uttp);
+
+/** Idle the core until the next interrupt.
+ *
+ * The core enters System ON low-power mode with the uptime RTC
+ * running.  Every pending uptime alarm has its compare register
+ * programmed, so the sleep lasts no longer than the time until
+ * the next alarm (see bBSPACMuptimeNextAlarm()), or until some other
+ * interrupt.  There is no periodic tick from the uptime clock, but a
+ * running hires timer on TIMER1 or TIMER2 wakes the core on every
+ * counter wrap, every 4.096 ms at 16 MHz (see
+ * #BSPACM_HIRES_OVERFLOW_CCIDX); use TIMER0 for the hires timer, or
+ * stop it, when idle time matters.  The time spent asleep is
+ * accumulated for vBSPACMuptimeIdleStatistics().
+ *
+ * Invoke this with interrupts disabled, after confirming there is no
+ * work to do.  The core wakes when an interrupt becomes pending, but
+ * its handler does not run until the caller re-enables interrupts.
+ * This avoids losing a wakeup that happens between the check and the
+ * sleep.
+ *
+ * @return the number of uptime ticks spent asleep */
+unsigned int
+uiBSPACMuptimeIdle (void);
+
+/** Idle-time accounting from uiBSPACMuptimeIdle(). */
+typedef struct sBSPACMuptimeIdleStatistics {
+  /** Uptime ticks elapsed since the statistics were reset */
+  unsigned long long elapsed_utt;
+  /** Uptime ticks of #elapsed_utt spent asleep */
+  unsigned long long asleep_utt;
+  /** The number of times the core went to sleep */
+  unsigned int idle_count;
+} sBSPACMuptimeIdleStatistics;
+
+/** Retrieve idle-time accounting.
+ *
+ * The awake time is sBSPACMuptimeIdleStatistics::elapsed_utt less
+ * sBSPACMuptimeIdleStatistics::asleep_utt.
+ *
+ * @param sp where to store the statistics, or a null pointer to
+ * only reset them
+ *
+ * @param reset if @c true the statistics are reset after being
+ * retrieved */
+void
+vBSPACMuptimeIdleStatistics (sBSPACMuptimeIdleStatistics * sp,
+                             bool reset);
+
+/** Begin calibrating the uptime clock against the high-frequency
+ * clock.
+ *
+ * The low-frequency clock feeding the uptime RTC may be an RC
+ * oscillator or a poor crystal, with an error of tens or hundreds of
+ * ppm.  The high-frequency clock is normally a crystal with a much
+ * smaller error.  Calibration counts ticks of #BSPACM_HIRES_TIMER
+ * over @p window_utt uptime ticks, and records the fractional
+ * difference from the nominal ratio for
+ * ullBSPACMuptimeCalibratedConvert_utt_us() and
+ * iBSPACMuptimeCalibration_ppb().
+ *
+ * Measurement runs in the background from a software alarm (see
+ * iBSPACMuptimeAlarmSchedule()) that fires at the start and end of
+ * each window.  Each timestamps an uptime tick edge with the hires
+ * timer by polling in the alarm handler, normally for less than one
+ * uptime tick (30.5 us).  Interrupts are not disabled.  An edge at
+ * which the poll was preempted is rejected and the next one tried;
+ * after four such edges (122 us) the handler returns and the sample
+ * is retried about 1 ms later, extending the window if necessary.
+ *
+ * @param window_utt the duration of each measurement.  The
+ * resolution is roughly one hires tick divided by the window, so
+ * several seconds are needed for sub-ppm results.  Must be less than
+ * 2<sup>23</sup>.
+ *
+ * @param interval_utt the time between the starts of successive
+ * measurements, or zero to measure only once.  If non-zero must be
+ * at least @p window_utt.
+ *
+ * @return 0 if calibration was started, or a negative error code if
+ * the uptime clock or high-resolution timer is not running, a
+ * calibration is already in progress, or the parameters are invalid.
+ *
+ * @note The high-resolution timer keeps the high-frequency clock
+ * running during calibration. */
+int
+iBSPACMuptimeCalibrationStart (unsigned int window_utt,
+                               unsigned int interval_utt);
+
+/** Stop background calibration.
+ *
+ * A measurement in progress is discarded.  The most recent completed
+ * calibration remains in effect. */
+void
+vBSPACMuptimeCalibrationStop (void);
+
+/** Return the most recently measured uptime clock error in parts per
+ * billion.
+ *
+ * A positive value indicates that the uptime clock runs slow, i.e.
+ * each tick is longer than nominal.  Zero if no calibration has
+ * completed. */
+inline
+int
+iBSPACMuptimeCalibration_ppb (void)
+{
+  return ((long long)xBSPACMuptimeState_.calibration_q32 * 1000000000LL) >> 32;
+}
+
+/** Convert a time from uptime ticks to microseconds, applying the
+ * most recent calibration.
+ *
+ * @see ullBSPACMuptimeConvert_utt_us()
+ * @see iBSPACMuptimeCalibrationStart() */
+inline
+unsigned long long
+ullBSPACMuptimeCalibratedConvert_utt_us (unsigned long long dur_utt)
+{
+  unsigned long long dur_us = ullBSPACMuptimeConvert_utt_us(dur_utt);
+  return dur_us + llBSPACMuptimeRateCorrection_us(dur_us, xBSPACMuptimeState_.calibration_q32);
+}
+
 #ifdef __cplusplus
 }
 #endif /* __cplusplus */
@@ -0,0 +1,176 @@
+/* Copyright 2015, Peter A. Bigot
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of the software nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without
+ *   specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/** @file
+ *
+ * @brief nRF51-specific support for a wall-clock time service
+ *
+ * Wall-clock time is maintained as a linear function of the uptime
+ * clock.  The function is established by synchronization points:
+ * each call to vBSPACMwalltimeSync() records the UTC time that
+ * corresponded to a particular uptime.  The first point fixes the
+ * offset; later points additionally estimate the rate at which the
+ * uptime clock drifts relative to the reference, which is then
+ * applied when extrapolating from the most recent point.
+ *
+ * Conversion parameters are published through a sequence lock.  The
+ * writer updates them with interrupts disabled; readers never block
+ * or disable interrupts, but retry if an update completed while they
+ * were copying the parameters.  Consequently llBSPACMwalltime_us()
+ * and llBSPACMwalltimeFromUptime_us() may be invoked from interrupt
+ * handlers, e.g. to timestamp an event at the moment it occurs.
+ *
+ * When this module is linked, it provides the newlib
+ * <tt>_gettimeofday()</tt> system call and an implementation of
+ * <tt>clock_gettime()</tt> supporting @c CLOCK_REALTIME and @c
+ * CLOCK_MONOTONIC.  Note that the module is pulled from the archive
+ * only when the application references one of its functions, such as
+ * vBSPACMwalltimeSync(); otherwise the weak stub in @c nosys.c
+ * remains in effect.
+ *
+ * @homepage http://github.com/pabigot/bspacm
+ * @copyright Copyright 2015, Peter A. Bigot.  Licensed under <a href="http://www.opensource.org/licenses/BSD-3-Clause">BSD-3-Clause</a>
+ */
+
+#ifndef BSPACM_DEVICE_NRF51_INTERNAL_UTILITY_WALLTIME_H
+#define BSPACM_DEVICE_NRF51_INTERNAL_UTILITY_WALLTIME_H
+
+#include <bspacm/core.h>
+#include <bspacm/utility/uptime.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+#ifndef BSPACM_WALLTIME_RATE_MINIMUM_INTERVAL_UTT
+/** The minimum uptime interval between two synchronization points
+ * for the second to update the rate estimate.  Points closer than
+ * this only correct the offset, since timestamp jitter would dominate
+ * a rate computed over a short baseline.
+ *
+ * @cppflag
+ * @defaulted */
+#define BSPACM_WALLTIME_RATE_MINIMUM_INTERVAL_UTT (60U * BSPACM_UPTIME_Hz)
+#endif /* BSPACM_WALLTIME_RATE_MINIMUM_INTERVAL_UTT */
+
+/** State for the wall-clock time service.
+ *
+ * Do not access this directly; use vBSPACMwalltimeSync() to update
+ * it and the llBSPACMwalltime functions to read it. */
+typedef struct sBSPACMwalltimeState {
+  /** Sequence lock.  Odd while an update is in progress; incremented
+   * twice by each update. */
+  volatile unsigned int sequence;
+
+  /** The uptime of the most recent synchronization point. */
+  unsigned long long base_utt;
+
+  /** UTC time, in microseconds since the POSIX epoch, of the most
+   * recent synchronization point. */
+  long long base_us;
+
+  /** Estimated fractional rate by which the reference clock runs
+   * faster than the uptime clock, in units of 2<sup>-32</sup>.
+   * Until a rate has been estimated from two synchronization points
+   * this is the uptime calibration, if any. */
+  long rate_q32;
+
+  /** The number of synchronization points recorded.  Zero indicates
+   * that wall-clock time has never been set. */
+  unsigned int sync_count;
+} sBSPACMwalltimeState;
+
+/** The wall-clock state.  Exposed only for debugging. */
+extern sBSPACMwalltimeState xBSPACMwalltimeState_;
+
+/** Record a synchronization point.
+ *
+ * @param sync_utt the uptime at which the reference time was valid,
+ * e.g. as captured by ullBSPACMuptime() when the time message was
+ * received.
+ *
+ * @param utc_us the reference time, in microseconds since the POSIX
+ * epoch, corresponding to @p sync_utt.
+ *
+ * Wall-clock time is stepped to match the reference.  If at least
+ * #BSPACM_WALLTIME_RATE_MINIMUM_INTERVAL_UTT has passed since the
+ * previous synchronization point the drift rate is re-estimated from
+ * the two points.  The first synchronization point adopts the rate
+ * measured by iBSPACMuptimeCalibrationStart(), if any.
+ *
+ * This function may be invoked from an interrupt handler. */
+void vBSPACMwalltimeSync (unsigned long long sync_utt,
+                          long long utc_us);
+
+/** Return @c true iff at least one synchronization point has been
+ * recorded. */
+static BSPACM_CORE_INLINE
+bool
+bBSPACMwalltimeValid (void)
+{
+  return 0 != xBSPACMwalltimeState_.sync_count;
+}
+
+/** Return the current drift correction in parts per billion.
+ *
+ * A positive value indicates that the uptime clock runs slow relative
+ * to the reference. */
+int iBSPACMwalltimeRate_ppb (void);
+
+/** Convert an uptime to wall-clock time.
+ *
+ * @param utt an uptime as returned by ullBSPACMuptime().  Times
+ * preceding the most recent synchronization point are converted
+ * without drift correction.
+ *
+ * @return microseconds since the POSIX epoch.  If wall-clock time
+ * has not been set, the epoch is taken to be uptime zero.
+ *
+ * This function does not disable interrupts and may be invoked from
+ * interrupt handlers. */
+long long llBSPACMwalltimeFromUptime_us (unsigned long long utt);
+
+/** Return the current wall-clock time in microseconds since the
+ * POSIX epoch.
+ *
+ * @see llBSPACMwalltimeFromUptime_us() */
+static BSPACM_CORE_INLINE
+long long
+llBSPACMwalltime_us (void)
+{
+  return llBSPACMwalltimeFromUptime_us(ullBSPACMuptime());
+}
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* BSPACM_DEVICE_NRF51_INTERNAL_UTILITY_WALLTIME_H */
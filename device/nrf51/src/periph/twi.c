@@ -37,10 +37,53 @@
 #include <bspacm/periph/twi.h>
 #include <bspacm/utility/hires.h>
 #include <bspacm/utility/uptime.h>
+#include <bspacm/utility/event.h>
+#include <bspacm/utility/task.h>
+#include <stddef.h>
 #include <string.h>
 
 #include "nrf51_bitfields.h"
 
+/** The TWI interrupts used by the transaction engine. */
+#define TWI_INTEN_ENGINE (TWI_INTENSET_TXDSENT_Msk      \
+                          | TWI_INTENSET_RXDREADY_Msk   \
+                          | TWI_INTENSET_ERROR_Msk      \
+                          | TWI_INTENSET_STOPPED_Msk)
+
+/** Recover the bus from a pointer to one of its alarms. */
+#define TWI_BUS_FROM_ALARM(ap_, member_) \
+  ((hBSPACMi2cBus)((uintptr_t)(ap_) - offsetof(sBSPACMi2cBus, member_)))
+
+/** The enabled bus for NRF_TWI0 and NRF_TWI1, for use by the
+ * interrupt handlers. */
+static hBSPACMi2cBus twi_bus[2];
+
+/** Uptime ticks between recovery steps.  The uptime clock runs at
+ * 32 KiHz, and an alarm two ticks out is due after at least one full
+ * tick (30.5 us), which exceeds the 5 us half cycle of a 100 kHz bus
+ * clock. */
+#define TWI_RECOVERY_STEP_UTT 2
+
+/** SCL half-cycles toggled when clearing a held bus: enough to flush
+ * both leader and follower bytes. */
+#define TWI_RECOVERY_TOGGLES 36
+
+/** Steps of the bus recovery sequence, as values of
+ * sBSPACMi2cBus::recovery_step_. */
+enum {
+  TWI_RECOVERY_IDLE = 0,
+  TWI_RECOVERY_POWER_ON,
+  TWI_RECOVERY_SAMPLE,
+  TWI_RECOVERY_TOGGLE,
+};
+
+/* Forward declarations */
+static void twi_timeout_flih (int ccidx, hBSPACMuptimeAlarm ap);
+static void twi_recovery_flih (int ccidx, hBSPACMuptimeAlarm ap);
+#if (BSPACM_NRF_APPLY_PAN_56 - 0)
+static void twi_resume_flih (hBSPACMhiresAlarm ap);
+#endif /* BSPACM_NRF_APPLY_PAN_56 */
+
 hBSPACMi2cBus
 hBSPACMi2cConfigureBus (sBSPACMi2cBus * tpp,
                         NRF_TWI_Type * twi,
@@ -83,6 +126,19 @@ hBSPACMi2cConfigureBus (sBSPACMi2cBus * tpp,
     timeout_us = BSPACM_I2C_MINIMUM_BUS_TIMEOUT_us;
   }
   tpp->timeout_utt = uiBSPACMuptimeConvert_us_utt(timeout_us);
+  tpp->timeout_alarm_.callback_flih = twi_timeout_flih;
+  tpp->recovery_alarm_.callback_flih = twi_recovery_flih;
+#if (BSPACM_NRF_APPLY_PAN_56 - 0)
+  /* Two bus clock periods, rounded up */
+  if (TWI_FREQUENCY_FREQUENCY_K400 == frequency) {
+    tpp->resume_delay_us = 5;
+  } else if (TWI_FREQUENCY_FREQUENCY_K250 == frequency) {
+    tpp->resume_delay_us = 8;
+  } else {
+    tpp->resume_delay_us = 20;
+  }
+  tpp->resume_alarm_.callback_flih = twi_resume_flih;
+#endif /* BSPACM_NRF_APPLY_PAN_56 */
   return tpp;
 }
 
@@ -96,46 +152,64 @@ hBSPACMi2cConfigureBus (sBSPACMi2cBus * tpp,
                            | (GPIO_PIN_CNF_INPUT_Connect << GPIO_PIN_CNF_INPUT_Pos) \
                            | (GPIO_PIN_CNF_DIR_Output << GPIO_PIN_CNF_DIR_Pos) )
 
+/** Take the TWI pins under GPIO control with SDA and SCL released,
+ * and disable the TWI peripheral, so the bus can be sampled and
+ * clocked by hand. */
+static void
+twi_bus_release (hBSPACMi2cBus tpp)
+{
+  NRF_GPIO->OUTSET = (1U << tpp->scl_pin) | (1U << tpp->sda_pin);
+  NRF_GPIO->PIN_CNF[tpp->sda_pin] = TWI_GPIO_PIN_CNF;
+  NRF_GPIO->PIN_CNF[tpp->scl_pin] = TWI_GPIO_PIN_CNF;
+  tpp->twi->ENABLE = (TWI_ENABLE_ENABLE_Disabled << TWI_ENABLE_ENABLE_Pos);
+}
+
+/** Return @c true if neither SDA nor SCL is pulled low. */
+static bool
+twi_bus_idle (hBSPACMi2cBus tpp)
+{
+  uint32_t const bits = (1U << tpp->scl_pin) | (1U << tpp->sda_pin);
+
+  return bits == (bits & NRF_GPIO->IN);
+}
+
 /** Reset the I2C bus to idle state if a secondary device is holding
  * it active.
  *
  * The bus is enabled if and only if the return value is zero (no
  * error).
  *
+ * This busy-waits, and is used only when enabling the bus.  Recovery
+ * from interrupt handlers is stepped by twi_recovery_flih().
+ *
  * @return zero if bus is left in the idle state (SDA and SCL not
  * pulled low), and #BSPACM_NRF_TWI_BUS_ERROR_CLEAR_FAILED if not.
  */
 static int
 twi_bus_clear (hBSPACMi2cBus tpp)
 {
-  uint32_t const sda_bit = (1U << tpp->sda_pin);
   uint32_t const scl_bit = (1U << tpp->scl_pin);
-  uint32_t const bits = scl_bit | sda_bit;
   unsigned int const half_cycle_us = 5; /* Half cycle at 100 kHz */
   bool cleared;
 
   /* Pull up SDA and SCL then turn off TWI and wait a cycle to
    * settle before sampling the signals. */
-  NRF_GPIO->OUTSET = bits;
-  NRF_GPIO->PIN_CNF[tpp->sda_pin] = TWI_GPIO_PIN_CNF;
-  NRF_GPIO->PIN_CNF[tpp->scl_pin] = TWI_GPIO_PIN_CNF;
-  tpp->twi->ENABLE = (TWI_ENABLE_ENABLE_Disabled << TWI_ENABLE_ENABLE_Pos);
-
-  vBSPACMhiresSleep_us(2 * half_cycle_us);
-  cleared = (bits == (bits & NRF_GPIO->IN));
+  twi_bus_release(tpp);
+  BSPACM_CORE_DELAY_US(2 * half_cycle_us);
+  cleared = twi_bus_idle(tpp);
 
   if (! cleared) {
     /* At least one of SDA or SCL is being held low by a follower
      * device.  Toggle the clock enough to flush both leader and
      * follower bytes, then see if it's let go. */
-    int cycles = 18;
+    int cycles = TWI_RECOVERY_TOGGLES / 2;
     while (0 < cycles--) {
       NRF_GPIO->OUTCLR = scl_bit;
-      vBSPACMhiresSleep_us(half_cycle_us);
+      BSPACM_CORE_DELAY_US(half_cycle_us);
       NRF_GPIO->OUTSET = scl_bit;
-      vBSPACMhiresSleep_us(half_cycle_us);
+      BSPACM_CORE_DELAY_US(half_cycle_us);
     }
-    cleared = (bits == (bits & NRF_GPIO->IN));
+    cleared = twi_bus_idle(tpp);
   }
 
   if (cleared) {
@@ -146,235 +220,523 @@ twi_bus_clear (hBSPACMi2cBus tpp)
   return cleared ? 0 : BSPACM_NRF_TWI_BUS_ERROR_CLEAR_FAILED;
 }
 
+/** Program the pin selection and frequency of the peripheral, which
+ * are lost when it is power-cycled. */
+static void
+twi_configure_peripheral (hBSPACMi2cBus tpp)
+{
+  tpp->twi->PSELSCL = tpp->scl_pin;
+  tpp->twi->PSELSDA = tpp->sda_pin;
+  tpp->twi->FREQUENCY = tpp->frequency;
+}
+
+/** Disable the engine interrupts and cancel the alarms and read
+ * shortcut of the transaction in progress.  Invoked with interrupts
+ * disabled. */
+static void
+twi_quiesce (hBSPACMi2cBus tpp)
+{
+  tpp->twi->INTENCLR = TWI_INTEN_ENGINE;
+  (void)bBSPACMuptimeAlarmCancel(&tpp->timeout_alarm_);
+#if (BSPACM_NRF_APPLY_PAN_56 - 0)
+  (void)bBSPACMhiresAlarmCancel(&tpp->resume_alarm_);
+#endif /* BSPACM_NRF_APPLY_PAN_56 */
+#if (BSPACM_NRF_APPLY_PAN_36 - 0)
+  vBSPACMnrf51_PPI_CHENCLR(PPI_CHENCLR_CH0_Msk << tpp->ppi_chidx);
+#else /* BSPACM_NRF_APPLY_PAN_36 */
+  tpp->twi->SHORTS = 0;
+#endif /* BSPACM_NRF_APPLY_PAN_36 */
+}
+
+/** Begin the read phase of a transaction.
+ *
+ * The nRF51 RM demonstrates BB->SUSPEND and BB->STOP connections
+ * during TWI reads, but fails to motivate this except for the
+ * BB->STOP required for the last byte read.  A compelling discusion
+ * of why the non-final byte connections are also needed is at:
+ * https://devzone.nordicsemi.com/question/17472
+ *
+ * If the transaction wrote data this issues a repeated start. */
+static void
+twi_start_rx (hBSPACMi2cBus tpp,
+              hBSPACMi2cTransaction xp)
+{
+  /* Select the appropriate mechanism to provide this coordination. */
+#if (BSPACM_NRF_APPLY_PAN_36 - 0)
+  if (1 == xp->rx_len) {
+    vBSPACMnrf51_PPI_CH(tpp->ppi_chidx, &tpp->twi->EVENTS_BB, &tpp->twi->TASKS_STOP);
+  } else {
+    vBSPACMnrf51_PPI_CH(tpp->ppi_chidx, &tpp->twi->EVENTS_BB, &tpp->twi->TASKS_SUSPEND);
+  }
+  vBSPACMnrf51_PPI_CHENSET(PPI_CHENSET_CH0_Msk << tpp->ppi_chidx);
+#else /* BSPACM_NRF_APPLY_PAN_36 */
+  if (1 == xp->rx_len) {
+    tpp->twi->SHORTS = (TWI_SHORTS_BB_STOP_Enabled << TWI_SHORTS_BB_STOP_Pos);
+  } else {
+    tpp->twi->SHORTS = (TWI_SHORTS_BB_SUSPEND_Enabled << TWI_SHORTS_BB_SUSPEND_Pos);
+  }
+#endif /* BSPACM_NRF_APPLY_PAN_36 */
+  tpp->twi->TASKS_STARTRX = 1;
+}
+
+/** Begin the transaction at the head of the queue.  Invoked with
+ * interrupts disabled. */
+static void
+twi_start (hBSPACMi2cBus tpp)
+{
+  NRF_TWI_Type * const twi = tpp->twi;
+  hBSPACMi2cTransaction const xp = tpp->head_;
+
+  tpp->tx_idx_ = 0;
+  tpp->rx_idx_ = 0;
+  tpp->error_ = false;
+  twi->ADDRESS = xp->addr;
+  twi->EVENTS_ERROR = 0;
+  twi->EVENTS_STOPPED = 0;
+  twi->EVENTS_TXDSENT = 0;
+  twi->EVENTS_RXDREADY = 0;
+  twi->INTENSET = TWI_INTEN_ENGINE;
+  tpp->progress_utt_ = uiBSPACMuptime();
+  (void)iBSPACMuptimeAlarmSchedule(tpp->progress_utt_ + tpp->timeout_utt, &tpp->timeout_alarm_);
+  if (0 < xp->tx_len) {
+    twi->TXD = xp->tx[0];
+    twi->TASKS_STARTTX = 1;
+  } else {
+    twi_start_rx(tpp, xp);
+  }
+}
+
+/** Record the result of the transaction at the head of the queue,
+ * remove it, and start the next one if the peripheral is enabled.
+ * Invoked with interrupts disabled.
+ *
+ * @return the completed transaction, which the caller must pass to
+ * twi_notify() after re-enabling interrupts. */
+static hBSPACMi2cTransaction
+twi_finish (hBSPACMi2cBus tpp,
+            int result)
+{
+  hBSPACMi2cTransaction const xp = tpp->head_;
+
+  twi_quiesce(tpp);
+  tpp->head_ = xp->next_;
+  if (NULL == tpp->head_) {
+    tpp->tail_ = NULL;
+  }
+  xp->next_ = NULL;
+  xp->result = result;
+  xp->completed = true;
+  if ((NULL != tpp->head_)
+      && ((TWI_ENABLE_ENABLE_Enabled << TWI_ENABLE_ENABLE_Pos) == tpp->twi->ENABLE)) {
+    twi_start(tpp);
+  }
+  return xp;
+}
+
+/** Inform the submitter that a transaction has completed. */
+static void
+twi_notify (hBSPACMi2cTransaction xp)
+{
+  if (xp->callback_flih) {
+    xp->callback_flih(xp);
+  }
+  if (xp->task) {
+    (void)iBSPACMtaskPost(xp->task);
+  }
+  vBSPACMeventPost(&xBSPACMeventSystem, BSPACM_EVENT_I2C);
+}
+
+/** Complete every queued transaction with error code @p result. */
+static void
+twi_abort (hBSPACMi2cBus tpp,
+           int result)
+{
+  BSPACM_CORE_SAVED_INTERRUPT_STATE(istate);
+  hBSPACMi2cTransaction xp;
+
+  BSPACM_CORE_DISABLE_INTERRUPT();
+  twi_quiesce(tpp);
+  (void)bBSPACMuptimeAlarmCancel(&tpp->recovery_alarm_);
+  tpp->recovery_step_ = TWI_RECOVERY_IDLE;
+  xp = tpp->head_;
+  tpp->head_ = tpp->tail_ = NULL;
+  BSPACM_CORE_REENABLE_INTERRUPT(istate);
+  while (NULL != xp) {
+    hBSPACMi2cTransaction const nxp = xp->next_;
+
+    xp->next_ = NULL;
+    xp->result = result;
+    xp->completed = true;
+    twi_notify(xp);
+    xp = nxp;
+  }
+}
+
 int
 iBSPACMi2cSetEnabled (hBSPACMi2cBus tpp,
                       bool enabled)
 {
+  int const idx = (NRF_TWI1 == tpp->twi);
+  IRQn_Type const irqn = idx ? SPI1_TWI1_IRQn : SPI0_TWI0_IRQn;
   int rv = 0;
 
+  if (! enabled) {
+    twi_abort(tpp, -1);
+    twi_bus[idx] = NULL;
+  }
   tpp->twi->ENABLE = (TWI_ENABLE_ENABLE_Disabled << TWI_ENABLE_ENABLE_Pos);
   if (enabled) {
-    tpp->twi->PSELSCL = tpp->scl_pin;
-    tpp->twi->PSELSDA = tpp->sda_pin;
-    tpp->twi->FREQUENCY = tpp->frequency;
+    twi_configure_peripheral(tpp);
 
 #if (BSPACM_NRF_APPLY_PAN_36 - 0)
     vBSPACMnrf51_PPI_CHENCLR(PPI_CHENCLR_CH0_Msk << tpp->ppi_chidx);
 #endif /* BSPACM_NRF_APPLY_PAN_36 */
+    twi_bus[idx] = tpp;
+    vBSPACMnrf51NVICsetApplicationPriority(irqn, true);
+    vBSPACMnrf51_NVIC_EnableIRQ(irqn);
     rv = - twi_bus_clear(tpp);
   }
   return rv;
 }
 
-/** Invoked when a read or write operation detects a bus error.
+/** Begin recovering the bus after the transaction in progress
+ * failed.
  *
- * The error cause(s) are read and returned as a bit set.  If no error
- * is detected, #BSPACM_NRF_TWI_BUS_ERROR_UNKNOWN is set.  An attempt is made to
- * restore the bus to a cleared state; failure to do so is also
- * indicated in the return value.
+ * The transaction stays at the head of the queue until recovery
+ * completes, so nothing else starts on the bus.  If @p power_cycle
+ * is set the peripheral is first powered off to satisfy the PAN #56
+ * workaround.  The bus is then released and sampled, and clocked by
+ * hand if a follower is holding it, in steps driven by
+ * #recovery_alarm_ so that no handler busy-waits.
  *
- * Callers may combine the return value with other error indicators
- * but should negate the result prior to returning it as an error from
- * public API functions.
+ * @param rv error flags for the failed transaction
  *
- * @return a positive integer representing one or more error flags,
- * possibly including a failure to clear the bus, or an indication
- * that the cause of the aerror could not be determined. */
-static int
-twi_error_clear (hBSPACMi2cBus tpp)
+ * @param power_cycle whether to power-cycle the peripheral */
+static void
+twi_recover (hBSPACMi2cBus tpp,
+             int rv,
+             bool power_cycle)
 {
-  int rv = tpp->twi->ERRORSRC;
-  if (0 == rv) {
-    rv |= BSPACM_NRF_TWI_BUS_ERROR_UNKNOWN;
+  BSPACM_CORE_SAVED_INTERRUPT_STATE(istate);
+
+  BSPACM_CORE_DISABLE_INTERRUPT();
+  twi_quiesce(tpp);
+  tpp->recovery_rv_ = rv;
+  if (power_cycle) {
+    tpp->recovery_step_ = TWI_RECOVERY_POWER_ON;
+    tpp->twi->ENABLE = (TWI_ENABLE_ENABLE_Disabled << TWI_ENABLE_ENABLE_Pos);
+    tpp->twi->POWER = 0;
+  } else {
+    tpp->recovery_step_ = TWI_RECOVERY_SAMPLE;
+    twi_bus_release(tpp);
   }
-  tpp->twi->ERRORSRC = 0;
-  rv |= twi_bus_clear(tpp);
-  return rv;
+  (void)iBSPACMuptimeAlarmSchedule(uiBSPACMuptime() + TWI_RECOVERY_STEP_UTT, &tpp->recovery_alarm_);
+  BSPACM_CORE_REENABLE_INTERRUPT(istate);
 }
 
-#if (BSPACM_NRF_APPLY_PAN_56 - 0)
-/** Power cycle the peripheral and re-initialize it.
- *
- * Returns zero if the reset was successful, otherwise a negative error code. */
-static int
-twi_pan56_reset (hBSPACMi2cBus tpp)
+/** Perform the next step of bus recovery. */
+static void
+twi_recovery_flih (int ccidx,
+                   hBSPACMuptimeAlarm ap)
 {
-  uint16_t address = tpp->twi->ADDRESS;
-  int rv;
-
-#if 0
-  printf("PAN56 Workaround!\n");
-  /* Use this to reset the loop limit to something that works when
-   * verifying the behavior of a too-short limit */
-  ((sBSPACMi2cBus*)tpp)->timeout_utt = 100;
-#endif
-  tpp->twi->ENABLE = (TWI_ENABLE_ENABLE_Disabled << TWI_ENABLE_ENABLE_Pos);
-  tpp->twi->POWER = 0;
-  vBSPACMhiresSleep_us(5);
-  tpp->twi->POWER = 1;
-  rv = - iBSPACMi2cSetEnabled(tpp, true);
+  hBSPACMi2cBus const tpp = TWI_BUS_FROM_ALARM(ap, recovery_alarm_);
+  hBSPACMi2cTransaction xp = NULL;
+  int rv = 0;
+  BSPACM_CORE_SAVED_INTERRUPT_STATE(istate);
+
+  (void)ccidx;
+  switch (tpp->recovery_step_) {
+    default:
+    case TWI_RECOVERY_IDLE:
+      return;
+    case TWI_RECOVERY_POWER_ON:
+      tpp->twi->POWER = 1;
+      twi_configure_peripheral(tpp);
+      twi_bus_release(tpp);
+      tpp->recovery_step_ = TWI_RECOVERY_SAMPLE;
+      break;
+    case TWI_RECOVERY_SAMPLE:
+      if (twi_bus_idle(tpp)) {
+        tpp->recovery_step_ = TWI_RECOVERY_IDLE;
+        break;
+      }
+      /* At least one of SDA or SCL is being held low by a follower
+       * device.  Toggle the clock, then see if it's let go. */
+      tpp->recovery_toggles_ = TWI_RECOVERY_TOGGLES;
+      tpp->recovery_step_ = TWI_RECOVERY_TOGGLE;
+      /*FALLTHRU*/
+    case TWI_RECOVERY_TOGGLE:
+      if (0 < tpp->recovery_toggles_) {
+        /* Low on even counts, high on odd, so the last half-cycle
+         * leaves SCL released. */
+        if (1 & tpp->recovery_toggles_--) {
+          NRF_GPIO->OUTSET = (1U << tpp->scl_pin);
+        } else {
+          NRF_GPIO->OUTCLR = (1U << tpp->scl_pin);
+        }
+        break;
+      }
+      if (! twi_bus_idle(tpp)) {
+        rv = BSPACM_NRF_TWI_BUS_ERROR_CLEAR_FAILED;
+      }
+      tpp->recovery_step_ = TWI_RECOVERY_IDLE;
+      break;
+  }
+  if (TWI_RECOVERY_IDLE != tpp->recovery_step_) {
+    (void)iBSPACMuptimeAlarmSchedule(uiBSPACMuptime() + TWI_RECOVERY_STEP_UTT, ap);
+    return;
+  }
+
+  /* Recovery is done.  As with twi_bus_clear() the peripheral is
+   * enabled only if the bus is idle. */
   if (0 == rv) {
-    tpp->twi->ADDRESS = address;
+    tpp->twi->ENABLE = (TWI_ENABLE_ENABLE_Enabled << TWI_ENABLE_ENABLE_Pos);
   }
-  return rv;
+  BSPACM_CORE_DISABLE_INTERRUPT();
+  if (NULL != tpp->head_) {
+    xp = twi_finish(tpp, - (tpp->recovery_rv_ | rv));
+  }
+  BSPACM_CORE_REENABLE_INTERRUPT(istate);
+  if (NULL != xp) {
+    twi_notify(xp);
+  }
+  /* Transactions queued behind the failure cannot run on a bus that
+   * could not be cleared. */
+  if (0 != rv) {
+    twi_abort(tpp, -rv);
+  }
+}
+
+#if (BSPACM_NRF_APPLY_PAN_56 - 0)
+/** Resume a suspended read once the PAN #56 delay has elapsed.  The
+ * delay is ours, not the follower's, so the byte timeout restarts
+ * here. */
+static void
+twi_resume_flih (hBSPACMhiresAlarm ap)
+{
+  hBSPACMi2cBus const tpp = TWI_BUS_FROM_ALARM(ap, resume_alarm_);
+
+  tpp->progress_utt_ = uiBSPACMuptime();
+  tpp->twi->TASKS_RESUME = 1;
 }
 #endif /* BSPACM_NRF_APPLY_PAN_56 */
 
-int
-iBSPACMi2cRead (hBSPACMi2cBus tpp,
-                unsigned int addr,
-                uint8_t * dp,
-                size_t len)
+/** Abandon the transaction in progress if it has made no progress
+ * within the bus timeout. */
+static void
+twi_timeout_flih (int ccidx,
+                  hBSPACMuptimeAlarm ap)
 {
-  uint8_t * const dps = dp;
-  uint8_t * const dpe = dps + len;
-  int rv = len;
+  hBSPACMi2cBus const tpp = TWI_BUS_FROM_ALARM(ap, timeout_alarm_);
+  unsigned int const due_utt = tpp->progress_utt_ + tpp->timeout_utt;
 
-/* The nRF51 RM demonstrates BB->SUSPEND and BB->STOP connections
- * during TWI reads, but fails to motivate this except for the
- * BB->STOP required for the last byte read.  A compelling discusion
- * of why the non-final byte connections are also needed is at:
- * https://devzone.nordicsemi.com/question/17472
- *
- * Select the appropriate mechanism to provide this coordination. */
-#if (BSPACM_NRF_APPLY_PAN_36 - 0)
-  if (1 == len) {
-    vBSPACMnrf51_PPI_CH(tpp->ppi_chidx, &tpp->twi->EVENTS_BB, &tpp->twi->TASKS_STOP);
-  } else {
-    vBSPACMnrf51_PPI_CH(tpp->ppi_chidx, &tpp->twi->EVENTS_BB, &tpp->twi->TASKS_SUSPEND);
+  (void)ccidx;
+  if ((NULL == tpp->head_)
+      || (TWI_RECOVERY_IDLE != tpp->recovery_step_)) {
+    return;
   }
-  vBSPACMnrf51_PPI_CHENSET(PPI_CHENSET_CH0_Msk << tpp->ppi_chidx);
-#else /* */
-  if (1 == len) {
-    tpp->twi->SHORTS = (TWI_SHORTS_BB_STOP_Enabled << TWI_SHORTS_BB_STOP_Pos);
-  } else {
-    tpp->twi->SHORTS = (TWI_SHORTS_BB_SUSPEND_Enabled << TWI_SHORTS_BB_SUSPEND_Pos);
+  if (0 < (int)(due_utt - uiBSPACMuptime())) {
+    /* A byte was transferred since the alarm was set. */
+    (void)iBSPACMuptimeAlarmSchedule(due_utt, ap);
+    return;
   }
-#endif /* BSPACM_NRF_APPLY_PAN_36 */
-
-  tpp->twi->ADDRESS = addr;
-  tpp->twi->EVENTS_ERROR = 0;
-  tpp->twi->EVENTS_STOPPED = 0;
-  tpp->twi->EVENTS_RXDREADY = 0;
-  tpp->twi->TASKS_STARTRX = 1;
+  /* Recover the peripheral before the next transaction starts. */
+  twi_recover(tpp, BSPACM_NRF_TWI_BUS_ERROR_TIMEOUT,
+              (BSPACM_NRF_APPLY_PAN_56 - 0));
+}
 
-  while (! bBSPACMuptimeEnabled()) {
-    /* If you block here, you didn't enable the uptime clock */
+int
+iBSPACMi2cSubmit (hBSPACMi2cBus tpp,
+                  hBSPACMi2cTransaction xp)
+{
+  BSPACM_CORE_SAVED_INTERRUPT_STATE(istate);
+  int rv = -1;
+
+  if ((NULL == tpp)
+      || (NULL == xp)
+      || (0 == (xp->tx_len + xp->rx_len))
+      || ((0 < xp->tx_len) && (NULL == xp->tx))
+      || ((0 < xp->rx_len) && (NULL == xp->rx))
+      || (! bBSPACMuptimeEnabled())
+#if (BSPACM_NRF_APPLY_PAN_56 - 0)
+      || (! bBSPACMhiresEnabled())
+#endif /* BSPACM_NRF_APPLY_PAN_56 */
+      ) {
+    return -1;
   }
-  unsigned int start_utt = uiBSPACMuptime();
+  BSPACM_CORE_DISABLE_INTERRUPT();
+  do {
+    /* The peripheral is disabled while the bus is recovering, but
+     * submissions queue behind the failed transaction. */
+    if (((TWI_RECOVERY_IDLE == tpp->recovery_step_)
+         && ((TWI_ENABLE_ENABLE_Enabled << TWI_ENABLE_ENABLE_Pos) != tpp->twi->ENABLE))
+        || (NULL != xp->next_)
+        || (xp == tpp->tail_)) {
+      break;
+    }
+    xp->completed = false;
+    xp->result = 0;
+    if (NULL == tpp->tail_) {
+      tpp->head_ = xp;
+    } else {
+      tpp->tail_->next_ = xp;
+    }
+    tpp->tail_ = xp;
+    if (xp == tpp->head_) {
+      twi_start(tpp);
+    }
+    rv = 0;
+  } while (0);
+  BSPACM_CORE_REENABLE_INTERRUPT(istate);
+  return rv;
+}
 
-  while (dp < dpe) {
-    while (! (tpp->twi->EVENTS_RXDREADY
-              || tpp->twi->EVENTS_ERROR)) {
-      if ((uiBSPACMuptime() - start_utt) >= tpp->timeout_utt) {
-        break;
+void
+vBSPACMi2cIRQHandler (hBSPACMi2cBus tpp)
+{
+  NRF_TWI_Type * const twi = tpp->twi;
+  hBSPACMi2cTransaction const xp = tpp->head_;
+  hBSPACMi2cTransaction done_xp = NULL;
+  BSPACM_CORE_SAVED_INTERRUPT_STATE(istate);
+
+  /* The transaction in progress belongs to this handler until it
+   * completes, so only the queue manipulation is done with
+   * interrupts disabled. */
+  do {
+    if ((NULL == xp)
+        || (TWI_RECOVERY_IDLE != tpp->recovery_step_)) {
+      twi->INTENCLR = TWI_INTEN_ENGINE;
+      break;
+    }
+    if (twi->EVENTS_ERROR) {
+      twi->EVENTS_ERROR = 0;
+      /* The bus is still moving; give the stop its own byte time. */
+      tpp->progress_utt_ = uiBSPACMuptime();
+      tpp->error_ = true;
+      twi->TASKS_STOP = 1;
+    }
+    if (twi->EVENTS_TXDSENT) {
+      twi->EVENTS_TXDSENT = 0;
+      tpp->progress_utt_ = uiBSPACMuptime();
+      if (tpp->error_) {
+        /* Wait for STOPPED */
+      } else if (++tpp->tx_idx_ < xp->tx_len) {
+        twi->TXD = xp->tx[tpp->tx_idx_];
+      } else if (0 < xp->rx_len) {
+        twi_start_rx(tpp, xp);
+      } else {
+        twi->TASKS_STOP = 1;
       }
     }
-    if (tpp->twi->EVENTS_ERROR) {
-      tpp->twi->EVENTS_STOPPED = 0;
-      tpp->twi->TASKS_STOP = 1;
-      rv = -1;
-      break;
-    } else if (tpp->twi->EVENTS_RXDREADY) {
-      *dp++ = tpp->twi->RXD;
-      if ((dp+1) >= dpe) {
+    if (twi->EVENTS_RXDREADY) {
+      twi->EVENTS_RXDREADY = 0;
+      tpp->progress_utt_ = uiBSPACMuptime();
+      if (tpp->rx_idx_ < xp->rx_len) {
+        xp->rx[tpp->rx_idx_++] = twi->RXD;
+      }
+      if ((! tpp->error_) && (tpp->rx_idx_ < xp->rx_len)) {
+        if ((tpp->rx_idx_ + 1) >= xp->rx_len) {
 #if (BSPACM_NRF_APPLY_PAN_36 - 0)
-        NRF_PPI->CH[tpp->ppi_chidx].TEP = (uintptr_t)&tpp->twi->TASKS_STOP;
+          NRF_PPI->CH[tpp->ppi_chidx].TEP = (uintptr_t)&twi->TASKS_STOP;
 #else /* BSPACM_NRF_APPLY_PAN_36 */
-        tpp->twi->SHORTS = (TWI_SHORTS_BB_STOP_Enabled << TWI_SHORTS_BB_STOP_Pos);
+          twi->SHORTS = (TWI_SHORTS_BB_STOP_Enabled << TWI_SHORTS_BB_STOP_Pos);
 #endif /* BSPACM_NRF_APPLY_PAN_36 */
-      }
-      tpp->twi->EVENTS_RXDREADY = 0;
-      start_utt = uiBSPACMuptime();
-    } else {
-      rv = BSPACM_NRF_TWI_BUS_ERROR_TIMEOUT;
+        }
 #if (BSPACM_NRF_APPLY_PAN_56 - 0)
-      rv |= twi_pan56_reset(tpp);
+        /* PAN-56: module lock-up
+         *
+         * Delay RESUME for a least two TWI clock periods after RXD read
+         * to ensure clock-stretched ACK completes.  The delay is a
+         * hires alarm, so the handler returns immediately. */
+        (void)iBSPACMhiresAlarmSchedule(ullBSPACMhires() + uiBSPACMhiresConvert_us_hrt(tpp->resume_delay_us),
+                                        &tpp->resume_alarm_);
+#else /* BSPACM_NRF_APPLY_PAN_56 */
+        twi->TASKS_RESUME = 1;
 #endif /* BSPACM_NRF_APPLY_PAN_56 */
-      return -rv;
+      }
     }
-#if (BSPACM_NRF_APPLY_PAN_56 - 0)
-    /* PAN-56: module lock-up
-     *
-     * Delay RESUME for a least two TWI clock periods after RXD read
-     * to ensure clock-stretched ACK completes.
-     *
-     * 100 kHz = 20us, 400 kHz = 5us. */
-    vBSPACMhiresSleep_us(20);
-#endif /* BSPACM_NRF_APPLY_PAN_56 */
-    tpp->twi->TASKS_RESUME = 1;
+    if (twi->EVENTS_STOPPED) {
+      twi->EVENTS_STOPPED = 0;
+      if (tpp->error_) {
+        /* Obtain details on error cause, then clear the bus before
+         * completing the transaction. */
+        int rv = twi->ERRORSRC;
+
+        if (0 == rv) {
+          rv = BSPACM_NRF_TWI_BUS_ERROR_UNKNOWN;
+        }
+        twi->ERRORSRC = 0;
+        twi_recover(tpp, rv, false);
+        break;
+      }
+      BSPACM_CORE_DISABLE_INTERRUPT();
+      done_xp = twi_finish(tpp, xp->tx_len + xp->rx_len);
+      BSPACM_CORE_REENABLE_INTERRUPT(istate);
+    }
+  } while (0);
+  if (NULL != done_xp) {
+    twi_notify(done_xp);
   }
+}
 
-#if (BSPACM_NRF_APPLY_PAN_36 - 0)
-  vBSPACMnrf51_PPI_CHENCLR(PPI_CHENCLR_CH0_Msk << tpp->ppi_chidx);
-#else /* BSPACM_NRF_APPLY_PAN_36 */
-  tpp->twi->SHORTS = 0;
-#endif /* BSPACM_NRF_APPLY_PAN_36 */
+void
+SPI0_TWI0_IRQHandler (void)
+{
+  if (NULL != twi_bus[0]) {
+    vBSPACMi2cIRQHandler(twi_bus[0]);
+  }
+}
 
-  while (! tpp->twi->EVENTS_STOPPED) {
+void
+SPI1_TWI1_IRQHandler (void)
+{
+  if (NULL != twi_bus[1]) {
+    vBSPACMi2cIRQHandler(twi_bus[1]);
   }
-  tpp->twi->EVENTS_STOPPED = 0;
+}
+
+/** Submit a transaction and sleep until it completes. */
+static int
+twi_transact (hBSPACMi2cBus tpp,
+              hBSPACMi2cTransaction xp)
+{
+  int rv = iBSPACMi2cSubmit(tpp, xp);
 
-  if (0 > rv) {
-    /* Obtain details on error cause */
-    rv = - twi_error_clear(tpp);
+  if (0 == rv) {
+    while (! xp->completed) {
+      __WFE();
+    }
+    rv = xp->result;
   }
   return rv;
 }
 
+int
+iBSPACMi2cRead (hBSPACMi2cBus tpp,
+                unsigned int addr,
+                uint8_t * dp,
+                size_t len)
+{
+  sBSPACMi2cTransaction xact;
+
+  memset(&xact, 0, sizeof(xact));
+  xact.addr = addr;
+  xact.rx = dp;
+  xact.rx_len = len;
+  return twi_transact(tpp, &xact);
+}
+
 int
 iBSPACMi2cWrite (hBSPACMi2cBus tpp,
                  unsigned int addr,
                  const uint8_t * sp,
                  size_t len)
 {
-  const uint8_t * const spe = sp + len;
-  int rv = len;
-
-  tpp->twi->ADDRESS = addr;
-  tpp->twi->EVENTS_ERROR = 0;
-  tpp->twi->EVENTS_TXDSENT = 0;
-  tpp->twi->TXD = *sp;
-  tpp->twi->TASKS_STARTTX = 1;
+  sBSPACMi2cTransaction xact;
 
-  while (! bBSPACMuptimeEnabled()) {
-    /* If you block here, you didn't enable the uptime clock */
-  }
-  unsigned int start_utt = uiBSPACMuptime();
-
-  while (true) {
-    while (! (tpp->twi->EVENTS_TXDSENT
-              || tpp->twi->EVENTS_ERROR)) {
-      if ((uiBSPACMuptime() - start_utt) >= tpp->timeout_utt) {
-        break;
-      }
-    }
-    if (tpp->twi->EVENTS_ERROR) {
-      rv = -1;
-      break;
-    } else if (tpp->twi->EVENTS_TXDSENT) {
-      tpp->twi->EVENTS_TXDSENT = 0;
-      if (++sp < spe) {
-        tpp->twi->TXD = *sp;
-      } else {
-        break;
-      }
-    } else {
-      rv = BSPACM_NRF_TWI_BUS_ERROR_TIMEOUT;
-#if (BSPACM_NRF_APPLY_PAN_56 - 0)
-      rv |= twi_pan56_reset(tpp);
-#endif /* BSPACM_NRF_APPLY_PAN_56 */
-      return -rv;
-    }
-  }
-  tpp->twi->EVENTS_STOPPED = 0;
-  tpp->twi->TASKS_STOP = 1;
-  while (! tpp->twi->EVENTS_STOPPED) {
-  }
-
-  if (0 > rv) {
-    /* Obtain details on error cause */
-    rv = - twi_error_clear(tpp);
-  }
-  return rv;
+  memset(&xact, 0, sizeof(xact));
+  xact.addr = addr;
+  xact.tx = sp;
+  xact.tx_len = len;
+  return twi_transact(tpp, &xact);
 }
@@ -36,6 +36,8 @@
 
 #include <bspacm/periph/uart.h>
 #include <bspacm/internal/utility/fifo.h>
+#include <bspacm/utility/event.h>
+#include <bspacm/utility/task.h>
 #include "nrf_gpio.h"
 
 /* Hardware flow control has not yet been validated */
@@ -266,6 +268,10 @@ vBSPACMdeviceNRF51periphUARTirqhandler (sBSPACMperiphUARTstate * const usp)
       usp->rx_dropped_errors += 1;
     }
     usp->rx_count += 1;
+    vBSPACMeventPost(&xBSPACMeventSystem, BSPACM_EVENT_UART_RX);
+    if (usp->rx_task) {
+      (void)iBSPACMtaskPost(usp->rx_task);
+    }
   }
   if (NRF_UART0->EVENTS_TXDRDY) {
     usp->peripheral_state_ni |= PERIPHERAL_FLAG_TXDRDY;
@@ -281,6 +287,7 @@ vBSPACMdeviceNRF51periphUARTirqhandler (sBSPACMperiphUARTstate * const usp)
     } else {
       NRF_UART0->TASKS_STOPTX = 1;
       usp->peripheral_state_ni &= ~PERIPHERAL_FLAG_TXTASK;
+      vBSPACMeventPost(&xBSPACMeventSystem, BSPACM_EVENT_UART_TX);
     }
   }
   BSPACM_CORE_REENABLE_INTERRUPT(istate);
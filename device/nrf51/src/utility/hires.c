@@ -32,6 +32,8 @@
  */
 
 #include <bspacm/utility/hires.h>
+#include <bspacm/utility/event.h>
+#include <bspacm/utility/task.h>
 #include "nrf_delay.h"
 
 #if NRF_TIMER0_BASE == BSPACM_HIRES_TIMER_BASE
@@ -47,17 +49,181 @@
 #error Unrecognized high-resolution timer
 #endif /* BSPACM_HIRES_TIMER_BASE */
 
+#define OVERFLOW_COMPARE_BIT (TIMER_INTENSET_COMPARE0_Enabled << (BSPACM_HIRES_OVERFLOW_CCIDX + TIMER_INTENSET_COMPARE0_Pos))
+#define ALARM_COMPARE_BIT (TIMER_INTENSET_COMPARE0_Enabled << (BSPACM_HIRES_ALARM_CCIDX + TIMER_INTENSET_COMPARE0_Pos))
+
+sBSPACMhiresState xBSPACMhiresState_;
+
 static bool hires_initialized;
 static bool hires_enabled;
 
-static volatile bool cc0_timeout;
+/* The alarm queue, sorted by increasing due time. */
+static hBSPACMhiresAlarm alarms;
+
+/* The alarm ending the current vBSPACMhiresSleep_us().  Its expiry
+ * is private, so it does not post an event. */
+static sBSPACMhiresAlarm sleep_alarm;
+
+/* Ticks allowed for reading the counter and writing the compare
+ * register in alarm_program().  An alarm within this many ticks of a
+ * full counter range away could alias with the counter as the
+ * register is written, so it is approached in steps instead. */
+#define ALARM_PROGRAM_MARGIN_HRT 64U
+
+/* Program the alarm compare register for the earliest alarm.  An
+ * alarm due within the counter range less the margin is armed
+ * directly.  A more distant one is approached through an
+ * intermediate compare half a counter range ahead, after which the
+ * handler reprograms; this never lets a deadline pass unarmed.  If
+ * the alarm is due so soon that the compare might be missed, pend
+ * the interrupt instead.  Call with interrupts disabled. */
+static void
+alarm_program (void)
+{
+  hBSPACMhiresAlarm ap = alarms;
+  unsigned long long now_hrt;
+  unsigned long long cc_hrt;
+
+  BSPACM_HIRES_TIMER->INTENCLR = ALARM_COMPARE_BIT;
+  BSPACM_HIRES_TIMER->EVENTS_COMPARE[BSPACM_HIRES_ALARM_CCIDX] = 0;
+  if (NULL == ap) {
+    return;
+  }
+  now_hrt = ullBSPACMhires();
+  cc_hrt = ap->when_hrt;
+  if ((cc_hrt > now_hrt)
+      && ((cc_hrt - now_hrt) >= ((1ULL << BSPACM_HIRES_COUNTER_BITS) - ALARM_PROGRAM_MARGIN_HRT))) {
+    cc_hrt = now_hrt + (1ULL << (BSPACM_HIRES_COUNTER_BITS - 1));
+  }
+  BSPACM_HIRES_TIMER->CC[BSPACM_HIRES_ALARM_CCIDX] = BSPACM_HIRES_COUNTER_MASK & cc_hrt;
+  BSPACM_HIRES_TIMER->INTENSET = ALARM_COMPARE_BIT;
+  /* The compare event is generated only when the counter increments
+   * to the register value.  If it has already reached the tick
+   * before, it is too late to rely on that. */
+  if ((ullBSPACMhires() + 1) >= cc_hrt) {
+    NVIC_SetPendingIRQ(BSPACM_HIRES_TIMER_IRQn);
+  }
+}
+
+/* Insert an alarm into the queue after any alarms with the same due
+ * time, so alarms due together fire in the order scheduled.  Call
+ * with interrupts disabled. */
+static void
+alarm_insert (hBSPACMhiresAlarm ap)
+{
+  hBSPACMhiresAlarm * app = &alarms;
+
+  while (*app && ((*app)->when_hrt <= ap->when_hrt)) {
+    app = &(*app)->next_;
+  }
+  ap->next_ = *app;
+  *app = ap;
+  ap->scheduled_ = true;
+}
+
+/* Invoke every alarm that is due, then reprogram the compare
+ * register.  Called from the interrupt handler. */
+static void
+alarm_expire (void)
+{
+  BSPACM_CORE_SAVED_INTERRUPT_STATE(istate);
+  hBSPACMhiresAlarm ap;
+
+  BSPACM_CORE_DISABLE_INTERRUPT();
+  while ((NULL != (ap = alarms))
+         && (ap->when_hrt <= ullBSPACMhires())) {
+    alarms = ap->next_;
+    ap->next_ = NULL;
+    ap->scheduled_ = false;
+    if (ap->interval_hrt) {
+      ap->when_hrt += ap->interval_hrt;
+      alarm_insert(ap);
+    }
+    BSPACM_CORE_REENABLE_INTERRUPT(istate);
+    if (ap->callback_flih) {
+      ap->callback_flih(ap);
+    }
+    if (ap->task) {
+      (void)iBSPACMtaskPost(ap->task);
+    }
+    if (&sleep_alarm != ap) {
+      vBSPACMeventPost(&xBSPACMeventSystem, BSPACM_EVENT_HIRES_ALARM);
+    }
+    BSPACM_CORE_DISABLE_INTERRUPT();
+  }
+  alarm_program();
+  BSPACM_CORE_RESTORE_INTERRUPT_STATE(istate);
+}
 
 void BSPACM_HIRES_TIMER_IRQHandler ()
 {
-  if (BSPACM_HIRES_TIMER->EVENTS_COMPARE[0]) {
-    cc0_timeout = true;
-    BSPACM_HIRES_TIMER->EVENTS_COMPARE[0] = 0;
+  if (BSPACM_HIRES_TIMER->EVENTS_COMPARE[BSPACM_HIRES_OVERFLOW_CCIDX]) {
+    /* Clear the event before counting it, so ullBSPACMhires() never
+     * sees both the pending event and the incremented count. */
+    BSPACM_HIRES_TIMER->EVENTS_COMPARE[BSPACM_HIRES_OVERFLOW_CCIDX] = 0;
+    ++xBSPACMhiresState_.overflows;
   }
+  /* The alarm compare event may be absent if the interrupt was pended
+   * by alarm_program(), and may be an intermediate step toward a
+   * distant alarm, so check the queue whenever it is non-empty. */
+  BSPACM_HIRES_TIMER->EVENTS_COMPARE[BSPACM_HIRES_ALARM_CCIDX] = 0;
+  if (alarms) {
+    alarm_expire();
+  }
+}
+
+int
+iBSPACMhiresAlarmSchedule (unsigned long long when_hrt,
+                           hBSPACMhiresAlarm ap)
+{
+  BSPACM_CORE_SAVED_INTERRUPT_STATE(istate);
+  int rv = -1;
+
+  if (! hires_enabled) {
+    return -1;
+  }
+  BSPACM_CORE_DISABLE_INTERRUPT();
+  do {
+    if ((NULL == ap) || ap->scheduled_) {
+      break;
+    }
+    ap->when_hrt = when_hrt;
+    alarm_insert(ap);
+    if (alarms == ap) {
+      alarm_program();
+    }
+    rv = 0;
+  } while (0);
+  BSPACM_CORE_RESTORE_INTERRUPT_STATE(istate);
+  return rv;
+}
+
+bool
+bBSPACMhiresAlarmCancel (hBSPACMhiresAlarm ap)
+{
+  BSPACM_CORE_SAVED_INTERRUPT_STATE(istate);
+  bool rv = false;
+
+  BSPACM_CORE_DISABLE_INTERRUPT();
+  do {
+    hBSPACMhiresAlarm * app = &alarms;
+
+    if ((NULL == ap) || (! ap->scheduled_)) {
+      break;
+    }
+    while (*app != ap) {
+      app = &(*app)->next_;
+    }
+    *app = ap->next_;
+    ap->next_ = NULL;
+    ap->scheduled_ = false;
+    if (app == &alarms) {
+      alarm_program();
+    }
+    rv = true;
+  } while (0);
+  BSPACM_CORE_RESTORE_INTERRUPT_STATE(istate);
+  return rv;
 }
 
 int
@@ -86,14 +252,14 @@ iBSPACMhiresInitialize (unsigned int freq_Hz)
   }
 
   /* Use a the biggest timer base available.  Pretty feeble except for
-   * TIMER0. */
+   * TIMER0, but ullBSPACMhires() extends it in software. */
   BSPACM_HIRES_TIMER->MODE = (TIMER_MODE_MODE_Timer << TIMER_MODE_MODE_Pos);
   BSPACM_HIRES_TIMER->PRESCALER = prescaler;
-#if (NRF_TIMER0_BASE == BSPACM_HIRES_TIMER_BASE)
+#if (32 == BSPACM_HIRES_COUNTER_BITS)
   BSPACM_HIRES_TIMER->BITMODE = (TIMER_BITMODE_BITMODE_32Bit << TIMER_BITMODE_BITMODE_Pos);
-#else /* BSPACM_HIRES_TIMER_BASE */
+#else /* BSPACM_HIRES_COUNTER_BITS */
   BSPACM_HIRES_TIMER->BITMODE = (TIMER_BITMODE_BITMODE_16Bit << TIMER_BITMODE_BITMODE_Pos);
-#endif /* BSPACM_HIRES_TIMER_BASE */
+#endif /* BSPACM_HIRES_COUNTER_BITS */
 
   hires_initialized = true;
   return 0;
@@ -116,7 +282,13 @@ iBSPACMhiresSetEnabled (bool enabled)
     /* Enable interrupts (thus event wakeup?) at the peripheral, but not
      * at the NVIC */
     BSPACM_HIRES_TIMER->INTENCLR = ~0;
-    BSPACM_HIRES_TIMER->INTENSET = (TIMER_INTENSET_COMPARE0_Enabled << TIMER_INTENSET_COMPARE0_Pos);
+
+    /* The overflow compare matches when the counter wraps to zero. */
+    BSPACM_HIRES_TIMER->CC[BSPACM_HIRES_OVERFLOW_CCIDX] = 0;
+    BSPACM_HIRES_TIMER->EVENTS_COMPARE[BSPACM_HIRES_OVERFLOW_CCIDX] = 0;
+    xBSPACMhiresState_.overflows = 0;
+    BSPACM_HIRES_TIMER->INTENSET = OVERFLOW_COMPARE_BIT;
+
     NVIC_ClearPendingIRQ(BSPACM_HIRES_TIMER_IRQn);
     vBSPACMnrf51NVICsetApplicationPriority(BSPACM_HIRES_TIMER_IRQn, true);
     NVIC_EnableIRQ(BSPACM_HIRES_TIMER_IRQn);
@@ -129,6 +301,15 @@ iBSPACMhiresSetEnabled (bool enabled)
     NVIC_DisableIRQ(BSPACM_HIRES_TIMER_IRQn);
     BSPACM_HIRES_TIMER->INTENCLR = ~0;
     NVIC_ClearPendingIRQ(BSPACM_HIRES_TIMER_IRQn);
+
+    /* The count restarts when the timer is next enabled, so pending
+     * alarm times are meaningless.  Discard them. */
+    while (alarms) {
+      hBSPACMhiresAlarm ap = alarms;
+      alarms = ap->next_;
+      ap->next_ = NULL;
+      ap->scheduled_ = false;
+    }
   }
   hires_enabled = enabled;
   return in_enabled;
@@ -163,14 +344,12 @@ vBSPACMhiresSleep_us (unsigned long count_us)
     return;
   }
 
-  cc0_timeout = false;
-  BSPACM_HIRES_TIMER->TASKS_CAPTURE[0] = 1;
-  BSPACM_HIRES_TIMER->EVENTS_COMPARE[0] = 0;
-  BSPACM_HIRES_TIMER->INTENSET = TIMER_INTENSET_COMPARE0_Msk;
-  BSPACM_HIRES_TIMER->CC[0] += count_hrt;
-  while (! cc0_timeout) {
+  /* The compare register is reserved for reading the counter, which
+   * interrupt handlers may do at any time, so sleep on the alarm
+   * queue instead. */
+  (void)iBSPACMhiresAlarmSchedule(ullBSPACMhires() + count_hrt, &sleep_alarm);
+  while (sleep_alarm.scheduled_) {
     __WFE();
   }
-  BSPACM_HIRES_TIMER->INTENCLR = TIMER_INTENCLR_COMPARE0_Msk;
   return;
 }
@@ -0,0 +1,197 @@
+/* BSPACM - nRF51 hardware edge timestamping with the hires timer
+ *
+ * Copyright 2015, Peter A. Bigot
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of the software nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without
+ *   specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <bspacm/utility/hires.h>
+
+#define GPIOTE_CHANNEL_COUNT (sizeof(NRF_GPIOTE->CONFIG) / sizeof(*NRF_GPIOTE->CONFIG))
+#define PPI_CHANNEL_COUNT (sizeof(NRF_PPI->CH) / sizeof(*NRF_PPI->CH))
+
+typedef struct sCapture {
+  unsigned long long * ring;
+  unsigned int ring_len;
+  /* Free-running indices; head is advanced by the interrupt handler
+   * and tail by bBSPACMhiresCaptureGet(). */
+  volatile unsigned int head;
+  volatile unsigned int tail;
+  volatile unsigned int dropped;
+  /* The most recent timestamp, used to avoid recording one capture
+   * twice. */
+  unsigned long long last_hrt;
+  uint8_t gpiote_chidx;
+  uint8_t ppi_chidx;
+  volatile bool active;
+} sCapture;
+
+static sCapture capture;
+
+void
+vBSPACMhiresCaptureIRQHandler (void)
+{
+  sCapture * const cp = &capture;
+  unsigned int cc;
+  unsigned long long now_hrt;
+  unsigned long long hrt;
+
+  if ((! cp->active)
+      || (! NRF_GPIOTE->EVENTS_IN[cp->gpiote_chidx])) {
+    return;
+  }
+  /* Clear the event before reading the latched value so a following
+   * edge still pends the interrupt.  If that edge's capture lands
+   * before the read, the timestamp of this one has been overwritten
+   * and is lost: the register then holds the new edge, which is
+   * recorded when the handler runs again and is read here as a
+   * repeat.  Distinguish that from an edge after the read, which
+   * changes the register, and count the loss. */
+  NRF_GPIOTE->EVENTS_IN[cp->gpiote_chidx] = 0;
+  cc = BSPACM_HIRES_TIMER->CC[BSPACM_HIRES_CAPTURE_CCIDX];
+  if (NRF_GPIOTE->EVENTS_IN[cp->gpiote_chidx]
+      && (cc == BSPACM_HIRES_TIMER->CC[BSPACM_HIRES_CAPTURE_CCIDX])) {
+    ++cp->dropped;
+    return;
+  }
+
+  /* The capture preceded this read by less than one counter wrap, so
+   * its extended value is the current time less the elapsed ticks. */
+  now_hrt = ullBSPACMhires();
+  hrt = now_hrt - (BSPACM_HIRES_COUNTER_MASK & ((unsigned int)now_hrt - cc));
+  if (hrt == cp->last_hrt) {
+    return;
+  }
+  cp->last_hrt = hrt;
+  if ((cp->head - cp->tail) >= cp->ring_len) {
+    ++cp->dropped;
+    return;
+  }
+  cp->ring[cp->head & (cp->ring_len - 1)] = hrt;
+  __DMB();
+  ++cp->head;
+}
+
+int
+iBSPACMhiresCaptureStart (unsigned int pin,
+                          unsigned int polarity,
+                          unsigned int gpiote_chidx,
+                          unsigned int ppi_chidx,
+                          unsigned long long * ring,
+                          unsigned int ring_len)
+{
+  sCapture * const cp = &capture;
+  BSPACM_CORE_SAVED_INTERRUPT_STATE(istate);
+  int rv = -1;
+
+  if ((! bBSPACMhiresEnabled())
+      || (31 < pin)
+      || ((GPIOTE_CONFIG_POLARITY_Msk >> GPIOTE_CONFIG_POLARITY_Pos) < polarity)
+      || (GPIOTE_CHANNEL_COUNT <= gpiote_chidx)
+      || (PPI_CHANNEL_COUNT <= ppi_chidx)
+      || (NULL == ring)
+      || (0 == ring_len)
+      || (0 != (ring_len & (ring_len - 1)))) {
+    return -1;
+  }
+  BSPACM_CORE_DISABLE_INTERRUPT();
+  do {
+    if (cp->active) {
+      break;
+    }
+    cp->ring = ring;
+    cp->ring_len = ring_len;
+    cp->head = cp->tail = 0;
+    cp->dropped = 0;
+    cp->last_hrt = ~0ULL;
+    cp->gpiote_chidx = gpiote_chidx;
+    cp->ppi_chidx = ppi_chidx;
+
+    NRF_GPIOTE->INTENCLR = (1U << gpiote_chidx);
+    NRF_GPIOTE->CONFIG[gpiote_chidx] = 0
+      | (GPIOTE_CONFIG_MODE_Event << GPIOTE_CONFIG_MODE_Pos)
+      | (pin << GPIOTE_CONFIG_PSEL_Pos)
+      | (polarity << GPIOTE_CONFIG_POLARITY_Pos)
+      ;
+    NRF_GPIOTE->EVENTS_IN[gpiote_chidx] = 0;
+    vBSPACMnrf51_PPI_CH(ppi_chidx, &NRF_GPIOTE->EVENTS_IN[gpiote_chidx],
+                        &BSPACM_HIRES_TIMER->TASKS_CAPTURE[BSPACM_HIRES_CAPTURE_CCIDX]);
+    vBSPACMnrf51_PPI_CHENSET(1U << ppi_chidx);
+    cp->active = true;
+    NRF_GPIOTE->INTENSET = (1U << gpiote_chidx);
+
+    vBSPACMnrf51NVICsetApplicationPriority(GPIOTE_IRQn, true);
+    vBSPACMnrf51_NVIC_EnableIRQ(GPIOTE_IRQn);
+    rv = 0;
+  } while (0);
+  BSPACM_CORE_REENABLE_INTERRUPT(istate);
+  return rv;
+}
+
+void
+vBSPACMhiresCaptureStop (void)
+{
+  sCapture * const cp = &capture;
+  BSPACM_CORE_SAVED_INTERRUPT_STATE(istate);
+
+  BSPACM_CORE_DISABLE_INTERRUPT();
+  do {
+    if (! cp->active) {
+      break;
+    }
+    vBSPACMnrf51_PPI_CHENCLR(1U << cp->ppi_chidx);
+    NRF_GPIOTE->INTENCLR = (1U << cp->gpiote_chidx);
+    NRF_GPIOTE->CONFIG[cp->gpiote_chidx] = (GPIOTE_CONFIG_MODE_Disabled << GPIOTE_CONFIG_MODE_Pos);
+    NRF_GPIOTE->EVENTS_IN[cp->gpiote_chidx] = 0;
+    cp->active = false;
+  } while (0);
+  BSPACM_CORE_REENABLE_INTERRUPT(istate);
+}
+
+bool
+bBSPACMhiresCaptureGet (unsigned long long * hrtp)
+{
+  sCapture * const cp = &capture;
+  unsigned int tail = cp->tail;
+
+  if (tail == cp->head) {
+    return false;
+  }
+  __DMB();
+  *hrtp = cp->ring[tail & (cp->ring_len - 1)];
+  __DMB();
+  cp->tail = tail + 1;
+  return true;
+}
+
+unsigned int
+uiBSPACMhiresCaptureDropped (void)
+{
+  return capture.dropped;
+}
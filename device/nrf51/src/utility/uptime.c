@@ -32,6 +32,8 @@
  */
 
 #include <bspacm/utility/uptime.h>
+#include <bspacm/utility/event.h>
+#include <bspacm/utility/task.h>
 #include <string.h>
 
 #include "nrf51_bitfields.h"
@@ -50,6 +52,16 @@
 #define RTC_COUNTER_MASK ((1U << RTC_COUNTER_BITS) - 1)
 #define SLEEP_CCIDX 0
 #define SLEEP_COMPARE_BIT (RTC_INTENSET_COMPARE0_Enabled << (SLEEP_CCIDX + RTC_INTENSET_COMPARE0_Pos))
+#define TIMER_COMPARE_BIT (RTC_INTENSET_COMPARE0_Enabled << (BSPACM_UPTIME_TIMER_CCIDX + RTC_INTENSET_COMPARE0_Pos))
+
+#if (SLEEP_CCIDX == BSPACM_UPTIME_TIMER_CCIDX) || (BSPACM_UPTIME_CC_COUNT <= BSPACM_UPTIME_TIMER_CCIDX)
+#error BSPACM_UPTIME_TIMER_CCIDX is not valid
+#endif /* BSPACM_UPTIME_TIMER_CCIDX */
+
+/* The longest interval programmed into the timer compare register.
+ * Alarms further in the future are reached through intermediate
+ * compare events, so the 24-bit counter never wraps past one. */
+#define TIMER_MAXIMUM_DELTA_UTT (1U << (RTC_COUNTER_BITS - 1))
 
 sBSPACMuptimeState xBSPACMuptimeState_;
 
@@ -68,6 +80,7 @@ iBSPACMuptimeAlarmSet (int ccidx,
   do {
     if ((0 > ccidx)
         || (SLEEP_CCIDX == ccidx)
+        || (BSPACM_UPTIME_TIMER_CCIDX == ccidx)
         || (BSPACM_UPTIME_CC_COUNT <= ccidx)
         || (NULL != xBSPACMuptimeState_.alarm[ccidx])
         || (NULL == ap)) {
@@ -93,6 +106,7 @@ hBSPACMuptimeAlarmClear (int ccidx,
   BSPACM_CORE_DISABLE_INTERRUPT();
   do {
     if ((1 > ccidx)
+        || (BSPACM_UPTIME_TIMER_CCIDX == ccidx)
         || (BSPACM_UPTIME_CC_COUNT <= ccidx)) {
       break;
     }
@@ -111,6 +125,222 @@ hBSPACMuptimeAlarmClear (int ccidx,
   return rv;
 }
 
+/* True iff alarm a is due before alarm b.  Valid while all scheduled
+ * alarms are due within 2^31 ticks of each other. */
+#define TIMER_BEFORE(a_, b_) (0 > (int)((a_)->when_utt - (b_)->when_utt))
+
+/* Join two pairing heap roots, returning the new root.  The loser
+ * becomes the first child of the winner.  The winner's sibling links
+ * are left for the caller to set. */
+static hBSPACMuptimeAlarm
+timer_meld (hBSPACMuptimeAlarm a,
+            hBSPACMuptimeAlarm b)
+{
+  if (TIMER_BEFORE(b, a)) {
+    hBSPACMuptimeAlarm t = a;
+    a = b;
+    b = t;
+  }
+  b->next_ = a->child_;
+  if (b->next_) {
+    b->next_->prev_ = b;
+  }
+  b->prev_ = a;
+  a->child_ = b;
+  return a;
+}
+
+/* Combine a list of sibling subheaps into one heap using the
+ * standard two-pass pairing. */
+static hBSPACMuptimeAlarm
+timer_merge_pairs (hBSPACMuptimeAlarm first)
+{
+  hBSPACMuptimeAlarm pairs = NULL;
+  hBSPACMuptimeAlarm rv;
+
+  if (! first) {
+    return NULL;
+  }
+  /* Left to right, meld adjacent pairs, stacking the results. */
+  while (first) {
+    hBSPACMuptimeAlarm a = first;
+    hBSPACMuptimeAlarm b = a->next_;
+    if (! b) {
+      a->next_ = pairs;
+      pairs = a;
+      break;
+    }
+    first = b->next_;
+    a = timer_meld(a, b);
+    a->next_ = pairs;
+    pairs = a;
+  }
+  /* Right to left, meld the stacked results into one heap. */
+  rv = pairs;
+  pairs = pairs->next_;
+  while (pairs) {
+    hBSPACMuptimeAlarm n = pairs->next_;
+    rv = timer_meld(rv, pairs);
+    pairs = n;
+  }
+  rv->next_ = rv->prev_ = NULL;
+  return rv;
+}
+
+/* Program the timer compare register for the earliest scheduled
+ * alarm.  Interrupts must be disabled. */
+static void
+timer_program (void)
+{
+  hBSPACMuptimeAlarm const root = xBSPACMuptimeState_.timers;
+  unsigned int now_utt;
+  int delta_utt;
+
+  if (! root) {
+    BSPACM_UPTIME_RTC->INTENCLR = TIMER_COMPARE_BIT;
+    BSPACM_UPTIME_RTC->EVENTS_COMPARE[BSPACM_UPTIME_TIMER_CCIDX] = 0;
+    return;
+  }
+  now_utt = uiBSPACMuptime();
+  delta_utt = (int)(root->when_utt - now_utt);
+  /* The RTC does not reliably generate a compare event for a value
+   * less than two ticks beyond the counter. */
+  if (BSPACM_UPTIME_SLEEP_MINIMUM > delta_utt) {
+    delta_utt = BSPACM_UPTIME_SLEEP_MINIMUM;
+  } else if (TIMER_MAXIMUM_DELTA_UTT < delta_utt) {
+    delta_utt = TIMER_MAXIMUM_DELTA_UTT;
+  }
+  BSPACM_UPTIME_RTC->CC[BSPACM_UPTIME_TIMER_CCIDX] = RTC_COUNTER_MASK & (now_utt + delta_utt);
+  BSPACM_UPTIME_RTC->EVENTS_COMPARE[BSPACM_UPTIME_TIMER_CCIDX] = 0;
+  BSPACM_UPTIME_RTC->INTENSET = TIMER_COMPARE_BIT;
+}
+
+/* Remove the earliest alarm from the queue.  Interrupts must be
+ * disabled. */
+static hBSPACMuptimeAlarm
+timer_pop (void)
+{
+  hBSPACMuptimeAlarm const rv = xBSPACMuptimeState_.timers;
+
+  xBSPACMuptimeState_.timers = timer_merge_pairs(rv->child_);
+  rv->scheduled_ = false;
+  return rv;
+}
+
+/* Add an alarm to the queue.  Interrupts must be disabled. */
+static void
+timer_insert (hBSPACMuptimeAlarm ap)
+{
+  hBSPACMuptimeAlarm root = xBSPACMuptimeState_.timers;
+
+  ap->child_ = ap->next_ = ap->prev_ = NULL;
+  ap->scheduled_ = true;
+  if (root) {
+    root = timer_meld(root, ap);
+    root->next_ = root->prev_ = NULL;
+  } else {
+    root = ap;
+  }
+  xBSPACMuptimeState_.timers = root;
+}
+
+int
+iBSPACMuptimeAlarmSchedule (unsigned int when_utt,
+                            hBSPACMuptimeAlarm ap)
+{
+  BSPACM_CORE_SAVED_INTERRUPT_STATE(istate);
+  int rv = -1;
+
+  if (! bBSPACMuptimeEnabled()) {
+    return -1;
+  }
+  BSPACM_CORE_DISABLE_INTERRUPT();
+  do {
+    if ((NULL == ap) || ap->scheduled_) {
+      break;
+    }
+    ap->when_utt = when_utt;
+    timer_insert(ap);
+    if (xBSPACMuptimeState_.timers == ap) {
+      timer_program();
+    }
+    rv = 0;
+  } while (0);
+  BSPACM_CORE_RESTORE_INTERRUPT_STATE(istate);
+  return rv;
+}
+
+bool
+bBSPACMuptimeAlarmCancel (hBSPACMuptimeAlarm ap)
+{
+  BSPACM_CORE_SAVED_INTERRUPT_STATE(istate);
+  bool rv = false;
+
+  BSPACM_CORE_DISABLE_INTERRUPT();
+  do {
+    hBSPACMuptimeAlarm sub;
+
+    if ((NULL == ap) || (! ap->scheduled_)) {
+      break;
+    }
+    rv = true;
+    if (xBSPACMuptimeState_.timers == ap) {
+      (void)timer_pop();
+      timer_program();
+      break;
+    }
+    /* Unlink from the parent (if leftmost) or left sibling, then
+     * meld the alarm's children back into the heap. */
+    if (ap->prev_->child_ == ap) {
+      ap->prev_->child_ = ap->next_;
+    } else {
+      ap->prev_->next_ = ap->next_;
+    }
+    if (ap->next_) {
+      ap->next_->prev_ = ap->prev_;
+    }
+    ap->scheduled_ = false;
+    sub = timer_merge_pairs(ap->child_);
+    if (sub) {
+      hBSPACMuptimeAlarm root = timer_meld(xBSPACMuptimeState_.timers, sub);
+      root->next_ = root->prev_ = NULL;
+      xBSPACMuptimeState_.timers = root;
+    }
+  } while (0);
+  BSPACM_CORE_RESTORE_INTERRUPT_STATE(istate);
+  return rv;
+}
+
+/* Invoke every scheduled alarm that is due, then reprogram the
+ * compare register.  Called from the interrupt handler. */
+static void
+timer_expire (void)
+{
+  BSPACM_CORE_SAVED_INTERRUPT_STATE(istate);
+  hBSPACMuptimeAlarm ap;
+
+  BSPACM_CORE_DISABLE_INTERRUPT();
+  while ((NULL != (ap = xBSPACMuptimeState_.timers))
+         && (0 >= (int)(ap->when_utt - uiBSPACMuptime()))) {
+    (void)timer_pop();
+    if (ap->interval_utt) {
+      ap->when_utt += ap->interval_utt;
+      timer_insert(ap);
+    }
+    BSPACM_CORE_REENABLE_INTERRUPT(istate);
+    if (ap->callback_flih) {
+      ap->callback_flih(BSPACM_UPTIME_TIMER_CCIDX, ap);
+    }
+    if (ap->task) {
+      (void)iBSPACMtaskPost(ap->task);
+    }
+    vBSPACMeventPost(&xBSPACMeventSystem, BSPACM_EVENT_UPTIME_ALARM);
+    BSPACM_CORE_DISABLE_INTERRUPT();
+  }
+  timer_program();
+  BSPACM_CORE_REENABLE_INTERRUPT(istate);
+}
+
 void
 vBSPACMuptimeStart ()
 {
@@ -152,6 +382,87 @@ vBSPACMuptimeStart ()
   xBSPACMuptimeState_.enabled = true;
 }
 
+bool
+bBSPACMuptimeNextAlarm (unsigned int * when_uttp)
+{
+  BSPACM_CORE_SAVED_INTERRUPT_STATE(istate);
+  bool rv = false;
+  unsigned int when_utt = 0;
+  int ccidx;
+
+  BSPACM_CORE_DISABLE_INTERRUPT();
+  do {
+    unsigned int const now_utt = uiBSPACMuptime();
+
+    if (xBSPACMuptimeState_.timers) {
+      when_utt = xBSPACMuptimeState_.timers->when_utt;
+      rv = true;
+    }
+    for (ccidx = 1; ccidx < BSPACM_UPTIME_CC_COUNT; ++ccidx) {
+      unsigned int cc_utt;
+      if ((BSPACM_UPTIME_TIMER_CCIDX == ccidx)
+          || (! xBSPACMuptimeState_.alarm[ccidx])) {
+        continue;
+      }
+      /* Compare registers hold 24 bits; the alarm is the next time
+       * the counter reaches the value. */
+      cc_utt = now_utt + (RTC_COUNTER_MASK & (BSPACM_UPTIME_RTC->CC[ccidx] - now_utt));
+      if ((! rv) || (0 > (int)(cc_utt - when_utt))) {
+        when_utt = cc_utt;
+        rv = true;
+      }
+    }
+  } while (0);
+  BSPACM_CORE_REENABLE_INTERRUPT(istate);
+  if (rv && when_uttp) {
+    *when_uttp = when_utt;
+  }
+  return rv;
+}
+
+unsigned int
+uiBSPACMuptimeIdle (void)
+{
+  BSPACM_CORE_SAVED_INTERRUPT_STATE(istate);
+  unsigned int ctr0;
+  unsigned int asleep_utt;
+
+  /* Measure with the raw counter.  The overflow interrupt is always
+   * enabled, so no sleep can span more than one counter period, and
+   * an overflow that is pending but not yet counted does not matter
+   * here. */
+  BSPACM_CORE_DISABLE_INTERRUPT();
+  ctr0 = BSPACM_UPTIME_RTC->COUNTER;
+  NRF_POWER->TASKS_LOWPWR = 1;
+  __WFI();
+  asleep_utt = RTC_COUNTER_MASK & (BSPACM_UPTIME_RTC->COUNTER - ctr0);
+  xBSPACMuptimeState_.idle_asleep_utt += asleep_utt;
+  ++xBSPACMuptimeState_.idle_count;
+  BSPACM_CORE_REENABLE_INTERRUPT(istate);
+  return asleep_utt;
+}
+
+void
+vBSPACMuptimeIdleStatistics (sBSPACMuptimeIdleStatistics * sp,
+                             bool reset)
+{
+  BSPACM_CORE_SAVED_INTERRUPT_STATE(istate);
+  unsigned long long const now_utt = ullBSPACMuptime();
+
+  BSPACM_CORE_DISABLE_INTERRUPT();
+  if (sp) {
+    sp->elapsed_utt = now_utt - xBSPACMuptimeState_.idle_epoch_utt;
+    sp->asleep_utt = xBSPACMuptimeState_.idle_asleep_utt;
+    sp->idle_count = xBSPACMuptimeState_.idle_count;
+  }
+  if (reset) {
+    xBSPACMuptimeState_.idle_epoch_utt = now_utt;
+    xBSPACMuptimeState_.idle_asleep_utt = 0;
+    xBSPACMuptimeState_.idle_count = 0;
+  }
+  BSPACM_CORE_REENABLE_INTERRUPT(istate);
+}
+
 static volatile bool sleep_aborted;
 static volatile bool sleep_wakeup;
 
@@ -203,7 +514,14 @@ BSPACM_UPTIME_RTC_IRQHandler ()
     sleep_wakeup = true;
     BSPACM_UPTIME_RTC->INTENCLR = SLEEP_COMPARE_BIT;
   }
+  if (BSPACM_UPTIME_RTC->EVENTS_COMPARE[BSPACM_UPTIME_TIMER_CCIDX]) {
+    BSPACM_UPTIME_RTC->EVENTS_COMPARE[BSPACM_UPTIME_TIMER_CCIDX] = 0;
+    timer_expire();
+  }
   for (ccidx = 0; ccidx < BSPACM_UPTIME_CC_COUNT; ++ccidx) {
+    if (BSPACM_UPTIME_TIMER_CCIDX == ccidx) {
+      continue;
+    }
     if (BSPACM_UPTIME_RTC->EVENTS_COMPARE[ccidx]) {
       hBSPACMuptimeAlarm ap = xBSPACMuptimeState_.alarm[ccidx];
       BSPACM_UPTIME_RTC->EVENTS_COMPARE[ccidx] = 0;
@@ -216,7 +534,11 @@ BSPACM_UPTIME_RTC_IRQHandler ()
         if (ap->callback_flih) {
           ap->callback_flih(ccidx, ap);
         }
+        if (ap->task) {
+          (void)iBSPACMtaskPost(ap->task);
+        }
       }
+      vBSPACMeventPost(&xBSPACMeventSystem, BSPACM_EVENT_UPTIME_ALARM);
     }
   }
 }
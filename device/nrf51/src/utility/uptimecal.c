@@ -0,0 +1,233 @@
+/* BSPACM - nRF51 uptime clock calibration against HFCLK
+ *
+ * Copyright 2015, Peter A. Bigot
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of the software nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without
+ *   specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <bspacm/utility/uptime.h>
+#include <bspacm/utility/hires.h>
+#include <string.h>
+
+#define RTC_COUNTER_MASK 0xFFFFFFU
+
+/* Nominal HFCLK ticks per uptime tick is 16000000/32768 =
+ * 15625/32. */
+#define HFCLK_PER_UTT_NUM 15625U
+#define HFCLK_PER_UTT_SHIFT 5
+
+typedef struct sCalibration {
+  /* Must be first: the alarm callback recovers the containing
+   * structure from the alarm pointer. */
+  sBSPACMuptimeAlarm alarm;
+  unsigned int window_utt;
+  unsigned int interval_utt;
+  /* Uptime at which the current window began, in the units used to
+   * schedule the alarm. */
+  unsigned int begin_utt;
+  /* RTC counter value and hires time at the tick edge that started
+   * the window */
+  unsigned int begin_ctr;
+  unsigned long long begin_hrt;
+  bool measuring;
+  volatile bool active;
+} sCalibration;
+
+static sCalibration calibration;
+
+/* Widest hires bracket, in microseconds, around an uptime tick edge
+ * that edge_sample() accepts.  An unpreempted bracket spans about two
+ * poll iterations; anything wider means the poll was preempted near
+ * the edge, so the delay to the timestamp is unknown. */
+#define EDGE_BRACKET_US 4
+
+/* Number of uptime tick edges edge_sample() will try before giving
+ * up. */
+#define EDGE_ATTEMPTS 4
+
+/* Delay before trying again when edge_sample() gives up, about 1 ms.
+ * Retrying from the alarm handler immediately would not let the
+ * preempting activity finish. */
+#define EDGE_RETRY_UTT 32
+
+/* Busy-wait for the next uptime tick edge and timestamp it with the
+ * hires timer.  Interrupts are left enabled.  Each read of the RTC
+ * counter is preceded by a hires read, and once the counter changes
+ * the hires timer is read again.  The edge lies between the hires
+ * read before the last unchanged counter value and the one after the
+ * change; if those are too far apart the poll was preempted around
+ * the edge and the next edge is tried instead.  Stores the new RTC
+ * counter value and the extended hires time of the edge, and returns
+ * false if no clean edge was seen within EDGE_ATTEMPTS ticks. */
+static bool
+edge_sample (unsigned int * ctrp,
+             unsigned long long * hrtp)
+{
+  unsigned int const limit_hrt = 1 + uiBSPACMhiresConvert_us_hrt(EDGE_BRACKET_US);
+  unsigned int attempts = EDGE_ATTEMPTS;
+  unsigned int before_hrt = uiBSPACMhires();
+  unsigned int ctr = BSPACM_UPTIME_RTC->COUNTER;
+
+  while (0 < attempts--) {
+    unsigned int hrt;
+    unsigned int nctr;
+
+    while (1) {
+      hrt = uiBSPACMhires();
+      nctr = BSPACM_UPTIME_RTC->COUNTER;
+      if (nctr != ctr) {
+        break;
+      }
+      before_hrt = hrt;
+    }
+    hrt = uiBSPACMhires();
+    if (limit_hrt >= (BSPACM_HIRES_COUNTER_MASK & (hrt - before_hrt))) {
+      unsigned long long const now_hrt = ullBSPACMhires();
+
+      *ctrp = nctr;
+      *hrtp = now_hrt - (BSPACM_HIRES_COUNTER_MASK & ((unsigned int)now_hrt - hrt));
+      return true;
+    }
+    ctr = nctr;
+    before_hrt = hrt;
+  }
+  return false;
+}
+
+/* Convert a completed measurement to a rate.  Returns false if the
+ * result is implausible. */
+static bool
+calculate_rate (unsigned int window_ctr,
+                unsigned long long total_hrt,
+                long * rate_q32p)
+{
+  long long expected = (long long)window_ctr * HFCLK_PER_UTT_NUM;
+  long long measured = (long long)(total_hrt << (BSPACM_HIRES_PRESCALER_() + HFCLK_PER_UTT_SHIFT));
+  long long diff = measured - expected;
+  long long limit = llBSPACMuptimeRateCorrection_us(expected, BSPACM_UPTIME_RATE_LIMIT_Q32);
+
+  /* A positive difference means more HFCLK ticks elapsed than
+   * nominal, i.e. uptime ticks are long.  The window limit bounds
+   * expected below 2^37, so the scaled difference cannot
+   * overflow. */
+  if ((diff >= limit) || (-diff >= limit)) {
+    return false;
+  }
+  *rate_q32p = (diff * (1LL << 32)) / expected;
+  return true;
+}
+
+static void
+calibration_callback (int ccidx,
+                      hBSPACMuptimeAlarm ap)
+{
+  sCalibration * const cp = (sCalibration *)ap;
+  unsigned long long end_hrt;
+  unsigned int end_ctr;
+  long rate_q32;
+
+  (void)ccidx;
+  if (! bBSPACMhiresEnabled()) {
+    cp->measuring = false;
+    cp->active = false;
+    return;
+  }
+  if (! cp->measuring) {
+    if (! edge_sample(&cp->begin_ctr, &cp->begin_hrt)) {
+      (void)iBSPACMuptimeAlarmSchedule(uiBSPACMuptime() + EDGE_RETRY_UTT, ap);
+      return;
+    }
+    cp->begin_utt = ap->when_utt;
+    cp->measuring = true;
+    (void)iBSPACMuptimeAlarmSchedule(cp->begin_utt + cp->window_utt, ap);
+    return;
+  }
+  /* If the end edge cannot be timestamped the window is extended;
+   * the rate is computed from the counters actually sampled. */
+  if (! edge_sample(&end_ctr, &end_hrt)) {
+    (void)iBSPACMuptimeAlarmSchedule(uiBSPACMuptime() + EDGE_RETRY_UTT, ap);
+    return;
+  }
+  cp->measuring = false;
+  if (calculate_rate(RTC_COUNTER_MASK & (end_ctr - cp->begin_ctr), end_hrt - cp->begin_hrt, &rate_q32)) {
+    xBSPACMuptimeState_.calibration_q32 = rate_q32;
+  }
+  if (0 == cp->interval_utt) {
+    cp->active = false;
+    return;
+  }
+  (void)iBSPACMuptimeAlarmSchedule(cp->begin_utt + cp->interval_utt, ap);
+}
+
+int
+iBSPACMuptimeCalibrationStart (unsigned int window_utt,
+                               unsigned int interval_utt)
+{
+  sCalibration * const cp = &calibration;
+  BSPACM_CORE_SAVED_INTERRUPT_STATE(istate);
+  int rv = -1;
+
+  if ((! bBSPACMuptimeEnabled())
+      || (! bBSPACMhiresEnabled())
+      || (0 == window_utt)
+      || ((RTC_COUNTER_MASK >> 1) < window_utt)
+      || ((0 != interval_utt) && (interval_utt < window_utt))) {
+    return -1;
+  }
+
+  BSPACM_CORE_DISABLE_INTERRUPT();
+  do {
+    if (cp->active) {
+      break;
+    }
+    memset(cp, 0, sizeof(*cp));
+    cp->alarm.callback_flih = calibration_callback;
+    cp->window_utt = window_utt;
+    cp->interval_utt = interval_utt;
+    rv = iBSPACMuptimeAlarmSchedule(uiBSPACMuptime(), &cp->alarm);
+    cp->active = (0 == rv);
+  } while (0);
+  BSPACM_CORE_REENABLE_INTERRUPT(istate);
+  return rv;
+}
+
+void
+vBSPACMuptimeCalibrationStop (void)
+{
+  sCalibration * const cp = &calibration;
+  BSPACM_CORE_SAVED_INTERRUPT_STATE(istate);
+
+  BSPACM_CORE_DISABLE_INTERRUPT();
+  do {
+    (void)bBSPACMuptimeAlarmCancel(&cp->alarm);
+    cp->measuring = false;
+    cp->active = false;
+  } while (0);
+  BSPACM_CORE_REENABLE_INTERRUPT(istate);
+}
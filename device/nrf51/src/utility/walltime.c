@@ -0,0 +1,156 @@
+/* BSPACM - nRF51 wall-clock time service
+ *
+ * Copyright 2015, Peter A. Bigot
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of the software nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without
+ *   specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <bspacm/utility/walltime.h>
+#include <sys/time.h>
+#include <time.h>
+#include <errno.h>
+
+sBSPACMwalltimeState xBSPACMwalltimeState_;
+
+void
+vBSPACMwalltimeSync (unsigned long long sync_utt,
+                     long long utc_us)
+{
+  sBSPACMwalltimeState * const sp = &xBSPACMwalltimeState_;
+  BSPACM_CORE_SAVED_INTERRUPT_STATE(istate);
+  long rate_q32 = sp->rate_q32;
+
+  /* Estimate the rate outside the critical section; only this
+   * function writes the state, and it is not re-entrant across
+   * synchronization sources. */
+  if (0 == sp->sync_count) {
+    /* No baseline yet: start from the uptime calibration. */
+    rate_q32 = xBSPACMuptimeState_.calibration_q32;
+  } else if ((sync_utt > sp->base_utt)
+      && ((sync_utt - sp->base_utt) >= BSPACM_WALLTIME_RATE_MINIMUM_INTERVAL_UTT)) {
+    long long elapsed_us = ullBSPACMuptimeConvert_utt_us(sync_utt - sp->base_utt);
+    long long error_us = (utc_us - sp->base_us) - elapsed_us;
+    long long limit_us = llBSPACMuptimeRateCorrection_us(elapsed_us, BSPACM_UPTIME_RATE_LIMIT_Q32);
+
+    if ((error_us < limit_us) && (-error_us < limit_us)) {
+      /* |error_us| < elapsed_us / 2^10; reduce both until the scaled
+       * error cannot overflow.  The lost precision is negligible
+       * relative to the timestamp jitter. */
+      while ((error_us >= (1LL << 30)) || (-error_us >= (1LL << 30))) {
+        error_us /= 2;
+        elapsed_us >>= 1;
+      }
+      rate_q32 = (error_us * (1LL << 32)) / elapsed_us;
+    }
+  }
+
+  BSPACM_CORE_DISABLE_INTERRUPT();
+  do {
+    ++sp->sequence;
+    __DMB();
+    sp->base_utt = sync_utt;
+    sp->base_us = utc_us;
+    sp->rate_q32 = rate_q32;
+    ++sp->sync_count;
+    __DMB();
+    ++sp->sequence;
+  } while (0);
+  BSPACM_CORE_REENABLE_INTERRUPT(istate);
+}
+
+int
+iBSPACMwalltimeRate_ppb (void)
+{
+  /* rate_q32 is bounded by BSPACM_UPTIME_RATE_LIMIT_Q32 so the
+   * product fits in 64 bits. */
+  return ((long long)xBSPACMwalltimeState_.rate_q32 * 1000000000LL) >> 32;
+}
+
+long long
+llBSPACMwalltimeFromUptime_us (unsigned long long utt)
+{
+  sBSPACMwalltimeState const * const sp = &xBSPACMwalltimeState_;
+  unsigned int seq;
+  unsigned long long base_utt;
+  long long base_us;
+  long rate_q32;
+
+  do {
+    seq = sp->sequence;
+    __DMB();
+    base_utt = sp->base_utt;
+    base_us = sp->base_us;
+    rate_q32 = sp->rate_q32;
+    __DMB();
+  } while ((seq & 1) || (seq != sp->sequence));
+
+  if (utt < base_utt) {
+    return base_us - (long long)ullBSPACMuptimeConvert_utt_us(base_utt - utt);
+  }
+  {
+    unsigned long long dur_us = ullBSPACMuptimeConvert_utt_us(utt - base_utt);
+    return base_us + (long long)dur_us + llBSPACMuptimeRateCorrection_us(dur_us, rate_q32);
+  }
+}
+
+int
+_gettimeofday (struct timeval * tv,
+               struct timezone * tz)
+{
+  (void)tz;
+  if (tv) {
+    long long now_us = llBSPACMwalltime_us();
+    tv->tv_sec = now_us / 1000000;
+    tv->tv_usec = now_us - 1000000LL * tv->tv_sec;
+  }
+  return 0;
+}
+
+#if defined(CLOCK_REALTIME)
+int
+clock_gettime (clockid_t clock_id,
+               struct timespec * tp)
+{
+  long long now_us;
+
+  if (CLOCK_REALTIME == clock_id) {
+    now_us = llBSPACMwalltime_us();
+#if defined(CLOCK_MONOTONIC)
+  } else if (CLOCK_MONOTONIC == clock_id) {
+    now_us = ullBSPACMuptimeConvert_utt_us(ullBSPACMuptime());
+#endif /* CLOCK_MONOTONIC */
+  } else {
+    errno = EINVAL;
+    return -1;
+  }
+  tp->tv_sec = now_us / 1000000;
+  tp->tv_nsec = 1000 * (now_us - 1000000LL * tp->tv_sec);
+  return 0;
+}
+#endif /* CLOCK_REALTIME */
@@ -38,6 +38,8 @@
 #include <bspacm/device/periphs.h>
 #include <bspacm/periph/gpio.h>
 #include <bspacm/internal/utility/fifo.h>
+#include <bspacm/utility/event.h>
+#include <bspacm/utility/task.h>
 #include <inc/hw_sysctl.h>
 #include <inc/hw_ints.h>
 #include <inc/hw_uart.h>
@@ -142,6 +144,16 @@ uart_configure (sBSPACMperiphUARTstate * usp,
       baud_rate = 115200;
     }
 
+    /* On reconfiguration the UART is still running.  The baud rate
+     * and line control registers must not be changed while it is
+     * enabled, so disable it and let the character in progress
+     * complete.  It is re-enabled below. */
+    if (UART_CTL_UARTEN & uart->CTL) {
+      uart->CTL &= ~UART_CTL_UARTEN;
+      while (UART_FR_BUSY & uart->FR) {
+      }
+    }
+
     /* System clock divided by the UART divisor (16) and the baud
      * rate, scaled to represent in units of 1/64 bit (6-bit
      * fraction), plus 1/2 for rounding.  Convert this to an
@@ -156,6 +168,7 @@ uart_configure (sBSPACMperiphUARTstate * usp,
      * the NVIC, then enable the UART */
     uart->ICR = uart->RIS;
     NVIC_ClearPendingIRQ(devcfgp->irqn);
+    NVIC_SetPriority(devcfgp->irqn, BSPACM_CORE_PRIORITY_DRIVER);
     NVIC_EnableIRQ(devcfgp->irqn);
     uart->IM = UART_IM_RXIM | UART_IM_RTIM;
     uart->CTL = UART_CTL_UARTEN | UART_CTL_TXE | UART_CTL_RXE;
@@ -192,11 +205,11 @@ uart_hw_txien (sBSPACMperiphUARTstate * usp,
 static int
 uart_fifo_state (sBSPACMperiphUARTstate * usp)
 {
-  BSPACM_CORE_SAVED_INTERRUPT_STATE(istate);
+  BSPACM_CORE_SAVED_PRIORITY_MASK(pmask);
   UART0_Type * const uart = (UART0_Type *)usp->uart;
   int rv = 0;
 
-  BSPACM_CORE_DISABLE_INTERRUPT();
+  BSPACM_CORE_MASK_PRIORITY();
   do {
     if (UART_FR_TXFE != ((UART_FR_TXFE | UART_FR_BUSY) & uart->FR)) {
       rv |= eBSPACMperiphUARTfifoState_HWTX;
@@ -211,17 +224,20 @@ uart_fifo_state (sBSPACMperiphUARTstate * usp)
       rv |= eBSPACMperiphUARTfifoState_SWRX;
     }
   } while (0);
-  BSPACM_CORE_REENABLE_INTERRUPT(istate);
+  BSPACM_CORE_RESTORE_PRIORITY_MASK(pmask);
   return rv;
 }
 
 void
 vBSPACMdeviceTM4CperiphUARTirqhandler (sBSPACMperiphUARTstate * const usp)
 {
-  BSPACM_CORE_SAVED_INTERRUPT_STATE(istate);
+  BSPACM_CORE_SAVED_PRIORITY_MASK(pmask);
   UART0_Type * const uart = (UART0_Type *)usp->uart;
+  bool received = false;
 
-  BSPACM_CORE_DISABLE_INTERRUPT();
+  /* Only the software FIFOs and the fields the driver also mutates
+   * are protected; error accounting and notification run with
+   * interrupts unmasked. */
   uart->ICR = (~ UART_MIS_TXMIS) & uart->MIS;
   while (! (UART_FR_RXFE & uart->FR)) {
     uint8_t dr = uart->DR;
@@ -243,23 +259,41 @@ vBSPACMdeviceTM4CperiphUARTirqhandler (sBSPACMperiphUARTstate * const usp)
         usp->rx_overrun_errors += 1;
       }
     } else {
-      if ((! usp->rx_fifo_ni_)
-          || (0 > fifo_push_head(usp->rx_fifo_ni_, dr))) {
+      int rc = -1;
+      if (usp->rx_fifo_ni_) {
+        BSPACM_CORE_MASK_PRIORITY();
+        rc = fifo_push_head(usp->rx_fifo_ni_, dr);
+        BSPACM_CORE_RESTORE_PRIORITY_MASK(pmask);
+      }
+      if (0 > rc) {
         usp->rx_dropped_errors += 1;
       }
       usp->rx_count += 1;
+      received = true;
+    }
+  }
+  if (received) {
+    vBSPACMeventPost(&xBSPACMeventSystem, BSPACM_EVENT_UART_RX);
+    if (usp->rx_task) {
+      (void)iBSPACMtaskPost(usp->rx_task);
     }
   }
   if (usp->tx_fifo_ni_) {
+    bool drained;
+    BSPACM_CORE_MASK_PRIORITY();
     while (! (fifo_empty(usp->tx_fifo_ni_) || (UART_FR_TXFF & uart->FR))) {
       uart->DR = fifo_pop_tail(usp->tx_fifo_ni_, 0);
       usp->tx_count += 1;
     }
-    if (fifo_empty(usp->tx_fifo_ni_)) {
+    drained = fifo_empty(usp->tx_fifo_ni_);
+    if (drained) {
       uart->IM &= ~UART_IM_TXIM;
     }
+    BSPACM_CORE_RESTORE_PRIORITY_MASK(pmask);
+    if (drained) {
+      vBSPACMeventPost(&xBSPACMeventSystem, BSPACM_EVENT_UART_TX);
+    }
   }
-  BSPACM_CORE_REENABLE_INTERRUPT(istate);
 }
 
 const sBSPACMperiphUARToperations xBSPACMdeviceTM4CperiphUARToperations = {
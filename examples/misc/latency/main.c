@@ -0,0 +1,149 @@
+/* BSPACM - misc/latency demonstration application
+ *
+ * Written in 2014 by Peter A. Bigot <http://pabigot.github.io/bspacm/>
+ *
+ * To the extent possible under law, the author(s) have dedicated all
+ * copyright and related and neighboring rights to this software to
+ * the public domain worldwide. This software is distributed without
+ * any warranty.
+ *
+ * You should have received a copy of the CC0 Public Domain Dedication
+ * along with this software. If not, see
+ * <http://creativecommons.org/publicdomain/zero/1.0/>.
+ */
+
+/* Measure interrupt entry latency while BSPACM infrastructure is
+ * exercised, one load at a time.  Each load is reported with its
+ * latency distribution and a PASS/FAIL verdict against
+ * LATENCY_LIMIT_CYCLES, so the application can be run after any
+ * change to critical sections to detect regressions.
+ */
+
+#include <bspacm/utility/latency.h>
+#include <bspacm/periph/uart.h>
+#include <bspacm/newlib/ioctl.h>
+#include <bspacm/newlib/uart.h>
+#if (BSPACM_DEVICE_SERIES_NRF51 - 0)
+#include <bspacm/utility/uptime.h>
+#endif /* BSPACM_DEVICE_SERIES_NRF51 */
+#include <stdio.h>
+#include <fcntl.h>
+
+#ifndef LATENCY_LIMIT_CYCLES
+#define LATENCY_LIMIT_CYCLES 200
+#endif /* LATENCY_LIMIT_CYCLES */
+
+#ifndef LATENCY_PRIORITY
+#define LATENCY_PRIORITY 0
+#endif /* LATENCY_PRIORITY */
+
+/* Events every 4096 to 8191 cycles. */
+#define LATENCY_PERIOD 4096
+#define LATENCY_JITTER 4095
+
+/* Latency samples to collect under each load.  Loads differ greatly
+ * in the time a pass takes, so each is repeated until this many
+ * events have been measured, giving every load the same statistical
+ * weight. */
+#define LOAD_SAMPLES 1000
+
+static volatile unsigned int sink;
+
+static void
+load_idle (void)
+{
+  unsigned int i;
+  for (i = 0; i < 16; ++i) {
+    sink += i;
+  }
+}
+
+/* Queue output through the UART transmit FIFO, which is shared with
+ * the UART interrupt handler. */
+static void
+load_uart_write (void)
+{
+  static const char line[] = "The quick brown fox jumps over the lazy dog\n";
+
+  (void)iBSPACMperiphUARTwrite(hBSPACMdefaultUART, line, sizeof(line) - 1);
+}
+
+/* Query FIFO state through the periph and newlib layers. */
+static void
+load_fifo_state (void)
+{
+  sBSPACMnewlibFDOPSuartFifoLevels levels;
+
+  sink += iBSPACMperiphUARTfifoState(hBSPACMdefaultUART);
+  (void)ioctl(1, BSPACM_IOCTL_UART_FIFO_LEVELS, &levels);
+}
+
+#if (BSPACM_DEVICE_SERIES_NRF51 - 0)
+static void
+load_uptime (void)
+{
+  sink += (unsigned int)ullBSPACMuptime();
+}
+#endif /* BSPACM_DEVICE_SERIES_NRF51 */
+
+/* A load is one pass of some activity, repeated until LOAD_SAMPLES
+ * events have been measured. */
+typedef struct sLoad {
+  const char * name;
+  void (* run) (void);
+} sLoad;
+
+static const sLoad loads[] = {
+  { "idle", load_idle },
+  { "uart write", load_uart_write },
+  { "fifo state", load_fifo_state },
+#if (BSPACM_DEVICE_SERIES_NRF51 - 0)
+  { "uptime", load_uptime },
+#endif /* BSPACM_DEVICE_SERIES_NRF51 */
+};
+
+void main ()
+{
+  const sLoad * lp = loads;
+  const sLoad * const elp = loads + sizeof(loads) / sizeof(*loads);
+  unsigned int failures = 0;
+
+  BSPACM_CORE_ENABLE_INTERRUPT();
+#if (BSPACM_DEVICE_SERIES_NRF51 - 0)
+  vBSPACMuptimeStart();
+#endif /* BSPACM_DEVICE_SERIES_NRF51 */
+
+  printf("\n" __DATE__ " " __TIME__ "\n");
+  printf("System clock %lu Hz\n", SystemCoreClock);
+  printf("Latency limit %u cycles at priority %u\n",
+         LATENCY_LIMIT_CYCLES, LATENCY_PRIORITY);
+
+  while (lp < elp) {
+    sBSPACMlatencyStatistics stats;
+
+    fflush(stdout);
+    ioctl(1, BSPACM_IOCTL_FLUSH, O_WRONLY);
+    if (0 != iBSPACMlatencyStart(LATENCY_PERIOD, LATENCY_JITTER, LATENCY_PRIORITY)) {
+      printf("ERR: latency measurement failed to start\n");
+      break;
+    }
+    do {
+      lp->run();
+    } while (LOAD_SAMPLES > uiBSPACMlatencyCount());
+    /* Output queued by the load drains under measurement too. */
+    (void)iBSPACMperiphUARTflush(hBSPACMdefaultUART, eBSPACMperiphUARTfifoState_TX);
+    vBSPACMlatencyStop();
+    vBSPACMlatencySnapshot(&stats, true);
+
+    printf("\n%s: %s\n", lp->name,
+           (LATENCY_LIMIT_CYCLES < stats.max) ? "FAIL" : "PASS");
+    vBSPACMlatencyReport(&stats);
+    if (LATENCY_LIMIT_CYCLES < stats.max) {
+      ++failures;
+    }
+    ++lp;
+  }
+  printf("\n%u of %u loads exceeded the limit\n", failures, (unsigned int)(elp - loads));
+  fflush(stdout);
+  ioctl(1, BSPACM_IOCTL_FLUSH, O_WRONLY);
+}
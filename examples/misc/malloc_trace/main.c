@@ -0,0 +1,167 @@
+/* BSPACM - misc/malloc_trace demonstration application
+ *
+ * Written in 2014 by Peter A. Bigot <http://pabigot.github.io/bspacm/>
+ *
+ * To the extent possible under law, the author(s) have dedicated all
+ * copyright and related and neighboring rights to this software to
+ * the public domain worldwide. This software is distributed without
+ * any warranty.
+ *
+ * You should have received a copy of the CC0 Public Domain Dedication
+ * along with this software. If not, see
+ * <http://creativecommons.org/publicdomain/zero/1.0/>.
+ */
+
+/* Replay allocation traces against the heap allocator, recording the
+ * worst-case cycle count of each operation and the resulting heap
+ * fragmentation.  Build with NEWLIB_MALLOC=tlsf (the default here) or
+ * NEWLIB_MALLOC= to compare the TLSF and newlib allocators on the
+ * same trace.
+ */
+
+#include <bspacm/core.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#if (WITH_TLSF - 0)
+#include <bspacm/newlib/tlsf.h>
+#else /* WITH_TLSF */
+#include <malloc.h>
+#endif /* WITH_TLSF */
+
+#define SLOT_COUNT 32
+
+/* A recorded trace: each entry names a slot and a size.  A non-zero
+ * size allocates (or reallocates, if the slot is occupied); a zero
+ * size frees the slot.  This one models a packet driver that holds
+ * a few long-lived buffers while short-lived buffers of varying size
+ * come and go. */
+typedef struct sTraceEntry {
+  uint8_t slot;
+  uint16_t size;
+} sTraceEntry;
+
+static const sTraceEntry packet_trace[] = {
+  { 0, 512 }, { 1, 64 }, { 2, 128 }, { 3, 40 }, { 4, 300 },
+  { 3, 0 }, { 5, 96 }, { 1, 0 }, { 6, 256 }, { 7, 24 },
+  { 2, 0 }, { 8, 180 }, { 4, 0 }, { 9, 12 }, { 10, 700 },
+  { 5, 0 }, { 7, 0 }, { 11, 48 }, { 12, 64 }, { 6, 400 },
+  { 9, 0 }, { 13, 1024 }, { 8, 0 }, { 14, 32 }, { 10, 0 },
+  { 11, 0 }, { 15, 256 }, { 12, 0 }, { 13, 0 }, { 14, 0 },
+  { 15, 0 }, { 6, 0 },
+};
+
+static void * slot[SLOT_COUNT];
+
+typedef struct sStats {
+  unsigned int ops;
+  unsigned int failures;
+  unsigned int max_alloc_cycles;
+  unsigned int max_free_cycles;
+} sStats;
+
+static void
+apply (sStats * sp,
+       unsigned int si,
+       size_t size)
+{
+  unsigned int t0;
+  unsigned int dt;
+
+  sp->ops += 1;
+  if (0 == size) {
+    t0 = BSPACM_CORE_CYCCNT();
+    free(slot[si]);
+    dt = BSPACM_CORE_CYCCNT() - t0;
+    slot[si] = 0;
+    if (dt > sp->max_free_cycles) {
+      sp->max_free_cycles = dt;
+    }
+  } else {
+    void * p;
+    t0 = BSPACM_CORE_CYCCNT();
+    p = realloc(slot[si], size);
+    dt = BSPACM_CORE_CYCCNT() - t0;
+    if (dt > sp->max_alloc_cycles) {
+      sp->max_alloc_cycles = dt;
+    }
+    if (p) {
+      slot[si] = p;
+      memset(p, si, size);
+    } else {
+      sp->failures += 1;
+    }
+  }
+}
+
+static void
+report (const char * tag,
+        const sStats * sp)
+{
+  printf("%s: %u ops, %u failed; max cycles alloc %u free %u\n",
+         tag, sp->ops, sp->failures,
+         sp->max_alloc_cycles, sp->max_free_cycles);
+#if (WITH_TLSF - 0)
+  {
+    sBSPACMnewlibTLSFstatistics ts;
+    vBSPACMnewlibTLSFstatistics(&ts);
+    printf("  TLSF heap %u: used %u (peak %u) in %u, free %u in %u, largest %u\n",
+           ts.heap_size, ts.used, ts.max_used, ts.used_blocks,
+           ts.free, ts.free_blocks, ts.largest_free);
+  }
+#else /* WITH_TLSF */
+  {
+    struct mallinfo mi = mallinfo();
+    printf("  newlib arena %u: used %u, free %u\n",
+           mi.arena, mi.uordblks, mi.fordblks);
+  }
+#endif /* WITH_TLSF */
+}
+
+void main ()
+{
+  sStats stats;
+  unsigned int i;
+  unsigned int rep;
+  uint32_t lcg = 1;
+
+  BSPACM_CORE_ENABLE_INTERRUPT();
+  BSPACM_CORE_ENABLE_CYCCNT();
+
+  printf("\n" __DATE__ " " __TIME__ "\n");
+  printf("System clock %lu Hz\n", SystemCoreClock);
+#if ! (BSPACM_CORE_SUPPORTS_CYCCNT - 0)
+  printf("No cycle counter: timings will be zero\n");
+#endif /* BSPACM_CORE_SUPPORTS_CYCCNT */
+
+  memset(&stats, 0, sizeof(stats));
+  for (rep = 0; rep < 100; ++rep) {
+    for (i = 0; i < sizeof(packet_trace)/sizeof(*packet_trace); ++i) {
+      apply(&stats, packet_trace[i].slot, packet_trace[i].size);
+    }
+  }
+  report("Packet trace", &stats);
+
+  /* A synthetic trace with randomly chosen slots and sizes, which
+   * tends to fragment the heap. */
+  memset(&stats, 0, sizeof(stats));
+  for (i = 0; i < 20000; ++i) {
+    unsigned int si;
+    size_t size;
+
+    lcg = 1664525 * lcg + 1013904223;
+    si = (lcg >> 8) % SLOT_COUNT;
+    size = (lcg >> 16) & 0x1FF;
+    if (slot[si] && (lcg & 0x80000000)) {
+      size = 0;
+    }
+    apply(&stats, si, size);
+  }
+  report("Random trace", &stats);
+
+  for (i = 0; i < SLOT_COUNT; ++i) {
+    free(slot[i]);
+    slot[i] = 0;
+  }
+  report("Released", &stats);
+}
@@ -17,6 +17,7 @@
 
 #include <bspacm/utility/led.h>
 #include <bspacm/utility/uptime.h>
+#include <bspacm/utility/event.h>
 #include <bspacm/newlib/ioctl.h>
 #include <stdio.h>
 #include <fcntl.h>
@@ -46,6 +47,10 @@ volatile uint8_t button_state;
 
 volatile unsigned int irqs;
 
+/* Application event posted by the GPIOTE handler when a button
+ * changes state. */
+#define EVENT_BUTTON BSPACM_EVENT_APPLICATION_BASE
+
 void
 GPIOTE_IRQHandler (void)
 {
@@ -63,15 +68,14 @@ GPIOTE_IRQHandler (void)
       } else {
         button_state |= bbit;
       }
-      if (1 & b) {
-        vBSPACMuptimeSleepCancel();
-      }
+      vBSPACMeventPost(&xBSPACMeventSystem, EVENT_BUTTON);
     }
   }
 }
 
 void main ()
 {
+  sBSPACMuptimeAlarm tick = { .interval_utt = BSPACM_UPTIME_Hz };
   int b;
 
   vBSPACMledConfigure();
@@ -105,8 +109,12 @@ void main ()
   vBSPACMnrf51_NVIC_ClearPendingIRQ(GPIOTE_IRQn);
   vBSPACMnrf51_NVIC_EnableIRQ(GPIOTE_IRQn);
 
+  /* Display state once per second even if no buttons change. */
+  (void)iBSPACMuptimeAlarmSet(1, uiBSPACMuptime() + BSPACM_UPTIME_Hz, &tick);
+
   while (1) {
-    bool fns = bBSPACMuptimeSleep(BSPACM_UPTIME_Hz);
+    uint32_t events = uiBSPACMeventWait(&xBSPACMeventSystem,
+                                        EVENT_BUTTON | BSPACM_EVENT_UPTIME_ALARM);
     /* Yes, this is a race condition.  No, I don't care; it's an
      * example. */
     uint8_t chgd = button_changed;
@@ -116,8 +124,8 @@ void main ()
 
       putchar(NRF_GPIO->IN & pbit ? ' ' : 'P');
     }
-    printf(" -- st %x ; chg %x ; irqs %u ; full sleep %d\n",
-           button_state, chgd, irqs, fns);
+    printf(" -- st %x ; chg %x ; irqs %u ; events %lx\n",
+           button_state, chgd, irqs, events);
   }
 
   fflush(stdout);
@@ -16,7 +16,9 @@
 #include <bspacm/newlib/ioctl.h>
 #include <bspacm/utility/misc.h>
 #include <bspacm/utility/hires.h>
+#include <bspacm/utility/uptime.h>
 #include <bspacm/utility/onewire.h>
+#include <bspacm/utility/pt.h>
 #include <stdio.h>
 #include <string.h>
 #include <fcntl.h>
@@ -28,9 +30,57 @@
 #define ONEWIRE_PWR_PIN 0
 #endif /* ONEWIRE_PWR_PIN */
 
+/* The measurement cycle is a protothread.  Bit-level 1-wire timing
+ * still uses microsecond hires sleeps, but the long waits for the
+ * conversion and between samples suspend the protothread so the
+ * core can sleep (or other protothreads could run). */
+typedef struct sensor_pt {
+  sBSPACMpt pt;
+  hBSPACMonewireBus bus;
+  int external_power;
+} sensor_pt;
+
+static int
+sensor_thread (sensor_pt * sp)
+{
+  int16_t t_xCel;
+  int rc;
+
+  BSPACM_PT_BEGIN(&sp->pt);
+  while (0 == iBSPACMonewireRequestTemperature(sp->bus)) {
+    if (sp->external_power) {
+      /* Conversion time can be as long as 750 ms if 12-bit resolution
+       * is used (this resolution is the default).  Wait 600ms, then
+       * test at 10ms intervals until the result is ready. */
+      BSPACM_PT_SLEEP_UTT(&sp->pt, uiBSPACMuptimeConvert_ms_utt(600));
+      while (! iBSPACMonewireReadBit(sp->bus)) {
+        BSPACM_PT_SLEEP_UTT(&sp->pt, uiBSPACMuptimeConvert_ms_utt(10));
+      }
+    } else {
+      /* Output high on the parasitic power boost line for 750ms, to
+       * power the conversion.  Then switch that signal back to
+       * input so the data can flow over the same circuit. */
+      vBSPACMonewireParasitePower(sp->bus, true);
+      BSPACM_PT_SLEEP_UTT(&sp->pt, uiBSPACMuptimeConvert_ms_utt(750));
+      vBSPACMonewireParasitePower(sp->bus, false);
+    }
+    t_xCel = -1;
+    rc = iBSPACMonewireReadTemperature(sp->bus, &t_xCel);
+    vBSPACMonewireShutdown(sp->bus);
+    printf("Got %d: %d xCel, %d dCel, %d d[degF], %d dK\n",
+           rc, t_xCel,
+           BSPACM_ONEWIRE_xCel_TO_dCel(t_xCel),
+           BSPACM_ONEWIRE_xCel_TO_ddegF(t_xCel),
+           BSPACM_ONEWIRE_xCel_TO_dK(t_xCel));
+    BSPACM_PT_SLEEP_UTT(&sp->pt, BSPACM_UPTIME_Hz);
+  }
+  BSPACM_PT_END(&sp->pt);
+}
+
 void main ()
 {
   vBSPACMledConfigure();
+  vBSPACMuptimeStart();
 
   printf("\n" __DATE__ " " __TIME__ "\n");
   printf("System clock %lu Hz\n", SystemCoreClock);
@@ -38,6 +88,7 @@ void main ()
   do {
     sBSPACMonewireBus bus_config;
     hBSPACMonewireBus bus = hBSPACMonewireConfigureBus(&bus_config, ONEWIRE_DQ_PIN, ONEWIRE_PWR_PIN);
+    sensor_pt sensor;
     int rc;
 
     /* Configure high-resolution timer at 1 MHz */
@@ -72,36 +123,12 @@ void main ()
     vBSPACMconsoleDisplayOctets(serial.id, sizeof(serial.id));
     putchar('\n');
 
-    while (0 == iBSPACMonewireRequestTemperature(bus)) {
-      if (external_power) {
-        /* Wait for read to complete.  Conversion time can be as long as
-         * 750 ms if 12-bit resolution is used (this resolution is the
-         * default). Timing will be wrong unless interrupts are enabled
-         * so uptime overflow events can be handled.  Sleep for 600ms,
-         * then test at 10ms intervals until the result is ready. */
-        vBSPACMhiresSleep_ms(600);
-        while (! iBSPACMonewireReadBit(bus)) {
-          vBSPACMhiresSleep_ms(10);
-        }
-      } else {
-        /* Output high on the parasitic power boost line for 750ms, to
-         * power the conversion.  Then switch that signal back to
-         * input so the data can flow over the same circuit. */
-        vBSPACMonewireParasitePower(bus, true);
-        vBSPACMhiresSleep_ms(750);
-        vBSPACMonewireParasitePower(bus, false);
-      }
-      int16_t t_xCel = -1;
-      rc = iBSPACMonewireReadTemperature(bus, &t_xCel);
-      vBSPACMonewireShutdown(bus);
-      printf("Got %d xCel, %d dCel, %d d[degF], %d dK\n",
-             t_xCel,
-             BSPACM_ONEWIRE_xCel_TO_dCel(t_xCel),
-             BSPACM_ONEWIRE_xCel_TO_ddegF(t_xCel),
-             BSPACM_ONEWIRE_xCel_TO_dK(t_xCel));
-      vBSPACMhiresSleep_ms(1000);
+    memset(&sensor, 0, sizeof(sensor));
+    sensor.bus = bus;
+    sensor.external_power = external_power;
+    while (BSPACM_PT_EXITED > sensor_thread(&sensor)) {
+      (void)uiBSPACMptIdle(0);
     }
-
   } while (0);
 
   fflush(stdout);
@@ -17,6 +17,7 @@
 #include <bspacm/utility/misc.h>
 #include <bspacm/utility/hires.h>
 #include <bspacm/utility/uptime.h>
+#include <bspacm/utility/pt.h>
 #include <bspacm/periph/dietemp.h>
 #include <bspacm/periph/twi.h>
 #include <stdio.h>
@@ -125,33 +126,20 @@ int sht21_read_eic (hBSPACMi2cBus tp,
   return rc;
 }
 
-/* What we're doing here is using the generic uptime infrastructure to
- * wake up once per second and start a sequence of timed I2C
- * operations: first intiate a temperature read; after 100 ms read the
- * temperature and initiate a humidity read; after 50 ms read the
- * humidity and display the results; then start again in 850 ms. */
-
-typedef struct alarm_stage {
-  /* The alarm that fired to initiate this stage */
-  sBSPACMuptimeAlarm alarm;
-  /* The function that implements this stage */
-  int (* callback) (const struct alarm_stage * asp);
-  /* The next stage to run */
-  struct alarm_stage * next;
-  /* I2C parameters required to execute the stage */
+/* What we're doing here is using a protothread to wake up once per
+ * second and run a sequence of timed I2C operations: first initiate
+ * a temperature read; after 100 ms read the temperature and initiate
+ * a humidity read; after 50 ms read the humidity and display the
+ * results; then start again at the next second. */
+
+typedef struct sht21_pt {
+  sBSPACMpt pt;
+  /* The I2C bus to which the sensor is attached */
   hBSPACMi2cBus tpp;
-  /* The raw uptime clock value when this stage fired */
-  uint32_t last_fired;
-  /* The delta from #last_fired to when the next stage should be
-   * started */
-  uint16_t delta_utt;
-  /* An I2C command parameter used within the stage */
-  uint8_t cmd;
-} alarm_stage;
-
-unsigned int wake_count;
-uint64_t epoch;
-uint64_t wake_total;
+  /* The uptime at which the current measurement cycle started */
+  unsigned int cycle_utt;
+} sht21_pt;
+
 uint16_t t_raw;
 uint16_t rh_raw;
 
@@ -168,19 +156,20 @@ uint16_t rh_raw;
  */
 #define BSP430_SENSORS_SHT21_TEMPERATURE_RAW_TO_cK(raw_) (22630U + (unsigned int)((17572UL * (raw_)) >> 16))
 
-int show_results (const alarm_stage * asp)
+int show_results (void)
 {
   uint64_t now = ullBSPACMuptime();
-  uint64_t elapsed = now - epoch;
+  sBSPACMuptimeIdleStatistics idle;
+  uint64_t awake;
 
-  (void)asp;
-
-  printf("%lu: %u wakeups ; uptime %lu ; awake %lu ; duty %lu [ppth]\n",
+  vBSPACMuptimeIdleStatistics(&idle, false);
+  awake = idle.elapsed_utt - idle.asleep_utt;
+  printf("%lu: %u sleeps ; uptime %lu ; awake %lu ; duty %lu [ppth]\n",
          (unsigned long)(now / BSPACM_UPTIME_Hz),
-         wake_count,
-         (unsigned long)elapsed,
-         (unsigned long)wake_total,
-         (unsigned long)((1000 * wake_total) / elapsed));
+         idle.idle_count,
+         (unsigned long)idle.elapsed_utt,
+         (unsigned long)awake,
+         (unsigned long)((1000 * awake) / idle.elapsed_utt));
 #if ! (DUTY_CYCLE_ONLY - 0)
   /* If all output is disabled the duty cycle is less than 0.2%, as
    * opposed to 1.5% with output enabled.  This is about 2 ms per
@@ -205,57 +194,57 @@ int show_results (const alarm_stage * asp)
   return 0;
 }
 
-int send_read (const alarm_stage * asp)
+int send_read (hBSPACMi2cBus tpp,
+               uint8_t what)
 {
-  uint8_t cmd = (asp->cmd
+  uint8_t cmd = (what
                  | SHT21_CMDBIT_BASE
                  | SHT21_CMDBIT_READ
                  | SHT21_CMDBIT_NOHOLD);
-  return iBSPACMi2cWrite(asp->tpp, SHT21_ADDRESS, &cmd, sizeof(cmd));
+  return iBSPACMi2cWrite(tpp, SHT21_ADDRESS, &cmd, sizeof(cmd));
 }
 
-int read_result (const alarm_stage * asp)
+int read_result (hBSPACMi2cBus tpp)
 {
   uint8_t data[3];
   int rc;
 
-  rc = iBSPACMi2cRead(asp->tpp, SHT21_ADDRESS, data, sizeof(data));
+  rc = iBSPACMi2cRead(tpp, SHT21_ADDRESS, data, sizeof(data));
   if ((0 <= rc) && (0 == sht21_crc(data, rc))) {
     rc = ((data[0] << 8) | data[1]) & ~0x03;
-    if (asp->cmd) {
-      t_raw = rc;
-      rc = send_read(asp);
-    } else {
-      rh_raw = rc;
-      show_results(asp);
-    }
+  } else if (0 <= rc) {
+    rc = -1;
   }
   return rc;
 }
 
-static const alarm_stage * volatile pending_stage_;
-void stage_flih (int ccidx,
-                 hBSPACMuptimeAlarm ap)
-{
-  alarm_stage * asp = (alarm_stage *)ap;
-  asp->last_fired = BSPACM_UPTIME_RTC->CC[ccidx];
-  pending_stage_ = asp;
-}
-
-/* Return a pointer to the next stage to execute, or a null pointer if
- * no stage has become due since the last call to this function. */
-const alarm_stage * get_pending_stage ()
+int sht21_thread (sht21_pt * sp)
 {
-  BSPACM_CORE_SAVED_INTERRUPT_STATE(istate);
-  const alarm_stage * rv;
+  int rc;
 
-  BSPACM_CORE_DISABLE_INTERRUPT();
-  do {
-    rv = pending_stage_;
-    pending_stage_ = NULL;
-  } while (0);
-  BSPACM_CORE_REENABLE_INTERRUPT(istate);
-  return rv;
+  BSPACM_PT_BEGIN(&sp->pt);
+  while (1) {
+    sp->cycle_utt += BSPACM_UPTIME_Hz;
+    BSPACM_PT_SLEEP_UNTIL_UTT(&sp->pt, sp->cycle_utt);
+    (void)send_read(sp->tpp, SHT21_CMDBIT_TEMP);
+    /* High-resolution temperature read takes up to 85 ms.  Sleep for
+     * 100 ms. */
+    BSPACM_PT_SLEEP_UTT(&sp->pt, BSPACM_UPTIME_Hz / 10);
+    rc = read_result(sp->tpp);
+    if (0 <= rc) {
+      t_raw = rc;
+    }
+    (void)send_read(sp->tpp, SHT21_CMDBIT_RH);
+    /* High-resolution humidity read takes up to 29 ms.  Sleep for 50
+     * ms. */
+    BSPACM_PT_SLEEP_UTT(&sp->pt, BSPACM_UPTIME_Hz / 20);
+    rc = read_result(sp->tpp);
+    if (0 <= rc) {
+      rh_raw = rc;
+    }
+    show_results();
+  }
+  BSPACM_PT_END(&sp->pt);
 }
 
 void main ()
@@ -272,9 +261,7 @@ void main ()
   do {
     sBSPACMi2cBus tp;
     hBSPACMi2cBus tpp;
-    alarm_stage alarm_stages[4];
-    alarm_stage * asp;
-    unsigned int remaining_delay;
+    sht21_pt sensor;
     uint8_t buf[16];
     int rc;
 
@@ -325,60 +312,16 @@ void main ()
       }
     }
 
-    remaining_delay = BSPACM_UPTIME_Hz;
+    memset(&sensor, 0, sizeof(sensor));
+    sensor.tpp = tpp;
 
-    memset(alarm_stages, 0, sizeof(alarm_stages));
-
-    asp = alarm_stages;
-
-    asp->alarm.callback_flih = stage_flih;
-    asp->callback = send_read;
-    asp->tpp = &tp;
-    asp->cmd = SHT21_CMDBIT_TEMP;
-    /* High-resolution temperature read takes up to 85 ms.  Sleep for
-     * 100 ms. */
-    asp->delta_utt = BSPACM_UPTIME_Hz / 10;
-    remaining_delay -= asp->delta_utt;
-    asp->next = asp+1;
-    ++asp;
-
-    asp->alarm.callback_flih = stage_flih;
-    asp->callback = read_result;
-    asp->tpp = &tp;
-    asp->cmd = SHT21_CMDBIT_RH;
-    /* High-resolution humidity read takes up to 29 ms.  Sleep for 50
-     * ms. */
-    asp->delta_utt = BSPACM_UPTIME_Hz / 20;
-    remaining_delay -= asp->delta_utt;
-    asp->next = asp+1;
-    ++asp;
-
-    asp->alarm.callback_flih = stage_flih;
-    asp->callback = read_result;
-    asp->tpp = &tp;
-    asp->delta_utt = remaining_delay;
-    asp->next = alarm_stages;
-
-    uint64_t last_wake = ullBSPACMuptime();
-    wake_count = 0;
-    epoch = last_wake;
-    rc = iBSPACMuptimeAlarmSet(1, BSPACM_UPTIME_Hz, &alarm_stages[0].alarm);
+    /* Start idle accounting now.  Every sleep, including those for
+     * UART interrupts as the transmit buffer drains, is counted. */
+    vBSPACMuptimeIdleStatistics(NULL, true);
+    sensor.cycle_utt = uiBSPACMuptime();
     while (1) {
-      const alarm_stage * asp;
-      while (! ((asp = get_pending_stage()))) {
-        uint64_t last_sleep = ullBSPACMuptime();
-        wake_total += (last_sleep - last_wake);
-        __WFE();
-        last_wake = ullBSPACMuptime();
-        /* NB: We can get wakeups not only because the alarm is ready
-         * but also because of UART interrupts as the transmit buffer
-         * drains. */
-        ++wake_count;
-      }
-      asp->callback(asp);
-      if (asp->next) {
-        rc = iBSPACMuptimeAlarmSet(1, asp->last_fired + asp->delta_utt, &asp->next->alarm);
-      }
+      (void)sht21_thread(&sensor);
+      (void)uiBSPACMptIdle(0);
     }
   } while (0);
   fflush(stdout);
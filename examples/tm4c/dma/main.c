@@ -15,6 +15,7 @@
 #include <bspacm/utility/led.h>
 #include <bspacm/newlib/ioctl.h>
 #include <bspacm/utility/misc.h>
+#include <bspacm/utility/profile.h>
 #include <inc/hw_udma.h>
 #include <string.h>
 #include <inttypes.h>
@@ -23,7 +24,7 @@
 
 /* Allocate 32 primary and alternative channels.  The channel table
  * must be aligned to a 1 KiBy boundary. */
-BSPACM_CORE_ALIGNED_OBJECT(1024)
+BSPACM_CORE_SECTION_DMA BSPACM_CORE_ALIGNED_OBJECT(1024)
 UDMA_CHANNEL_Type dma_channel_table[32 * 2];
 
 #ifndef DMA_BUFFER_SIZE
@@ -46,20 +47,22 @@ UDMAERR_IRQHandler (void)
   BSPACM_CORE_BITBAND_PERIPH(UDMA->ERRCLR, 0) = 0;
 }
 
+BSPACM_PROFILE_PROBE_DEFINE(dma_octets);
+BSPACM_PROFILE_PROBE_DEFINE(memset);
+BSPACM_PROFILE_PROBE_DEFINE(dma_words);
+
 #define DMA_CHANNEL_MM 30
 #define DMA_SELECT_MM 4
 
 void main ()
 {
   int i;
-  unsigned int t0;
-  unsigned int t1;
   vBSPACMledConfigure();
   unsigned int const transfer_size_By = sizeof(src_buffer);
   unsigned int const display_size_By = 128;
   UDMA_CHANNEL_Type * swch = dma_channel_table + DMA_CHANNEL_MM;
 
-  BSPACM_CORE_ENABLE_CYCCNT();
+  (void)iBSPACMprofileInitialize();
   BSPACM_CORE_ENABLE_INTERRUPT();
 
   printf("\n" __DATE__ " " __TIME__ "\n");
@@ -126,23 +129,22 @@ void main ()
   fflush(stdout);
   ioctl(1, BSPACM_IOCTL_FLUSH, O_WRONLY);
 
-  t0 = BSPACM_CORE_CYCCNT();
+  BSPACM_PROFILE_ENTER(dma_octets);
   /* Trigger the DMA and wait for completion */
   BSPACM_CORE_BITBAND_PERIPH(UDMA->SWREQ, DMA_CHANNEL_MM) = 1;
   while (! BSPACM_CORE_BITBAND_PERIPH(UDMA->CHIS, DMA_CHANNEL_MM)) {
   }
-  t1 = BSPACM_CORE_CYCCNT();
-  printf("Completed ctrl %" PRIx32 " from %" PRIxPTR " to %" PRIxPTR " in %u cycles\n",
-         swch->chctl, (uintptr_t)swch->srcendp, (uintptr_t)swch->dstendp, t1-t0);
+  BSPACM_PROFILE_EXIT(dma_octets);
+  printf("Completed ctrl %" PRIx32 " from %" PRIxPTR " to %" PRIxPTR "\n",
+         swch->chctl, (uintptr_t)swch->srcendp, (uintptr_t)swch->dstendp);
   printf("UDMA STAT %lx CFG %lx ENA %lx CHIS %lx\n",
          UDMA->STAT, UDMA->CFG, UDMA->ENASET, UDMA->CHIS);
 
   printf("Destination:\n");
   vBSPACMconsoleDisplayMemoryOctets(dst_buffer, display_size_By, (uintptr_t)dst_buffer);
-  t0 = BSPACM_CORE_CYCCNT();
+  BSPACM_PROFILE_ENTER(memset);
   memset(dst_buffer, 0, sizeof(dst_buffer));
-  t1 = BSPACM_CORE_CYCCNT();
-  printf("Clear destination took %u cycles\n", t1-t0);
+  BSPACM_PROFILE_EXIT(memset);
 
   /* Same transfer but with 32-bit values and maximum delay before
    * arbitration (more than total transfer length) */
@@ -167,19 +169,18 @@ void main ()
   fflush(stdout);
   ioctl(1, BSPACM_IOCTL_FLUSH, O_WRONLY);
 
-  t0 = BSPACM_CORE_CYCCNT();
+  BSPACM_PROFILE_ENTER(dma_words);
   BSPACM_CORE_BITBAND_PERIPH(UDMA->SWREQ, DMA_CHANNEL_MM) = 1;
   while (! BSPACM_CORE_BITBAND_PERIPH(UDMA->CHIS, DMA_CHANNEL_MM)) {
   }
-  t1 = BSPACM_CORE_CYCCNT();
-
-  printf("Word transfer took %u cycles\n", t1-t0);
+  BSPACM_PROFILE_EXIT(dma_words);
 
   printf("Destination:\n");
   vBSPACMconsoleDisplayMemoryOctets(dst_buffer, display_size_By, (uintptr_t)dst_buffer);
 
   NVIC_DisableIRQ(UDMAERR_IRQn);
   printf("%u DMA errors\n", ndmaerr);
+  vBSPACMprofileReport(false);
   fflush(stdout);
   ioctl(1, BSPACM_IOCTL_FLUSH, O_WRONLY);
   BSPACM_CORE_DEEP_SLEEP();
@@ -120,7 +120,7 @@ capture_delta_us (capture_type c0,
 /* Allocate space to hold the configurations for the primary and
  * alternative DMA channels.  The channel table must be aligned to a 1
  * KiBy boundary. */
-BSPACM_CORE_ALIGNED_OBJECT(1024)
+BSPACM_CORE_SECTION_DMA BSPACM_CORE_ALIGNED_OBJECT(1024)
 static UDMA_CHANNEL_Type dma_channel_table[DMA_CHANNEL_COUNT * 2];
 
 /** The DMA channel control bit settings exclusive of transfer size.
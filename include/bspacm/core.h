@@ -105,6 +105,61 @@
 #define BSPACM_CORE_ALIGNED_OBJECT(sz_) __attribute__((__aligned__(sz_)))
 #endif /* TOOLCHAIN */
 
+/** Place a function in RAM.
+ *
+ * The function is copied from flash to RAM during startup, and will
+ * execute from RAM.  This is appropriate for code that must run while
+ * flash is being programmed or is powered down, or where zero
+ * wait-state execution is required.  Calls between flash and RAM are
+ * out of range for a direct branch; the linker inserts veneers.
+ *
+ * @note This requires that the startup code be built with @c
+ * __STARTUP_COPY_MULTIPLE, as is done by default.
+ *
+ * @see #BSPACM_CORE_SECTION_FAST_DATA */
+#if defined(BSPACM_DOXYGEN) || (BSPACM_CORE_TOOLCHAIN_GCC - 0)
+#define BSPACM_CORE_SECTION_FAST_TEXT __attribute__((__section__(".fast.text"),__noinline__))
+#endif /* TOOLCHAIN */
+
+/** Place an initialized object in the RAM region that holds
+ * #BSPACM_CORE_SECTION_FAST_TEXT functions.
+ *
+ * Use this for lookup tables and similar constant data referenced by
+ * RAM functions, to avoid flash accesses.  (GCC does not permit
+ * functions and objects to share a section within one translation
+ * unit, so a separate section is used for data.) */
+#if defined(BSPACM_DOXYGEN) || (BSPACM_CORE_TOOLCHAIN_GCC - 0)
+#define BSPACM_CORE_SECTION_FAST_DATA __attribute__((__section__(".fast.data")))
+#endif /* TOOLCHAIN */
+
+/** Place an object in the RAM region reserved for DMA buffers.
+ *
+ * The region is located at the start of RAM and is cleared at
+ * startup.  Objects in it are sorted by decreasing alignment, so
+ * combining this with #BSPACM_CORE_ALIGNED_OBJECT places a
+ * strictly-aligned object such as a micro-DMA channel table without
+ * padding:
+ *
+ * @code
+ * BSPACM_CORE_SECTION_DMA BSPACM_CORE_ALIGNED_OBJECT(1024)
+ * static UDMA_CHANNEL_Type dma_channel_table[32 * 2];
+ * @endcode
+ *
+ * @note This requires that the startup code be built with @c
+ * __STARTUP_CLEAR_BSS_MULTIPLE, as is done by default. */
+#if defined(BSPACM_DOXYGEN) || (BSPACM_CORE_TOOLCHAIN_GCC - 0)
+#define BSPACM_CORE_SECTION_DMA __attribute__((__section__(".dma")))
+#endif /* TOOLCHAIN */
+
+/** Place an object in RAM that is neither initialized nor cleared at
+ * startup.
+ *
+ * The contents of such objects are undefined after power-up, but are
+ * retained across a reset, e.g. to record the cause of a fault. */
+#if defined(BSPACM_DOXYGEN) || (BSPACM_CORE_TOOLCHAIN_GCC - 0)
+#define BSPACM_CORE_SECTION_NOINIT __attribute__((__section__(".noinit")))
+#endif /* TOOLCHAIN */
+
 /* Device-specific material.  This includes device vendor and CMSIS
  * headers, and provides any necessary bridging declarations.  The
  * correct content should be located by the prioritization of include
@@ -168,6 +223,134 @@
     }                                             \
   } while (0)
 
+/** Defined to a true value if the core supports masking interrupts
+ * by priority through the @c BASEPRI register.  This is false on
+ * Cortex-M0 and Cortex-M0+ devices. */
+#if (3 <= (__CORTEX_M - 0))
+#define BSPACM_CORE_SUPPORTS_BASEPRI 1
+#else /* __CORTEX_M */
+#define BSPACM_CORE_SUPPORTS_BASEPRI 0
+#endif /* __CORTEX_M */
+
+/** @def BSPACM_CORE_PRIORITY_CEILING
+ *
+ * The NVIC priority at and below which interrupts are blocked by
+ * BSPACM_CORE_MASK_PRIORITY().
+ *
+ * There is no default: priority masking is opt-in.  Unless the
+ * application defines this, the priority-mask macros are the PRIMASK
+ * macros and every critical section blocks every interrupt, as in
+ * code that predates them.
+ *
+ * Interrupts with a numerically lower (more urgent) priority than
+ * this are not blocked by BSPACM driver critical sections, so are
+ * not delayed by them.  Such interrupts must not invoke BSPACM
+ * driver functions.  The value must be at least 1 and less than @c
+ * (1 << __NVIC_PRIO_BITS).
+ *
+ * @cppflag
+ * @dependency #BSPACM_CORE_SUPPORTS_BASEPRI */
+
+/** Defined to a true value if BSPACM_CORE_MASK_PRIORITY() uses @c
+ * BASEPRI, i.e. the core supports it and the application defined
+ * #BSPACM_CORE_PRIORITY_CEILING. */
+#if (BSPACM_CORE_SUPPORTS_BASEPRI - 0) && defined(BSPACM_CORE_PRIORITY_CEILING)
+#define BSPACM_CORE_USE_BASEPRI 1
+#else /* BSPACM_CORE_SUPPORTS_BASEPRI && BSPACM_CORE_PRIORITY_CEILING */
+#define BSPACM_CORE_USE_BASEPRI 0
+#endif /* BSPACM_CORE_SUPPORTS_BASEPRI && BSPACM_CORE_PRIORITY_CEILING */
+
+/** The NVIC priority assigned by BSPACM drivers to the interrupts
+ * they manage.  This must not be more urgent than
+ * #BSPACM_CORE_PRIORITY_CEILING.  It defaults to the ceiling when
+ * that is defined, and otherwise to zero, the reset priority.
+ *
+ * @cppflag
+ * @defaulted */
+#ifndef BSPACM_CORE_PRIORITY_DRIVER
+#if defined(BSPACM_CORE_PRIORITY_CEILING)
+#define BSPACM_CORE_PRIORITY_DRIVER BSPACM_CORE_PRIORITY_CEILING
+#else /* BSPACM_CORE_PRIORITY_CEILING */
+#define BSPACM_CORE_PRIORITY_DRIVER 0
+#endif /* BSPACM_CORE_PRIORITY_CEILING */
+#endif /* BSPACM_CORE_PRIORITY_DRIVER */
+
+#if (BSPACM_CORE_USE_BASEPRI - 0)
+/* CMSIS intrinsics for BASEPRI lack a memory clobber in some
+ * versions, and not all versions provide BASEPRI_MAX.  These are
+ * compiler barriers. */
+static BSPACM_CORE_INLINE_FORCED
+uint32_t
+uiBSPACMcoreGetBASEPRI_ (void)
+{
+  uint32_t rv;
+  __asm__ __volatile__("mrs %0, basepri" : "=r" (rv) : : "memory");
+  return rv;
+}
+
+static BSPACM_CORE_INLINE_FORCED
+void
+vBSPACMcoreSetBASEPRI_ (uint32_t v)
+{
+  __asm__ __volatile__("msr basepri, %0" : : "r" (v) : "memory");
+}
+
+static BSPACM_CORE_INLINE_FORCED
+void
+vBSPACMcoreSetBASEPRImax_ (uint32_t v)
+{
+  __asm__ __volatile__("msr basepri_max, %0" : : "r" (v) : "memory");
+}
+#endif /* BSPACM_CORE_USE_BASEPRI */
+
+/** @def BSPACM_CORE_SAVED_PRIORITY_MASK
+ *
+ * Declare and initialize a const variable that records the current
+ * priority mask, for later use by
+ * BSPACM_CORE_RESTORE_PRIORITY_MASK().
+ *
+ * This is the priority-masked analog of
+ * BSPACM_CORE_SAVED_INTERRUPT_STATE(), and is used the same way:
+ *
+ * @code
+ * BSPACM_CORE_SAVED_PRIORITY_MASK(pmask);
+ * BSPACM_CORE_MASK_PRIORITY();
+ * // access state shared with driver interrupt handlers
+ * BSPACM_CORE_RESTORE_PRIORITY_MASK(pmask);
+ * @endcode
+ *
+ * When #BSPACM_CORE_USE_BASEPRI is false the priority-mask macros
+ * are the PRIMASK macros.
+ *
+ * @param var_ an identifier for a variable that will be defined to
+ * hold the priority mask at the point of definition.
+ *
+ * @def BSPACM_CORE_MASK_PRIORITY
+ *
+ * Block interrupts with priorities at or below
+ * #BSPACM_CORE_PRIORITY_CEILING.  The mask is only ever raised, so
+ * this is safe to nest within an existing priority-masked or
+ * PRIMASK critical section.
+ *
+ * @warning Do not sleep with the priority mask raised: a masked
+ * interrupt will not wake the core.  Sections that sleep waiting
+ * for an interrupt must use BSPACM_CORE_DISABLE_INTERRUPT().
+ *
+ * @def BSPACM_CORE_RESTORE_PRIORITY_MASK
+ *
+ * Restore the priority mask to what it was when @p var_ was
+ * declared by BSPACM_CORE_SAVED_PRIORITY_MASK(). */
+#if (BSPACM_CORE_USE_BASEPRI - 0)
+#define BSPACM_CORE_SAVED_PRIORITY_MASK(var_) uint32_t const var_ = uiBSPACMcoreGetBASEPRI_()
+#define BSPACM_CORE_MASK_PRIORITY() \
+  vBSPACMcoreSetBASEPRImax_((BSPACM_CORE_PRIORITY_CEILING) << (8 - __NVIC_PRIO_BITS))
+#define BSPACM_CORE_RESTORE_PRIORITY_MASK(var_) vBSPACMcoreSetBASEPRI_(var_)
+#else /* BSPACM_CORE_USE_BASEPRI */
+#define BSPACM_CORE_SAVED_PRIORITY_MASK(var_) BSPACM_CORE_SAVED_INTERRUPT_STATE(var_)
+#define BSPACM_CORE_MASK_PRIORITY() BSPACM_CORE_DISABLE_INTERRUPT()
+#define BSPACM_CORE_RESTORE_PRIORITY_MASK(var_) BSPACM_CORE_REENABLE_INTERRUPT(var_)
+#endif /* BSPACM_CORE_USE_BASEPRI */
+
 #if defined(BSPACM_DOXYGEN) || (! defined(BSPACM_CORE_SLEEP))
 /** Enter the Cortex-M sleep mode.
  *
@@ -285,12 +468,28 @@
 #define BSPACM_CORE_CYCCNT() 0
 #endif /* BSPACM_CORE_SUPPORTS_CYCCNT */
 
+/** Defined to true value if the core implements the SysTick timer.
+ * This is an optional component of Cortex-M0 and Cortex-M0+ cores,
+ * and is absent from nRF51 devices.
+ *
+ * @cppflag
+ * @defaulted */
+#ifndef BSPACM_CORE_SUPPORTS_SYSTICK
+#if (BSPACM_DEVICE_SERIES_NRF51 - 0)
+#define BSPACM_CORE_SUPPORTS_SYSTICK 0
+#else /* BSPACM_DEVICE_SERIES_NRF51 */
+#define BSPACM_CORE_SUPPORTS_SYSTICK 1
+#endif /* BSPACM_DEVICE_SERIES_NRF51 */
+#endif /* BSPACM_CORE_SUPPORTS_SYSTICK */
+
 /** Delay for a specified number of cycles.
  *
  * This does not attempt to account for the overhead of the loop.
  *
- * @warning On architectures that do not support a cycle counter, this
- * is a rough estimate based on cycles-per-iteration of a loop. */
+ * On architectures that do not support a cycle counter this invokes
+ * vBSPACMcoreDelayCycles().
+ *
+ * @see BSPACM_CORE_DELAY_US() */
 #if (BSPACM_CORE_SUPPORTS_CYCCNT - 0)
 #define BSPACM_CORE_DELAY_CYCLES(cycles_) do {  \
     uint32_t const delta = (cycles_);           \
@@ -300,13 +499,68 @@
     }                                           \
   } while (0)
 #else /* BSPACM_CORE_SUPPORTS_CYCCNT */
-#define BSPACM_CORE_DELAY_CYCLES(cycles_) do {  \
-    uint32_t const cycles_per_iter = 3;         \
-    uint32_t remaining = (cycles_);             \
-    while (remaining > cycles_per_iter) {       \
-      remaining -= cycles_per_iter;             \
-    }                                           \
-  } while (0)
+#define BSPACM_CORE_DELAY_CYCLES(cycles_) vBSPACMcoreDelayCycles(cycles_)
+
+/** Delay for a specified number of core clock cycles on a core
+ * without a cycle counter.
+ *
+ * When SysTick is running from the core clock its counter is
+ * polled, and if the SysTick interrupt is enabled the core sleeps
+ * between ticks for as long as the remaining delay exceeds one
+ * SysTick period.  On nRF51 devices the core sleeps in
+ * vBSPACMhiresSleep_us() for long delays if the high-resolution
+ * timer is enabled.  Otherwise a delay loop is used, with a
+ * per-iteration cost that is measured at startup by
+ * uiBSPACMcoreDelayCalibrate().
+ *
+ * Delays of fewer than a few dozen cycles are extended by the call
+ * overhead.
+ *
+ * @param cycles the number of core clock cycles to delay
+ *
+ * @dependency !#BSPACM_CORE_SUPPORTS_CYCCNT */
+void vBSPACMcoreDelayCycles (uint32_t cycles);
+
+/** Measure the cost of an iteration of the delay loop used by
+ * vBSPACMcoreDelayCycles().
+ *
+ * This is invoked automatically before main().  It borrows SysTick,
+ * or on nRF51 devices #BSPACM_HIRES_TIMER, and must only be
+ * re-invoked when neither is in use, e.g. after changing flash wait
+ * states.  It also records the core clock rate from @c
+ * SystemCoreClock, so it must be re-invoked after changing that.
+ *
+ * @return the measured cost of one loop iteration, in sixteenths of
+ * a core clock cycle
+ *
+ * @dependency !#BSPACM_CORE_SUPPORTS_CYCCNT */
+unsigned int uiBSPACMcoreDelayCalibrate (void);
+
+/** Delay for a specified number of microseconds on a core without a
+ * cycle counter.
+ *
+ * This is vBSPACMcoreDelayCycles() scaled by the cycles per
+ * microsecond recorded by uiBSPACMcoreDelayCalibrate(), so it
+ * performs no division.
+ *
+ * @param us the number of microseconds to delay
+ *
+ * @dependency !#BSPACM_CORE_SUPPORTS_CYCCNT */
+void vBSPACMcoreDelay_us (uint32_t us);
+#endif /* BSPACM_CORE_SUPPORTS_CYCCNT */
+
+/** Delay for a specified number of microseconds.
+ *
+ * This is BSPACM_CORE_DELAY_CYCLES() scaled by @c SystemCoreClock.
+ * On cores without a cycle counter it invokes vBSPACMcoreDelay_us().
+ *
+ * @warning The cycle count must fit in 32 bits; at 48 MHz this
+ * limits the delay to about 89 seconds. */
+#if (BSPACM_CORE_SUPPORTS_CYCCNT - 0)
+#define BSPACM_CORE_DELAY_US(us_) \
+  BSPACM_CORE_DELAY_CYCLES((us_) * (SystemCoreClock / 1000000U))
+#else /* BSPACM_CORE_SUPPORTS_CYCCNT */
+#define BSPACM_CORE_DELAY_US(us_) vBSPACMcoreDelay_us(us_)
 #endif /* BSPACM_CORE_SUPPORTS_CYCCNT */
 
 /* Cortex-M3 devices support bit-band access to SRAM and peripherals,
@@ -374,6 +628,10 @@
 #define BSPACM_CORE_BITBAND_PERIPH(object_, bit_) (*(volatile uint32_t *)(BSPACM_CORE_PERIPH_BITBAND_BASE + 4 * ((bit_) + 8 * ((uintptr_t)&(object_) - BSPACM_CORE_PERIPH_BASE))))
 #endif /* PERIPH bitband supported */
 
+/* Bit location and counting utilities, which need the CMSIS
+ * intrinsics from the device headers. */
+#include <bspacm/utility/bits.h>
+
 /** Convert a bit mask to a bit number.
  *
  * Useful for bitband object references.  Some vendors (SiLabs)
@@ -381,84 +639,21 @@
  * values.
  *
  * @warning If the passed value does not have exactly one bit set,
- * this function will hang.
+ * the result identifies the lowest set bit, or is -1 cast to unsigned
+ * if no bit is set.
  *
  * @param mask a bit mask.  Exactly one bit must be set.  In normal
  * use the parameter is a compile-time constant so this function
  * reduces to a compile-time constant too.
  *
- * @return the offset of the single set bit in @p mask. */
-static BSPACM_CORE_INLINE
+ * @return the offset of the single set bit in @p mask.
+ *
+ * @see iBSPACMbitsFindFirstSet() */
+static BSPACM_CORE_INLINE_FORCED
 unsigned int
 uiBSPACMcoreBitFromMask (uint32_t mask)
 {
-  if (0x1U == mask) {
-    return 0;
-  } else  if (0x2U == mask) {
-    return 1;
-  } else  if (0x4U == mask) {
-    return 2;
-  } else  if (0x8U == mask) {
-    return 3;
-  } else  if (0x10U == mask) {
-    return 4;
-  } else  if (0x20U == mask) {
-    return 5;
-  } else  if (0x40U == mask) {
-    return 6;
-  } else  if (0x80U == mask) {
-    return 7;
-  } else  if (0x100U == mask) {
-    return 8;
-  } else  if (0x200U == mask) {
-    return 9;
-  } else  if (0x400U == mask) {
-    return 10;
-  } else  if (0x800U == mask) {
-    return 11;
-  } else  if (0x1000U == mask) {
-    return 12;
-  } else  if (0x2000U == mask) {
-    return 13;
-  } else  if (0x4000U == mask) {
-    return 14;
-  } else  if (0x8000U == mask) {
-    return 15;
-  } else  if (0x10000U == mask) {
-    return 16;
-  } else  if (0x20000U == mask) {
-    return 17;
-  } else  if (0x40000U == mask) {
-    return 18;
-  } else  if (0x80000U == mask) {
-    return 19;
-  } else  if (0x100000U == mask) {
-    return 20;
-  } else  if (0x200000U == mask) {
-    return 21;
-  } else  if (0x400000U == mask) {
-    return 22;
-  } else  if (0x800000U == mask) {
-    return 23;
-  } else  if (0x1000000U == mask) {
-    return 24;
-  } else  if (0x2000000U == mask) {
-    return 25;
-  } else  if (0x4000000U == mask) {
-    return 26;
-  } else  if (0x8000000U == mask) {
-    return 27;
-  } else  if (0x10000000U == mask) {
-    return 28;
-  } else  if (0x20000000U == mask) {
-    return 29;
-  } else  if (0x40000000U == mask) {
-    return 30;
-  } else  if (0x80000000U != mask) {
-    /* Not exactly one bit set.  This is an error in usage. */
-    while(1);
-  }
-  return 31;
+  return iBSPACMbitsFindFirstSet(mask);
 }
 
 /** Function to set the value of a nybble in a word array.
@@ -93,9 +93,74 @@ typedef hBSPACMnewlibFDOPSfile (* fBSPACMnewlibFDOPSdriver) (const char * pathna
  * that intend to combine console support with other drivers must
  * provide an alternative implementation to override this.
  * Applications that need file descriptor operations but do not use
- * the console capability must provide an implementation. */
+ * the console capability must provide an implementation.
+ *
+ * @note Drivers in this list are tried only after
+ * #xBSPACMnewlibFDOPSdevice fails to recognize the pathname.  A
+ * driver that supports exactly one fixed path should be registered
+ * there instead, where it is located without invoking every driver in
+ * turn. */
 extern const fBSPACMnewlibFDOPSdriver xBSPACMnewlibFDOPSdriver[];
 
+/** Association between a fixed device path and the driver that opens
+ * it.
+ *
+ * @see #xBSPACMnewlibFDOPSdevice */
+typedef struct sBSPACMnewlibFDOPSdevice {
+  /** The full path that identifies the device, e.g. @c
+   * "/dev/console".  A null pointer terminates the table. */
+  const char * name;
+
+  /** The function that creates a file handle for the device.  When
+   * invoked through #xBSPACMnewlibFDOPSdevice the pathname passed to
+   * the driver is known to equal #name, so the driver need not
+   * compare it again. */
+  fBSPACMnewlibFDOPSdriver driver;
+} sBSPACMnewlibFDOPSdevice;
+
+/** A table of devices identified by fixed paths.  The table ends with
+ * an entry that has a null @link sBSPACMnewlibFDOPSdevice::name
+ * name@endlink.
+ *
+ * On first use of any file descriptor operation a hash index of the
+ * device names is built in #BSPACM_NEWLIB_FDOPS_DEVICE_INDEX_SIZE
+ * bytes of RAM.  The @c open() call consults that index to locate the
+ * single driver that supports a given path, so the cost of opening a
+ * device does not depend on the number of devices.  Only if no device
+ * matches are the drivers in #xBSPACMnewlibFDOPSdriver invoked.
+ *
+ * @weakdef The console capability provides a weak definition for
+ * this that maps @c "/dev/console" to
+ * fBSPACMnewlibFDOPSdeviceCONSOLE().  Applications that provide
+ * additional devices must provide an alternative implementation that
+ * includes the console entry if the console is required. */
+extern const sBSPACMnewlibFDOPSdevice xBSPACMnewlibFDOPSdevice[];
+
+#ifndef BSPACM_NEWLIB_FDOPS_DEVICE_INDEX_SIZE
+/** The number of slots in the hash index over
+ * #xBSPACMnewlibFDOPSdevice.  This must be a power of two.  Devices
+ * beyond this number remain accessible, but are located by a linear
+ * search.
+ *
+ * @cppflag
+ * @defaulted */
+#define BSPACM_NEWLIB_FDOPS_DEVICE_INDEX_SIZE 16
+#endif /* BSPACM_NEWLIB_FDOPS_DEVICE_INDEX_SIZE */
+
+#ifndef BSPACM_NEWLIB_FDOPS_FILE_LIMIT
+/** The maximum number of file descriptors supported by the
+ * infrastructure.  Descriptor availability is tracked in a bitmap of
+ * this many bits, so the lowest available descriptor is found with a
+ * count-leading-zeros instruction rather than a scan of
+ * #xBSPACMnewlibFDOPSfile_.  Descriptors at or above this limit are
+ * never assigned by @c open() even if #nBSPACMnewlibFDOPSfile is
+ * larger.
+ *
+ * @cppflag
+ * @defaulted */
+#define BSPACM_NEWLIB_FDOPS_FILE_LIMIT 32
+#endif /* BSPACM_NEWLIB_FDOPS_FILE_LIMIT */
+
 /** Record for the implementations of file descriptor operations that
  * are supported for a particular class of device.
  *
@@ -176,6 +241,10 @@ typedef sBSPACMnewlibFDOPSfile * hBSPACMnewlibFDOPSfile;
  * index is used as the descriptor for the next successful open
  * operation.
  *
+ * @note The infrastructure caches which elements are inactive.
+ * Other than within vBSPACMnewlibFDOPSinitializeStdio_(), elements
+ * must be changed only through @c open() and @c close().
+ *
  * Generally applications should never need to examine this array.
  * However, they do need to ensure presence of a definition that has
  * sufficient room for the descriptors required by the application.
@@ -88,4 +88,55 @@ void * _bspacm_sbrk_error (void * brk,
                            ptrdiff_t current,
                            ptrdiff_t increment);
 
+/** The number of recent _sbrk() increments retained in
+ * #sBSPACMnewlibSbrkStatistics.
+ *
+ * Set this to zero to disable the trace.
+ *
+ * @cppflag
+ * @defaulted */
+#ifndef BSPACM_NEWLIB_SBRK_TRACE_LENGTH
+#define BSPACM_NEWLIB_SBRK_TRACE_LENGTH 8
+#endif /* BSPACM_NEWLIB_SBRK_TRACE_LENGTH */
+
+/** Record of activity by the BSPACM _sbrk() policies.
+ *
+ * This is maintained by all policies in @c src/newlib/sbrk.c, and is
+ * used by <bspacm/utility/highwater.h> to report heap usage. */
+typedef struct sBSPACMnewlibSbrkStatistics {
+  /** The current program break.  This is a null pointer until the
+   * first call to _sbrk(). */
+  char * brk;
+
+  /** The highest value that @p brk has held.  This differs from @p
+   * brk only if the break has been reduced by a negative
+   * increment. */
+  char * max_brk;
+
+  /** Number of invocations of _sbrk(), including failed ones */
+  unsigned int calls;
+
+  /** Number of invocations of _sbrk() that invoked
+   * _bspacm_sbrk_error() */
+  unsigned int failures;
+
+  /** The largest increment requested in any call, whether or not
+   * it succeeded */
+  ptrdiff_t max_increment;
+
+#if (0 < BSPACM_NEWLIB_SBRK_TRACE_LENGTH) || defined(BSPACM_DOXYGEN)
+  /** The increments requested by the most recent calls, whether or
+   * not they succeeded.  Entry <tt>calls %
+   * BSPACM_NEWLIB_SBRK_TRACE_LENGTH</tt> is the oldest (or unused).
+   *
+   * @dependency #BSPACM_NEWLIB_SBRK_TRACE_LENGTH */
+  ptrdiff_t trace[BSPACM_NEWLIB_SBRK_TRACE_LENGTH];
+#endif /* BSPACM_NEWLIB_SBRK_TRACE_LENGTH */
+} sBSPACMnewlibSbrkStatistics;
+
+/** The statistics maintained by the BSPACM _sbrk() policies.
+ *
+ * @warning This should be treated as read-only by the application. */
+extern sBSPACMnewlibSbrkStatistics xBSPACMnewlibSbrkStatistics_;
+
 #endif /* BSPACM_NEWLIB_SYSTEM_H */
@@ -0,0 +1,152 @@
+/* Copyright 2014, Peter A. Bigot
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of the software nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without
+ *   specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/** @file
+ *
+ * @brief Two-Level Segregated Fit replacement for newlib malloc
+ *
+ * The functions here implement malloc(), free(), realloc(), and
+ * calloc() (along with their reentrant @c _r variants) using the
+ * Two-Level Segregated Fit algorithm.  Every operation completes in
+ * bounded time independent of the number of allocated blocks, and
+ * free blocks are coalesced immediately so fragmentation is limited.
+ * Operations are performed with interrupts disabled, so the allocator
+ * may be used from interrupt handlers.
+ *
+ * The implementation is selected at link time in the same way as
+ * the @ref newlib_sys_sbrk "_sbrk() policies": set the @c make
+ * variable @c NEWLIB_MALLOC to @c tlsf and the standard allocation
+ * functions will be defined as aliases to the functions here.  Leave
+ * it unset to use the newlib allocator.
+ *
+ * On first use the allocator claims, through sbrk(), all space
+ * between the current program break and @c __HeapLimit.  Set @c
+ * STARTUP_HEAP_SIZE to the amount of memory to be managed, and
+ * initialize anything else that uses sbrk() (such as
+ * <bspacm/utility/pool.h>) before the first allocation.
+ *
+ * @homepage http://github.com/pabigot/bspacm
+ * @copyright Copyright 2014, Peter A. Bigot.  Licensed under <a href="http://www.opensource.org/licenses/BSD-3-Clause">BSD-3-Clause</a>
+ */
+
+#ifndef BSPACM_NEWLIB_TLSF_H
+#define BSPACM_NEWLIB_TLSF_H
+
+#include <bspacm/core.h>
+#include <stddef.h>
+
+/** Base 2 logarithm of the number of second-level lists per
+ * first-level size class.  Larger values reduce internal
+ * fragmentation at the cost of a larger control structure.
+ *
+ * @cppflag
+ * @defaulted */
+#ifndef BSPACM_NEWLIB_TLSF_SL_LOG2
+#define BSPACM_NEWLIB_TLSF_SL_LOG2 3
+#endif /* BSPACM_NEWLIB_TLSF_SL_LOG2 */
+
+/** Base 2 logarithm of the largest block that can be managed.  The
+ * default supports a heap of up to 256 KiB.
+ *
+ * @cppflag
+ * @defaulted */
+#ifndef BSPACM_NEWLIB_TLSF_FL_LOG2
+#define BSPACM_NEWLIB_TLSF_FL_LOG2 18
+#endif /* BSPACM_NEWLIB_TLSF_FL_LOG2 */
+
+/** Information about the state of the TLSF heap.  All sizes are in
+ * octets and exclude per-block overhead. */
+typedef struct sBSPACMnewlibTLSFstatistics {
+  /** Size of the region managed by the allocator, including
+   * overhead.  Zero if the allocator has not been used. */
+  size_t heap_size;
+
+  /** Total size of allocated blocks */
+  size_t used;
+
+  /** Maximum value held by @p used */
+  size_t max_used;
+
+  /** Total size of free blocks */
+  size_t free;
+
+  /** Size of the largest free block */
+  size_t largest_free;
+
+  /** Number of free blocks.  Along with @p largest_free this
+   * indicates fragmentation. */
+  unsigned int free_blocks;
+
+  /** Number of allocated blocks */
+  unsigned int used_blocks;
+
+  /** Number of requests that could not be satisfied */
+  unsigned int failures;
+} sBSPACMnewlibTLSFstatistics;
+
+/** Obtain information about the TLSF heap.
+ *
+ * The totals are maintained as the heap changes and are copied in
+ * constant time.  Finding @p largest_free scans the list for the
+ * largest occupied size class, disabling interrupts for only a few
+ * blocks at a time.  If allocations keep changing that list during
+ * the scan, @p largest_free may understate the true value.
+ *
+ * @param sp where the statistics should be stored */
+void vBSPACMnewlibTLSFstatistics (sBSPACMnewlibTLSFstatistics * sp);
+
+/** TLSF implementation of malloc() */
+void * _bspacm_tlsf_malloc (size_t size);
+
+/** TLSF implementation of free() */
+void _bspacm_tlsf_free (void * ptr);
+
+/** TLSF implementation of realloc() */
+void * _bspacm_tlsf_realloc (void * ptr, size_t size);
+
+/** TLSF implementation of calloc() */
+void * _bspacm_tlsf_calloc (size_t nmemb, size_t size);
+
+struct _reent;
+
+/** TLSF implementation of _malloc_r() */
+void * _bspacm_tlsf_malloc_r (struct _reent * reent, size_t size);
+
+/** TLSF implementation of _free_r() */
+void _bspacm_tlsf_free_r (struct _reent * reent, void * ptr);
+
+/** TLSF implementation of _realloc_r() */
+void * _bspacm_tlsf_realloc_r (struct _reent * reent, void * ptr, size_t size);
+
+/** TLSF implementation of _calloc_r() */
+void * _bspacm_tlsf_calloc_r (struct _reent * reent, size_t nmemb, size_t size);
+
+#endif /* BSPACM_NEWLIB_TLSF_H */
@@ -43,12 +43,127 @@
 #include <bspacm/core.h>
 #include <bspacm/newlib/fdops.h>
 #include <bspacm/periph/uart.h>
+#include <bspacm/newlib/ioctl.h>
+
+/** Query the occupancy of the software FIFOs underlying a UART
+ * descriptor.
+ *
+ * The values are captured with interrupts disabled, so the receive
+ * and transmit levels reflect the same instant.
+ *
+ * @param levels pointer to a #sBSPACMnewlibFDOPSuartFifoLevels
+ * structure that is filled in by the call.
+ *
+ * @return 0 on success, or -1 with @c errno set. */
+#define BSPACM_IOCTL_UART_FIFO_LEVELS 0x200
+
+/** Change the baud rate of an open UART descriptor.
+ *
+ * This blocks until all pending output has been transmitted at the
+ * current rate, then reconfigures the peripheral without discarding
+ * received data that has not yet been read.  See
+ * iBSPACMperiphUARTreconfigure().
+ *
+ * @param speed_baud an <tt>unsigned int</tt> holding the new baud
+ * rate.  Zero selects the peripheral-specific default.
+ *
+ * @return 0 on success, or -1 with @c errno set. */
+#define BSPACM_IOCTL_UART_SET_BAUD 0x201
+
+/** Enable or disable newline-to-CRLF conversion on output.
+ *
+ * See #BSPACM_PERIPH_UART_FLAG_ONLCR.
+ *
+ * @param enable an @c int that is nonzero to enable conversion and
+ * zero to disable it.  A negative value leaves the setting unchanged.
+ *
+ * @return 1 or 0 reflecting whether conversion was enabled prior to
+ * the call, or -1 with @c errno set. */
+#define BSPACM_IOCTL_UART_SET_ONLCR 0x202
+
+/** Set the timeout applied by read() when no data is available.
+ *
+ * By default read() on a UART descriptor returns -1 with @c errno set
+ * to @c EAGAIN if no data is available.  This request allows the read
+ * to wait for data instead.
+ *
+ * @note The console device is shared among all descriptors that
+ * reference it, so the timeout applies to all of them.
+ *
+ * @param timeout_ms an @c int.  Zero (the default) does not wait.  A
+ * positive value waits for up to that many milliseconds, measured by
+ * busy-waiting on the core clock.  A negative value sleeps until at
+ * least one octet has been received.
+ *
+ * @return the previous timeout, or -1 with @c errno set. */
+#define BSPACM_IOCTL_UART_SET_READ_TIMEOUT 0x203
+
+/** Read the UART statistics counters.
+ *
+ * The counters are copied with interrupts disabled so that the
+ * snapshot is consistent.
+ *
+ * @param stats pointer to a #sBSPACMnewlibFDOPSuartStatistics
+ * structure that is filled in by the call.
+ *
+ * @return 0 on success, or -1 with @c errno set. */
+#define BSPACM_IOCTL_UART_STATISTICS 0x204
+
+/** Result structure for #BSPACM_IOCTL_UART_FIFO_LEVELS.
+ *
+ * Capacities are zero when the corresponding FIFO is absent. */
+typedef struct sBSPACMnewlibFDOPSuartFifoLevels {
+  /** Number of received octets not yet read */
+  uint16_t rx_length;
+
+  /** Maximum number of octets the receive FIFO can hold */
+  uint16_t rx_capacity;
+
+  /** Number of octets queued for transmission */
+  uint16_t tx_length;
+
+  /** Maximum number of octets the transmit FIFO can hold */
+  uint16_t tx_capacity;
+
+  /** The result of iBSPACMperiphUARTfifoState() at the time the
+   * levels were captured, including hardware state bits. */
+  int fifo_state;
+} sBSPACMnewlibFDOPSuartFifoLevels;
+
+/** Result structure for #BSPACM_IOCTL_UART_STATISTICS.
+ *
+ * The fields correspond to the like-named fields of
+ * #sBSPACMperiphUARTstate. */
+typedef struct sBSPACMnewlibFDOPSuartStatistics {
+  /** Total number of octets received */
+  unsigned int rx_count;
+
+  /** Total number of octets transmitted */
+  unsigned int tx_count;
+
+  /** Number of received octets dropped due to full receive FIFO */
+  uint16_t rx_dropped_errors;
+
+  /** Number of framing errors */
+  uint8_t rx_frame_errors;
+
+  /** Number of parity errors */
+  uint8_t rx_parity_errors;
+
+  /** Number of break errors */
+  uint8_t rx_break_errors;
+
+  /** Number of overrun errors */
+  uint8_t rx_overrun_errors;
+} sBSPACMnewlibFDOPSuartStatistics;
 
 /** Utility function to bind a UART peripheral to file descriptor state.
  *
  * This function allocates a file descriptor state object, assigns @p
  * usp into its @link sBSPACMnewlibFDOPSfile::dev dev@endlink field,
- * and assigning the standard UART operations table.
+ * and assigning the standard UART operations table.  The table
+ * supports #BSPACM_IOCTL_FLUSH and the @c BSPACM_IOCTL_UART_*
+ * requests defined in this header.
  *
  * @note If @p usp refers to the default console device, and that
  * device is already open, the call will fail with @c errno set to
@@ -65,15 +180,35 @@
  * something went wrong. */
 hBSPACMnewlibFDOPSfile hBSPACMnewlibFDOPSdriverUARTbind (hBSPACMperiphUART usp);
 
+/** A device function to support @c /dev/console as a UART.
+ *
+ * This is the implementation of fBSPACMnewlibFDOPSdriverCONSOLE()
+ * without the check of @p pathname.  It is intended to be placed in
+ * #xBSPACMnewlibFDOPSdevice under the name @c "/dev/console", and is
+ * the entry in the weak default definition of that table.
+ *
+ * @param pathname ignored
+ *
+ * @param flags ignored
+ *
+ * @return pointer to the singleton instance of the console descriptor
+ * state, or a null pointer (with @c errno set) if the console could
+ * not be opened. */
+sBSPACMnewlibFDOPSfile *
+fBSPACMnewlibFDOPSdeviceCONSOLE (const char * pathname,
+                                 int flags);
+
 /** A driver function to support @c /dev/console as a UART.
  *
  * The UART will be configured at a peripheral-specific speed.  This
  * should be 115200 8N1 for most UARTs, but if a low-speed peripheral
  * is selected it may be 9600 8N1.
  *
- * This should be placed into #xBSPACMnewlibFDOPSdriver if the BSPACM
+ * This may be placed into #xBSPACMnewlibFDOPSdriver if the BSPACM
  * board default UART is to be recognized as the console device for
- * stdin/stdout/stderr.
+ * stdin/stdout/stderr.  Registering fBSPACMnewlibFDOPSdeviceCONSOLE()
+ * in #xBSPACMnewlibFDOPSdevice is preferred, as it avoids the string
+ * comparison.
  *
  * Because there is only one console device, but it may need to be
  * referenced by multiple descriptors, the returned structure is
@@ -140,6 +140,12 @@ typedef struct sBSPACMperiphUARTstate {
    * implementation layers can't use it.  See
    * #peripheral_state_ni.  */
   uint8_t tx_state_;
+
+  /** An optional task, posted from the interrupt handler when
+   * received data has been stored in #rx_fifo_ni_.  This lets an
+   * application process input at task level rather than polling for
+   * it.  See iBSPACMtaskPost(). */
+  struct sBSPACMtask * rx_task;
 } sBSPACMperiphUARTstate;
 
 /** Typedef for API that references UARTs as handles where the fact
@@ -366,18 +372,18 @@ int iBSPACMperiphUARTwrite (hBSPACMperiphUART usp, const void * buf,  size_t cou
 static BSPACM_CORE_INLINE
 int iBSPACMperiphUARTfifoState (hBSPACMperiphUART usp)
 {
-  BSPACM_CORE_SAVED_INTERRUPT_STATE(istate);
+  BSPACM_CORE_SAVED_PRIORITY_MASK(pmask);
   int rv = -1;
 
   if (usp) {
-    BSPACM_CORE_DISABLE_INTERRUPT();
+    BSPACM_CORE_MASK_PRIORITY();
     do {
       rv = usp->ops->fifo_state(usp);
       if (usp->tx_state_) {
         rv |= eBSPACMperiphUARTfifoState_DRTX;
       }
     } while (0);
-    BSPACM_CORE_REENABLE_INTERRUPT(istate);
+    BSPACM_CORE_RESTORE_PRIORITY_MASK(pmask);
   }
   return rv;
 }
@@ -410,6 +416,28 @@ int iBSPACMperiphUARTfifoState (hBSPACMperiphUART usp)
 int iBSPACMperiphUARTflush (hBSPACMperiphUART usp,
                             int fifo_mask);
 
+/** Change the configuration of an active UART without discarding
+ * buffered data.
+ *
+ * hBSPACMperiphUARTconfigure() resets the software FIFOs, so using it
+ * to change (e.g.) the baud rate of an open UART loses pending input
+ * and output.  This function instead blocks until all pending output
+ * has been transmitted at the old configuration, then applies @p cfgp
+ * while retaining any received data that has not yet been read.
+ *
+ * @note Received data that is still in the hardware receive buffer
+ * when the new configuration is applied may be lost, depending on the
+ * peripheral.
+ *
+ * @param usp the UART peripheral state.  The peripheral must be
+ * configured and active.
+ *
+ * @param cfgp the new configuration.  This must not be null.
+ *
+ * @return zero on success, otherwise a negative error code. */
+int iBSPACMperiphUARTreconfigure (hBSPACMperiphUART usp,
+                                  const sBSPACMperiphUARTconfiguration * cfgp);
+
 /** The default UART device for the application/board.
  *
  * @weakdef A weak definition with a null pointer value is provided in
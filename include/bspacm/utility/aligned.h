@@ -0,0 +1,78 @@
+/* Copyright 2014, Peter A. Bigot
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of the software nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without
+ *   specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/** @file
+ *
+ * @brief Allocation of strictly aligned buffers
+ *
+ * Peripherals such as micro-DMA controllers and Ethernet MACs
+ * require buffers and descriptor tables aligned to boundaries larger
+ * than malloc() guarantees.  Buffers with static lifetime should be
+ * placed with #BSPACM_CORE_SECTION_DMA and
+ * #BSPACM_CORE_ALIGNED_OBJECT.  The functions here provide the same
+ * alignment for buffers whose size or lifetime is determined at
+ * runtime.
+ *
+ * Memory is obtained through malloc(), so it is affected by the
+ * selected heap allocator and _sbrk() policy.  The Cortex-M cores
+ * supported by BSPACM have no data cache, so alignment is the only
+ * requirement for a buffer in SRAM to be usable by DMA.
+ *
+ * @homepage http://github.com/pabigot/bspacm
+ * @copyright Copyright 2014, Peter A. Bigot.  Licensed under <a href="http://www.opensource.org/licenses/BSD-3-Clause">BSD-3-Clause</a>
+ */
+
+#ifndef BSPACM_UTILITY_ALIGNED_H
+#define BSPACM_UTILITY_ALIGNED_H
+
+#include <bspacm/core.h>
+#include <stddef.h>
+
+/** Allocate a buffer with a specific alignment.
+ *
+ * @param alignment the required alignment in octets.  This must be a
+ * power of two.
+ *
+ * @param size the size of the buffer in octets
+ *
+ * @return a pointer to a buffer of at least @p size octets whose
+ * address is a multiple of @p alignment, or a null pointer with @c
+ * errno set if the allocation failed.  The buffer must be released
+ * with vBSPACMalignedRelease(), not free(). */
+void * pvBSPACMalignedAllocate (size_t alignment,
+                                size_t size);
+
+/** Release a buffer obtained from pvBSPACMalignedAllocate().
+ *
+ * @param ptr the buffer to release, or a null pointer */
+void vBSPACMalignedRelease (void * ptr);
+
+#endif /* BSPACM_UTILITY_ALIGNED_H */
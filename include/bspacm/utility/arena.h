@@ -0,0 +1,210 @@
+/* Copyright 2014, Peter A. Bigot
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of the software nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without
+ *   specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/** @file
+ *
+ * @brief Scratch arenas for short-lived buffers
+ *
+ * An arena is a region of memory from which buffers are allocated by
+ * advancing a pointer.  Individual buffers are never freed; instead
+ * the application records a mark before a sequence of allocations
+ * (e.g. those needed for one sensor transaction or protocol message)
+ * and releases back to the mark when they are no longer needed.
+ * Marks nest, so a helper can take its own mark within an outer
+ * transaction.
+ *
+ * This keeps large temporary buffers off the stack, so @c
+ * STARTUP_STACK_SIZE need not be sized for the worst-case transaction,
+ * while avoiding the cost and fragmentation of malloc().
+ *
+ * The region may be static (see #BSPACM_ARENA_DEFINE), supplied by
+ * the caller (see vBSPACMarenaInitialize()), or a block from
+ * <bspacm/utility/pool.h> (see iBSPACMarenaInitializeFromPool()).
+ *
+ * @note Arena operations are not protected against concurrent use.
+ * An arena should be used from only one context, e.g. either the main
+ * loop or a single interrupt handler.
+ *
+ * @homepage http://github.com/pabigot/bspacm
+ * @copyright Copyright 2014, Peter A. Bigot.  Licensed under <a href="http://www.opensource.org/licenses/BSD-3-Clause">BSD-3-Clause</a>
+ */
+
+#ifndef BSPACM_UTILITY_ARENA_H
+#define BSPACM_UTILITY_ARENA_H
+
+#include <bspacm/core.h>
+#include <stddef.h>
+
+/** The alignment of every buffer returned from an arena, in octets.
+ *
+ * @cppflag
+ * @defaulted */
+#ifndef BSPACM_ARENA_ALIGNMENT
+#define BSPACM_ARENA_ALIGNMENT 8
+#endif /* BSPACM_ARENA_ALIGNMENT */
+
+/** State for an arena. */
+typedef struct sBSPACMarena {
+  /** The start of the region */
+  uint8_t * base;
+
+  /** The address following the region */
+  uint8_t * limit;
+
+  /** The address at which the next buffer will be allocated */
+  uint8_t * next;
+
+  /** The largest value that @p next has held, for use in sizing the
+   * region */
+  uint8_t * high_water;
+} sBSPACMarena;
+
+/** Define an arena backed by a static region of @p size_ octets.
+ *
+ * @param arena_ the name of the #sBSPACMarena instance.  The region
+ * is a separate object with @c _region appended to this name.
+ *
+ * @param size_ the size of the region in octets.  This is rounded up
+ * to a multiple of #BSPACM_ARENA_ALIGNMENT. */
+#define BSPACM_ARENA_DEFINE(arena_, size_)                              \
+  static BSPACM_CORE_ALIGNED_OBJECT(BSPACM_ARENA_ALIGNMENT)             \
+  uint8_t arena_##_region[((size_) + BSPACM_ARENA_ALIGNMENT - 1)        \
+                          & ~(BSPACM_ARENA_ALIGNMENT - 1)];             \
+  static sBSPACMarena arena_ = {                                        \
+    arena_##_region, arena_##_region + sizeof(arena_##_region),         \
+    arena_##_region, arena_##_region                                    \
+  }
+
+/** Initialize an arena to use a caller-supplied region.
+ *
+ * @param ap the arena to initialize
+ *
+ * @param region the start of the region.  If this is not aligned to
+ * #BSPACM_ARENA_ALIGNMENT the start is adjusted.
+ *
+ * @param size the size of the region in octets */
+void vBSPACMarenaInitialize (sBSPACMarena * ap,
+                             void * region,
+                             size_t size);
+
+/** Initialize an arena using a block obtained from
+ * pvBSPACMpoolAllocate().
+ *
+ * @param ap the arena to initialize
+ *
+ * @param size the minimum size of the region in octets
+ *
+ * @return zero on success, or -1 if no pool block was available */
+int iBSPACMarenaInitializeFromPool (sBSPACMarena * ap,
+                                    size_t size);
+
+/** Return the region of an arena initialized by
+ * iBSPACMarenaInitializeFromPool() to its pool.
+ *
+ * @param ap the arena.  On return its region is empty.
+ *
+ * @return the result of iBSPACMpoolRelease() */
+int iBSPACMarenaReleaseToPool (sBSPACMarena * ap);
+
+/** Allocate a buffer from an arena.
+ *
+ * @param ap the arena
+ *
+ * @param size the size of the buffer in octets
+ *
+ * @return a pointer to a buffer aligned to #BSPACM_ARENA_ALIGNMENT,
+ * or a null pointer if the arena has insufficient space. */
+static BSPACM_CORE_INLINE
+void *
+pvBSPACMarenaAllocate (sBSPACMarena * ap,
+                       size_t size)
+{
+  uint8_t * rv = ap->next;
+
+  size = (size + BSPACM_ARENA_ALIGNMENT - 1) & ~(size_t)(BSPACM_ARENA_ALIGNMENT - 1);
+  if (size > (size_t)(ap->limit - rv)) {
+    return 0;
+  }
+  ap->next = rv + size;
+  if (ap->next > ap->high_water) {
+    ap->high_water = ap->next;
+  }
+  return rv;
+}
+
+/** Record the current allocation point of an arena.
+ *
+ * @param ap the arena
+ *
+ * @return a mark to be passed to vBSPACMarenaRelease() */
+static BSPACM_CORE_INLINE
+void *
+pvBSPACMarenaMark (const sBSPACMarena * ap)
+{
+  return ap->next;
+}
+
+/** Release all buffers allocated since a mark was taken.
+ *
+ * Marks must be released in the reverse of the order in which they
+ * were taken; releasing an outer mark implicitly releases all inner
+ * ones.
+ *
+ * @param ap the arena
+ *
+ * @param mark a value returned by pvBSPACMarenaMark() for @p ap */
+static BSPACM_CORE_INLINE
+void
+vBSPACMarenaRelease (sBSPACMarena * ap,
+                     void * mark)
+{
+  ap->next = (uint8_t *)mark;
+}
+
+/** Release all buffers allocated from an arena.
+ *
+ * @param ap the arena */
+static BSPACM_CORE_INLINE
+void
+vBSPACMarenaReset (sBSPACMarena * ap)
+{
+  ap->next = ap->base;
+}
+
+/** Return the number of octets that remain available in an arena. */
+static BSPACM_CORE_INLINE
+size_t
+uiBSPACMarenaAvailable (const sBSPACMarena * ap)
+{
+  return ap->limit - ap->next;
+}
+
+#endif /* BSPACM_UTILITY_ARENA_H */
@@ -0,0 +1,178 @@
+/* Copyright 2014, Peter A. Bigot
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of the software nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without
+ *   specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/** @file
+ *
+ * @brief Constant-time bit manipulation utilities
+ *
+ * These functions locate and count set bits in 32-bit words without
+ * loops or data-dependent branches.  On Cortex-M3 and Cortex-M4 they
+ * use the @c CLZ and @c RBIT instructions; on Cortex-M0 and
+ * Cortex-M0+, which lack those instructions, they use de Bruijn
+ * sequence multiplication and table lookup.  When the argument is a
+ * compile-time constant the result is computed by the compiler.
+ *
+ * This header is included by <bspacm/core.h>.
+ *
+ * @homepage http://github.com/pabigot/bspacm
+ * @copyright Copyright 2014, Peter A. Bigot.  Licensed under <a href="http://www.opensource.org/licenses/BSD-3-Clause">BSD-3-Clause</a>
+ */
+
+/* This header and <bspacm/core.h> include each other.  Make sure
+ * core.h has completed its own definitions before defining the
+ * material here. */
+#include <bspacm/core.h>
+
+#ifndef BSPACM_UTILITY_BITS_H
+#define BSPACM_UTILITY_BITS_H
+
+/** Defined to a true value if the core implements the @c CLZ and @c
+ * RBIT instructions (ARMv7-M).
+ *
+ * @cppflag
+ * @defaulted */
+#ifndef BSPACM_BITS_HAVE_CLZ
+#if (3 <= (__CORTEX_M - 0))
+#define BSPACM_BITS_HAVE_CLZ 1
+#else /* __CORTEX_M */
+#define BSPACM_BITS_HAVE_CLZ 0
+#endif /* __CORTEX_M */
+#endif /* BSPACM_BITS_HAVE_CLZ */
+
+#if ! (BSPACM_BITS_HAVE_CLZ - 0)
+/** Bit positions indexed by the top five bits of the product of an
+ * isolated bit and the de Bruijn constant 0x077CB531.
+ *
+ * @dependency !#BSPACM_BITS_HAVE_CLZ */
+static const uint8_t xBSPACMbitsDeBruijnPosition_[32] = {
+  0, 1, 28, 2, 29, 14, 24, 3, 30, 22, 20, 15, 25, 17, 4, 8,
+  31, 27, 13, 23, 21, 19, 16, 7, 26, 12, 18, 6, 11, 5, 10, 9
+};
+
+/** Bit positions indexed by the top five bits of the product of a
+ * word with all bits below its highest set bit also set and the de
+ * Bruijn constant 0x07C4ACDD.
+ *
+ * @dependency !#BSPACM_BITS_HAVE_CLZ */
+static const uint8_t xBSPACMbitsDeBruijnLog2_[32] = {
+  0, 9, 1, 10, 13, 21, 2, 29, 11, 14, 16, 18, 22, 25, 3, 30,
+  8, 12, 20, 28, 15, 17, 24, 7, 19, 27, 23, 6, 26, 5, 4, 31
+};
+#endif /* BSPACM_BITS_HAVE_CLZ */
+
+/** Return the index of the least significant set bit in a word.
+ *
+ * @param v the word to be inspected
+ *
+ * @return the index (0 through 31) of the lowest bit that is set in
+ * @p v, or -1 if @p v is zero. */
+static BSPACM_CORE_INLINE_FORCED
+int
+iBSPACMbitsFindFirstSet (uint32_t v)
+{
+  if (__builtin_constant_p(v)) {
+    return __builtin_ffs(v) - 1;
+  }
+#if (BSPACM_BITS_HAVE_CLZ - 0)
+  {
+    int rv = __CLZ(__RBIT(v));
+    return (32 == rv) ? -1 : rv;
+  }
+#else /* BSPACM_BITS_HAVE_CLZ */
+  if (0 == v) {
+    return -1;
+  }
+  return xBSPACMbitsDeBruijnPosition_[((v & -v) * 0x077CB531U) >> 27];
+#endif /* BSPACM_BITS_HAVE_CLZ */
+}
+
+/** Return the index of the most significant set bit in a word.
+ *
+ * This is the integer base-2 logarithm of @p v.
+ *
+ * @param v the word to be inspected
+ *
+ * @return the index (0 through 31) of the highest bit that is set in
+ * @p v, or -1 if @p v is zero. */
+static BSPACM_CORE_INLINE_FORCED
+int
+iBSPACMbitsFindLastSet (uint32_t v)
+{
+  if (__builtin_constant_p(v)) {
+    return v ? (31 - __builtin_clz(v)) : -1;
+  }
+#if (BSPACM_BITS_HAVE_CLZ - 0)
+  return 31 - (int)__CLZ(v);
+#else /* BSPACM_BITS_HAVE_CLZ */
+  if (0 == v) {
+    return -1;
+  }
+  v |= v >> 1;
+  v |= v >> 2;
+  v |= v >> 4;
+  v |= v >> 8;
+  v |= v >> 16;
+  return xBSPACMbitsDeBruijnLog2_[(v * 0x07C4ACDDU) >> 27];
+#endif /* BSPACM_BITS_HAVE_CLZ */
+}
+
+/** Return the number of leading zero bits in a word.
+ *
+ * @param v the word to be inspected
+ *
+ * @return the number of zero bits above the highest set bit in @p v;
+ * 32 if @p v is zero. */
+static BSPACM_CORE_INLINE_FORCED
+unsigned int
+uiBSPACMbitsCountLeadingZeros (uint32_t v)
+{
+  return 31 - iBSPACMbitsFindLastSet(v);
+}
+
+/** Return the number of set bits in a word.
+ *
+ * @param v the word to be inspected
+ *
+ * @return the number of bits in @p v that are set */
+static BSPACM_CORE_INLINE_FORCED
+unsigned int
+uiBSPACMbitsPopulationCount (uint32_t v)
+{
+  if (__builtin_constant_p(v)) {
+    return __builtin_popcount(v);
+  }
+  v = v - ((v >> 1) & 0x55555555U);
+  v = (v & 0x33333333U) + ((v >> 2) & 0x33333333U);
+  v = (v + (v >> 4)) & 0x0F0F0F0FU;
+  return (v * 0x01010101U) >> 24;
+}
+
+#endif /* BSPACM_UTILITY_BITS_H */
@@ -0,0 +1,238 @@
+/* Copyright 2014, Peter A. Bigot
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of the software nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without
+ *   specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/** @file
+ *
+ * @brief Event flags for sleep-driven main loops
+ *
+ * An event group is a word of flags.  Interrupt handlers post flags
+ * with vBSPACMeventPost(); the application waits for any of a set of
+ * flags with uiBSPACMeventWait(), which sleeps until one is posted
+ * and consumes the flags it returns.  Posting and consuming are
+ * atomic: on Cortex-M3 and Cortex-M4 they use bit-band stores or
+ * exclusive access, and on Cortex-M0 they briefly disable interrupts.
+ *
+ * BSPACM infrastructure posts events to #xBSPACMeventSystem, using
+ * the bits defined here.  Bits at and above
+ * #BSPACM_EVENT_APPLICATION_BASE in that group are available to the
+ * application, which may also define additional groups.
+ *
+ * @code
+ * while (1) {
+ *   uint32_t ev = uiBSPACMeventWait(&xBSPACMeventSystem,
+ *                                   BSPACM_EVENT_UART_RX | BUTTON_EVENT);
+ *   if (BSPACM_EVENT_UART_RX & ev) {
+ *     // consume input
+ *   }
+ *   if (BUTTON_EVENT & ev) {
+ *     // handle button
+ *   }
+ * }
+ * @endcode
+ *
+ * @homepage http://github.com/pabigot/bspacm
+ * @copyright Copyright 2014, Peter A. Bigot.  Licensed under <a href="http://www.opensource.org/licenses/BSD-3-Clause">BSD-3-Clause</a>
+ */
+
+#ifndef BSPACM_UTILITY_EVENT_H
+#define BSPACM_UTILITY_EVENT_H
+
+#include <bspacm/core.h>
+
+/** Posted by UART interrupt handlers when received data is stored in
+ * a receive FIFO. */
+#define BSPACM_EVENT_UART_RX 0x01
+
+/** Posted by UART interrupt handlers when a transmit FIFO drains. */
+#define BSPACM_EVENT_UART_TX 0x02
+
+/** Posted by the uptime interrupt handler when an alarm fires. */
+#define BSPACM_EVENT_UPTIME_ALARM 0x04
+
+/** Posted by the nRF51 hires timer interrupt handler when an alarm
+ * fires. */
+#define BSPACM_EVENT_HIRES_ALARM 0x08
+
+/** Posted by the nRF51 TWI interrupt handler when an I2C transaction
+ * completes. */
+#define BSPACM_EVENT_I2C 0x10
+
+/** The lowest bit of #xBSPACMeventSystem that is reserved for the
+ * application. */
+#define BSPACM_EVENT_APPLICATION_BASE 0x100
+
+/** A set of event flags. */
+typedef struct sBSPACMeventGroup {
+  /** Flags that have been posted but not consumed. */
+  volatile uint32_t flags;
+} sBSPACMeventGroup;
+
+/** The event group to which BSPACM infrastructure posts. */
+extern sBSPACMeventGroup xBSPACMeventSystem;
+
+/** Atomically set flags in an event group.
+ *
+ * This may be invoked from any context.  A single-bit compile-time
+ * constant @p bits is posted with one bit-band store where the core
+ * supports it.
+ *
+ * @param gp the event group
+ *
+ * @param bits the flags to set */
+static BSPACM_CORE_INLINE_FORCED
+void
+vBSPACMeventPost (sBSPACMeventGroup * gp,
+                  uint32_t bits)
+{
+#if (3 <= (__CORTEX_M - 0))
+#if defined(BSPACM_CORE_BITBAND_SRAM32)
+  if (__builtin_constant_p(bits) && (1 == uiBSPACMbitsPopulationCount(bits))) {
+    BSPACM_CORE_BITBAND_SRAM32(gp->flags, iBSPACMbitsFindFirstSet(bits)) = 1;
+    return;
+  }
+#endif /* BSPACM_CORE_BITBAND_SRAM32 */
+  do {
+    uint32_t const v = __LDREXW((volatile uint32_t *)&gp->flags);
+    if (0 == __STREXW(v | bits, (volatile uint32_t *)&gp->flags)) {
+      break;
+    }
+  } while (1);
+#else /* __CORTEX_M */
+  BSPACM_CORE_SAVED_INTERRUPT_STATE(istate);
+  BSPACM_CORE_DISABLE_INTERRUPT();
+  gp->flags |= bits;
+  BSPACM_CORE_REENABLE_INTERRUPT(istate);
+#endif /* __CORTEX_M */
+}
+
+/** Atomically consume flags from an event group without waiting.
+ *
+ * @param gp the event group
+ *
+ * @param mask the flags of interest
+ *
+ * @return the flags in @p mask that were set; these are cleared in
+ * the group. */
+static BSPACM_CORE_INLINE
+uint32_t
+uiBSPACMeventTake (sBSPACMeventGroup * gp,
+                   uint32_t mask)
+{
+  uint32_t v;
+#if (3 <= (__CORTEX_M - 0))
+  do {
+    v = __LDREXW((volatile uint32_t *)&gp->flags);
+    if (0 == (v & mask)) {
+      __CLREX();
+      break;
+    }
+    if (0 == __STREXW(v & ~mask, (volatile uint32_t *)&gp->flags)) {
+      break;
+    }
+  } while (1);
+#else /* __CORTEX_M */
+  BSPACM_CORE_SAVED_INTERRUPT_STATE(istate);
+  BSPACM_CORE_DISABLE_INTERRUPT();
+  v = gp->flags;
+  gp->flags = v & ~mask;
+  BSPACM_CORE_REENABLE_INTERRUPT(istate);
+#endif /* __CORTEX_M */
+  return v & mask;
+}
+
+/** Wait until at least one flag in a mask is posted, then consume
+ * the posted flags in the mask.
+ *
+ * While no flag is posted the core sleeps, in deep sleep if
+ * bBSPACMeventDeepSleepPermitted() allows it.  Interrupts are
+ * enabled while waiting, and restored to their state on entry before
+ * returning.
+ *
+ * @warning Do not invoke this from an interrupt handler.
+ *
+ * @param gp the event group
+ *
+ * @param mask the flags of interest
+ *
+ * @return the non-zero subset of @p mask that was posted */
+uint32_t uiBSPACMeventWait (sBSPACMeventGroup * gp,
+                            uint32_t mask);
+
+/** Sleep once, in the mode selected by
+ * bBSPACMeventDeepSleepPermitted().
+ *
+ * This is the sleep step of uiBSPACMeventWait(), for loops that
+ * check their own wakeup conditions.  Invoke it with interrupts
+ * disabled after confirming no work is pending.  The core wakes when
+ * an interrupt becomes pending; its handler runs when the caller
+ * re-enables interrupts.
+ *
+ * On nRF51 devices with the uptime clock running this sleeps with
+ * uiBSPACMuptimeIdle(), so the time is included in the idle
+ * accounting.
+ *
+ * @param gp the group being waited on
+ *
+ * @param mask the flags being waited for */
+void vBSPACMeventIdle (const sBSPACMeventGroup * gp,
+                       uint32_t mask);
+
+/** Record that a driver needs clocks that deep sleep would stop.
+ *
+ * Calls nest: deep sleep is inhibited until each call with @p
+ * inhibit true is matched by one with @p inhibit false.
+ *
+ * @param inhibit true to add an inhibition, false to remove one */
+void vBSPACMeventDeepSleepInhibit (bool inhibit);
+
+/** Determine whether uiBSPACMeventWait() may enter deep sleep.
+ *
+ * This is invoked with interrupts disabled immediately before
+ * sleeping.  It is not consulted, and deep sleep is refused, while
+ * any inhibition from vBSPACMeventDeepSleepInhibit() is active, while
+ * the default UART has output pending, or while the wait includes
+ * #BSPACM_EVENT_UART_RX on #xBSPACMeventSystem.
+ *
+ * The default implementation returns @c false, so vBSPACMeventIdle()
+ * uses BSPACM_CORE_SLEEP() unless the application knows deep sleep
+ * is safe.  BSPACM drivers do not record their clock needs, and a
+ * peripheral whose clock stops will not produce the awaited event.
+ *
+ * @param gp the group being waited on
+ *
+ * @param mask the flags being waited for
+ *
+ * @weakdef Override to apply application knowledge of which clocks
+ * are needed to produce the awaited events. */
+bool bBSPACMeventDeepSleepPermitted (const sBSPACMeventGroup * gp,
+                                     uint32_t mask);
+
+#endif /* BSPACM_UTILITY_EVENT_H */
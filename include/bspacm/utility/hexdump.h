@@ -0,0 +1,179 @@
+/* Copyright 2014, Peter A. Bigot
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of the software nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without
+ *   specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/** @file
+ *
+ * @brief Formatting of memory dumps to arbitrary output sinks
+ *
+ * The formatter builds each line of output in a local buffer using
+ * table lookup for hexadecimal digits, then passes the complete line
+ * to a sink function.  Sinks are provided for stdio streams, file
+ * descriptors, UART peripherals, memory buffers, and FIFOs (for
+ * deferred transmission); applications may supply others.
+ *
+ * vBSPACMconsoleDisplayMemoryOctets() and related functions in
+ * <bspacm/utility/misc.h> use this module with a @c stdout sink.
+ *
+ * @homepage http://github.com/pabigot/bspacm
+ * @copyright Copyright 2014, Peter A. Bigot.  Licensed under <a href="http://www.opensource.org/licenses/BSD-3-Clause">BSD-3-Clause</a>
+ */
+
+#ifndef BSPACM_UTILITY_HEXDUMP_H
+#define BSPACM_UTILITY_HEXDUMP_H
+
+#include <bspacm/core.h>
+#include <stddef.h>
+
+/** Function that receives formatted output.
+ *
+ * @param context the sink-specific context provided to the
+ * formatting function
+ *
+ * @param text the text to be emitted.  This is not NUL-terminated.
+ *
+ * @param len the number of characters in @p text
+ *
+ * @return zero if all of @p text was accepted, or a negative value
+ * to abort formatting. */
+typedef int (* fBSPACMhexdumpSink) (void * context,
+                                    const char * text,
+                                    size_t len);
+
+/** Format a block of memory as octets and printable characters.
+ *
+ * The output format is that of vBSPACMconsoleDisplayMemoryOctets():
+ * one line per 16 octets, beginning with the 16-byte aligned address
+ * and followed by the octet values and their printable
+ * representation.
+ *
+ * @param sink the function that receives each line
+ * @param context the value passed as the first argument to @p sink
+ * @param dp pointer to start of memory region
+ * @param count number of octets to display
+ * @param base base displayed address for first octet
+ *
+ * @return zero on success, or the negative value returned by @p sink */
+int iBSPACMhexdumpOctets (fBSPACMhexdumpSink sink,
+                          void * context,
+                          const uint8_t * dp,
+                          size_t count,
+                          uintptr_t base);
+
+/** Format a block of memory as 32-bit hexadecimal words.
+ *
+ * The output format is that of vBSPACMconsoleDisplayMemoryWords().
+ *
+ * @param sink the function that receives each line
+ * @param context the value passed as the first argument to @p sink
+ * @param dp pointer to start of memory region
+ * @param count number of words to display
+ * @param base base displayed address for first word
+ *
+ * @return zero on success, or the negative value returned by @p sink */
+int iBSPACMhexdumpWords (fBSPACMhexdumpSink sink,
+                         void * context,
+                         const uint32_t * dp,
+                         size_t count,
+                         uintptr_t base);
+
+/** Format a sequence of octets as space-separated hexadecimal values
+ * with no address information or line breaks.
+ *
+ * The output format is that of vBSPACMconsoleDisplayOctets().
+ *
+ * @param sink the function that receives the output
+ * @param context the value passed as the first argument to @p sink
+ * @param dp pointer to start of memory region
+ * @param count number of octets to display
+ *
+ * @return zero on success, or the negative value returned by @p sink */
+int iBSPACMhexdumpSequence (fBSPACMhexdumpSink sink,
+                            void * context,
+                            const uint8_t * dp,
+                            size_t count);
+
+/** Sink that writes to a stdio stream.
+ *
+ * @param context a <tt>FILE *</tt>, or a null pointer for @c stdout */
+int iBSPACMhexdumpSinkFILE (void * context,
+                            const char * text,
+                            size_t len);
+
+/** Sink that writes to a file descriptor using write().
+ *
+ * @param context the descriptor, cast through @c intptr_t */
+int iBSPACMhexdumpSinkFD (void * context,
+                          const char * text,
+                          size_t len);
+
+/** Sink that writes to a UART peripheral, blocking until the text
+ * has been accepted.
+ *
+ * @param context the #hBSPACMperiphUART handle */
+int iBSPACMhexdumpSinkUART (void * context,
+                            const char * text,
+                            size_t len);
+
+/** Context for iBSPACMhexdumpSinkBuffer(). */
+typedef struct sBSPACMhexdumpBuffer {
+  /** Start of the buffer */
+  char * buffer;
+
+  /** Size of the buffer in octets */
+  size_t size;
+
+  /** Number of octets stored in the buffer */
+  size_t length;
+} sBSPACMhexdumpBuffer;
+
+/** Sink that appends to a memory buffer.
+ *
+ * Output that does not fit is discarded and formatting is aborted.
+ * The buffer is not NUL-terminated.
+ *
+ * @param context pointer to a #sBSPACMhexdumpBuffer */
+int iBSPACMhexdumpSinkBuffer (void * context,
+                              const char * text,
+                              size_t len);
+
+/** Sink that stores into a FIFO for later transmission.
+ *
+ * Each line is stored with interrupts disabled, so the FIFO may be
+ * drained by an interrupt handler.  If the FIFO overflows the oldest
+ * text is lost and formatting is aborted.
+ *
+ * @param context pointer to an @c sFIFO (see
+ * <bspacm/internal/utility/fifo.h>) */
+int iBSPACMhexdumpSinkFIFO (void * context,
+                            const char * text,
+                            size_t len);
+
+#endif /* BSPACM_UTILITY_HEXDUMP_H */
@@ -0,0 +1,117 @@
+/* Copyright 2014, Peter A. Bigot
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of the software nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without
+ *   specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/** @file
+ *
+ * @brief Measurement of peak stack and heap usage
+ *
+ * This module supports right-sizing of @c STARTUP_STACK_SIZE and @c
+ * STARTUP_HEAP_SIZE from measurements taken on a running system.
+ *
+ * Linking this module causes a constructor to fill the unused stack
+ * region, from @c __StackLimit up to the stack pointer, with
+ * #BSPACM_HIGHWATER_STACK_PAINT before main() is invoked.  The depth
+ * of the stack is later determined by scanning upwards from @c
+ * __StackLimit for the first word that no longer holds the paint
+ * value.  Heap usage is obtained from the statistics maintained by
+ * the BSPACM _sbrk() policies (see #xBSPACMnewlibSbrkStatistics_).
+ *
+ * @note The scan cannot detect stack use below @c __StackLimit.  A
+ * stack depth equal to the reserved size should be interpreted as a
+ * probable overflow.  When an _sbrk() policy that allows the heap to
+ * extend above @c __StackLimit is used, the scan starts at the
+ * program break instead.
+ *
+ * @homepage http://github.com/pabigot/bspacm
+ * @copyright Copyright 2014, Peter A. Bigot.  Licensed under <a href="http://www.opensource.org/licenses/BSD-3-Clause">BSD-3-Clause</a>
+ */
+
+#ifndef BSPACM_UTILITY_HIGHWATER_H
+#define BSPACM_UTILITY_HIGHWATER_H
+
+#include <bspacm/core.h>
+#include <bspacm/newlib/system.h>
+
+/** The value written into unused stack words at startup.
+ *
+ * @cppflag
+ * @defaulted */
+#ifndef BSPACM_HIGHWATER_STACK_PAINT
+#define BSPACM_HIGHWATER_STACK_PAINT 0xDEADBEEF
+#endif /* BSPACM_HIGHWATER_STACK_PAINT */
+
+/** A snapshot of memory usage.  All sizes are in octets. */
+typedef struct sBSPACMhighwater {
+  /** Space between @c __StackLimit and @c __StackTop */
+  size_t stack_reserved;
+
+  /** Maximum depth of the stack observed since startup */
+  size_t stack_max_used;
+
+  /** Space between @c end and @c __HeapLimit */
+  size_t heap_reserved;
+
+  /** Space currently allocated through _sbrk() */
+  size_t heap_used;
+
+  /** Maximum space ever allocated through _sbrk() */
+  size_t heap_max_used;
+
+  /** A copy of the _sbrk() statistics */
+  sBSPACMnewlibSbrkStatistics sbrk;
+} sBSPACMhighwater;
+
+/** Paint the unused portion of the stack.
+ *
+ * This is invoked automatically before main() when this module is
+ * linked.  It may be invoked again to restart stack measurement,
+ * e.g. after an initialization phase with atypical stack use.
+ *
+ * Only words below the current stack pointer are painted. */
+void vBSPACMhighwaterPaintStack (void);
+
+/** Capture a snapshot of current memory usage.
+ *
+ * The stack scan is performed with interrupts enabled, so the
+ * reported depth may include interrupt frames that occur during the
+ * scan.
+ *
+ * @param sp where the snapshot should be stored.  This must not be
+ * null. */
+void vBSPACMhighwaterSnapshot (sBSPACMhighwater * sp);
+
+/** Display a snapshot of memory usage on the console.
+ *
+ * @param sp a snapshot to display, or a null pointer to take and
+ * display a new one. */
+void vBSPACMhighwaterReport (const sBSPACMhighwater * sp);
+
+#endif /* BSPACM_UTILITY_HIGHWATER_H */
@@ -0,0 +1,180 @@
+/* Copyright 2014, Peter A. Bigot
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of the software nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without
+ *   specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/** @file
+ *
+ * @brief Interrupt entry latency measurement
+ *
+ * This module arms a hardware timer to raise an interrupt at a known
+ * count, and on entry to the handler reads how far the counter has
+ * advanced since the event.  The difference is the entry latency:
+ * the hardware exception entry time plus any delay caused by
+ * critical sections, higher-priority handlers, or flash wait states
+ * at the point the application was interrupted.  Successive events
+ * are separated by a base period plus a pseudo-random offset so
+ * that sampling does not lock to the phase of periodic application
+ * activity.
+ *
+ * The timer is SysTick, except on nRF51 devices which do not
+ * implement it.  There a TIMER peripheral running at the 16 MHz core
+ * clock is used.  In both cases latency is measured in core clock
+ * cycles.
+ *
+ * Run an application's normal workload while the measurement is
+ * active, then display the distribution with
+ * vBSPACMlatencyReport().  The maximum is the worst-case delay that
+ * application imposes on interrupts at the configured priority.
+ *
+ * @note Linking this module defines the interrupt handler for the
+ * selected timer, which is therefore not available to the
+ * application.
+ *
+ * @homepage http://github.com/pabigot/bspacm
+ * @copyright Copyright 2014, Peter A. Bigot.  Licensed under <a href="http://www.opensource.org/licenses/BSD-3-Clause">BSD-3-Clause</a>
+ */
+
+#ifndef BSPACM_UTILITY_LATENCY_H
+#define BSPACM_UTILITY_LATENCY_H
+
+#include <bspacm/core.h>
+
+/** The number of bins in the latency histogram.  The last bin
+ * counts every sample that exceeds the range of the others.
+ *
+ * @cppflag
+ * @defaulted */
+#ifndef BSPACM_LATENCY_HISTOGRAM_BINS
+#define BSPACM_LATENCY_HISTOGRAM_BINS 32
+#endif /* BSPACM_LATENCY_HISTOGRAM_BINS */
+
+/** The width of each latency histogram bin, in cycles.
+ *
+ * @cppflag
+ * @defaulted */
+#ifndef BSPACM_LATENCY_HISTOGRAM_WIDTH
+#define BSPACM_LATENCY_HISTOGRAM_WIDTH 4
+#endif /* BSPACM_LATENCY_HISTOGRAM_WIDTH */
+
+#if (BSPACM_DEVICE_SERIES_NRF51 - 0)
+#ifndef BSPACM_LATENCY_TIMER_BASE
+/** The integral address of the nRF51 TIMER peripheral used to
+ * measure latency.  This must differ from
+ * #BSPACM_HIRES_TIMER_BASE.
+ *
+ * @cppflag
+ * @defaulted */
+#define BSPACM_LATENCY_TIMER_BASE NRF_TIMER2_BASE
+#endif /* BSPACM_LATENCY_TIMER_BASE */
+
+/** The largest counter value supported by the timer. */
+#if (NRF_TIMER0_BASE == BSPACM_LATENCY_TIMER_BASE)
+#define BSPACM_LATENCY_COUNTER_MASK 0xFFFFFFFFU
+#else /* BSPACM_LATENCY_TIMER_BASE */
+#define BSPACM_LATENCY_COUNTER_MASK 0xFFFFU
+#endif /* BSPACM_LATENCY_TIMER_BASE */
+#else /* BSPACM_DEVICE_SERIES_NRF51 */
+#define BSPACM_LATENCY_COUNTER_MASK SysTick_LOAD_RELOAD_Msk
+#endif /* BSPACM_DEVICE_SERIES_NRF51 */
+
+/** Distribution of measured interrupt entry latencies, in core clock
+ * cycles. */
+typedef struct sBSPACMlatencyStatistics {
+  /** Number of samples */
+  uint32_t count;
+
+  /** Shortest latency observed.  Meaningless if @p count is zero. */
+  uint32_t min;
+
+  /** Longest latency observed */
+  uint32_t max;
+
+  /** Sum of all latencies */
+  uint64_t total;
+
+  /** Bin @em k counts latencies @em L with @em k *
+   * #BSPACM_LATENCY_HISTOGRAM_WIDTH <= @em L < (@em k + 1) *
+   * #BSPACM_LATENCY_HISTOGRAM_WIDTH, except the last bin which has
+   * no upper bound. */
+  uint32_t histogram[BSPACM_LATENCY_HISTOGRAM_BINS];
+} sBSPACMlatencyStatistics;
+
+/** Begin measuring interrupt entry latency.
+ *
+ * Any previously accumulated samples are discarded.
+ *
+ * @param period_cycles the minimum interval between timer events,
+ * in core clock cycles.  This must exceed the longest expected
+ * latency.
+ *
+ * @param jitter_mask a mask applied to a pseudo-random value that is
+ * added to @p period_cycles for each interval.  Use a value of the
+ * form 2<sup>n</sup>-1, or zero for a fixed period.
+ *
+ * @param priority the NVIC priority assigned to the measurement
+ * interrupt.  Use 0 to measure the effect of every critical section,
+ * or, when the application defines #BSPACM_CORE_PRIORITY_CEILING, a
+ * more urgent value to verify that priority-masked sections add no
+ * delay.
+ *
+ * @return 0 if measurement started, or -1 if the interval does not
+ * fit in the timer. */
+int iBSPACMlatencyStart (unsigned int period_cycles,
+                         unsigned int jitter_mask,
+                         unsigned int priority);
+
+/** Stop measuring interrupt entry latency.  Accumulated samples are
+ * retained. */
+void vBSPACMlatencyStop (void);
+
+/** Atomically copy the accumulated latency samples.
+ *
+ * @param sp where the samples should be stored.  This must not be
+ * null.
+ *
+ * @param reset if true the accumulated samples are discarded as part
+ * of the same atomic operation */
+void vBSPACMlatencySnapshot (sBSPACMlatencyStatistics * sp,
+                             bool reset);
+
+/** Return the number of latency samples accumulated so far.
+ *
+ * Unlike vBSPACMlatencySnapshot() this does not disable interrupts,
+ * so it can be polled while measuring without adding a critical
+ * section of its own. */
+uint32_t uiBSPACMlatencyCount (void);
+
+/** Display a latency distribution on the console.
+ *
+ * @param sp the distribution to display, or a null pointer to take
+ * and display a snapshot of the accumulated samples. */
+void vBSPACMlatencyReport (const sBSPACMlatencyStatistics * sp);
+
+#endif /* BSPACM_UTILITY_LATENCY_H */
@@ -0,0 +1,190 @@
+/* Copyright 2014, Peter A. Bigot
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of the software nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without
+ *   specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/** @file
+ *
+ * @brief Fixed-block memory pools suitable for use from interrupt handlers
+ *
+ * This module partitions a region of memory obtained from the heap
+ * (between @c end and @c __HeapLimit) into a small number of pools,
+ * each holding blocks of a single size.  Allocation and release are
+ * constant-time operations that hold interrupts disabled only long
+ * enough to unlink or link one block, so they may be invoked from
+ * interrupt handlers.  Blocks never fragment, making the pools
+ * suitable for long-running applications that repeatedly allocate and
+ * release buffers such as network packets.
+ *
+ * Pools are configured once, by the application, using
+ * iBSPACMpoolInitialize().  An allocation request is satisfied from
+ * the smallest class with a block size at least as large as the
+ * request; if that class is exhausted successively larger classes are
+ * tried.  When no block can be provided
+ * vBSPACMpoolAllocationFailure() is invoked and a null pointer is
+ * returned.
+ *
+ * @homepage http://github.com/pabigot/bspacm
+ * @copyright Copyright 2014, Peter A. Bigot.  Licensed under <a href="http://www.opensource.org/licenses/BSD-3-Clause">BSD-3-Clause</a>
+ */
+
+#ifndef BSPACM_UTILITY_POOL_H
+#define BSPACM_UTILITY_POOL_H
+
+#include <bspacm/core.h>
+
+/** The maximum number of block-size classes supported.
+ *
+ * This bounds the work performed by pvBSPACMpoolAllocate() and
+ * iBSPACMpoolRelease(), and the size of the static pool state.
+ *
+ * @cppflag
+ * @defaulted */
+#ifndef BSPACM_POOL_CLASS_LIMIT
+#define BSPACM_POOL_CLASS_LIMIT 4
+#endif /* BSPACM_POOL_CLASS_LIMIT */
+
+/** The alignment of every block returned by the pool, in octets.
+ * Block sizes are rounded up to a multiple of this value.
+ *
+ * @cppflag
+ * @defaulted */
+#ifndef BSPACM_POOL_ALIGNMENT
+#define BSPACM_POOL_ALIGNMENT 8
+#endif /* BSPACM_POOL_ALIGNMENT */
+
+/** Configuration of a single block-size class. */
+typedef struct sBSPACMpoolClassConfiguration {
+  /** The size of each block in the class, in octets.  This is
+   * rounded up to a multiple of #BSPACM_POOL_ALIGNMENT. */
+  uint16_t block_size;
+
+  /** The number of blocks in the class. */
+  uint16_t block_count;
+} sBSPACMpoolClassConfiguration;
+
+/** Occupancy information for a single block-size class. */
+typedef struct sBSPACMpoolClassStatistics {
+  /** The size of each block in the class, after alignment */
+  uint16_t block_size;
+
+  /** The number of blocks in the class */
+  uint16_t block_count;
+
+  /** The number of blocks currently allocated */
+  uint16_t in_use;
+
+  /** The largest value that @p in_use has held since the pool was
+   * initialized */
+  uint16_t max_in_use;
+
+  /** The number of allocation requests that targeted this class but
+   * were satisfied by a larger class because this class was
+   * exhausted. */
+  uint16_t overflows;
+
+  /** The number of allocation requests that targeted this class but
+   * could not be satisfied at all. */
+  uint16_t failures;
+} sBSPACMpoolClassStatistics;
+
+/** Allocate memory for the pools and initialize them.
+ *
+ * The memory is obtained with sbrk(), so it does not conflict with
+ * malloc(), but once allocated it is never returned to the heap.
+ * The call fails without invoking sbrk() if the space between the
+ * current program break and @c __HeapLimit is insufficient, so
+ * configure @c STARTUP_HEAP_SIZE to cover both the pools and any use
+ * of malloc().
+ *
+ * This function may be invoked only once.
+ *
+ * @param classes the block-size classes to create.  These must be
+ * sorted in increasing order of @p block_size, and no class may have
+ * a zero block size or block count.  The array is not referenced
+ * after the call returns.
+ *
+ * @param nclasses the number of entries in @p classes.  This may not
+ * exceed #BSPACM_POOL_CLASS_LIMIT.
+ *
+ * @return zero on success, or -1 if the configuration is invalid, the
+ * pools have already been initialized, or there is insufficient
+ * memory. */
+int iBSPACMpoolInitialize (const sBSPACMpoolClassConfiguration * classes,
+                           unsigned int nclasses);
+
+/** Allocate a block from the pools.
+ *
+ * This may be invoked from interrupt handlers.
+ *
+ * @param size the minimum required size of the block, in octets
+ *
+ * @return a pointer to a block of at least @p size octets aligned to
+ * #BSPACM_POOL_ALIGNMENT, or a null pointer if no such block is
+ * available. */
+void * pvBSPACMpoolAllocate (size_t size);
+
+/** Return a block to the pool from which it was allocated.
+ *
+ * This may be invoked from interrupt handlers.
+ *
+ * @param ptr a pointer previously returned by pvBSPACMpoolAllocate(),
+ * or a null pointer.
+ *
+ * @return zero if @p ptr was released or is null, or -1 if @p ptr
+ * does not identify the start of a block within the pools. */
+int iBSPACMpoolRelease (void * ptr);
+
+/** Obtain a consistent snapshot of the statistics for a class.
+ *
+ * @param cls the index of the class, per the order of classes in the
+ * configuration passed to iBSPACMpoolInitialize()
+ *
+ * @param sp where the statistics should be stored
+ *
+ * @return zero on success, or -1 if @p cls does not identify a class
+ * or @p sp is null. */
+int iBSPACMpoolClassStatistics (unsigned int cls,
+                                sBSPACMpoolClassStatistics * sp);
+
+/** Function invoked when pvBSPACMpoolAllocate() cannot satisfy a
+ * request.
+ *
+ * This is called with interrupts in the state they had on entry to
+ * pvBSPACMpoolAllocate(), which may be from within an interrupt
+ * handler.  On return the allocation returns a null pointer.
+ *
+ * @weakdef A weak definition that does nothing is provided.  An
+ * application may override it to log the event, release cached
+ * buffers, or reset the system.
+ *
+ * @param size the size that was requested */
+void vBSPACMpoolAllocationFailure (size_t size);
+
+#endif /* BSPACM_UTILITY_POOL_H */
@@ -0,0 +1,320 @@
+/* Copyright 2014, Peter A. Bigot
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of the software nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without
+ *   specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/** @file
+ *
+ * @brief Named profiling probes
+ *
+ * A probe accumulates the duration of every pass through a region of
+ * code bracketed by BSPACM_PROFILE_ENTER() and BSPACM_PROFILE_EXIT().
+ * Probes are defined at file scope with BSPACM_PROFILE_PROBE_DEFINE(),
+ * which places them in a dedicated linker section so the reporting
+ * functions can find every probe in the application without runtime
+ * registration.
+ *
+ * Durations are measured in ticks of the source selected by
+ * #BSPACM_PROFILE_SOURCE: the DWT cycle counter where the core has
+ * one, otherwise the nRF51 high-resolution timer or the SysTick
+ * counter.
+ *
+ * Unless #BSPACM_PROFILE is defined to a true value when the
+ * application is compiled, probe definitions and the enter/exit
+ * macros expand to nothing, and no code or data is added.
+ *
+ * @warning A probe records only the most recent entry time.  A probe
+ * must not be entered from an interrupt handler while it is active
+ * in the interrupted code.
+ *
+ * @homepage http://github.com/pabigot/bspacm
+ * @copyright Copyright 2014, Peter A. Bigot.  Licensed under <a href="http://www.opensource.org/licenses/BSD-3-Clause">BSD-3-Clause</a>
+ */
+
+#ifndef BSPACM_UTILITY_PROFILE_H
+#define BSPACM_UTILITY_PROFILE_H
+
+#include <bspacm/core.h>
+
+/** Define to a true value to enable the profiling macros.  When
+ * false, BSPACM_PROFILE_PROBE_DEFINE(), BSPACM_PROFILE_ENTER() and
+ * BSPACM_PROFILE_EXIT() generate no code.
+ *
+ * The supporting functions are always present in the library, so
+ * this may be set per application or per translation unit.
+ *
+ * @cppflag
+ * @defaulted */
+#ifndef BSPACM_PROFILE
+#define BSPACM_PROFILE 0
+#endif /* BSPACM_PROFILE */
+
+/** Value for #BSPACM_PROFILE_SOURCE selecting the DWT cycle counter */
+#define BSPACM_PROFILE_SOURCE_CYCCNT 1
+
+/** Value for #BSPACM_PROFILE_SOURCE selecting the SysTick counter,
+ * which iBSPACMprofileInitialize() configures to free-run at the
+ * core clock rate with no interrupt. */
+#define BSPACM_PROFILE_SOURCE_SYSTICK 2
+
+/** Value for #BSPACM_PROFILE_SOURCE selecting the nRF51
+ * high-resolution timer, which the application must initialize and
+ * enable. */
+#define BSPACM_PROFILE_SOURCE_HIRES 3
+
+/** The time base for profile measurements.
+ *
+ * The default is #BSPACM_PROFILE_SOURCE_CYCCNT when
+ * #BSPACM_CORE_SUPPORTS_CYCCNT is true,
+ * #BSPACM_PROFILE_SOURCE_HIRES on nRF51 devices (which do not
+ * implement SysTick), and #BSPACM_PROFILE_SOURCE_SYSTICK otherwise.
+ *
+ * @note This must have the same value in the library and the
+ * application.
+ *
+ * @cppflag
+ * @defaulted */
+#ifndef BSPACM_PROFILE_SOURCE
+#if (BSPACM_CORE_SUPPORTS_CYCCNT - 0)
+#define BSPACM_PROFILE_SOURCE BSPACM_PROFILE_SOURCE_CYCCNT
+#elif (BSPACM_DEVICE_SERIES_NRF51 - 0)
+#define BSPACM_PROFILE_SOURCE BSPACM_PROFILE_SOURCE_HIRES
+#else /* BSPACM_PROFILE_SOURCE */
+#define BSPACM_PROFILE_SOURCE BSPACM_PROFILE_SOURCE_SYSTICK
+#endif /* BSPACM_PROFILE_SOURCE */
+#endif /* BSPACM_PROFILE_SOURCE */
+
+#if (BSPACM_PROFILE_SOURCE_HIRES == BSPACM_PROFILE_SOURCE)
+#include <bspacm/utility/hires.h>
+
+/** The #BSPACM_HIRES_TIMER capture register used to read the counter
+ * when #BSPACM_PROFILE_SOURCE is #BSPACM_PROFILE_SOURCE_HIRES.
+ *
+ * The default shares register 0 with uiBSPACMhires(), which also
+ * captures and reads without comparing.  A capture from an interrupt
+ * between the two steps only makes the value read slightly later.
+ * The other registers hold #BSPACM_HIRES_OVERFLOW_CCIDX,
+ * #BSPACM_HIRES_ALARM_CCIDX and #BSPACM_HIRES_CAPTURE_CCIDX, which a
+ * capture would corrupt.
+ *
+ * @cppflag
+ * @defaulted */
+#ifndef BSPACM_PROFILE_HIRES_CC
+#define BSPACM_PROFILE_HIRES_CC 0
+#endif /* BSPACM_PROFILE_HIRES_CC */
+
+#if (BSPACM_HIRES_OVERFLOW_CCIDX == BSPACM_PROFILE_HIRES_CC) || (BSPACM_HIRES_ALARM_CCIDX == BSPACM_PROFILE_HIRES_CC) || (BSPACM_HIRES_CAPTURE_CCIDX == BSPACM_PROFILE_HIRES_CC)
+#error BSPACM_PROFILE_HIRES_CC is not valid
+#endif /* BSPACM_PROFILE_HIRES_CC */
+#endif /* BSPACM_PROFILE_SOURCE */
+
+/** @def BSPACM_PROFILE_TIMESTAMP
+ *
+ * Expression producing the current value of the profile time base
+ * as an increasing count.
+ *
+ * @def BSPACM_PROFILE_TIMESTAMP_MASK
+ *
+ * Mask selecting the bits of #BSPACM_PROFILE_TIMESTAMP that are
+ * significant.  Durations longer than this many ticks wrap.
+ *
+ * @def BSPACM_PROFILE_TIMESTAMP_UNITS
+ *
+ * Text describing the unit of profile durations. */
+#if (BSPACM_PROFILE_SOURCE_CYCCNT == BSPACM_PROFILE_SOURCE)
+#define BSPACM_PROFILE_TIMESTAMP() BSPACM_CORE_CYCCNT()
+#define BSPACM_PROFILE_TIMESTAMP_MASK 0xFFFFFFFFU
+#define BSPACM_PROFILE_TIMESTAMP_UNITS "cycles"
+#elif (BSPACM_PROFILE_SOURCE_HIRES == BSPACM_PROFILE_SOURCE)
+#define BSPACM_PROFILE_TIMESTAMP() \
+  (BSPACM_HIRES_TIMER->TASKS_CAPTURE[BSPACM_PROFILE_HIRES_CC] = 1, \
+   BSPACM_HIRES_TIMER->CC[BSPACM_PROFILE_HIRES_CC])
+#if (NRF_TIMER0_BASE == BSPACM_HIRES_TIMER_BASE)
+#define BSPACM_PROFILE_TIMESTAMP_MASK 0xFFFFFFFFU
+#else /* BSPACM_HIRES_TIMER_BASE */
+#define BSPACM_PROFILE_TIMESTAMP_MASK 0xFFFFU
+#endif /* BSPACM_HIRES_TIMER_BASE */
+#define BSPACM_PROFILE_TIMESTAMP_UNITS "hires ticks"
+#elif (BSPACM_PROFILE_SOURCE_SYSTICK == BSPACM_PROFILE_SOURCE)
+#define BSPACM_PROFILE_TIMESTAMP() (SysTick_LOAD_RELOAD_Msk - SysTick->VAL)
+#define BSPACM_PROFILE_TIMESTAMP_MASK SysTick_LOAD_RELOAD_Msk
+#define BSPACM_PROFILE_TIMESTAMP_UNITS "cycles"
+#else /* BSPACM_PROFILE_SOURCE */
+#error Unrecognized BSPACM_PROFILE_SOURCE
+#endif /* BSPACM_PROFILE_SOURCE */
+
+/** Number of entries in a probe histogram.  Entry 0 counts
+ * zero-length durations; entry @em k counts durations @em d with
+ * 2<sup>k-1</sup> <= @em d < 2<sup>k</sup>. */
+#define BSPACM_PROFILE_HISTOGRAM_BINS 33
+
+/** Define to a true value to have BSPACM_PROFILE_PROBE_DEFINE()
+ * allocate a log2 histogram of durations for each probe.  This costs
+ * 132 octets of RAM per probe.
+ *
+ * @cppflag
+ * @defaulted */
+#ifndef BSPACM_PROFILE_HISTOGRAM
+#define BSPACM_PROFILE_HISTOGRAM 0
+#endif /* BSPACM_PROFILE_HISTOGRAM */
+
+/** Accumulated measurements for a probe.  All durations are in
+ * units of #BSPACM_PROFILE_TIMESTAMP_UNITS. */
+typedef struct sBSPACMprofileStatistics {
+  /** Number of completed passes through the probe */
+  uint32_t count;
+
+  /** Shortest duration observed.  Meaningless if @p count is zero. */
+  uint32_t min;
+
+  /** Longest duration observed */
+  uint32_t max;
+
+  /** Sum of all durations */
+  uint64_t total;
+} sBSPACMprofileStatistics;
+
+/** State for a profile probe.  Instances should be created only by
+ * BSPACM_PROFILE_PROBE_DEFINE(). */
+typedef struct sBSPACMprofileProbe {
+  /** The name of the probe, for reports */
+  const char * const name;
+
+  /** Null, or an array of #BSPACM_PROFILE_HISTOGRAM_BINS counters */
+  uint32_t * const histogram;
+
+  /** The timestamp recorded at the most recent entry */
+  uint32_t start;
+
+  /** Accumulated measurements */
+  sBSPACMprofileStatistics statistics;
+} sBSPACMprofileProbe;
+
+#if (BSPACM_PROFILE - 0)
+#if (BSPACM_PROFILE_HISTOGRAM - 0)
+#define BSPACM_PROFILE_HISTOGRAM_DEFINE_(probe_)                        \
+  static uint32_t xBSPACMprofileHistogram_##probe_[BSPACM_PROFILE_HISTOGRAM_BINS];
+#define BSPACM_PROFILE_HISTOGRAM_REF_(probe_) xBSPACMprofileHistogram_##probe_
+#else /* BSPACM_PROFILE_HISTOGRAM */
+#define BSPACM_PROFILE_HISTOGRAM_DEFINE_(probe_)
+#define BSPACM_PROFILE_HISTOGRAM_REF_(probe_) 0
+#endif /* BSPACM_PROFILE_HISTOGRAM */
+
+/** Define a probe with the given identifier.  This must be used at
+ * file scope, and the identifier must be unique within the
+ * application.
+ *
+ * @param probe_ the probe identifier, which is also used as its
+ * name in reports */
+#define BSPACM_PROFILE_PROBE_DEFINE(probe_)                             \
+  BSPACM_PROFILE_HISTOGRAM_DEFINE_(probe_)                              \
+  __attribute__((__section__(".bspacm_profile"),__used__))              \
+  sBSPACMprofileProbe xBSPACMprofileProbe_##probe_ = {                  \
+    .name = #probe_,                                                    \
+    .histogram = BSPACM_PROFILE_HISTOGRAM_REF_(probe_),                 \
+  }
+
+/** Declare a probe defined in another translation unit. */
+#define BSPACM_PROFILE_PROBE_DECLARE(probe_) \
+  extern sBSPACMprofileProbe xBSPACMprofileProbe_##probe_
+
+/** Record entry to the region measured by a probe. */
+#define BSPACM_PROFILE_ENTER(probe_) do {                         \
+    xBSPACMprofileProbe_##probe_.start = BSPACM_PROFILE_TIMESTAMP(); \
+  } while (0)
+
+/** Record exit from the region measured by a probe, and accumulate
+ * the duration since the corresponding BSPACM_PROFILE_ENTER(). */
+#define BSPACM_PROFILE_EXIT(probe_) \
+  vBSPACMprofileRecord_(&xBSPACMprofileProbe_##probe_, BSPACM_PROFILE_TIMESTAMP())
+
+#else /* BSPACM_PROFILE */
+#define BSPACM_PROFILE_PROBE_DEFINE(probe_) \
+  extern sBSPACMprofileProbe xBSPACMprofileProbe_##probe_
+#define BSPACM_PROFILE_PROBE_DECLARE(probe_) \
+  extern sBSPACMprofileProbe xBSPACMprofileProbe_##probe_
+#define BSPACM_PROFILE_ENTER(probe_) do { } while (0)
+#define BSPACM_PROFILE_EXIT(probe_) do { } while (0)
+#endif /* BSPACM_PROFILE */
+
+/** Prepare the profile time base.
+ *
+ * For #BSPACM_PROFILE_SOURCE_CYCCNT this enables the cycle counter;
+ * for #BSPACM_PROFILE_SOURCE_SYSTICK it takes over the SysTick
+ * counter.
+ *
+ * @return 0 on success, or -1 if the time base is not available
+ * (e.g. the high-resolution timer has not been enabled). */
+int iBSPACMprofileInitialize (void);
+
+/** Accumulate one measurement into a probe.
+ *
+ * This is the implementation of BSPACM_PROFILE_EXIT() and should
+ * not be called directly.
+ *
+ * @param pp the probe
+ *
+ * @param end the timestamp at exit from the measured region */
+void vBSPACMprofileRecord_ (sBSPACMprofileProbe * pp,
+                            uint32_t end);
+
+/** Get the probes defined in the application.
+ *
+ * @param countp where the number of probes should be stored
+ *
+ * @return a pointer to the first of @p *countp contiguous probes */
+sBSPACMprofileProbe * pxBSPACMprofileProbes (unsigned int * countp);
+
+/** Atomically copy the measurements of a probe.
+ *
+ * @param pp the probe of interest
+ *
+ * @param sp where the statistics should be stored.  This must not be
+ * null.
+ *
+ * @param histogram null, or where the probe histogram should be
+ * stored.  This must have #BSPACM_PROFILE_HISTOGRAM_BINS entries.  It
+ * is zero-filled if the probe has no histogram.
+ *
+ * @param reset if true the probe measurements are cleared as part of
+ * the same atomic operation */
+void vBSPACMprofileSnapshot (sBSPACMprofileProbe * pp,
+                             sBSPACMprofileStatistics * sp,
+                             uint32_t * histogram,
+                             bool reset);
+
+/** Display the measurements of every probe on the console.
+ *
+ * Each probe is captured with vBSPACMprofileSnapshot().
+ *
+ * @param reset if true each probe is cleared after its measurements
+ * are captured */
+void vBSPACMprofileReport (bool reset);
+
+#endif /* BSPACM_UTILITY_PROFILE_H */
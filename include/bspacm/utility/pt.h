@@ -0,0 +1,256 @@
+/* Copyright 2014, Peter A. Bigot
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of the software nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without
+ *   specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/** @file
+ *
+ * @brief Stackless coroutines (protothreads)
+ *
+ * A protothread is a function that can suspend at designated points
+ * and resume there on its next invocation, without a stack of its
+ * own.  This allows multi-step device interactions such as
+ * measure-wait-read sequences to be written as straight-line code
+ * while sharing the application stack with any number of other
+ * interactions.
+ *
+ * The suspension point is recorded in a #sBSPACMpt structure using
+ * the switch-based local continuation technique.  The consequences
+ * are:
+ * @li Local variables are not preserved across a suspension.  Keep
+ * state that must survive in a structure that embeds the #sBSPACMpt.
+ * @li A @c switch statement may not contain a suspension point.
+ * @li Each suspension must be on its own source line.
+ *
+ * A protothread function is declared to return @c int, starts with
+ * BSPACM_PT_BEGIN() and ends with BSPACM_PT_END().  The return value
+ * is one of #BSPACM_PT_WAITING, #BSPACM_PT_YIELDED,
+ * #BSPACM_PT_EXITED, #BSPACM_PT_ENDED.  The application invokes each
+ * protothread in turn from its main loop, then calls
+ * uiBSPACMptIdle() to sleep until an event of interest is posted to
+ * #xBSPACMeventSystem or a protothread deadline arrives.
+ *
+ * On devices with the uptime clock, protothreads can wait for a
+ * duration as well.  All pending deadlines share a single alarm in
+ * the uptime software alarm queue.
+ *
+ * @homepage http://github.com/pabigot/bspacm
+ * @copyright Copyright 2014, Peter A. Bigot.  Licensed under <a href="http://www.opensource.org/licenses/BSD-3-Clause">BSD-3-Clause</a>
+ */
+
+#ifndef BSPACM_UTILITY_PT_H
+#define BSPACM_UTILITY_PT_H
+
+#include <bspacm/core.h>
+#include <bspacm/utility/event.h>
+#if (BSPACM_DEVICE_SERIES_NRF51 - 0)
+#include <bspacm/utility/uptime.h>
+#endif /* BSPACM_DEVICE_SERIES_NRF51 */
+
+/** Returned by a protothread that is blocked waiting for a
+ * condition. */
+#define BSPACM_PT_WAITING 0
+
+/** Returned by a protothread that voluntarily gave up control. */
+#define BSPACM_PT_YIELDED 1
+
+/** Returned by a protothread that terminated through
+ * BSPACM_PT_EXIT(). */
+#define BSPACM_PT_EXITED 2
+
+/** Returned by a protothread that reached BSPACM_PT_END(). */
+#define BSPACM_PT_ENDED 3
+
+/** State for a protothread. */
+typedef struct sBSPACMpt {
+  /** The source line of the suspension point, or zero if the
+   * protothread starts from the beginning on its next invocation. */
+  uint16_t lc_;
+
+  /** The events consumed by the most recent BSPACM_PT_WAIT_EVENT()
+   * or BSPACM_PT_WAIT_EVENT_UTT(). */
+  uint32_t events;
+
+  /** The uptime at which the current duration wait completes. */
+  unsigned int deadline_utt;
+} sBSPACMpt;
+
+/** Reset a protothread so its next invocation starts from the
+ * beginning. */
+#define BSPACM_PT_INITIALIZE(pt_) do { \
+    (pt_)->lc_ = 0;                    \
+  } while (0)
+
+/** @cond DOXYGEN_EXCLUDE */
+#define BSPACM_PT_SET_LC_(pt_) (pt_)->lc_ = __LINE__; case __LINE__:
+/** @endcond */
+
+/** Open the body of a protothread.  Must be matched by
+ * BSPACM_PT_END() in the same function. */
+#define BSPACM_PT_BEGIN(pt_) {                  \
+    bool pt_resumed_ = true;                    \
+    (void)pt_resumed_;                          \
+    switch ((pt_)->lc_) {                       \
+      case 0:
+
+/** Close the body of a protothread.  Reaching this resets the
+ * protothread and returns #BSPACM_PT_ENDED. */
+#define BSPACM_PT_END(pt_)                      \
+    }                                           \
+    BSPACM_PT_INITIALIZE(pt_);                  \
+    return BSPACM_PT_ENDED;                     \
+  }
+
+/** Suspend until a condition is true.  The condition is evaluated
+ * on every invocation of the protothread until it holds. */
+#define BSPACM_PT_WAIT_UNTIL(pt_, cond_) do {   \
+    BSPACM_PT_SET_LC_(pt_);                     \
+    if (! (cond_)) {                            \
+      return BSPACM_PT_WAITING;                 \
+    }                                           \
+  } while (0)
+
+/** Suspend while a condition is true. */
+#define BSPACM_PT_WAIT_WHILE(pt_, cond_) BSPACM_PT_WAIT_UNTIL(pt_, ! (cond_))
+
+/** Suspend once, resuming on the next invocation. */
+#define BSPACM_PT_YIELD(pt_) do {               \
+    pt_resumed_ = false;                        \
+    BSPACM_PT_SET_LC_(pt_);                     \
+    if (! pt_resumed_) {                        \
+      return BSPACM_PT_YIELDED;                 \
+    }                                           \
+  } while (0)
+
+/** Terminate the protothread, resetting it so its next invocation
+ * starts from the beginning. */
+#define BSPACM_PT_EXIT(pt_) do {                \
+    BSPACM_PT_INITIALIZE(pt_);                  \
+    return BSPACM_PT_EXITED;                    \
+  } while (0)
+
+/** Suspend until a child protothread terminates.
+ *
+ * @param pt_ the parent protothread
+ *
+ * @param thread_ an invocation of the child, e.g. @c child(&cpt) */
+#define BSPACM_PT_WAIT_THREAD(pt_, thread_) BSPACM_PT_WAIT_WHILE(pt_, BSPACM_PT_EXITED > (thread_))
+
+/** Start a child protothread from the beginning and suspend until it
+ * terminates.
+ *
+ * @param pt_ the parent protothread
+ *
+ * @param child_ pointer to the #sBSPACMpt of the child
+ *
+ * @param thread_ an invocation of the child */
+#define BSPACM_PT_SPAWN(pt_, child_, thread_) do { \
+    BSPACM_PT_INITIALIZE(child_);                  \
+    BSPACM_PT_WAIT_THREAD(pt_, thread_);           \
+  } while (0)
+
+/** Suspend until an event in @p mask_ has been posted to @p gp_.
+ * The posted events in the mask are consumed and stored in
+ * sBSPACMpt::events.
+ *
+ * @note An event is consumed by the first protothread that observes
+ * it.  Where several protothreads wait for the same condition each
+ * should confirm the condition itself, e.g. by checking a FIFO,
+ * rather than relying on receipt of the event. */
+#define BSPACM_PT_WAIT_EVENT(pt_, gp_, mask_) \
+  BSPACM_PT_WAIT_UNTIL(pt_, 0 != ((pt_)->events = uiBSPACMeventTake((gp_), (mask_))))
+
+/** Sleep until a flag in @p mask is posted to #xBSPACMeventSystem or
+ * a deadline recorded by a protothread duration wait has passed.
+ *
+ * Unlike uiBSPACMeventWait() this does not consume the posted flags;
+ * they remain for the protothreads to take.  The application should
+ * invoke its protothreads after each return.
+ *
+ * @param mask the events that protothreads may be waiting for
+ *
+ * @return the flags in @p mask that are posted, which may be zero
+ * if the wakeup was due to a deadline */
+uint32_t uiBSPACMptIdle (uint32_t mask);
+
+#if defined(BSPACM_DOXYGEN) || (BSPACM_DEVICE_SERIES_NRF51 - 0)
+
+/** Determine whether an uptime deadline has passed.
+ *
+ * If it has not, ensure the protothread wakeup alarm will fire no
+ * later than the deadline.
+ *
+ * @param deadline_utt the deadline, as a value of uiBSPACMuptime()
+ *
+ * @return @c true iff the deadline has passed */
+bool bBSPACMptDeadlineReached (unsigned int deadline_utt);
+
+/** Suspend for a duration.
+ *
+ * @param pt_ the protothread
+ *
+ * @param duration_utt_ the duration in #BSPACM_UPTIME_Hz ticks, not
+ * exceeding 2^23 */
+#define BSPACM_PT_SLEEP_UTT(pt_, duration_utt_) do {               \
+    (pt_)->deadline_utt = uiBSPACMuptime() + (duration_utt_);      \
+    BSPACM_PT_WAIT_UNTIL(pt_, bBSPACMptDeadlineReached((pt_)->deadline_utt)); \
+  } while (0)
+
+/** Suspend until an absolute time.  Use this rather than
+ * BSPACM_PT_SLEEP_UTT() to schedule periodic activity without
+ * accumulating drift.
+ *
+ * @param pt_ the protothread
+ *
+ * @param when_utt_ the time to resume, as a value of
+ * uiBSPACMuptime() */
+#define BSPACM_PT_SLEEP_UNTIL_UTT(pt_, when_utt_) do {             \
+    (pt_)->deadline_utt = (when_utt_);                             \
+    BSPACM_PT_WAIT_UNTIL(pt_, bBSPACMptDeadlineReached((pt_)->deadline_utt)); \
+  } while (0)
+
+/** Suspend until an event is posted or a duration elapses, whichever
+ * is first.  sBSPACMpt::events is zero if the duration elapsed.
+ *
+ * @param pt_ the protothread
+ *
+ * @param gp_ the event group
+ *
+ * @param mask_ the events of interest
+ *
+ * @param duration_utt_ the timeout in #BSPACM_UPTIME_Hz ticks */
+#define BSPACM_PT_WAIT_EVENT_UTT(pt_, gp_, mask_, duration_utt_) do {   \
+    (pt_)->deadline_utt = uiBSPACMuptime() + (duration_utt_);           \
+    BSPACM_PT_WAIT_UNTIL(pt_, ((0 != ((pt_)->events = uiBSPACMeventTake((gp_), (mask_)))) \
+                               || bBSPACMptDeadlineReached((pt_)->deadline_utt))); \
+  } while (0)
+
+#endif /* BSPACM_DEVICE_SERIES_NRF51 */
+
+#endif /* BSPACM_UTILITY_PT_H */
@@ -0,0 +1,151 @@
+/* Copyright 2014, Peter A. Bigot
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of the software nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without
+ *   specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/** @file
+ *
+ * @brief Run-to-completion tasks dispatched from PendSV
+ *
+ * Interrupt handlers frequently need to do more work than should be
+ * done at their priority.  This module lets a handler post a task,
+ * which is a statically allocated structure identifying a function
+ * to be invoked later.  Posting takes constant time and holds
+ * interrupts disabled for only a few instructions.  Posting pends
+ * the PendSV exception, which is configured at the lowest interrupt
+ * priority; its handler invokes queued tasks, most urgent first, until
+ * none remain.
+ *
+ * Because PendSV runs below every peripheral interrupt, tasks are
+ * preempted by handlers but never by other tasks, and each runs to
+ * completion.  An application that does all its work in tasks can
+ * invoke vBSPACMtaskRun() from main() so the core sleeps whenever
+ * no task is queued.
+ *
+ * Tasks with equal priority run in the order they were posted.
+ * Posting a task that is already queued has no effect, so a handler
+ * that fires repeatedly before the task runs does not lose or
+ * duplicate work as long as the task drains all available input.
+ *
+ * @note The PendSV_Handler() that dispatches tasks is in its own
+ * object, linked only when the application invokes vBSPACMtaskRun()
+ * or builds with <tt>WITH_TASK_PENDSV=1</tt>.  An application or
+ * RTOS that uses neither must supply a PendSV_Handler() that calls
+ * uiBSPACMtaskDispatch() before any task is posted; otherwise the
+ * startup default handler is entered.  PendSV is set to the lowest
+ * priority when the first task is posted or vBSPACMtaskRun() is
+ * invoked, not when the module is linked.
+ *
+ * @homepage http://github.com/pabigot/bspacm
+ * @copyright Copyright 2014, Peter A. Bigot.  Licensed under <a href="http://www.opensource.org/licenses/BSD-3-Clause">BSD-3-Clause</a>
+ */
+
+#ifndef BSPACM_UTILITY_TASK_H
+#define BSPACM_UTILITY_TASK_H
+
+#include <bspacm/core.h>
+
+/** The number of distinct task priorities.  Valid priorities range
+ * from 0 (least urgent) through one less than this value.  The value
+ * may not exceed 32.
+ *
+ * @cppflag
+ * @defaulted */
+#ifndef BSPACM_TASK_PRIORITY_LEVELS
+#define BSPACM_TASK_PRIORITY_LEVELS 8
+#endif /* BSPACM_TASK_PRIORITY_LEVELS */
+
+struct sBSPACMtask;
+
+/** The function invoked when a task is dispatched.
+ *
+ * @param tp pointer to the task.  This may be embedded in a larger
+ * structure to pass context to the function.  The task has already
+ * been removed from the queue, so the function may post it again. */
+typedef void (* vBSPACMtaskFunction) (struct sBSPACMtask * tp);
+
+/** State for a task.  The structure must remain valid while the task
+ * is queued. */
+typedef struct sBSPACMtask {
+  /** The function to invoke when the task is dispatched. */
+  vBSPACMtaskFunction function;
+
+  /** The task priority; higher values are dispatched first. */
+  uint8_t priority;
+
+  /** Non-zero while the task is queued.  Managed by the
+   * scheduler. */
+  volatile uint8_t queued_;
+
+  /** Link to the next task of the same priority.  Managed by the
+   * scheduler. */
+  struct sBSPACMtask * next_;
+} sBSPACMtask;
+
+/** A handle to a task structure */
+typedef sBSPACMtask * hBSPACMtask;
+
+/** Static initializer for a task.
+ *
+ * @param function_ the #vBSPACMtaskFunction to invoke
+ *
+ * @param priority_ the priority of the task */
+#define BSPACM_TASK_INITIALIZER(function_, priority_) { \
+    .function = (function_),                            \
+    .priority = (priority_),                            \
+  }
+
+/** Queue a task for execution.
+ *
+ * This may be invoked from any context, including interrupt handlers
+ * at any priority.
+ *
+ * @param tp the task to queue
+ *
+ * @return 1 if the task was queued, 0 if it was already queued, or a
+ * negative error code if the task priority is not valid. */
+int iBSPACMtaskPost (hBSPACMtask tp);
+
+/** Invoke queued tasks until none remain.
+ *
+ * This is normally invoked only by the PendSV handler.  It is public
+ * so that an application that must supply its own PendSV_Handler()
+ * can delegate to it.
+ *
+ * @return the number of tasks invoked */
+unsigned int uiBSPACMtaskDispatch (void);
+
+/** Sleep forever, running tasks as they are posted.
+ *
+ * This enables sleep-on-exit so that after the last task completes
+ * the core returns to sleep without resuming thread mode.  Referencing
+ * this function links the BSPACM PendSV_Handler(). */
+void vBSPACMtaskRun (void) __attribute__((__noreturn__));
+
+#endif /* BSPACM_UTILITY_TASK_H */
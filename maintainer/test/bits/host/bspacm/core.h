@@ -0,0 +1,46 @@
+/* BSPACM - host stand-in for <bspacm/core.h> when testing bits.h
+ *
+ * Written in 2014 by Peter A. Bigot <http://pabigot.github.io/bspacm/>
+ *
+ * To the extent possible under law, the author(s) have dedicated all
+ * copyright and related and neighboring rights to this software to
+ * the public domain worldwide. This software is distributed without
+ * any warranty.
+ *
+ * You should have received a copy of the CC0 Public Domain Dedication
+ * along with this software. If not, see
+ * <http://creativecommons.org/publicdomain/zero/1.0/>.
+ */
+
+/* Supplies only what <bspacm/utility/bits.h> uses from the real
+ * core.h, with the CMSIS CLZ and RBIT intrinsics emulated so the
+ * ARMv7-M path can be exercised on the build host. */
+
+#ifndef BSPACM_TEST_HOST_CORE_H
+#define BSPACM_TEST_HOST_CORE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define BSPACM_CORE_INLINE inline
+#define BSPACM_CORE_INLINE_FORCED BSPACM_CORE_INLINE __attribute__((__always_inline__))
+
+static inline uint32_t
+__CLZ (uint32_t v)
+{
+  return v ? (uint32_t)__builtin_clz(v) : 32;
+}
+
+static inline uint32_t
+__RBIT (uint32_t v)
+{
+  uint32_t rv = 0;
+  int i;
+
+  for (i = 0; i < 32; ++i) {
+    rv = (rv << 1) | (1 & (v >> i));
+  }
+  return rv;
+}
+
+#endif /* BSPACM_TEST_HOST_CORE_H */
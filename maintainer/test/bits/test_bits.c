@@ -0,0 +1,125 @@
+/* BSPACM - host test of <bspacm/utility/bits.h>
+ *
+ * Written in 2014 by Peter A. Bigot <http://pabigot.github.io/bspacm/>
+ *
+ * To the extent possible under law, the author(s) have dedicated all
+ * copyright and related and neighboring rights to this software to
+ * the public domain worldwide. This software is distributed without
+ * any warranty.
+ *
+ * You should have received a copy of the CC0 Public Domain Dedication
+ * along with this software. If not, see
+ * <http://creativecommons.org/publicdomain/zero/1.0/>.
+ */
+
+/* Compares each bit utility against a naive loop for zero, every
+ * single-bit and low-mask word, and a stream of pseudo-random words.
+ * The Makefile builds this once with BSPACM_BITS_HAVE_CLZ true and
+ * once with it false, covering both implementations.  Values pass
+ * through a volatile so the __builtin_constant_p path is not taken,
+ * except in check_constants() which covers that path. */
+
+#include <bspacm/utility/bits.h>
+#include <stdio.h>
+
+static unsigned int failures;
+
+static int
+ref_ffs (uint32_t v)
+{
+  int i;
+
+  for (i = 0; i < 32; ++i) {
+    if (v & (1U << i)) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+static int
+ref_fls (uint32_t v)
+{
+  int i;
+
+  for (i = 31; i >= 0; --i) {
+    if (v & (1U << i)) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+static unsigned int
+ref_popcount (uint32_t v)
+{
+  unsigned int rv = 0;
+
+  while (v) {
+    rv += v & 1;
+    v >>= 1;
+  }
+  return rv;
+}
+
+static void
+check (uint32_t in)
+{
+  volatile uint32_t vv = in;
+  uint32_t const v = vv;
+  int const ffs = iBSPACMbitsFindFirstSet(v);
+  int const fls = iBSPACMbitsFindLastSet(v);
+  unsigned int const clz = uiBSPACMbitsCountLeadingZeros(v);
+  unsigned int const pop = uiBSPACMbitsPopulationCount(v);
+
+  if ((ffs != ref_ffs(in))
+      || (fls != ref_fls(in))
+      || (clz != (unsigned int)(31 - ref_fls(in)))
+      || (pop != ref_popcount(in))) {
+    printf("FAIL 0x%08x: ffs %d/%d fls %d/%d clz %u/%d pop %u/%u\n",
+           in, ffs, ref_ffs(in), fls, ref_fls(in),
+           clz, 31 - ref_fls(in), pop, ref_popcount(in));
+    ++failures;
+  }
+}
+
+static void
+check_constants (void)
+{
+  if ((-1 != iBSPACMbitsFindFirstSet(0))
+      || (4 != iBSPACMbitsFindFirstSet(0x30))
+      || (-1 != iBSPACMbitsFindLastSet(0))
+      || (31 != iBSPACMbitsFindLastSet(0x80000001U))
+      || (32 != uiBSPACMbitsCountLeadingZeros(0))
+      || (32 != uiBSPACMbitsPopulationCount(0xFFFFFFFFU))) {
+    printf("FAIL constant folding\n");
+    ++failures;
+  }
+}
+
+int
+main (void)
+{
+  uint32_t x = 0x2545F491U;
+  int i;
+
+  check_constants();
+  check(0);
+  check(0xFFFFFFFFU);
+  for (i = 0; i < 32; ++i) {
+    check(1U << i);
+    check((1U << i) - 1);
+    check(~((1U << i) - 1));
+  }
+  for (i = 0; i < 1000000; ++i) {
+    /* xorshift32 */
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    check(x);
+    check(x >> (x & 31));
+  }
+  printf("bits (BSPACM_BITS_HAVE_CLZ=%d): %s\n", BSPACM_BITS_HAVE_CLZ,
+         failures ? "FAILED" : "passed");
+  return failures ? 1 : 0;
+}
@@ -0,0 +1,72 @@
+/* BSPACM - host stand-in for <bspacm/core.h> when testing tasks
+ *
+ * Written in 2014 by Peter A. Bigot <http://pabigot.github.io/bspacm/>
+ *
+ * To the extent possible under law, the author(s) have dedicated all
+ * copyright and related and neighboring rights to this software to
+ * the public domain worldwide. This software is distributed without
+ * any warranty.
+ *
+ * You should have received a copy of the CC0 Public Domain Dedication
+ * along with this software. If not, see
+ * <http://creativecommons.org/publicdomain/zero/1.0/>.
+ */
+
+/* Supplies only what src/utility/task.c uses from the real core.h and
+ * CMSIS.  The interrupt mask, the System Control Block, and the NVIC
+ * priority of PendSV are variables the test inspects. */
+
+#ifndef BSPACM_TEST_HOST_CORE_H
+#define BSPACM_TEST_HOST_CORE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#define BSPACM_CORE_INLINE inline
+#define BSPACM_CORE_INLINE_FORCED BSPACM_CORE_INLINE __attribute__((__always_inline__))
+
+/* Emulated PRIMASK */
+extern unsigned int test_primask;
+
+#define BSPACM_CORE_ENABLE_INTERRUPT() do { test_primask = 0; } while (0)
+#define BSPACM_CORE_DISABLE_INTERRUPT() do { test_primask = 1; } while (0)
+#define BSPACM_CORE_SAVED_INTERRUPT_STATE(var_) unsigned int const var_ = test_primask
+#define BSPACM_CORE_REENABLE_INTERRUPT(var_) do { \
+    if (! (1U & var_)) {                          \
+      BSPACM_CORE_ENABLE_INTERRUPT();             \
+    }                                             \
+  } while (0)
+
+typedef struct {
+  volatile uint32_t ICSR;
+  volatile uint32_t SCR;
+} SCB_Type;
+
+extern SCB_Type test_scb;
+
+#define SCB (&test_scb)
+#define SCB_ICSR_PENDSVSET_Msk (1UL << 28)
+#define SCB_SCR_SLEEPONEXIT_Msk (1UL << 1)
+
+typedef int IRQn_Type;
+#define PendSV_IRQn ((IRQn_Type)-2)
+#define __NVIC_PRIO_BITS 2
+
+/* Records the last priority assigned to PendSV */
+extern int test_pendsv_priority;
+extern unsigned int test_pendsv_priority_writes;
+
+static inline void
+NVIC_SetPriority (IRQn_Type irqn,
+                  uint32_t priority)
+{
+  if (PendSV_IRQn == irqn) {
+    test_pendsv_priority = priority;
+    ++test_pendsv_priority_writes;
+  }
+}
+
+#include <bspacm/utility/bits.h>
+
+#endif /* BSPACM_TEST_HOST_CORE_H */
@@ -0,0 +1,168 @@
+/* BSPACM - host test of run-to-completion tasks
+ *
+ * Written in 2014 by Peter A. Bigot <http://pabigot.github.io/bspacm/>
+ *
+ * To the extent possible under law, the author(s) have dedicated all
+ * copyright and related and neighboring rights to this software to
+ * the public domain worldwide. This software is distributed without
+ * any warranty.
+ *
+ * You should have received a copy of the CC0 Public Domain Dedication
+ * along with this software. If not, see
+ * <http://creativecommons.org/publicdomain/zero/1.0/>.
+ */
+
+/* Builds src/utility/task.c on the host and checks that tasks run
+ * most urgent priority first and in posting order within a priority,
+ * that posting a queued task is coalesced, that a task may re-post
+ * itself or post others from within the dispatch, that invalid
+ * priorities are rejected, and that posting pends PendSV, configures
+ * its priority once, and restores the caller's interrupt mask.
+ * PendSV is simulated by invoking uiBSPACMtaskDispatch() when the
+ * test sees it pended. */
+
+#include <bspacm/utility/task.h>
+#include <stdio.h>
+#include <string.h>
+
+unsigned int test_primask;
+SCB_Type test_scb;
+int test_pendsv_priority = -1;
+unsigned int test_pendsv_priority_writes;
+
+static unsigned int failures;
+
+#define CHECK(cond_, ...) do {                  \
+    if (! (cond_)) {                            \
+      ++failures;                               \
+      printf("FAIL %s:%d: ", __FILE__, __LINE__); \
+      printf(__VA_ARGS__);                      \
+      putchar('\n');                            \
+    }                                           \
+  } while (0)
+
+typedef struct sTestTask {
+  sBSPACMtask task;
+  char id;
+  /* Number of times the task re-posts itself */
+  unsigned int reposts;
+  /* A task to post when this one runs */
+  struct sTestTask * chain;
+} sTestTask;
+
+static char trace[64];
+static unsigned int trace_len;
+
+static void
+run_task (hBSPACMtask tp)
+{
+  sTestTask * ttp = (sTestTask *)tp;
+
+  CHECK(0 == test_primask, "task %c invoked with interrupts disabled", ttp->id);
+  CHECK(! tp->queued_, "task %c still marked queued", ttp->id);
+  if (trace_len < (sizeof(trace) - 1)) {
+    trace[trace_len++] = ttp->id;
+  }
+  if (ttp->reposts) {
+    --ttp->reposts;
+    CHECK(1 == iBSPACMtaskPost(tp), "re-post of %c not queued", ttp->id);
+  }
+  if (ttp->chain) {
+    (void)iBSPACMtaskPost(&ttp->chain->task);
+  }
+}
+
+#define TEST_TASK(id_, pri_) { .task = BSPACM_TASK_INITIALIZER(run_task, pri_), .id = id_ }
+
+static sTestTask a_lo = TEST_TASK('a', 0);
+static sTestTask b_lo = TEST_TASK('b', 0);
+static sTestTask c_mid = TEST_TASK('c', 3);
+static sTestTask d_hi = TEST_TASK('d', BSPACM_TASK_PRIORITY_LEVELS - 1);
+static sTestTask e_mid = TEST_TASK('e', 3);
+static sTestTask bad = TEST_TASK('x', BSPACM_TASK_PRIORITY_LEVELS);
+
+/* Take the pended PendSV, if any, and return the dispatch trace. */
+static const char *
+pendsv (void)
+{
+  unsigned int n = 0;
+
+  trace_len = 0;
+  if (SCB_ICSR_PENDSVSET_Msk & test_scb.ICSR) {
+    test_scb.ICSR = 0;
+    n = uiBSPACMtaskDispatch();
+  }
+  trace[trace_len] = 0;
+  CHECK(n == trace_len, "dispatch returned %u for %u tasks", n, trace_len);
+  return trace;
+}
+
+static void
+expect (const char * what,
+        const char * want)
+{
+  const char * got = pendsv();
+
+  CHECK(0 == strcmp(got, want), "%s ran \"%s\", expected \"%s\"", what, got, want);
+}
+
+int
+main (void)
+{
+  CHECK(0 == test_pendsv_priority_writes, "PendSV configured before use");
+  expect("empty queue", "");
+
+  /* Priority order, FIFO within a priority. */
+  CHECK(1 == iBSPACMtaskPost(&a_lo.task), "post a");
+  CHECK((SCB_ICSR_PENDSVSET_Msk & test_scb.ICSR), "post did not pend PendSV");
+  CHECK(((1 << __NVIC_PRIO_BITS) - 1) == test_pendsv_priority,
+        "PendSV priority %d", test_pendsv_priority);
+  (void)iBSPACMtaskPost(&c_mid.task);
+  (void)iBSPACMtaskPost(&b_lo.task);
+  (void)iBSPACMtaskPost(&e_mid.task);
+  (void)iBSPACMtaskPost(&d_hi.task);
+  expect("priority order", "dceab");
+  CHECK(1 == test_pendsv_priority_writes, "PendSV configured %u times",
+        test_pendsv_priority_writes);
+
+  /* Coalescing */
+  CHECK(1 == iBSPACMtaskPost(&a_lo.task), "first post of a");
+  CHECK(0 == iBSPACMtaskPost(&a_lo.task), "second post of a not coalesced");
+  CHECK(a_lo.task.queued_, "a not marked queued");
+  expect("coalesced", "a");
+
+  /* Re-post from within the task runs it again in the same dispatch,
+   * after already-queued tasks of its priority. */
+  a_lo.reposts = 2;
+  (void)iBSPACMtaskPost(&a_lo.task);
+  (void)iBSPACMtaskPost(&b_lo.task);
+  expect("re-post", "abaa");
+
+  /* A higher priority posted from a task runs before queued lower
+   * ones; a lower one runs after. */
+  a_lo.chain = &d_hi;
+  d_hi.chain = &b_lo;
+  (void)iBSPACMtaskPost(&a_lo.task);
+  (void)iBSPACMtaskPost(&e_mid.task);
+  expect("chain", "eadb");
+  a_lo.chain = d_hi.chain = NULL;
+
+  /* Invalid priority */
+  CHECK(0 > iBSPACMtaskPost(&bad.task), "invalid priority accepted");
+  CHECK(! bad.task.queued_, "invalid task queued");
+  expect("invalid", "");
+
+  /* Posting with interrupts disabled leaves them disabled. */
+  test_primask = 1;
+  CHECK(1 == iBSPACMtaskPost(&c_mid.task), "post with interrupts disabled");
+  CHECK(1 == test_primask, "post re-enabled interrupts");
+  test_primask = 0;
+  expect("masked post", "c");
+
+  if (failures) {
+    printf("%u failures\n", failures);
+    return 1;
+  }
+  printf("All checks passed\n");
+  return 0;
+}
@@ -0,0 +1,36 @@
+/* BSPACM - host stand-in for <bspacm/core.h> when testing tlsf.c
+ *
+ * Written in 2014 by Peter A. Bigot <http://pabigot.github.io/bspacm/>
+ *
+ * To the extent possible under law, the author(s) have dedicated all
+ * copyright and related and neighboring rights to this software to
+ * the public domain worldwide. This software is distributed without
+ * any warranty.
+ *
+ * You should have received a copy of the CC0 Public Domain Dedication
+ * along with this software. If not, see
+ * <http://creativecommons.org/publicdomain/zero/1.0/>.
+ */
+
+/* Supplies only what the TLSF allocator uses from the real core.h.
+ * The host test is single-threaded, so the interrupt-state macros
+ * reduce to counting critical sections. */
+
+#ifndef BSPACM_TEST_HOST_CORE_H
+#define BSPACM_TEST_HOST_CORE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define BSPACM_CORE_INLINE inline
+#define BSPACM_CORE_INLINE_FORCED BSPACM_CORE_INLINE __attribute__((__always_inline__))
+
+/* Number of times interrupts were disabled; maintained by the
+ * test. */
+extern unsigned int test_critical_sections;
+
+#define BSPACM_CORE_SAVED_INTERRUPT_STATE(var_) unsigned int const var_ = 0
+#define BSPACM_CORE_DISABLE_INTERRUPT() do { ++test_critical_sections; } while (0)
+#define BSPACM_CORE_REENABLE_INTERRUPT(var_) do { (void)(var_); } while (0)
+
+#endif /* BSPACM_TEST_HOST_CORE_H */
@@ -0,0 +1,437 @@
+/* BSPACM - host trace replay for the TLSF allocator
+ *
+ * Written in 2014 by Peter A. Bigot <http://pabigot.github.io/bspacm/>
+ *
+ * To the extent possible under law, the author(s) have dedicated all
+ * copyright and related and neighboring rights to this software to
+ * the public domain worldwide. This software is distributed without
+ * any warranty.
+ *
+ * You should have received a copy of the CC0 Public Domain Dedication
+ * along with this software. If not, see
+ * <http://creativecommons.org/publicdomain/zero/1.0/>.
+ */
+
+/* Replays the traces from examples/misc/malloc_trace, plus one built
+ * to maximize the number of equal-sized free blocks, against
+ * src/newlib/tlsf.c.  The allocator source is included directly so
+ * the heap can be walked after every operation: physical links,
+ * coalescing, free list membership, the bitmaps, and the incremental
+ * totals are all checked, as is the content of every live
+ * allocation.  Any inconsistency fails the test.
+ *
+ * For each trace it reports the peak heap use, the worst
+ * fragmentation (one minus the largest free block over the total
+ * free), and the worst-case search: the most free blocks the
+ * statistics scan had to examine and the most critical sections it
+ * took to do so.  Host times per operation are reported for
+ * comparison only. */
+
+#define TEST_HEAP_SIZE 0x2000
+
+/* Route the allocator's sbrk() and __HeapLimit to a static heap. */
+#define sbrk test_sbrk
+#define __HeapLimit test_heap[TEST_HEAP_SIZE]
+#include "tlsf.c"
+#undef __HeapLimit
+#undef sbrk
+
+#include <stdio.h>
+#include <time.h>
+
+#define SLOT_COUNT 512
+
+unsigned int test_critical_sections;
+char test_heap[TEST_HEAP_SIZE] __attribute__((__aligned__(8)));
+static char * brk_;
+
+void *
+test_sbrk (intptr_t increment)
+{
+  char * rv = brk_;
+
+  if ((0 > increment)
+      || ((test_heap + TEST_HEAP_SIZE - brk_) < increment)) {
+    return (void *)-1;
+  }
+  brk_ += increment;
+  return rv;
+}
+
+typedef struct sTraceEntry {
+  uint16_t slot;
+  uint16_t size;
+} sTraceEntry;
+
+/* Copied from examples/misc/malloc_trace/main.c */
+static const sTraceEntry packet_trace[] = {
+  { 0, 512 }, { 1, 64 }, { 2, 128 }, { 3, 40 }, { 4, 300 },
+  { 3, 0 }, { 5, 96 }, { 1, 0 }, { 6, 256 }, { 7, 24 },
+  { 2, 0 }, { 8, 180 }, { 4, 0 }, { 9, 12 }, { 10, 700 },
+  { 5, 0 }, { 7, 0 }, { 11, 48 }, { 12, 64 }, { 6, 400 },
+  { 9, 0 }, { 13, 1024 }, { 8, 0 }, { 14, 32 }, { 10, 0 },
+  { 11, 0 }, { 15, 256 }, { 12, 0 }, { 13, 0 }, { 14, 0 },
+  { 15, 0 }, { 6, 0 },
+};
+
+typedef struct sSlot {
+  unsigned char * ptr;
+  size_t size;
+  unsigned char tag;
+} sSlot;
+
+static sSlot slot[SLOT_COUNT];
+
+typedef struct sStats {
+  unsigned int ops;
+  unsigned int failures;
+  size_t peak_used;
+  unsigned int worst_frag_pct;
+  unsigned int worst_scan_blocks;
+  unsigned int worst_scan_sections;
+  unsigned long max_alloc_ns;
+  unsigned long max_free_ns;
+} sStats;
+
+static unsigned int errors;
+static unsigned int tag_counter;
+
+#define CHECK(cond_, ...) do {                  \
+    if (! (cond_)) {                            \
+      ++errors;                                 \
+      printf("FAIL %s:%d: ", __FILE__, __LINE__); \
+      printf(__VA_ARGS__);                      \
+      putchar('\n');                            \
+    }                                           \
+  } while (0)
+
+static void
+reset_heap (void)
+{
+  memset(&control_, 0, sizeof(control_));
+  memset(slot, 0, sizeof(slot));
+  brk_ = test_heap;
+}
+
+static unsigned long
+elapsed_ns (const struct timespec * t0)
+{
+  struct timespec t1;
+
+  clock_gettime(CLOCK_MONOTONIC, &t1);
+  return (t1.tv_sec - t0->tv_sec) * 1000000000UL + t1.tv_nsec - t0->tv_nsec;
+}
+
+static bool
+on_free_list (const sBlock * bp)
+{
+  unsigned int fl;
+  unsigned int sl;
+  const sBlock * lp;
+
+  mapping_insert(block_size(bp), &fl, &sl);
+  for (lp = control_.blocks[fl][sl]; lp; lp = lp->next_free) {
+    if (lp == bp) {
+      return true;
+    }
+  }
+  return false;
+}
+
+/* Walk the heap and free lists, verifying every invariant the
+ * allocator relies on.  Returns the size of the largest free
+ * block. */
+static size_t
+check_heap (void)
+{
+  sBlock * bp = control_.first;
+  sBlock * prev = 0;
+  bool prev_free = false;
+  size_t used = 0;
+  size_t free = 0;
+  size_t largest = 0;
+  unsigned int used_blocks = 0;
+  unsigned int free_blocks = 0;
+  unsigned int listed = 0;
+  unsigned int fl;
+  unsigned int sl;
+
+  if (! bp) {
+    return 0;
+  }
+  while (1) {
+    bool const is_free = BLOCK_FREE & bp->size;
+
+    CHECK(prev == bp->prev_phys, "block %p prev_phys %p not %p",
+          (void *)bp, (void *)bp->prev_phys, (void *)prev);
+    CHECK(0 == (block_size(bp) & (ALIGN_SIZE - 1)), "block %p size %zu misaligned",
+          (void *)bp, block_size(bp));
+    if (0 == block_size(bp)) {
+      CHECK(! is_free, "sentinel marked free");
+      break;
+    }
+    if (is_free) {
+      CHECK(! prev_free, "adjacent free blocks at %p", (void *)bp);
+      CHECK(on_free_list(bp), "free block %p not on its list", (void *)bp);
+      free += block_size(bp);
+      free_blocks += 1;
+      if (block_size(bp) > largest) {
+        largest = block_size(bp);
+      }
+    } else {
+      used += block_size(bp);
+      used_blocks += 1;
+    }
+    prev_free = is_free;
+    prev = bp;
+    bp = block_next(bp);
+    CHECK((char *)bp < test_heap + TEST_HEAP_SIZE, "block chain leaves heap");
+    if ((char *)bp >= test_heap + TEST_HEAP_SIZE) {
+      return largest;
+    }
+  }
+  CHECK((char *)bp + BLOCK_OVERHEAD == control_.heap_size + (char *)control_.first,
+        "sentinel not at end of heap");
+  CHECK(used == control_.used, "used %zu tracked %zu", used, control_.used);
+  CHECK(free == control_.free, "free %zu tracked %zu", free, control_.free);
+  CHECK(used_blocks == control_.used_blocks, "used blocks %u tracked %u",
+        used_blocks, control_.used_blocks);
+  CHECK(free_blocks == control_.free_blocks, "free blocks %u tracked %u",
+        free_blocks, control_.free_blocks);
+
+  for (fl = 0; fl < FL_COUNT; ++fl) {
+    bool any = false;
+    for (sl = 0; sl < SL_COUNT; ++sl) {
+      const sBlock * lp = control_.blocks[fl][sl];
+      bool const marked = control_.sl_bitmap[fl] & (1U << sl);
+
+      CHECK((NULL != lp) == marked, "sl bitmap %u/%u disagrees with list", fl, sl);
+      any |= (NULL != lp);
+      for (; lp; lp = lp->next_free) {
+        CHECK(BLOCK_FREE & lp->size, "allocated block %p on free list", (void *)lp);
+        ++listed;
+      }
+    }
+    CHECK(any == (0 != (control_.fl_bitmap & (1U << fl))),
+          "fl bitmap %u disagrees with lists", fl);
+  }
+  CHECK(listed == free_blocks, "%u blocks listed, %u free", listed, free_blocks);
+  return largest;
+}
+
+static void
+check_contents (unsigned int si)
+{
+  const sSlot * sp = slot + si;
+  size_t i;
+
+  for (i = 0; i < sp->size; ++i) {
+    if (sp->tag != sp->ptr[i]) {
+      CHECK(0, "slot %u corrupted at offset %zu", si, i);
+      return;
+    }
+  }
+}
+
+/* Record fragmentation and the cost of the statistics scan in the
+ * current heap state. */
+static void
+measure (sStats * sp)
+{
+  sBSPACMnewlibTLSFstatistics ts;
+  unsigned int const sections = test_critical_sections;
+  size_t const largest = check_heap();
+  unsigned int blocks = 0;
+
+  if (control_.fl_bitmap) {
+    unsigned int const fl = fls_(control_.fl_bitmap);
+    const sBlock * bp = control_.blocks[fl][fls_(control_.sl_bitmap[fl])];
+    for (; bp; bp = bp->next_free) {
+      ++blocks;
+    }
+  }
+  vBSPACMnewlibTLSFstatistics(&ts);
+  CHECK(largest == ts.largest_free, "largest free %zu reported %zu",
+        largest, ts.largest_free);
+  if (blocks > sp->worst_scan_blocks) {
+    sp->worst_scan_blocks = blocks;
+  }
+  if ((test_critical_sections - sections) > sp->worst_scan_sections) {
+    sp->worst_scan_sections = test_critical_sections - sections;
+  }
+  if (ts.used > sp->peak_used) {
+    sp->peak_used = ts.used;
+  }
+  if (ts.free) {
+    unsigned int const pct = 100 - (unsigned int)((100 * largest) / ts.free);
+    if (pct > sp->worst_frag_pct) {
+      sp->worst_frag_pct = pct;
+    }
+  }
+}
+
+static void
+apply (sStats * sp,
+       unsigned int si,
+       size_t size)
+{
+  sSlot * const ssp = slot + si;
+  struct timespec t0;
+  unsigned long dt;
+
+  sp->ops += 1;
+  if (ssp->ptr) {
+    check_contents(si);
+  }
+  if (0 == size) {
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    _bspacm_tlsf_free(ssp->ptr);
+    dt = elapsed_ns(&t0);
+    if (dt > sp->max_free_ns) {
+      sp->max_free_ns = dt;
+    }
+    ssp->ptr = 0;
+    ssp->size = 0;
+  } else {
+    unsigned char * p;
+    size_t keep = (size < ssp->size) ? size : ssp->size;
+    size_t i;
+
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    p = _bspacm_tlsf_realloc(ssp->ptr, size);
+    dt = elapsed_ns(&t0);
+    if (dt > sp->max_alloc_ns) {
+      sp->max_alloc_ns = dt;
+    }
+    if (p) {
+      for (i = 0; i < keep; ++i) {
+        if (ssp->tag != p[i]) {
+          CHECK(0, "realloc of slot %u lost content at offset %zu", si, i);
+          break;
+        }
+      }
+      ssp->ptr = p;
+      ssp->size = size;
+      ssp->tag = ++tag_counter;
+      memset(p, ssp->tag, size);
+    } else {
+      sp->failures += 1;
+    }
+  }
+  measure(sp);
+}
+
+static void
+release_all (sStats * sp)
+{
+  unsigned int si;
+
+  for (si = 0; si < SLOT_COUNT; ++si) {
+    if (slot[si].ptr) {
+      apply(sp, si, 0);
+    }
+  }
+  CHECK(0 == control_.used, "%zu octets still in use", control_.used);
+  CHECK(1 == control_.free_blocks, "%u free blocks after release", control_.free_blocks);
+}
+
+static void
+report (const char * tag,
+        const sStats * sp)
+{
+  printf("%s: %u ops, %u failed; peak used %zu of %zu\n",
+         tag, sp->ops, sp->failures, sp->peak_used, control_.heap_size);
+  printf("  worst fragmentation %u%%; worst search %u blocks in %u sections\n",
+         sp->worst_frag_pct, sp->worst_scan_blocks, sp->worst_scan_sections);
+  printf("  max host ns alloc %lu free %lu\n", sp->max_alloc_ns, sp->max_free_ns);
+}
+
+static void
+replay_packet (void)
+{
+  sStats stats;
+  unsigned int rep;
+  unsigned int i;
+
+  reset_heap();
+  memset(&stats, 0, sizeof(stats));
+  for (rep = 0; rep < 100; ++rep) {
+    for (i = 0; i < sizeof(packet_trace)/sizeof(*packet_trace); ++i) {
+      apply(&stats, packet_trace[i].slot, packet_trace[i].size);
+    }
+  }
+  release_all(&stats);
+  CHECK(0 == stats.failures, "packet trace had %u failures", stats.failures);
+  report("Packet trace", &stats);
+}
+
+/* Same generator and parameters as examples/misc/malloc_trace. */
+static void
+replay_random (void)
+{
+  sStats stats;
+  unsigned int i;
+  uint32_t lcg = 1;
+
+  reset_heap();
+  memset(&stats, 0, sizeof(stats));
+  for (i = 0; i < 20000; ++i) {
+    unsigned int si;
+    size_t size;
+
+    lcg = 1664525 * lcg + 1013904223;
+    si = (lcg >> 8) % 32;
+    size = (lcg >> 16) & 0x1FF;
+    if (slot[si].ptr && (lcg & 0x80000000)) {
+      size = 0;
+    }
+    apply(&stats, si, size);
+  }
+  release_all(&stats);
+  report("Random trace", &stats);
+}
+
+/* Fill the heap with minimum-sized blocks, then free every other one
+ * and reallocate them.  This puts the largest possible number of
+ * blocks on a single free list, which is the worst case for the
+ * statistics scan. */
+static void
+replay_checkerboard (void)
+{
+  sStats stats;
+  unsigned int si;
+  unsigned int n;
+
+  reset_heap();
+  memset(&stats, 0, sizeof(stats));
+  for (n = 0; n < SLOT_COUNT; ++n) {
+    apply(&stats, n, 1);
+    if (! slot[n].ptr) {
+      break;
+    }
+  }
+  for (si = 0; si < n; si += 2) {
+    apply(&stats, si, 0);
+  }
+  for (si = 0; si < n; si += 2) {
+    apply(&stats, si, 1);
+  }
+  release_all(&stats);
+  CHECK(stats.worst_scan_blocks >= (n / 2) - 1, "only %u blocks scanned of %u",
+        stats.worst_scan_blocks, n / 2);
+  report("Checkerboard trace", &stats);
+}
+
+int
+main (void)
+{
+  replay_packet();
+  replay_random();
+  replay_checkerboard();
+  if (errors) {
+    printf("%u errors\n", errors);
+    return 1;
+  }
+  printf("All checks passed\n");
+  return 0;
+}
@@ -0,0 +1,155 @@
+/* BSPACM - host stand-in for <bspacm/core.h> when testing TWI
+ *
+ * Written in 2014 by Peter A. Bigot <http://pabigot.github.io/bspacm/>
+ *
+ * To the extent possible under law, the author(s) have dedicated all
+ * copyright and related and neighboring rights to this software to
+ * the public domain worldwide. This software is distributed without
+ * any warranty.
+ *
+ * You should have received a copy of the CC0 Public Domain Dedication
+ * along with this software. If not, see
+ * <http://creativecommons.org/publicdomain/zero/1.0/>.
+ */
+
+/* Supplies only what the nRF51 TWI driver uses from the real core.h,
+ * the nRF51 device header, and <bspacm/device.h>.  Peripherals are
+ * plain structures the test reads and writes to simulate hardware.
+ * The interrupt mask is a variable so tests can observe it.  Busy
+ * waits and sleeps call hooks so the test can let simulated time
+ * pass. */
+
+#ifndef BSPACM_TEST_HOST_CORE_H
+#define BSPACM_TEST_HOST_CORE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#define BSPACM_CORE_INLINE inline
+#define BSPACM_CORE_INLINE_FORCED BSPACM_CORE_INLINE __attribute__((__always_inline__))
+
+/* Emulated PRIMASK */
+extern unsigned int test_primask;
+
+#define BSPACM_CORE_ENABLE_INTERRUPT() do { test_primask = 0; } while (0)
+#define BSPACM_CORE_DISABLE_INTERRUPT() do { test_primask = 1; } while (0)
+#define BSPACM_CORE_SAVED_INTERRUPT_STATE(var_) unsigned int const var_ = test_primask
+#define BSPACM_CORE_REENABLE_INTERRUPT(var_) do { \
+    if (! (1U & var_)) {                          \
+      BSPACM_CORE_ENABLE_INTERRUPT();             \
+    }                                             \
+  } while (0)
+
+/* Invoked by BSPACM_CORE_DELAY_US() with the requested delay. */
+extern void (* test_delay_hook) (unsigned int us);
+
+#define BSPACM_CORE_DELAY_US(us_) do {          \
+    if (test_delay_hook) {                      \
+      test_delay_hook(us_);                     \
+    }                                           \
+  } while (0)
+
+/* Invoked by __WFE(); null to return immediately. */
+extern void (* test_sleep_hook) (void);
+
+static inline void
+__WFE (void)
+{
+  if (test_sleep_hook) {
+    test_sleep_hook();
+  }
+}
+
+typedef int IRQn_Type;
+#define SPI0_TWI0_IRQn 3
+#define SPI1_TWI1_IRQn 4
+
+/* Count of enabled TWI interrupts, indexed by instance */
+extern unsigned int test_irq_enabled[2];
+
+static inline void
+vBSPACMnrf51_NVIC_EnableIRQ (IRQn_Type irqn)
+{
+  ++test_irq_enabled[SPI1_TWI1_IRQn == irqn];
+}
+
+#define vBSPACMnrf51NVICsetApplicationPriority(irqn_, high_) do { (void)(irqn_); (void)(high_); } while (0)
+
+typedef struct {
+  volatile uint32_t TASKS_STARTRX;
+  volatile uint32_t TASKS_STARTTX;
+  volatile uint32_t TASKS_STOP;
+  volatile uint32_t TASKS_SUSPEND;
+  volatile uint32_t TASKS_RESUME;
+  volatile uint32_t EVENTS_STOPPED;
+  volatile uint32_t EVENTS_RXDREADY;
+  volatile uint32_t EVENTS_TXDSENT;
+  volatile uint32_t EVENTS_ERROR;
+  volatile uint32_t EVENTS_BB;
+  volatile uint32_t SHORTS;
+  volatile uint32_t INTENSET;
+  volatile uint32_t INTENCLR;
+  volatile uint32_t ERRORSRC;
+  volatile uint32_t ENABLE;
+  volatile uint32_t PSELSCL;
+  volatile uint32_t PSELSDA;
+  volatile uint32_t RXD;
+  volatile uint32_t TXD;
+  volatile uint32_t FREQUENCY;
+  volatile uint32_t ADDRESS;
+  volatile uint32_t POWER;
+} NRF_TWI_Type;
+
+typedef struct {
+  volatile uint32_t OUTSET;
+  volatile uint32_t OUTCLR;
+  volatile uint32_t IN;
+  volatile uint32_t PIN_CNF[32];
+} NRF_GPIO_Type;
+
+typedef struct {
+  volatile uint32_t EEP;
+  volatile uint32_t TEP;
+} PPI_CH_Type;
+
+typedef struct {
+  volatile uint32_t CHEN;
+  volatile uint32_t CHENSET;
+  volatile uint32_t CHENCLR;
+  PPI_CH_Type CH[16];
+} NRF_PPI_Type;
+
+extern NRF_TWI_Type test_twi[2];
+extern NRF_GPIO_Type test_gpio;
+extern NRF_PPI_Type test_ppi;
+
+#define NRF_TWI0 (&test_twi[0])
+#define NRF_TWI1 (&test_twi[1])
+#define NRF_GPIO (&test_gpio)
+#define NRF_PPI (&test_ppi)
+
+/* Channel enables are applied immediately; the endpoints are read by
+ * the test's PPI emulation. */
+static inline void
+vBSPACMnrf51_PPI_CH (uint8_t channel_num,
+                     const volatile void * evt_endpoint,
+                     const volatile void * task_endpoint)
+{
+  NRF_PPI->CH[channel_num].EEP = (uintptr_t)evt_endpoint;
+  NRF_PPI->CH[channel_num].TEP = (uintptr_t)task_endpoint;
+}
+
+static inline void
+vBSPACMnrf51_PPI_CHENSET (uint32_t mask)
+{
+  NRF_PPI->CHEN |= mask;
+}
+
+static inline void
+vBSPACMnrf51_PPI_CHENCLR (uint32_t mask)
+{
+  NRF_PPI->CHEN &= ~mask;
+}
+
+#endif /* BSPACM_TEST_HOST_CORE_H */
@@ -0,0 +1,48 @@
+/* BSPACM - host stand-in for <bspacm/utility/hires.h> when testing TWI
+ *
+ * Written in 2014 by Peter A. Bigot <http://pabigot.github.io/bspacm/>
+ *
+ * To the extent possible under law, the author(s) have dedicated all
+ * copyright and related and neighboring rights to this software to
+ * the public domain worldwide. This software is distributed without
+ * any warranty.
+ *
+ * You should have received a copy of the CC0 Public Domain Dedication
+ * along with this software. If not, see
+ * <http://creativecommons.org/publicdomain/zero/1.0/>.
+ */
+
+/* The hires alarm API the TWI driver uses, with the timer at 1 MHz.
+ * The test implements it over simulated time and fires the alarms
+ * itself. */
+
+#ifndef BSPACM_TEST_HOST_UTILITY_HIRES_H
+#define BSPACM_TEST_HOST_UTILITY_HIRES_H
+
+#include <bspacm/core.h>
+
+struct sBSPACMhiresAlarm;
+
+typedef void (* vBSPACMhiresAlarmCallback_flih) (struct sBSPACMhiresAlarm * ap);
+
+typedef struct sBSPACMhiresAlarm {
+  vBSPACMhiresAlarmCallback_flih callback_flih;
+  unsigned long long when_hrt;
+  volatile bool scheduled_;
+} sBSPACMhiresAlarm;
+
+typedef sBSPACMhiresAlarm * hBSPACMhiresAlarm;
+
+unsigned long long ullBSPACMhires (void);
+bool bBSPACMhiresEnabled (void);
+int iBSPACMhiresAlarmSchedule (unsigned long long when_hrt,
+                               hBSPACMhiresAlarm ap);
+bool bBSPACMhiresAlarmCancel (hBSPACMhiresAlarm ap);
+
+static inline unsigned int
+uiBSPACMhiresConvert_us_hrt (unsigned int dur_us)
+{
+  return dur_us;
+}
+
+#endif /* BSPACM_TEST_HOST_UTILITY_HIRES_H */
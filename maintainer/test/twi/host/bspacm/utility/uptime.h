@@ -0,0 +1,51 @@
+/* BSPACM - host stand-in for <bspacm/utility/uptime.h> when testing TWI
+ *
+ * Written in 2014 by Peter A. Bigot <http://pabigot.github.io/bspacm/>
+ *
+ * To the extent possible under law, the author(s) have dedicated all
+ * copyright and related and neighboring rights to this software to
+ * the public domain worldwide. This software is distributed without
+ * any warranty.
+ *
+ * You should have received a copy of the CC0 Public Domain Dedication
+ * along with this software. If not, see
+ * <http://creativecommons.org/publicdomain/zero/1.0/>.
+ */
+
+/* The uptime alarm API the TWI driver uses.  The test implements it
+ * over simulated time and fires the alarms itself. */
+
+#ifndef BSPACM_TEST_HOST_UTILITY_UPTIME_H
+#define BSPACM_TEST_HOST_UTILITY_UPTIME_H
+
+#include <bspacm/core.h>
+
+#define BSPACM_UPTIME_Hz 32768U
+#define BSPACM_UPTIME_TIMER_CCIDX 3
+
+struct sBSPACMuptimeAlarm;
+
+typedef void (* vBSPACMuptimeAlarmCallback_flih) (int ccidx,
+                                                  struct sBSPACMuptimeAlarm * ap);
+
+typedef struct sBSPACMuptimeAlarm {
+  vBSPACMuptimeAlarmCallback_flih callback_flih;
+  unsigned int when_utt;
+  volatile bool scheduled_;
+} sBSPACMuptimeAlarm;
+
+typedef sBSPACMuptimeAlarm * hBSPACMuptimeAlarm;
+
+unsigned int uiBSPACMuptime (void);
+bool bBSPACMuptimeEnabled (void);
+int iBSPACMuptimeAlarmSchedule (unsigned int when_utt,
+                                hBSPACMuptimeAlarm ap);
+bool bBSPACMuptimeAlarmCancel (hBSPACMuptimeAlarm ap);
+
+static inline unsigned int
+uiBSPACMuptimeConvert_us_utt (unsigned int dur_us)
+{
+  return ((unsigned long long)dur_us * BSPACM_UPTIME_Hz + 999999) / 1000000;
+}
+
+#endif /* BSPACM_TEST_HOST_UTILITY_UPTIME_H */
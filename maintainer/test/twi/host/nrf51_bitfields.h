@@ -0,0 +1,57 @@
+/* BSPACM - host stand-in for the nRF51 register field definitions
+ *
+ * Written in 2014 by Peter A. Bigot <http://pabigot.github.io/bspacm/>
+ *
+ * To the extent possible under law, the author(s) have dedicated all
+ * copyright and related and neighboring rights to this software to
+ * the public domain worldwide. This software is distributed without
+ * any warranty.
+ *
+ * You should have received a copy of the CC0 Public Domain Dedication
+ * along with this software. If not, see
+ * <http://creativecommons.org/publicdomain/zero/1.0/>.
+ */
+
+/* Only the fields the TWI driver uses, with the values from the nRF51
+ * reference manual. */
+
+#ifndef BSPACM_TEST_HOST_NRF51_BITFIELDS_H
+#define BSPACM_TEST_HOST_NRF51_BITFIELDS_H
+
+#define TWI_SHORTS_BB_SUSPEND_Pos 0
+#define TWI_SHORTS_BB_SUSPEND_Enabled 1
+#define TWI_SHORTS_BB_STOP_Pos 1
+#define TWI_SHORTS_BB_STOP_Enabled 1
+
+#define TWI_INTENSET_STOPPED_Msk (1UL << 1)
+#define TWI_INTENSET_RXDREADY_Msk (1UL << 2)
+#define TWI_INTENSET_TXDSENT_Msk (1UL << 7)
+#define TWI_INTENSET_ERROR_Msk (1UL << 9)
+
+#define TWI_ERRORSRC_OVERRUN_Msk (1UL << 0)
+#define TWI_ERRORSRC_ANACK_Msk (1UL << 1)
+#define TWI_ERRORSRC_DNACK_Msk (1UL << 2)
+
+#define TWI_ENABLE_ENABLE_Pos 0
+#define TWI_ENABLE_ENABLE_Disabled 0
+#define TWI_ENABLE_ENABLE_Enabled 5
+
+#define TWI_FREQUENCY_FREQUENCY_K100 0x01980000UL
+#define TWI_FREQUENCY_FREQUENCY_K250 0x04000000UL
+#define TWI_FREQUENCY_FREQUENCY_K400 0x06680000UL
+
+#define GPIO_PIN_CNF_DIR_Pos 0
+#define GPIO_PIN_CNF_DIR_Output 1
+#define GPIO_PIN_CNF_INPUT_Pos 1
+#define GPIO_PIN_CNF_INPUT_Connect 0
+#define GPIO_PIN_CNF_PULL_Pos 2
+#define GPIO_PIN_CNF_PULL_Pullup 3
+#define GPIO_PIN_CNF_DRIVE_Pos 8
+#define GPIO_PIN_CNF_DRIVE_S0D1 6
+#define GPIO_PIN_CNF_SENSE_Pos 16
+#define GPIO_PIN_CNF_SENSE_Disabled 0
+
+#define PPI_CHENSET_CH0_Msk (1UL << 0)
+#define PPI_CHENCLR_CH0_Msk (1UL << 0)
+
+#endif /* BSPACM_TEST_HOST_NRF51_BITFIELDS_H */
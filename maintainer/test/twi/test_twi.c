@@ -0,0 +1,826 @@
+/* BSPACM - host test of the nRF51 TWI (I2C) driver
+ *
+ * Written in 2014 by Peter A. Bigot <http://pabigot.github.io/bspacm/>
+ *
+ * To the extent possible under law, the author(s) have dedicated all
+ * copyright and related and neighboring rights to this software to
+ * the public domain worldwide. This software is distributed without
+ * any warranty.
+ *
+ * You should have received a copy of the CC0 Public Domain Dedication
+ * along with this software. If not, see
+ * <http://creativecommons.org/publicdomain/zero/1.0/>.
+ */
+
+/* Builds twi.c against a simulated TWI peripheral, follower device,
+ * GPIO port, and PPI, with the uptime and hires alarms fired by the
+ * test from simulated time.  Checks configuration and enable, write,
+ * read, and combined transactions, the transaction queue including
+ * resubmission from a callback, that the per-byte timeout is pushed
+ * back by progress, that reads are suspended at each byte and resumed
+ * no sooner than PAN #56 requires, that address NACK and a stalled
+ * follower are recovered without busy-waiting in a handler (power
+ * cycling the peripheral on timeout when PAN #56 is applied), that a
+ * bus held low is clocked free or reported, and the blocking
+ * wrappers.  Built once with the PAN workarounds and once without. */
+
+#include "twi.c"
+#include <stdio.h>
+
+unsigned int test_primask;
+void (* test_delay_hook) (unsigned int us);
+void (* test_sleep_hook) (void);
+unsigned int test_irq_enabled[2];
+NRF_TWI_Type test_twi[2];
+NRF_GPIO_Type test_gpio;
+NRF_PPI_Type test_ppi;
+sBSPACMeventGroup xBSPACMeventSystem;
+
+static unsigned int failures;
+
+#define CHECK(cond_, ...) do {                  \
+    if (! (cond_)) {                            \
+      ++failures;                               \
+      printf("FAIL %s:%d: ", __FILE__, __LINE__); \
+      printf(__VA_ARGS__);                      \
+      putchar('\n');                            \
+    }                                           \
+  } while (0)
+
+#define SDA_PIN 13
+#define SCL_PIN 12
+#define PPI_CHIDX 7
+#define FOLLOWER_ADDR 0x40
+
+/* Time to transfer one byte at 100 kHz, and to issue a stop */
+#define BYTE_US 90
+#define STOP_US 10
+
+#define TXD_UNWRITTEN 0xFFFFFFFFU
+
+static unsigned long long now_us;
+static unsigned int task_posts;
+static unsigned int handler_delays;
+static bool in_handler;
+
+/* Simulated time sources */
+
+unsigned int
+uiBSPACMuptime (void)
+{
+  return (now_us * BSPACM_UPTIME_Hz) / 1000000;
+}
+
+bool
+bBSPACMuptimeEnabled (void)
+{
+  return true;
+}
+
+unsigned long long
+ullBSPACMhires (void)
+{
+  return now_us;
+}
+
+bool
+bBSPACMhiresEnabled (void)
+{
+  return true;
+}
+
+int
+iBSPACMtaskPost (hBSPACMtask tp)
+{
+  ++task_posts;
+  return 1;
+}
+
+/* Alarms are kept in small registries and fired by run_step(). */
+
+#define MAX_ALARMS 4
+static hBSPACMuptimeAlarm uptime_alarms[MAX_ALARMS];
+static hBSPACMhiresAlarm hires_alarms[MAX_ALARMS];
+
+int
+iBSPACMuptimeAlarmSchedule (unsigned int when_utt,
+                            hBSPACMuptimeAlarm ap)
+{
+  unsigned int i;
+
+  if (ap->scheduled_) {
+    return -1;
+  }
+  for (i = 0; (i < MAX_ALARMS) && uptime_alarms[i] && (ap != uptime_alarms[i]); ++i) {
+  }
+  CHECK(i < MAX_ALARMS, "too many uptime alarms");
+  uptime_alarms[i] = ap;
+  ap->when_utt = when_utt;
+  ap->scheduled_ = true;
+  return 0;
+}
+
+bool
+bBSPACMuptimeAlarmCancel (hBSPACMuptimeAlarm ap)
+{
+  bool const rv = ap->scheduled_;
+
+  ap->scheduled_ = false;
+  return rv;
+}
+
+int
+iBSPACMhiresAlarmSchedule (unsigned long long when_hrt,
+                           hBSPACMhiresAlarm ap)
+{
+  unsigned int i;
+
+  if (ap->scheduled_) {
+    return -1;
+  }
+  for (i = 0; (i < MAX_ALARMS) && hires_alarms[i] && (ap != hires_alarms[i]); ++i) {
+  }
+  CHECK(i < MAX_ALARMS, "too many hires alarms");
+  hires_alarms[i] = ap;
+  ap->when_hrt = when_hrt;
+  ap->scheduled_ = true;
+  return 0;
+}
+
+bool
+bBSPACMhiresAlarmCancel (hBSPACMhiresAlarm ap)
+{
+  bool const rv = ap->scheduled_;
+
+  ap->scheduled_ = false;
+  return rv;
+}
+
+/* GPIO and the follower's hold on SDA.  Writes to OUTSET and OUTCLR
+ * are applied when the test next looks at the port, which is after
+ * every busy-wait and every handler, so each write is seen
+ * separately. */
+
+static uint32_t gpio_out = ~0U;
+static unsigned int sda_hold_edges;  /* SCL rising edges until release; 0 if not held */
+static unsigned int scl_rising;
+
+static void
+gpio_latch (void)
+{
+  uint32_t const scl_bit = 1U << SCL_PIN;
+  uint32_t const prev = gpio_out;
+
+  gpio_out &= ~test_gpio.OUTCLR;
+  test_gpio.OUTCLR = 0;
+  gpio_out |= test_gpio.OUTSET;
+  test_gpio.OUTSET = 0;
+  if ((scl_bit & gpio_out) && ! (scl_bit & prev)) {
+    ++scl_rising;
+    if (sda_hold_edges && (0 == --sda_hold_edges)) {
+      /* Released */
+    }
+  }
+  test_gpio.IN = gpio_out & ~(sda_hold_edges ? (1U << SDA_PIN) : 0);
+}
+
+static void
+delay_hook (unsigned int us)
+{
+  if (in_handler) {
+    ++handler_delays;
+  }
+  gpio_latch();
+  now_us += us;
+}
+
+/* The TWI peripheral and follower device */
+
+enum {
+  TWI_IDLE,
+  TWI_TX,                       /* byte in flight */
+  TWI_TX_WAIT,                  /* waiting for TXD, STARTRX, or STOP */
+  TWI_RX,                       /* byte in flight */
+  TWI_SUSPENDED,
+  TWI_STOPPING,
+  TWI_STALLED,
+};
+
+static NRF_TWI_Type * const twi = NRF_TWI0;
+static hBSPACMi2cBus twi_bus_under_test;
+static unsigned int twi_state;
+static unsigned long long twi_due_us;
+static uint32_t twi_inten;
+static uint32_t twi_last_power = 1;
+static unsigned int power_cycles;
+
+/* Follower behavior.  Each misbehavior happens once. */
+static unsigned int nack_count;       /* address NACKs to give */
+static int stall_after_bytes = -1;    /* bytes before it stops responding */
+static unsigned int hold_on_stall;    /* sda_hold_edges to apply on stall */
+static unsigned int bytes_moved;
+static uint8_t tx_log[64];
+static unsigned int tx_log_len;
+static uint8_t rx_next;
+
+/* Read timing checks */
+static unsigned long long rxdready_us;
+static unsigned int early_resumes;
+static unsigned int unsuspended_reads;
+
+static void
+twi_reset_model (void)
+{
+  twi_state = TWI_IDLE;
+  twi_inten = 0;
+  nack_count = 0;
+  stall_after_bytes = -1;
+  hold_on_stall = 0;
+  bytes_moved = 0;
+  tx_log_len = 0;
+  rx_next = 0xA0;
+  early_resumes = 0;
+  unsuspended_reads = 0;
+}
+
+static void
+twi_begin_byte (unsigned int state)
+{
+  if ((0 <= stall_after_bytes) && (bytes_moved >= (unsigned int)stall_after_bytes)) {
+    stall_after_bytes = -1;
+    sda_hold_edges = hold_on_stall;
+    twi_state = TWI_STALLED;
+    return;
+  }
+  twi_state = state;
+  twi_due_us = now_us + BYTE_US;
+}
+
+static bool
+ppi_routes_bb_to (const volatile uint32_t * task)
+{
+#if (BSPACM_NRF_APPLY_PAN_36 - 0)
+  /* The endpoint registers hold only the low 32 bits of a host
+   * pointer. */
+  return (NRF_PPI->CHEN & (1U << PPI_CHIDX))
+    && (NRF_PPI->CH[PPI_CHIDX].EEP == (uint32_t)(uintptr_t)&twi->EVENTS_BB)
+    && (NRF_PPI->CH[PPI_CHIDX].TEP == (uint32_t)(uintptr_t)task);
+#else /* BSPACM_NRF_APPLY_PAN_36 */
+  if (&twi->TASKS_SUSPEND == task) {
+    return twi->SHORTS & (TWI_SHORTS_BB_SUSPEND_Enabled << TWI_SHORTS_BB_SUSPEND_Pos);
+  }
+  return twi->SHORTS & (TWI_SHORTS_BB_STOP_Enabled << TWI_SHORTS_BB_STOP_Pos);
+#endif /* BSPACM_NRF_APPLY_PAN_36 */
+}
+
+/* React to task and register writes made by the driver. */
+static void
+twi_poll (void)
+{
+  /* The driver never enables interrupts and then disables them in
+   * the same pass, but does disable then re-enable them when it
+   * finishes one transaction and starts the next. */
+  twi_inten &= ~twi->INTENCLR;
+  twi->INTENCLR = 0;
+  twi_inten |= twi->INTENSET;
+  twi->INTENSET = 0;
+  if (twi_last_power && ! twi->POWER) {
+    ++power_cycles;
+    twi->PSELSCL = twi->PSELSDA = twi->FREQUENCY = 0;
+    twi_state = TWI_IDLE;
+  }
+  twi_last_power = twi->POWER;
+  if (twi->TASKS_STOP) {
+    twi->TASKS_STOP = 0;
+    twi_state = TWI_STOPPING;
+    twi_due_us = now_us + STOP_US;
+  }
+  if (twi->TASKS_STARTTX) {
+    twi->TASKS_STARTTX = 0;
+    CHECK(FOLLOWER_ADDR == twi->ADDRESS, "address %x", twi->ADDRESS);
+    twi_begin_byte(TWI_TX);
+  }
+  if (twi->TASKS_STARTRX) {
+    twi->TASKS_STARTRX = 0;
+    twi_begin_byte(TWI_RX);
+  }
+  if (twi->TASKS_RESUME) {
+    twi->TASKS_RESUME = 0;
+    if (TWI_SUSPENDED == twi_state) {
+#if (BSPACM_NRF_APPLY_PAN_56 - 0)
+      if ((now_us - rxdready_us) < twi_bus_under_test->resume_delay_us) {
+        ++early_resumes;
+      }
+#endif /* BSPACM_NRF_APPLY_PAN_56 */
+      twi_begin_byte(TWI_RX);
+    }
+  }
+  if ((TWI_TX_WAIT == twi_state) && (TXD_UNWRITTEN != twi->TXD)) {
+    twi_begin_byte(TWI_TX);
+  }
+}
+
+static bool
+twi_busy (void)
+{
+  return (TWI_TX == twi_state) || (TWI_RX == twi_state) || (TWI_STOPPING == twi_state);
+}
+
+/* Complete the operation in flight and raise its events. */
+static void
+twi_complete (void)
+{
+  switch (twi_state) {
+    case TWI_TX:
+      if (nack_count) {
+        --nack_count;
+        twi->ERRORSRC = TWI_ERRORSRC_ANACK_Msk;
+        twi->EVENTS_ERROR = 1;
+        twi_state = TWI_TX_WAIT;
+        twi->TXD = TXD_UNWRITTEN;
+        break;
+      }
+      ++bytes_moved;
+      if (tx_log_len < sizeof(tx_log)) {
+        tx_log[tx_log_len++] = twi->TXD;
+      }
+      twi->TXD = TXD_UNWRITTEN;
+      twi->EVENTS_TXDSENT = 1;
+      twi_state = TWI_TX_WAIT;
+      break;
+    case TWI_RX:
+      ++bytes_moved;
+      twi->EVENTS_BB = 1;
+      if (ppi_routes_bb_to(&twi->TASKS_STOP)) {
+        twi_state = TWI_STOPPING;
+        twi_due_us = now_us + STOP_US;
+      } else if (ppi_routes_bb_to(&twi->TASKS_SUSPEND)) {
+        twi_state = TWI_SUSPENDED;
+      } else {
+        ++unsuspended_reads;
+        twi_state = TWI_SUSPENDED;
+      }
+      twi->EVENTS_BB = 0;
+      twi->RXD = rx_next++;
+      twi->EVENTS_RXDREADY = 1;
+      rxdready_us = now_us;
+      break;
+    case TWI_STOPPING:
+      twi->EVENTS_STOPPED = 1;
+      twi_state = TWI_IDLE;
+      break;
+  }
+}
+
+static void
+twi_irq (void)
+{
+  uint32_t pending = 0;
+
+  if (twi->EVENTS_STOPPED) {
+    pending |= TWI_INTENSET_STOPPED_Msk;
+  }
+  if (twi->EVENTS_RXDREADY) {
+    pending |= TWI_INTENSET_RXDREADY_Msk;
+  }
+  if (twi->EVENTS_TXDSENT) {
+    pending |= TWI_INTENSET_TXDSENT_Msk;
+  }
+  if (twi->EVENTS_ERROR) {
+    pending |= TWI_INTENSET_ERROR_Msk;
+  }
+  if (pending & twi_inten) {
+    CHECK(0 == test_primask, "TWI interrupt taken with interrupts disabled");
+    in_handler = true;
+    SPI0_TWI0_IRQHandler();
+    in_handler = false;
+  }
+}
+
+static unsigned long long
+utt_to_us (unsigned int utt)
+{
+  return ((unsigned long long)utt * 1000000 + BSPACM_UPTIME_Hz - 1) / BSPACM_UPTIME_Hz;
+}
+
+/* Advance to the next thing that happens and do it.  Returns false if
+ * nothing is pending. */
+static bool
+run_step (void)
+{
+  unsigned long long next = ~0ULL;
+  hBSPACMuptimeAlarm uap = NULL;
+  hBSPACMhiresAlarm hap = NULL;
+  bool twi_next = false;
+  unsigned int i;
+
+  twi_poll();
+  gpio_latch();
+  if (twi_busy()) {
+    next = twi_due_us;
+    twi_next = true;
+  }
+  for (i = 0; i < MAX_ALARMS; ++i) {
+    hBSPACMuptimeAlarm const ap = uptime_alarms[i];
+
+    if (ap && ap->scheduled_ && (utt_to_us(ap->when_utt) < next)) {
+      next = utt_to_us(ap->when_utt);
+      uap = ap;
+      twi_next = false;
+    }
+  }
+  for (i = 0; i < MAX_ALARMS; ++i) {
+    hBSPACMhiresAlarm const ap = hires_alarms[i];
+
+    if (ap && ap->scheduled_ && (ap->when_hrt < next)) {
+      next = ap->when_hrt;
+      hap = ap;
+      uap = NULL;
+      twi_next = false;
+    }
+  }
+  if (~0ULL == next) {
+    return false;
+  }
+  if (now_us < next) {
+    now_us = next;
+  }
+  in_handler = true;
+  if (twi_next) {
+    in_handler = false;
+    twi_complete();
+    twi_irq();
+  } else if (hap) {
+    hap->scheduled_ = false;
+    hap->callback_flih(hap);
+  } else {
+    uap->scheduled_ = false;
+    uap->callback_flih(BSPACM_UPTIME_TIMER_CCIDX, uap);
+  }
+  in_handler = false;
+  twi_poll();
+  gpio_latch();
+  return true;
+}
+
+static void
+run_until_idle (void)
+{
+  unsigned int steps = 0;
+
+  while (run_step()) {
+    if (100000 < ++steps) {
+      CHECK(0, "simulation did not settle");
+      break;
+    }
+  }
+}
+
+static void
+sleep_hook (void)
+{
+  CHECK(run_step(), "sleeping with nothing pending");
+}
+
+/* Transactions */
+
+typedef struct sTestXact {
+  sBSPACMi2cTransaction xact;
+  unsigned int completions;
+  unsigned int resubmits;
+  uint8_t rx[32];
+} sTestXact;
+
+static hBSPACMi2cTransaction order[8];
+static unsigned int order_len;
+
+static void
+xact_callback (hBSPACMi2cTransaction xp)
+{
+  sTestXact * const txp = (sTestXact *)xp;
+
+  CHECK(xp->completed, "callback before completion");
+  ++txp->completions;
+  if (order_len < (sizeof(order) / sizeof(*order))) {
+    order[order_len++] = xp;
+  }
+  if (txp->resubmits) {
+    --txp->resubmits;
+    CHECK(0 == iBSPACMi2cSubmit(twi_bus_under_test, xp), "resubmit from callback");
+  }
+}
+
+static const uint8_t tx_data[24] = {
+  0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08,
+  0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f, 0x10,
+  0x11, 0x12, 0x13, 0x14, 0x15, 0x16, 0x17, 0x18,
+};
+
+static void
+xact_init (sTestXact * txp,
+           size_t tx_len,
+           size_t rx_len)
+{
+  memset(txp, 0, sizeof(*txp));
+  txp->xact.callback_flih = xact_callback;
+  txp->xact.addr = FOLLOWER_ADDR;
+  txp->xact.tx = tx_data;
+  txp->xact.tx_len = tx_len;
+  txp->xact.rx = txp->rx;
+  txp->xact.rx_len = rx_len;
+}
+
+static bool
+rx_matches (const sTestXact * txp,
+            uint8_t first)
+{
+  size_t i;
+
+  for (i = 0; i < txp->xact.rx_len; ++i) {
+    if ((uint8_t)(first + i) != txp->rx[i]) {
+      return false;
+    }
+  }
+  return true;
+}
+
+static sBSPACMi2cBus bus;
+
+static hBSPACMi2cBus
+configure (unsigned int timeout_us)
+{
+  return hBSPACMi2cConfigureBus(&bus, NRF_TWI0, SDA_PIN, SCL_PIN,
+#if (BSPACM_NRF_APPLY_PAN_36 - 0)
+                                PPI_CHIDX,
+#else /* BSPACM_NRF_APPLY_PAN_36 */
+                                -1,
+#endif /* BSPACM_NRF_APPLY_PAN_36 */
+                                TWI_FREQUENCY_FREQUENCY_K100, timeout_us);
+}
+
+static void
+reset (void)
+{
+  memset(test_twi, 0, sizeof(test_twi));
+  memset(&test_ppi, 0, sizeof(test_ppi));
+  memset(uptime_alarms, 0, sizeof(uptime_alarms));
+  memset(hires_alarms, 0, sizeof(hires_alarms));
+  test_twi[0].POWER = 1;
+  twi_last_power = 1;
+  test_twi[0].TXD = TXD_UNWRITTEN;
+  gpio_out = ~0U;
+  sda_hold_edges = 0;
+  scl_rising = 0;
+  power_cycles = 0;
+  handler_delays = 0;
+  task_posts = 0;
+  order_len = 0;
+  xBSPACMeventSystem.flags = 0;
+  twi_reset_model();
+  gpio_latch();
+}
+
+static void
+test_configure (void)
+{
+  sBSPACMi2cBus b;
+
+  reset();
+  CHECK(NULL == hBSPACMi2cConfigureBus(NULL, NRF_TWI0, SDA_PIN, SCL_PIN, -1, 0, 0), "null bus");
+  CHECK(NULL == hBSPACMi2cConfigureBus(&b, NRF_TWI0, 32, SCL_PIN, -1, 0, 0), "bad SDA");
+  CHECK(NULL == hBSPACMi2cConfigureBus(&b, NRF_TWI0, SDA_PIN, -1, -1, 0, 0), "bad SCL");
+  CHECK(NULL == hBSPACMi2cConfigureBus(&b, NRF_TWI0, SDA_PIN, SCL_PIN, 16, 0, 0), "bad PPI channel");
+#if (BSPACM_NRF_APPLY_PAN_36 - 0)
+  CHECK(NULL == hBSPACMi2cConfigureBus(&b, NRF_TWI0, SDA_PIN, SCL_PIN, -1, 0, 0), "PAN 36 without PPI");
+#else /* BSPACM_NRF_APPLY_PAN_36 */
+  CHECK(NULL == hBSPACMi2cConfigureBus(&b, NRF_TWI0, SDA_PIN, SCL_PIN, 3, 0, 0), "PPI without PAN 36");
+#endif /* BSPACM_NRF_APPLY_PAN_36 */
+  twi_bus_under_test = configure(1);
+  CHECK(&bus == twi_bus_under_test, "configure failed");
+  CHECK(uiBSPACMuptimeConvert_us_utt(BSPACM_I2C_MINIMUM_BUS_TIMEOUT_us) == bus.timeout_utt,
+        "timeout not raised to minimum: %u", bus.timeout_utt);
+#if (BSPACM_NRF_APPLY_PAN_56 - 0)
+  CHECK(20 == bus.resume_delay_us, "resume delay %u at 100 kHz", bus.resume_delay_us);
+#endif /* BSPACM_NRF_APPLY_PAN_56 */
+}
+
+static void
+test_enable (void)
+{
+  reset();
+  twi_bus_under_test = configure(0);
+  test_irq_enabled[0] = 0;
+  CHECK(0 == iBSPACMi2cSetEnabled(&bus, true), "enable idle bus");
+  CHECK((TWI_ENABLE_ENABLE_Enabled << TWI_ENABLE_ENABLE_Pos) == twi->ENABLE, "not enabled");
+  CHECK((SCL_PIN == twi->PSELSCL) && (SDA_PIN == twi->PSELSDA)
+        && (TWI_FREQUENCY_FREQUENCY_K100 == twi->FREQUENCY), "peripheral not configured");
+  CHECK(1 == test_irq_enabled[0], "interrupt not enabled");
+  CHECK(0 == scl_rising, "idle bus clocked");
+
+  /* A follower holding SDA is clocked free. */
+  reset();
+  sda_hold_edges = 5;
+  gpio_latch();
+  CHECK(0 == iBSPACMi2cSetEnabled(&bus, true), "enable held bus");
+  CHECK((TWI_ENABLE_ENABLE_Enabled << TWI_ENABLE_ENABLE_Pos) == twi->ENABLE, "not enabled");
+  CHECK(TWI_RECOVERY_TOGGLES / 2 == scl_rising, "%u SCL cycles", scl_rising);
+
+  /* One that never lets go is reported, and the bus left disabled. */
+  reset();
+  sda_hold_edges = ~0U;
+  gpio_latch();
+  CHECK(- BSPACM_NRF_TWI_BUS_ERROR_CLEAR_FAILED == iBSPACMi2cSetEnabled(&bus, true),
+        "stuck bus enabled");
+  CHECK((TWI_ENABLE_ENABLE_Enabled << TWI_ENABLE_ENABLE_Pos) != twi->ENABLE, "stuck bus enabled");
+  {
+    sTestXact t;
+
+    xact_init(&t, 1, 0);
+    CHECK(0 > iBSPACMi2cSubmit(&bus, &t.xact), "submit to disabled bus");
+  }
+}
+
+static void
+enable (void)
+{
+  reset();
+  twi_bus_under_test = configure(0);
+  CHECK(0 == iBSPACMi2cSetEnabled(&bus, true), "enable");
+}
+
+static void
+test_transactions (void)
+{
+  sTestXact w;
+  sTestXact r;
+  sTestXact wr;
+  sTestXact r1;
+
+  enable();
+  xact_init(&w, 3, 0);
+  xact_init(&r, 0, 4);
+  xact_init(&wr, 2, 3);
+  xact_init(&r1, 0, 1);
+  CHECK(0 == iBSPACMi2cSubmit(&bus, &w.xact), "submit write");
+  CHECK(0 == test_primask, "submit left interrupts disabled");
+  CHECK(0 > iBSPACMi2cSubmit(&bus, &w.xact), "duplicate submit accepted");
+  CHECK(0 == iBSPACMi2cSubmit(&bus, &r.xact), "submit read");
+  CHECK(0 == iBSPACMi2cSubmit(&bus, &wr.xact), "submit write-read");
+  CHECK(0 == iBSPACMi2cSubmit(&bus, &r1.xact), "submit single read");
+  CHECK(0 > iBSPACMi2cSubmit(&bus, &r1.xact), "duplicate tail submit accepted");
+  run_until_idle();
+  CHECK((4 == order_len) && (&w.xact == order[0]) && (&r.xact == order[1])
+        && (&wr.xact == order[2]) && (&r1.xact == order[3]), "completion order");
+  CHECK(3 == w.xact.result, "write result %d", w.xact.result);
+  CHECK(4 == r.xact.result, "read result %d", r.xact.result);
+  CHECK(5 == wr.xact.result, "write-read result %d", wr.xact.result);
+  CHECK(1 == r1.xact.result, "single read result %d", r1.xact.result);
+  CHECK((5 == tx_log_len) && (0 == memcmp(tx_log, tx_data, 3))
+        && (0 == memcmp(tx_log + 3, tx_data, 2)), "bytes written");
+  CHECK(rx_matches(&r, 0xA0) && rx_matches(&wr, 0xA4) && rx_matches(&r1, 0xA7), "bytes read");
+  CHECK(0 == unsuspended_reads, "%u reads not suspended at the byte boundary", unsuspended_reads);
+  CHECK(0 == early_resumes, "%u resumes before the PAN 56 delay", early_resumes);
+  CHECK(0 == handler_delays, "%u busy-waits in handlers", handler_delays);
+  CHECK(0 == power_cycles, "power cycled");
+  CHECK(BSPACM_EVENT_I2C & xBSPACMeventSystem.flags, "event not posted");
+  CHECK(TWI_IDLE == twi_state, "bus not stopped");
+  CHECK(0 == twi_inten, "interrupts left enabled");
+
+  /* Resubmission from the callback, and task posting */
+  enable();
+  xact_init(&w, 1, 0);
+  w.resubmits = 2;
+  w.xact.task = (hBSPACMtask)&w;
+  CHECK(0 == iBSPACMi2cSubmit(&bus, &w.xact), "submit");
+  run_until_idle();
+  CHECK(3 == w.completions, "%u completions", w.completions);
+  CHECK(3 == task_posts, "%u task posts", task_posts);
+  CHECK(1 == w.xact.result, "result %d", w.xact.result);
+
+  /* Progress pushes the per-byte timeout back, so a transfer much
+   * longer than the timeout completes. */
+  enable();
+  xact_init(&w, sizeof(tx_data), 0);
+  xact_init(&r, 0, sizeof(r.rx));
+  CHECK((sizeof(tx_data) * BYTE_US) > (10 * BSPACM_I2C_MINIMUM_BUS_TIMEOUT_us), "test too short");
+  CHECK(0 == iBSPACMi2cSubmit(&bus, &w.xact), "submit long write");
+  CHECK(0 == iBSPACMi2cSubmit(&bus, &r.xact), "submit long read");
+  run_until_idle();
+  CHECK(sizeof(tx_data) == w.xact.result, "long write result %d", w.xact.result);
+  CHECK(sizeof(r.rx) == r.xact.result, "long read result %d", r.xact.result);
+  CHECK(rx_matches(&r, 0xA0), "long read data");
+  CHECK(0 == early_resumes, "%u resumes before the PAN 56 delay", early_resumes);
+}
+
+static void
+test_errors (void)
+{
+  sTestXact a;
+  sTestXact b;
+
+  /* Address NACK: recovered, and the next transaction proceeds. */
+  enable();
+  nack_count = 1;
+  xact_init(&a, 2, 0);
+  xact_init(&b, 1, 2);
+  CHECK(0 == iBSPACMi2cSubmit(&bus, &a.xact), "submit");
+  CHECK(0 == iBSPACMi2cSubmit(&bus, &b.xact), "submit");
+  run_until_idle();
+  CHECK(- (int)TWI_ERRORSRC_ANACK_Msk == a.xact.result, "NACK result %d", a.xact.result);
+  CHECK(3 == b.xact.result, "after NACK result %d", b.xact.result);
+  CHECK(0 == power_cycles, "NACK power cycled");
+  CHECK(0 == handler_delays, "%u busy-waits in handlers", handler_delays);
+  CHECK(0 == bus.recovery_step_, "recovery not finished");
+
+  /* A follower that stops responding mid-read times out. */
+  enable();
+  stall_after_bytes = 3;
+  xact_init(&a, 1, 4);
+  xact_init(&b, 2, 0);
+  CHECK(0 == iBSPACMi2cSubmit(&bus, &a.xact), "submit");
+  CHECK(0 == iBSPACMi2cSubmit(&bus, &b.xact), "submit");
+  run_until_idle();
+  CHECK(- BSPACM_NRF_TWI_BUS_ERROR_TIMEOUT == a.xact.result, "stall result %d", a.xact.result);
+  CHECK(2 == b.xact.result, "after stall result %d", b.xact.result);
+  CHECK((BSPACM_NRF_APPLY_PAN_56 - 0) == power_cycles, "%u power cycles", power_cycles);
+  CHECK((SCL_PIN == twi->PSELSCL) && (TWI_FREQUENCY_FREQUENCY_K100 == twi->FREQUENCY),
+        "peripheral not reconfigured");
+  CHECK(0 == handler_delays, "%u busy-waits in handlers", handler_delays);
+
+  /* A stall with SDA held: recovery clocks the bus from alarms. */
+  enable();
+  stall_after_bytes = 1;
+  hold_on_stall = 4;
+  xact_init(&a, 2, 0);
+  CHECK(0 == iBSPACMi2cSubmit(&bus, &a.xact), "submit");
+  run_until_idle();
+  CHECK(- BSPACM_NRF_TWI_BUS_ERROR_TIMEOUT == a.xact.result, "held stall result %d", a.xact.result);
+  CHECK(TWI_RECOVERY_TOGGLES / 2 == scl_rising, "%u SCL cycles", scl_rising);
+  CHECK((TWI_ENABLE_ENABLE_Enabled << TWI_ENABLE_ENABLE_Pos) == twi->ENABLE, "not re-enabled");
+  CHECK(0 == handler_delays, "%u busy-waits in handlers", handler_delays);
+
+  /* A bus that cannot be freed is reported and left disabled, and
+   * transactions queued behind the failure complete with the same
+   * error without being started. */
+  enable();
+  stall_after_bytes = 0;
+  hold_on_stall = ~0U;
+  xact_init(&a, 1, 0);
+  xact_init(&b, 1, 0);
+  CHECK(0 == iBSPACMi2cSubmit(&bus, &a.xact), "submit");
+  CHECK(0 == iBSPACMi2cSubmit(&bus, &b.xact), "submit");
+  run_until_idle();
+  CHECK(- (BSPACM_NRF_TWI_BUS_ERROR_TIMEOUT | BSPACM_NRF_TWI_BUS_ERROR_CLEAR_FAILED) == a.xact.result,
+        "stuck result %d", a.xact.result);
+  CHECK((TWI_ENABLE_ENABLE_Enabled << TWI_ENABLE_ENABLE_Pos) != twi->ENABLE, "stuck bus enabled");
+  CHECK(b.xact.completed && (- BSPACM_NRF_TWI_BUS_ERROR_CLEAR_FAILED == b.xact.result),
+        "queued transaction result %d", b.xact.result);
+  CHECK(0 == tx_log_len, "queued transaction started on stuck bus");
+  CHECK(0 > iBSPACMi2cSubmit(&bus, &a.xact), "submit to stuck bus");
+
+  /* Disabling completes queued transactions with an error. */
+  enable();
+  stall_after_bytes = 0;
+  xact_init(&a, 1, 0);
+  xact_init(&b, 1, 0);
+  CHECK(0 == iBSPACMi2cSubmit(&bus, &a.xact), "submit");
+  CHECK(0 == iBSPACMi2cSubmit(&bus, &b.xact), "submit");
+  CHECK(0 == iBSPACMi2cSetEnabled(&bus, false), "disable");
+  CHECK(a.xact.completed && (-1 == a.xact.result), "in progress result %d", a.xact.result);
+  CHECK(b.xact.completed && (-1 == b.xact.result), "queued result %d", b.xact.result);
+  run_until_idle();
+  CHECK(2 == order_len, "%u completions after disable", order_len);
+}
+
+static void
+test_blocking (void)
+{
+  uint8_t buf[3];
+
+  enable();
+  test_sleep_hook = sleep_hook;
+  CHECK(2 == iBSPACMi2cWrite(&bus, FOLLOWER_ADDR, tx_data, 2), "blocking write");
+  CHECK(3 == iBSPACMi2cRead(&bus, FOLLOWER_ADDR, buf, sizeof(buf)), "blocking read");
+  CHECK((0xA0 == buf[0]) && (0xA1 == buf[1]) && (0xA2 == buf[2]), "blocking read data");
+  nack_count = 1;
+  CHECK(- (int)TWI_ERRORSRC_ANACK_Msk == iBSPACMi2cWrite(&bus, FOLLOWER_ADDR, tx_data, 1),
+        "blocking write NACK");
+  test_sleep_hook = NULL;
+}
+
+int
+main (void)
+{
+  test_delay_hook = delay_hook;
+  test_configure();
+  test_enable();
+  test_transactions();
+  test_errors();
+  test_blocking();
+  if (failures) {
+    printf("%u failures\n", failures);
+    return 1;
+  }
+  printf("All checks passed\n");
+  return 0;
+}
@@ -0,0 +1,150 @@
+/* BSPACM - host stand-in for <bspacm/core.h> when testing uptime
+ *
+ * Written in 2014 by Peter A. Bigot <http://pabigot.github.io/bspacm/>
+ *
+ * To the extent possible under law, the author(s) have dedicated all
+ * copyright and related and neighboring rights to this software to
+ * the public domain worldwide. This software is distributed without
+ * any warranty.
+ *
+ * You should have received a copy of the CC0 Public Domain Dedication
+ * along with this software. If not, see
+ * <http://creativecommons.org/publicdomain/zero/1.0/>.
+ */
+
+/* Supplies only what the nRF51 uptime sources use from the real
+ * core.h and the nRF51 device header.  Peripherals are plain
+ * structures the test reads and writes to simulate hardware.  The
+ * interrupt mask is a variable so tests can observe it, and the
+ * sleep and barrier instructions call hooks so tests can advance time
+ * or interleave updates while the code under test runs.  A test that
+ * needs time to pass as the code polls a peripheral may define
+ * TEST_NRF_RTC or TEST_NRF_TIMER as a call that advances time and
+ * returns the peripheral. */
+
+#ifndef BSPACM_TEST_HOST_CORE_H
+#define BSPACM_TEST_HOST_CORE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define BSPACM_CORE_INLINE inline
+#define BSPACM_CORE_INLINE_FORCED BSPACM_CORE_INLINE __attribute__((__always_inline__))
+
+/* Emulated PRIMASK */
+extern unsigned int test_primask;
+
+#define BSPACM_CORE_ENABLE_INTERRUPT() do { test_primask = 0; } while (0)
+#define BSPACM_CORE_DISABLE_INTERRUPT() do { test_primask = 1; } while (0)
+#define BSPACM_CORE_SAVED_INTERRUPT_STATE(var_) unsigned int const var_ = test_primask
+#define BSPACM_CORE_REENABLE_INTERRUPT(var_) do { \
+    if (! (1U & var_)) {                          \
+      BSPACM_CORE_ENABLE_INTERRUPT();             \
+    }                                             \
+  } while (0)
+#define BSPACM_CORE_RESTORE_INTERRUPT_STATE(var_) do { \
+    if (1U & var_) {                                   \
+      BSPACM_CORE_DISABLE_INTERRUPT();                 \
+    } else {                                           \
+      BSPACM_CORE_ENABLE_INTERRUPT();                  \
+    }                                                  \
+  } while (0)
+
+/* Invoked by __WFI() and __WFE(); null to return immediately. */
+extern void (* test_sleep_hook) (void);
+
+static inline void
+__WFI (void)
+{
+  if (test_sleep_hook) {
+    test_sleep_hook();
+  }
+}
+
+#define __WFE() __WFI()
+
+/* Invoked by __DMB(); null to do nothing.  This lets a test run
+ * "interrupt" code between the accesses a barrier separates. */
+extern void (* test_dmb_hook) (void);
+
+#define __DMB() do {                            \
+    __asm__ __volatile__("" ::: "memory");      \
+    if (test_dmb_hook) {                        \
+      test_dmb_hook();                          \
+    }                                           \
+  } while (0)
+
+typedef int IRQn_Type;
+#define RTC0_IRQn 11
+#define RTC1_IRQn 17
+#define NVIC_ClearPendingIRQ(irqn_) do { (void)(irqn_); } while (0)
+#define NVIC_EnableIRQ(irqn_) do { (void)(irqn_); } while (0)
+#define vBSPACMnrf51NVICsetApplicationPriority(irqn_, low_) do { (void)(irqn_); (void)(low_); } while (0)
+
+#define NRF_RTC0_BASE 0x4000B000UL
+#define NRF_RTC1_BASE 0x40011000UL
+#define NRF_TIMER0_BASE 0x40008000UL
+#define NRF_TIMER1_BASE 0x40009000UL
+#define NRF_TIMER2_BASE 0x4000A000UL
+
+typedef struct {
+  volatile uint32_t TASKS_START;
+  volatile uint32_t TASKS_STOP;
+  volatile uint32_t TASKS_CLEAR;
+  volatile uint32_t EVENTS_TICK;
+  volatile uint32_t EVENTS_OVRFLW;
+  volatile uint32_t EVENTS_COMPARE[4];
+  volatile uint32_t INTENSET;
+  volatile uint32_t INTENCLR;
+  volatile uint32_t EVTENCLR;
+  volatile uint32_t COUNTER;
+  volatile uint32_t CC[4];
+} NRF_RTC_Type;
+
+typedef struct {
+  volatile uint32_t TASKS_START;
+  volatile uint32_t TASKS_STOP;
+  volatile uint32_t TASKS_COUNT;
+  volatile uint32_t TASKS_CLEAR;
+  volatile uint32_t TASKS_CAPTURE[4];
+  volatile uint32_t EVENTS_COMPARE[4];
+  volatile uint32_t INTENSET;
+  volatile uint32_t INTENCLR;
+  volatile uint32_t MODE;
+  volatile uint32_t BITMODE;
+  volatile uint32_t PRESCALER;
+  volatile uint32_t CC[4];
+} NRF_TIMER_Type;
+
+typedef struct {
+  volatile uint32_t TASKS_LFCLKSTART;
+  volatile uint32_t EVENTS_LFCLKSTARTED;
+  volatile uint32_t LFCLKSTAT;
+  volatile uint32_t LFCLKSRC;
+} NRF_CLOCK_Type;
+
+typedef struct {
+  volatile uint32_t TASKS_LOWPWR;
+} NRF_POWER_Type;
+
+extern NRF_RTC_Type test_rtc;
+extern NRF_TIMER_Type test_timer;
+extern NRF_CLOCK_Type test_clock;
+extern NRF_POWER_Type test_power;
+
+#ifndef TEST_NRF_RTC
+#define TEST_NRF_RTC (&test_rtc)
+#endif /* TEST_NRF_RTC */
+#ifndef TEST_NRF_TIMER
+#define TEST_NRF_TIMER (&test_timer)
+#endif /* TEST_NRF_TIMER */
+
+#define NRF_RTC0 TEST_NRF_RTC
+#define NRF_RTC1 TEST_NRF_RTC
+#define NRF_TIMER0 TEST_NRF_TIMER
+#define NRF_TIMER1 TEST_NRF_TIMER
+#define NRF_TIMER2 TEST_NRF_TIMER
+#define NRF_CLOCK (&test_clock)
+#define NRF_POWER (&test_power)
+
+#endif /* BSPACM_TEST_HOST_CORE_H */
@@ -0,0 +1,34 @@
+/* BSPACM - host stand-in for the nRF51 register field definitions
+ *
+ * Written in 2014 by Peter A. Bigot <http://pabigot.github.io/bspacm/>
+ *
+ * To the extent possible under law, the author(s) have dedicated all
+ * copyright and related and neighboring rights to this software to
+ * the public domain worldwide. This software is distributed without
+ * any warranty.
+ *
+ * You should have received a copy of the CC0 Public Domain Dedication
+ * along with this software. If not, see
+ * <http://creativecommons.org/publicdomain/zero/1.0/>.
+ */
+
+/* Only the fields the uptime sources use, with the values from the
+ * nRF51 reference manual. */
+
+#ifndef BSPACM_TEST_HOST_NRF51_BITFIELDS_H
+#define BSPACM_TEST_HOST_NRF51_BITFIELDS_H
+
+#define RTC_INTENSET_OVRFLW_Pos 1
+#define RTC_INTENSET_OVRFLW_Enabled 1
+#define RTC_INTENSET_COMPARE0_Pos 16
+#define RTC_INTENSET_COMPARE0_Enabled 1
+#define RTC_INTENCLR_COMPARE0_Pos 16
+#define RTC_INTENCLR_COMPARE0_Enabled 1
+
+#define CLOCK_LFCLKSTAT_STATE_Pos 16
+#define CLOCK_LFCLKSTAT_STATE_Msk (1UL << CLOCK_LFCLKSTAT_STATE_Pos)
+#define CLOCK_LFCLKSTAT_STATE_Running 1
+#define CLOCK_LFCLKSTAT_SRC_Pos 0
+#define CLOCK_LFCLKSTAT_SRC_Xtal 1
+
+#endif /* BSPACM_TEST_HOST_NRF51_BITFIELDS_H */
@@ -0,0 +1,390 @@
+/* BSPACM - host test of the nRF51 uptime alarm queue
+ *
+ * Written in 2014 by Peter A. Bigot <http://pabigot.github.io/bspacm/>
+ *
+ * To the extent possible under law, the author(s) have dedicated all
+ * copyright and related and neighboring rights to this software to
+ * the public domain worldwide. This software is distributed without
+ * any warranty.
+ *
+ * You should have received a copy of the CC0 Public Domain Dedication
+ * along with this software. If not, see
+ * <http://creativecommons.org/publicdomain/zero/1.0/>.
+ */
+
+/* Drives the pairing heap behind iBSPACMuptimeAlarmSchedule() and
+ * bBSPACMuptimeAlarmCancel() through a simulated RTC.  The uptime
+ * source is included directly so the heap can be checked after every
+ * operation: each child is due no earlier than its parent, the
+ * sibling links are consistent, and exactly the scheduled alarms are
+ * present.  Time advances only to the compare value the code under
+ * test programmed, so an alarm that fires early, late, or not at all
+ * is detected.  An alarm due within #BSPACM_UPTIME_SLEEP_MINIMUM
+ * ticks of the previous compare may fire that much late, as on the
+ * hardware.
+ *
+ * Cases cover ordering of many alarms including equal deadlines,
+ * cancellation of the root and of interior nodes, deadlines that
+ * span the 24-bit counter and 32-bit tick wraps, alarms beyond the
+ * longest compare interval, periodic alarms, and callbacks that
+ * schedule and cancel other alarms. */
+
+#include "uptime.c"
+#include <stdio.h>
+#include <stdlib.h>
+
+unsigned int test_primask;
+void (* test_sleep_hook) (void);
+NRF_RTC_Type test_rtc;
+NRF_CLOCK_Type test_clock;
+NRF_POWER_Type test_power;
+sBSPACMeventGroup xBSPACMeventSystem;
+
+int
+iBSPACMtaskPost (hBSPACMtask tp)
+{
+  return 0;
+}
+
+#define ALARM_COUNT 300
+
+typedef struct sTestAlarm {
+  sBSPACMuptimeAlarm alarm;
+  unsigned int fired;
+  unsigned long long fired_utt;
+  bool cancelled;
+} sTestAlarm;
+
+/* One callback invocation */
+typedef struct sFiring {
+  const sTestAlarm * tap;
+  unsigned int due_utt;
+  unsigned long long fired_utt;
+} sFiring;
+
+static sTestAlarm alarms[ALARM_COUNT];
+static sFiring fired_order[4 * ALARM_COUNT];
+static unsigned int fired_count;
+static unsigned long long now_utt;
+static unsigned int failures;
+static uint32_t lcg = 1;
+
+#define CHECK(cond_, ...) do {                  \
+    if (! (cond_)) {                            \
+      ++failures;                               \
+      printf("FAIL %s:%d: ", __FILE__, __LINE__); \
+      printf(__VA_ARGS__);                      \
+      putchar('\n');                            \
+    }                                           \
+  } while (0)
+
+static unsigned int
+rand_below (unsigned int n)
+{
+  lcg = 1664525 * lcg + 1013904223;
+  return (lcg >> 8) % n;
+}
+
+static void
+set_now (unsigned long long t)
+{
+  now_utt = t;
+  xBSPACMuptimeState_.overflows = (unsigned int)(t >> RTC_COUNTER_BITS);
+  test_rtc.COUNTER = RTC_COUNTER_MASK & (unsigned int)t;
+}
+
+static void
+record_fire (int ccidx,
+             hBSPACMuptimeAlarm ap)
+{
+  sTestAlarm * tap = (sTestAlarm *)ap;
+
+  CHECK(BSPACM_UPTIME_TIMER_CCIDX == ccidx, "callback ccidx %d", ccidx);
+  tap->fired += 1;
+  tap->fired_utt = now_utt;
+  if (fired_count < (sizeof(fired_order) / sizeof(*fired_order))) {
+    sFiring * fp = fired_order + fired_count;
+    fp->tap = tap;
+    /* A periodic alarm has already been advanced to its next
+     * repetition. */
+    fp->due_utt = ap->when_utt - ap->interval_utt;
+    fp->fired_utt = now_utt;
+  }
+  ++fired_count;
+}
+
+/* Restart the clock at t with every alarm idle. */
+static void
+reset (unsigned long long t)
+{
+  unsigned int i;
+
+  test_clock.LFCLKSTAT = CLOCK_LFCLKSTAT_STATE_Running << CLOCK_LFCLKSTAT_STATE_Pos;
+  vBSPACMuptimeStart();
+  set_now(t);
+  memset(alarms, 0, sizeof(alarms));
+  for (i = 0; i < ALARM_COUNT; ++i) {
+    alarms[i].alarm.callback_flih = record_fire;
+  }
+  fired_count = 0;
+}
+
+/* Verify the subtree rooted at ap, returning the number of nodes. */
+static unsigned int
+check_subtree (hBSPACMuptimeAlarm ap)
+{
+  hBSPACMuptimeAlarm cp;
+  hBSPACMuptimeAlarm left = ap;
+  unsigned int n = 1;
+
+  CHECK(ap->scheduled_, "alarm %p in heap but not scheduled", (void *)ap);
+  for (cp = ap->child_; cp; cp = cp->next_) {
+    CHECK(! TIMER_BEFORE(cp, ap), "child %u due before parent %u",
+          cp->when_utt, ap->when_utt);
+    CHECK(left == cp->prev_, "child %p prev_ is %p not %p",
+          (void *)cp, (void *)cp->prev_, (void *)left);
+    left = cp;
+    n += check_subtree(cp);
+  }
+  return n;
+}
+
+static void
+check_heap (void)
+{
+  hBSPACMuptimeAlarm const root = xBSPACMuptimeState_.timers;
+  unsigned int scheduled = 0;
+  unsigned int i;
+
+  for (i = 0; i < ALARM_COUNT; ++i) {
+    scheduled += alarms[i].alarm.scheduled_;
+  }
+  if (! root) {
+    CHECK(0 == scheduled, "empty heap with %u scheduled", scheduled);
+    return;
+  }
+  CHECK((NULL == root->next_) && (NULL == root->prev_), "root has siblings");
+  i = check_subtree(root);
+  CHECK(i == scheduled, "heap holds %u of %u scheduled", i, scheduled);
+}
+
+static void
+schedule (sTestAlarm * tap,
+          unsigned int when_utt)
+{
+  int rc = iBSPACMuptimeAlarmSchedule(when_utt, &tap->alarm);
+
+  CHECK(0 == rc, "schedule returned %d", rc);
+  CHECK(0 == test_primask, "schedule left interrupts disabled");
+  check_heap();
+}
+
+static void
+cancel (sTestAlarm * tap)
+{
+  bool const was = tap->alarm.scheduled_;
+  bool const rv = bBSPACMuptimeAlarmCancel(&tap->alarm);
+
+  CHECK(rv == was, "cancel returned %d for scheduled %d", rv, was);
+  CHECK(! tap->alarm.scheduled_, "alarm still scheduled after cancel");
+  tap->cancelled |= was;
+  check_heap();
+}
+
+/* Advance to the next compare event and run the handler.  Returns
+ * false if no compare is armed. */
+static bool
+step (void)
+{
+  unsigned int delta;
+
+  if (! xBSPACMuptimeState_.timers) {
+    return false;
+  }
+  delta = RTC_COUNTER_MASK & (test_rtc.CC[BSPACM_UPTIME_TIMER_CCIDX] - test_rtc.COUNTER);
+  if (0 == delta) {
+    delta = RTC_COUNTER_MASK + 1;
+  }
+  set_now(now_utt + delta);
+  test_rtc.EVENTS_COMPARE[BSPACM_UPTIME_TIMER_CCIDX] = 1;
+  BSPACM_UPTIME_RTC_IRQHandler();
+  CHECK(0 == test_primask, "handler left interrupts disabled");
+  check_heap();
+  return true;
+}
+
+static void
+run (unsigned int limit)
+{
+  while ((fired_count < limit) && step()) {
+  }
+}
+
+/* Check that alarms fired in deadline order, none early, and none
+ * later than the compare register's minimum lead can explain; and
+ * that cancelled alarms did not fire. */
+static void
+check_fired (void)
+{
+  unsigned int i;
+
+  for (i = 0; i < fired_count; ++i) {
+    const sFiring * fp = fired_order + i;
+    unsigned int const late = (unsigned int)fp->fired_utt - fp->due_utt;
+    CHECK(late < BSPACM_UPTIME_SLEEP_MINIMUM,
+          "alarm %u due %u fired at %u", (unsigned int)(fp->tap - alarms),
+          fp->due_utt, (unsigned int)fp->fired_utt);
+    if (0 < i) {
+      CHECK(0 <= (int)(fp->due_utt - fp[-1].due_utt), "alarms fired out of order");
+    }
+  }
+  for (i = 0; i < ALARM_COUNT; ++i) {
+    const sTestAlarm * tap = alarms + i;
+    if (tap->cancelled) {
+      CHECK(0 == tap->fired, "cancelled alarm %u fired", i);
+    }
+  }
+}
+
+static void
+test_ordering (unsigned long long t0)
+{
+  unsigned int i;
+
+  reset(t0);
+  for (i = 0; i < ALARM_COUNT; ++i) {
+    /* A narrow range forces many equal deadlines. */
+    unsigned int const range = (i & 1) ? 100000 : 50;
+    schedule(alarms + i, (unsigned int)t0 + 2 + rand_below(range));
+  }
+  run(ALARM_COUNT);
+  check_fired();
+  CHECK(ALARM_COUNT == fired_count, "%u of %u alarms fired", fired_count, ALARM_COUNT);
+  for (i = 0; i < ALARM_COUNT; ++i) {
+    CHECK(1 == alarms[i].fired, "alarm %u fired %u times", i, alarms[i].fired);
+  }
+}
+
+static void
+test_cancel (unsigned long long t0)
+{
+  unsigned int i;
+  unsigned int cancelled = 0;
+
+  reset(t0);
+  for (i = 0; i < ALARM_COUNT; ++i) {
+    schedule(alarms + i, (unsigned int)t0 + 2 + rand_below(200000));
+  }
+  /* Fire some so the heap has been restructured by pops. */
+  run(ALARM_COUNT / 6);
+  /* Cancel the root a few times, then random (mostly interior)
+   * alarms, including some already fired or cancelled. */
+  for (i = 0; i < 5; ++i) {
+    cancel((sTestAlarm *)xBSPACMuptimeState_.timers);
+  }
+  for (i = 0; i < ALARM_COUNT / 2; ++i) {
+    cancel(alarms + rand_below(ALARM_COUNT));
+  }
+  for (i = 0; i < ALARM_COUNT; ++i) {
+    cancelled += alarms[i].cancelled;
+  }
+  run(4 * ALARM_COUNT);
+  check_fired();
+  CHECK((ALARM_COUNT - cancelled) == fired_count, "%u fired, %u cancelled",
+        fired_count, cancelled);
+  CHECK(NULL == xBSPACMuptimeState_.timers, "alarms remain after run");
+}
+
+static void
+test_far (void)
+{
+  unsigned long long const t0 = 0x123456;
+
+  reset(t0);
+  schedule(alarms + 0, (unsigned int)t0 + 3 * TIMER_MAXIMUM_DELTA_UTT + 5);
+  schedule(alarms + 1, (unsigned int)t0 + 7);
+  schedule(alarms + 2, (unsigned int)t0 + RTC_COUNTER_MASK + 100);
+  run(3);
+  check_fired();
+  CHECK(3 == fired_count, "%u of 3 far alarms fired", fired_count);
+}
+
+/* Periodic alarm that cancels itself after a fixed count, and
+ * exercises scheduling and cancelling from within a callback. */
+static void
+periodic_fire (int ccidx,
+               hBSPACMuptimeAlarm ap)
+{
+  sTestAlarm * tap = (sTestAlarm *)ap;
+
+  record_fire(ccidx, ap);
+  if (10 == tap->fired) {
+    CHECK(bBSPACMuptimeAlarmCancel(ap), "periodic alarm not scheduled in callback");
+  }
+  if (3 == tap->fired) {
+    /* Reschedule a fired one-shot, and cancel a pending one. */
+    schedule(alarms + 2, (unsigned int)now_utt + 1500);
+    cancel(alarms + 3);
+  }
+}
+
+static void
+test_periodic (void)
+{
+  unsigned long long const t0 = 1000;
+
+  reset(t0);
+  alarms[0].alarm.callback_flih = periodic_fire;
+  alarms[0].alarm.interval_utt = 1000;
+  schedule(alarms + 0, (unsigned int)t0 + 1000);
+  schedule(alarms + 1, (unsigned int)t0 + 2500);
+  schedule(alarms + 2, (unsigned int)t0 + 2600);
+  schedule(alarms + 3, (unsigned int)t0 + 9000);
+  run(100);
+  check_fired();
+  CHECK(10 == alarms[0].fired, "periodic alarm fired %u times", alarms[0].fired);
+  CHECK(2 == alarms[2].fired, "rescheduled alarm fired %u times", alarms[2].fired);
+  CHECK(alarms[2].fired_utt == t0 + 3000 + 1500, "rescheduled alarm fired at %llu",
+        alarms[2].fired_utt);
+  CHECK(0 == alarms[3].fired, "alarm cancelled in callback fired");
+}
+
+static void
+test_idle_cancel (void)
+{
+  reset(5000);
+  CHECK(! bBSPACMuptimeAlarmCancel(&alarms[0].alarm), "cancelled an idle alarm");
+  CHECK(! bBSPACMuptimeAlarmCancel(NULL), "cancelled a null alarm");
+  schedule(alarms + 0, 6000);
+  CHECK(0 != iBSPACMuptimeAlarmSchedule(7000, &alarms[0].alarm),
+        "scheduled an alarm twice");
+  check_heap();
+}
+
+int
+main (void)
+{
+  /* Ordinary, across the 24-bit counter wrap, and across the 32-bit
+   * tick wrap (which also wraps the counter). */
+  unsigned long long const starts[] = {
+    100,
+    (1ULL << RTC_COUNTER_BITS) - 60000,
+    (1ULL << 32) - 60000,
+    (0xABCDULL << 32) - 60000,
+  };
+  unsigned int i;
+
+  for (i = 0; i < sizeof(starts) / sizeof(*starts); ++i) {
+    test_ordering(starts[i]);
+    test_cancel(starts[i]);
+  }
+  test_far();
+  test_periodic();
+  test_idle_cancel();
+  if (failures) {
+    printf("%u failures\n", failures);
+    return 1;
+  }
+  printf("All checks passed\n");
+  return 0;
+}
@@ -0,0 +1,165 @@
+/* BSPACM - host test of the nRF51 uptime conversions
+ *
+ * Written in 2014 by Peter A. Bigot <http://pabigot.github.io/bspacm/>
+ *
+ * To the extent possible under law, the author(s) have dedicated all
+ * copyright and related and neighboring rights to this software to
+ * the public domain worldwide. This software is distributed without
+ * any warranty.
+ *
+ * You should have received a copy of the CC0 Public Domain Dedication
+ * along with this software. If not, see
+ * <http://creativecommons.org/publicdomain/zero/1.0/>.
+ */
+
+/* Compares each of the four 32-bit conversions in
+ * <bspacm/utility/uptime.h> against a 64-bit ceiling division for
+ * every 32-bit input in the range where the header documents the
+ * result as exact, and confirms each range is as large as claimed.
+ * The 64-bit tick conversions are checked against 128-bit arithmetic
+ * at every input below 2^20, at each multiple of the divisor's
+ * period, and at pseudo-random points across the 56-bit uptime
+ * range.  The exhaustive loops take a few tens of seconds. */
+
+#include <bspacm/utility/uptime.h>
+#include <stdio.h>
+
+/* Emit external definitions of the inline conversions here. */
+extern inline unsigned int uiBSPACMuptimeConvert_us_utt (unsigned int dur_us);
+extern inline unsigned int uiBSPACMuptimeConvert_ms_utt (unsigned int dur_ms);
+extern inline unsigned int uiBSPACMuptimeConvert_utt_us (unsigned int dur_utt);
+extern inline unsigned int uiBSPACMuptimeConvert_utt_ms (unsigned int dur_utt);
+extern inline unsigned long long ullBSPACMuptimeConvert_utt_us (unsigned long long dur_utt);
+extern inline unsigned long long ullBSPACMuptimeConvert_utt_ms (unsigned long long dur_utt);
+
+NRF_RTC_Type test_rtc;
+sBSPACMuptimeState xBSPACMuptimeState_;
+
+static unsigned int failures;
+
+/* ceil(v * num / den) */
+static uint64_t
+ref_ceil (uint64_t v,
+          uint64_t num,
+          uint64_t den)
+{
+  return ((v * num) + den - 1) / den;
+}
+
+static unsigned __int128
+ref_ceil128 (unsigned __int128 v,
+             unsigned int num,
+             unsigned int den)
+{
+  return ((v * num) + den - 1) / den;
+}
+
+/* Check a 32-bit conversion exhaustively over [0, limit], stopping
+ * at the first failure. */
+static void
+check32 (const char * name,
+         unsigned int (* fn) (unsigned int),
+         uint64_t num,
+         uint64_t den,
+         uint64_t limit)
+{
+  uint64_t v;
+
+  for (v = 0; v <= limit; ++v) {
+    uint64_t const expect = ref_ceil(v, num, den);
+    unsigned int const got = fn((unsigned int)v);
+    if (got != expect) {
+      ++failures;
+      printf("FAIL %s(%llu) = %u, expected %llu\n", name,
+             (unsigned long long)v, got, (unsigned long long)expect);
+      return;
+    }
+  }
+  printf("%s exact over [0, %llu]\n", name, (unsigned long long)limit);
+}
+
+/* Confirm that limit is the largest input whose converted value fits
+ * in 32 bits, matching the header's claim. */
+static void
+check_limit (const char * name,
+             uint64_t num,
+             uint64_t den,
+             uint64_t limit)
+{
+  if ((UINT32_MAX < ref_ceil(limit, num, den))
+      || (UINT32_MAX >= ref_ceil(limit + 1, num, den))) {
+    ++failures;
+    printf("FAIL %s documented limit %llu is not the largest valid input\n",
+           name, (unsigned long long)limit);
+  }
+}
+
+static void
+check64_point (uint64_t v)
+{
+  unsigned long long const us = ullBSPACMuptimeConvert_utt_us(v);
+  unsigned long long const ms = ullBSPACMuptimeConvert_utt_ms(v);
+
+  if (us != (unsigned long long)ref_ceil128(v, 15625, 512)) {
+    ++failures;
+    printf("FAIL ullBSPACMuptimeConvert_utt_us(%llu) = %llu\n",
+           (unsigned long long)v, us);
+  }
+  if (ms != (unsigned long long)ref_ceil128(v, 125, 4096)) {
+    ++failures;
+    printf("FAIL ullBSPACMuptimeConvert_utt_ms(%llu) = %llu\n",
+           (unsigned long long)v, ms);
+  }
+}
+
+static void
+check64 (void)
+{
+  uint64_t const limit = (1ULL << 56) - 1;
+  uint64_t v;
+  uint64_t lcg = 1;
+  unsigned int i;
+  unsigned int const start_failures = failures;
+
+  for (v = 0; v < (1U << 20); ++v) {
+    check64_point(v);
+  }
+  for (v = 4096; v <= limit; v += v) {
+    check64_point(v - 1);
+    check64_point(v);
+    check64_point(v + 1);
+  }
+  check64_point(limit);
+  for (i = 0; i < 1000000; ++i) {
+    lcg = 6364136223846793005ULL * lcg + 1442695040888963407ULL;
+    check64_point(lcg & limit);
+  }
+  if (start_failures == failures) {
+    printf("64-bit tick conversions exact at all sampled points\n");
+  }
+}
+
+int
+main (void)
+{
+  uint64_t const ms_utt_limit = 131071999;
+  uint64_t const utt_us_limit = 140737488;
+
+  check32("uiBSPACMuptimeConvert_us_utt", uiBSPACMuptimeConvert_us_utt,
+          512, 15625, UINT32_MAX);
+  check_limit("uiBSPACMuptimeConvert_ms_utt", 4096, 125, ms_utt_limit);
+  check32("uiBSPACMuptimeConvert_ms_utt", uiBSPACMuptimeConvert_ms_utt,
+          4096, 125, ms_utt_limit);
+  check_limit("uiBSPACMuptimeConvert_utt_us", 15625, 512, utt_us_limit);
+  check32("uiBSPACMuptimeConvert_utt_us", uiBSPACMuptimeConvert_utt_us,
+          15625, 512, utt_us_limit);
+  check32("uiBSPACMuptimeConvert_utt_ms", uiBSPACMuptimeConvert_utt_ms,
+          125, 4096, UINT32_MAX);
+  check64();
+  if (failures) {
+    printf("%u failures\n", failures);
+    return 1;
+  }
+  printf("All checks passed\n");
+  return 0;
+}
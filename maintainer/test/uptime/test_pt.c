@@ -0,0 +1,332 @@
+/* BSPACM - host test of protothreads
+ *
+ * Written in 2014 by Peter A. Bigot <http://pabigot.github.io/bspacm/>
+ *
+ * To the extent possible under law, the author(s) have dedicated all
+ * copyright and related and neighboring rights to this software to
+ * the public domain worldwide. This software is distributed without
+ * any warranty.
+ *
+ * You should have received a copy of the CC0 Public Domain Dedication
+ * along with this software. If not, see
+ * <http://creativecommons.org/publicdomain/zero/1.0/>.
+ */
+
+/* Checks the control flow of <bspacm/utility/pt.h> (wait, yield,
+ * exit, end, and child spawn) and, with uptime.c and pt.c built
+ * against the simulated RTC, the nRF51 duration waits.  Several
+ * protothreads sleep on different deadlines through the one shared
+ * wakeup alarm; each must resume no earlier than its deadline and no
+ * later than the compare register's minimum lead allows.  Event waits
+ * with a timeout must report the event when it arrives first and zero
+ * when the timeout does, and uiBSPACMptIdle() must leave posted
+ * events for the protothreads to take.
+ *
+ * Sleep is simulated by vBSPACMeventIdle(), which advances time to
+ * the next programmed compare (or to a scheduled event post, if that
+ * is sooner) and runs the RTC interrupt handler. */
+
+#define BSPACM_DEVICE_SERIES_NRF51 1
+#include "uptime.c"
+#include "pt.c"
+#include <stdio.h>
+
+unsigned int test_primask;
+void (* test_sleep_hook) (void);
+NRF_RTC_Type test_rtc;
+NRF_CLOCK_Type test_clock;
+NRF_POWER_Type test_power;
+sBSPACMeventGroup xBSPACMeventSystem;
+
+int
+iBSPACMtaskPost (hBSPACMtask tp)
+{
+  return 0;
+}
+
+static unsigned int failures;
+static unsigned long long now_utt;
+
+/* An event to post when time reaches inject_utt, if inject_bits is
+ * not zero. */
+static unsigned long long inject_utt;
+static uint32_t inject_bits;
+
+#define EV_A (BSPACM_EVENT_APPLICATION_BASE << 0)
+#define EV_B (BSPACM_EVENT_APPLICATION_BASE << 1)
+
+#define CHECK(cond_, ...) do {                  \
+    if (! (cond_)) {                            \
+      ++failures;                               \
+      printf("FAIL %s:%d: ", __FILE__, __LINE__); \
+      printf(__VA_ARGS__);                      \
+      putchar('\n');                            \
+    }                                           \
+  } while (0)
+
+static void
+set_now (unsigned long long t)
+{
+  now_utt = t;
+  xBSPACMuptimeState_.overflows = (unsigned int)(t >> RTC_COUNTER_BITS);
+  test_rtc.COUNTER = RTC_COUNTER_MASK & (unsigned int)t;
+}
+
+void
+vBSPACMeventIdle (const sBSPACMeventGroup * gp,
+                  uint32_t mask)
+{
+  unsigned long long next = ~0ULL;
+
+  CHECK(0 != test_primask, "idle entered with interrupts enabled");
+  if (xBSPACMuptimeState_.timers) {
+    unsigned int delta = RTC_COUNTER_MASK & (test_rtc.CC[BSPACM_UPTIME_TIMER_CCIDX] - test_rtc.COUNTER);
+    if (0 == delta) {
+      delta = RTC_COUNTER_MASK + 1;
+    }
+    next = now_utt + delta;
+  }
+  if (inject_bits && (inject_utt < next)) {
+    set_now(inject_utt);
+    xBSPACMeventSystem.flags |= inject_bits;
+    inject_bits = 0;
+    return;
+  }
+  CHECK(~0ULL != next, "idle with nothing to wake it");
+  if (~0ULL == next) {
+    return;
+  }
+  set_now(next);
+  /* The handler runs once the idle loop unmasks interrupts; running
+   * it here is equivalent because the loop re-checks after. */
+  test_rtc.EVENTS_COMPARE[BSPACM_UPTIME_TIMER_CCIDX] = 1;
+  BSPACM_UPTIME_RTC_IRQHandler();
+  test_primask = 1;
+}
+
+/* Control flow */
+
+typedef struct sFlow {
+  sBSPACMpt pt;
+  sBSPACMpt child;
+  bool go;
+  unsigned int steps;
+  unsigned int child_steps;
+} sFlow;
+
+static int
+flow_child (sFlow * fp)
+{
+  BSPACM_PT_BEGIN(&fp->child);
+  ++fp->child_steps;
+  BSPACM_PT_YIELD(&fp->child);
+  ++fp->child_steps;
+  BSPACM_PT_EXIT(&fp->child);
+  ++fp->child_steps;            /* not reached */
+  BSPACM_PT_END(&fp->child);
+}
+
+static int
+flow (sFlow * fp)
+{
+  BSPACM_PT_BEGIN(&fp->pt);
+  fp->steps = 1;
+  BSPACM_PT_WAIT_UNTIL(&fp->pt, fp->go);
+  fp->steps = 2;
+  BSPACM_PT_YIELD(&fp->pt);
+  fp->steps = 3;
+  BSPACM_PT_SPAWN(&fp->pt, &fp->child, flow_child(fp));
+  fp->steps = 4;
+  BSPACM_PT_WAIT_EVENT(&fp->pt, &xBSPACMeventSystem, EV_A | EV_B);
+  fp->steps = 5;
+  BSPACM_PT_END(&fp->pt);
+}
+
+static void
+test_flow (void)
+{
+  sFlow f = { .go = false };
+  int rc;
+
+  BSPACM_PT_INITIALIZE(&f.pt);
+  rc = flow(&f);
+  CHECK((BSPACM_PT_WAITING == rc) && (1 == f.steps), "initial wait: rc %d steps %u", rc, f.steps);
+  rc = flow(&f);
+  CHECK((BSPACM_PT_WAITING == rc) && (1 == f.steps), "re-wait: rc %d steps %u", rc, f.steps);
+  f.go = true;
+  rc = flow(&f);
+  CHECK((BSPACM_PT_YIELDED == rc) && (2 == f.steps), "yield: rc %d steps %u", rc, f.steps);
+  rc = flow(&f);
+  CHECK((BSPACM_PT_WAITING == rc) && (3 == f.steps) && (1 == f.child_steps),
+        "spawn: rc %d steps %u child %u", rc, f.steps, f.child_steps);
+  rc = flow(&f);
+  CHECK((BSPACM_PT_WAITING == rc) && (4 == f.steps) && (2 == f.child_steps),
+        "child exit: rc %d steps %u child %u", rc, f.steps, f.child_steps);
+  xBSPACMeventSystem.flags = EV_B | BSPACM_EVENT_UART_RX;
+  rc = flow(&f);
+  CHECK((BSPACM_PT_ENDED == rc) && (5 == f.steps) && (EV_B == f.pt.events),
+        "event: rc %d steps %u events %x", rc, f.steps, f.pt.events);
+  CHECK(BSPACM_EVENT_UART_RX == xBSPACMeventSystem.flags, "unrelated event consumed");
+  CHECK(0 == f.pt.lc_, "ended protothread not reset");
+  xBSPACMeventSystem.flags = 0;
+}
+
+/* Duration waits */
+
+typedef struct sSleeper {
+  sBSPACMpt pt;
+  unsigned int period_utt;
+  unsigned int wakes;
+  unsigned int late_max;
+  bool early;
+} sSleeper;
+
+static int
+sleeper (sSleeper * sp)
+{
+  BSPACM_PT_BEGIN(&sp->pt);
+  while (1) {
+    BSPACM_PT_SLEEP_UTT(&sp->pt, sp->period_utt);
+    {
+      int const late = (int)(uiBSPACMuptime() - sp->pt.deadline_utt);
+      if (0 > late) {
+        sp->early = true;
+      } else if (late > sp->late_max) {
+        sp->late_max = late;
+      }
+    }
+    ++sp->wakes;
+  }
+  BSPACM_PT_END(&sp->pt);
+}
+
+static void
+restart (unsigned long long t)
+{
+  test_clock.LFCLKSTAT = CLOCK_LFCLKSTAT_STATE_Running << CLOCK_LFCLKSTAT_STATE_Pos;
+  vBSPACMuptimeStart();
+  set_now(t);
+  memset(&wakeup_alarm_, 0, sizeof(wakeup_alarm_));
+  wakeup_alarm_.callback_flih = wakeup_flih;
+  wakeup_ = false;
+  xBSPACMeventSystem.flags = 0;
+  inject_bits = 0;
+}
+
+static void
+test_sleep (unsigned long long t0)
+{
+  sSleeper s[] = {
+    { .period_utt = 1000 },
+    { .period_utt = 333 },
+    { .period_utt = 7 },
+    { .period_utt = 40000 },
+  };
+  unsigned int const ns = sizeof(s) / sizeof(*s);
+  unsigned long long const end_utt = t0 + 400000;
+  unsigned int i;
+
+  restart(t0);
+  for (i = 0; i < ns; ++i) {
+    BSPACM_PT_INITIALIZE(&s[i].pt);
+  }
+  while (now_utt < end_utt) {
+    for (i = 0; i < ns; ++i) {
+      (void)sleeper(s + i);
+    }
+    test_primask = 0;
+    (void)uiBSPACMptIdle(0);
+    CHECK(0 == test_primask, "idle left interrupts disabled");
+  }
+  for (i = 0; i < ns; ++i) {
+    unsigned int const expect = 400000 / s[i].period_utt;
+    CHECK(! s[i].early, "sleeper %u woke early", i);
+    CHECK(s[i].late_max < BSPACM_UPTIME_SLEEP_MINIMUM, "sleeper %u late by %u",
+          i, s[i].late_max);
+    /* Late wakes accumulate into the period of a relative sleep. */
+    CHECK((s[i].wakes <= expect) && ((s[i].wakes + 1) * (s[i].period_utt + s[i].late_max) >= 400000),
+          "sleeper %u woke %u times, expected about %u", i, s[i].wakes, expect);
+  }
+}
+
+/* Event waits with timeout */
+
+typedef struct sWaiter {
+  sBSPACMpt pt;
+  bool done;
+  uint32_t events;
+  unsigned long long done_utt;
+} sWaiter;
+
+static int
+waiter (sWaiter * wp)
+{
+  BSPACM_PT_BEGIN(&wp->pt);
+  BSPACM_PT_WAIT_EVENT_UTT(&wp->pt, &xBSPACMeventSystem, EV_A, 5000);
+  wp->events = wp->pt.events;
+  wp->done = true;
+  wp->done_utt = now_utt;
+  BSPACM_PT_END(&wp->pt);
+}
+
+static void
+run_waiter (sWaiter * wp)
+{
+  memset(wp, 0, sizeof(*wp));
+  while (! wp->done) {
+    (void)waiter(wp);
+    if (! wp->done) {
+      uint32_t ev;
+
+      test_primask = 0;
+      ev = uiBSPACMptIdle(EV_A);
+      if (ev) {
+        CHECK(ev == (EV_A & xBSPACMeventSystem.flags), "idle consumed events");
+      }
+    }
+  }
+}
+
+static void
+test_event_timeout (unsigned long long t0)
+{
+  sWaiter w;
+
+  restart(t0);
+  inject_utt = t0 + 1200;
+  inject_bits = EV_A;
+  run_waiter(&w);
+  CHECK(EV_A == w.events, "event wait returned %x", w.events);
+  CHECK(t0 + 1200 == w.done_utt, "event wait completed at %llu", w.done_utt - t0);
+  CHECK(0 == xBSPACMeventSystem.flags, "event not consumed");
+
+  restart(t0);
+  inject_utt = t0 + 9000;
+  inject_bits = EV_A;
+  run_waiter(&w);
+  CHECK(0 == w.events, "timed-out wait returned %x", w.events);
+  CHECK((w.done_utt - t0 >= 5000) && (w.done_utt - t0 < 5000 + BSPACM_UPTIME_SLEEP_MINIMUM),
+        "timeout completed at %llu", w.done_utt - t0);
+}
+
+int
+main (void)
+{
+  unsigned long long const starts[] = {
+    100,
+    (1ULL << 32) - 200000,
+  };
+  unsigned int i;
+
+  test_flow();
+  for (i = 0; i < sizeof(starts) / sizeof(*starts); ++i) {
+    test_sleep(starts[i]);
+    test_event_timeout(starts[i]);
+  }
+  if (failures) {
+    printf("%u failures\n", failures);
+    return 1;
+  }
+  printf("All checks passed\n");
+  return 0;
+}
@@ -0,0 +1,347 @@
+/* BSPACM - host test of nRF51 uptime calibration
+ *
+ * Written in 2014 by Peter A. Bigot <http://pabigot.github.io/bspacm/>
+ *
+ * To the extent possible under law, the author(s) have dedicated all
+ * copyright and related and neighboring rights to this software to
+ * the public domain worldwide. This software is distributed without
+ * any warranty.
+ *
+ * You should have received a copy of the CC0 Public Domain Dedication
+ * along with this software. If not, see
+ * <http://creativecommons.org/publicdomain/zero/1.0/>.
+ */
+
+/* Builds uptimecal.c against simulated RTC and TIMER peripherals
+ * driven from one HFCLK time base, with the LFCLK off nominal by a
+ * chosen rate.  Every access to either peripheral advances time, so
+ * the edge polling runs as it would on hardware.  Checks that the
+ * measured rate matches the simulated one at both a fine and a
+ * coarse hires resolution, that interrupts are never disabled while
+ * polling, that an edge at which the poll is preempted is rejected
+ * and the next used, that a sample preempted at every attempt is
+ * retried later without losing accuracy, that an implausible rate is
+ * discarded, and that the start and stop API validates and cancels.
+ *
+ * The uptime alarm queue is replaced by stubs: the test fires the one
+ * calibration alarm itself once simulated time reaches it. */
+
+#define TEST_NRF_RTC (test_rtc_access())
+#define TEST_NRF_TIMER (test_timer_access())
+
+#include <bspacm/core.h>
+
+NRF_RTC_Type * test_rtc_access (void);
+NRF_TIMER_Type * test_timer_access (void);
+
+#include "uptimecal.c"
+#include <stdio.h>
+#include <stdlib.h>
+
+unsigned int test_primask;
+NRF_RTC_Type test_rtc;
+NRF_TIMER_Type test_timer;
+sBSPACMuptimeState xBSPACMuptimeState_;
+sBSPACMhiresState xBSPACMhiresState_;
+
+static unsigned int failures;
+
+#define CHECK(cond_, ...) do {                  \
+    if (! (cond_)) {                            \
+      ++failures;                               \
+      printf("FAIL %s:%d: ", __FILE__, __LINE__); \
+      printf(__VA_ARGS__);                      \
+      putchar('\n');                            \
+    }                                           \
+  } while (0)
+
+/* HFCLK ticks consumed by each peripheral access */
+#define ACCESS_HF 4
+
+/* HFCLK ticks taken by a simulated preempting interrupt, 20 us */
+#define PREEMPT_HF 320
+
+/* Simulated time, in 16 MHz HFCLK ticks */
+static unsigned long long now_hf;
+
+/* Fractional error of LFCLK: positive means uptime ticks are long */
+static long long skew_ppb;
+
+/* Number of upcoming uptime tick edges at which to simulate a
+ * preempting interrupt */
+static unsigned int preempt_edges;
+static unsigned long long last_rtc;
+static unsigned int primask_polls;
+static bool in_callback;
+
+static bool hires_enabled;
+static unsigned int schedules;
+
+static unsigned long long
+rtc_at (unsigned long long t_hf)
+{
+  __int128 const num = (__int128)t_hf * 32 * 1000000000LL;
+  __int128 const den = (__int128)15625 * (1000000000LL + skew_ppb);
+
+  return (unsigned long long)(num / den);
+}
+
+/* First HFCLK time at which the RTC reaches utt */
+static unsigned long long
+hf_at (unsigned long long utt)
+{
+  __int128 const num = (__int128)utt * 15625 * (1000000000LL + skew_ppb);
+  __int128 const den = (__int128)32 * 1000000000LL;
+
+  return (unsigned long long)((num + den - 1) / den);
+}
+
+static void
+advance (void)
+{
+  unsigned long long rtc;
+  unsigned long long hrt;
+
+  if (in_callback && test_primask) {
+    ++primask_polls;
+  }
+  now_hf += ACCESS_HF;
+  rtc = rtc_at(now_hf);
+  if (preempt_edges && (rtc != last_rtc)) {
+    --preempt_edges;
+    now_hf += PREEMPT_HF;
+    rtc = rtc_at(now_hf);
+  }
+  last_rtc = rtc;
+  xBSPACMuptimeState_.overflows = (unsigned int)(rtc >> 24);
+  test_rtc.COUNTER = RTC_COUNTER_MASK & (unsigned int)rtc;
+  hrt = now_hf >> test_timer.PRESCALER;
+  xBSPACMhiresState_.overflows = (unsigned int)(hrt >> BSPACM_HIRES_COUNTER_BITS);
+  test_timer.CC[0] = BSPACM_HIRES_COUNTER_MASK & (unsigned int)hrt;
+  test_timer.EVENTS_COMPARE[BSPACM_HIRES_OVERFLOW_CCIDX] = 0;
+}
+
+NRF_RTC_Type *
+test_rtc_access (void)
+{
+  advance();
+  return &test_rtc;
+}
+
+NRF_TIMER_Type *
+test_timer_access (void)
+{
+  advance();
+  return &test_timer;
+}
+
+bool
+bBSPACMhiresEnabled (void)
+{
+  return hires_enabled;
+}
+
+int
+iBSPACMuptimeAlarmSchedule (unsigned int when_utt,
+                            hBSPACMuptimeAlarm ap)
+{
+  if (ap->scheduled_) {
+    return -1;
+  }
+  ++schedules;
+  ap->when_utt = when_utt;
+  ap->scheduled_ = true;
+  return 0;
+}
+
+bool
+bBSPACMuptimeAlarmCancel (hBSPACMuptimeAlarm ap)
+{
+  bool const rv = ap->scheduled_;
+
+  ap->scheduled_ = false;
+  return rv;
+}
+
+static void
+reset (unsigned int prescaler,
+       long long ppb)
+{
+  memset(&calibration, 0, sizeof(calibration));
+  memset(&xBSPACMuptimeState_, 0, sizeof(xBSPACMuptimeState_));
+  xBSPACMuptimeState_.enabled = true;
+  hires_enabled = true;
+  test_timer.PRESCALER = prescaler;
+  skew_ppb = ppb;
+  now_hf = 1234567;
+  preempt_edges = 0;
+  primask_polls = 0;
+  schedules = 0;
+  advance();
+}
+
+/* Fire the calibration alarm once time reaches it.  Returns false if
+ * it is not scheduled. */
+static bool
+fire (void)
+{
+  hBSPACMuptimeAlarm const ap = &calibration.alarm;
+  unsigned long long when;
+
+  if (! ap->scheduled_) {
+    return false;
+  }
+  when = ullBSPACMuptime();
+  when += (int)(ap->when_utt - (unsigned int)when);
+  if (now_hf < hf_at(when)) {
+    now_hf = hf_at(when);
+    last_rtc = rtc_at(now_hf);
+  }
+  ap->scheduled_ = false;
+  in_callback = true;
+  ap->callback_flih(BSPACM_UPTIME_TIMER_CCIDX, ap);
+  in_callback = false;
+  return true;
+}
+
+/* Run a one-shot calibration to completion, with preempt_begin and
+ * preempt_end preempted edges at the start and end of the window. */
+static void
+run_once (unsigned int window_utt,
+          unsigned int preempt_begin,
+          unsigned int preempt_end)
+{
+  int rc = iBSPACMuptimeCalibrationStart(window_utt, 0);
+
+  CHECK(0 == rc, "start failed %d", rc);
+  preempt_edges = preempt_begin;
+  while (fire() && ! calibration.measuring) {
+  }
+  preempt_edges = preempt_end;
+  while (fire()) {
+  }
+  CHECK(! calibration.active, "calibration still active");
+}
+
+static void
+test_accuracy (void)
+{
+  static const long long ppbs[] = { -500000, -37500, 0, 20000, 250000, 900000 };
+  static const struct {
+    unsigned int prescaler;
+    int tolerance_ppb;
+  } rates[] = {
+    { 0, 100 },                 /* 16 MHz */
+    { 4, 250 },                 /* 1 MHz */
+  };
+  unsigned int const window_utt = 5 * BSPACM_UPTIME_Hz;
+  unsigned int ri;
+  unsigned int pi;
+
+  for (ri = 0; ri < sizeof(rates) / sizeof(*rates); ++ri) {
+    int worst = 0;
+
+    for (pi = 0; pi < sizeof(ppbs) / sizeof(*ppbs); ++pi) {
+      int err;
+
+      reset(rates[ri].prescaler, ppbs[pi]);
+      run_once(window_utt, 0, 0);
+      err = iBSPACMuptimeCalibration_ppb() - (int)ppbs[pi];
+      CHECK(rates[ri].tolerance_ppb >= abs(err), "prescaler %u at %lld ppb measured %d ppb",
+            rates[ri].prescaler, ppbs[pi], iBSPACMuptimeCalibration_ppb());
+      CHECK(0 == primask_polls, "%u peripheral accesses with interrupts disabled", primask_polls);
+      CHECK(2 == schedules, "%u alarms scheduled", schedules);
+      if (abs(err) > worst) {
+        worst = abs(err);
+      }
+    }
+    printf("Prescaler %u, %u s window: worst error %d ppb\n",
+           rates[ri].prescaler, window_utt / BSPACM_UPTIME_Hz, worst);
+  }
+}
+
+static void
+test_preempt (void)
+{
+  static const struct {
+    unsigned int begin;
+    unsigned int end;
+    unsigned int schedules;
+  } cases[] = {
+    /* A preempted edge is skipped and the next one used. */
+    { EDGE_ATTEMPTS - 1, 0, 2 },
+    { 0, EDGE_ATTEMPTS - 1, 2 },
+    /* Preempted at every attempt: the sample is retried later. */
+    { EDGE_ATTEMPTS, 0, 3 },
+    { 0, EDGE_ATTEMPTS, 3 },
+    { EDGE_ATTEMPTS, EDGE_ATTEMPTS, 4 },
+  };
+  unsigned int const window_utt = 5 * BSPACM_UPTIME_Hz;
+  long long const ppb = 37500;
+  unsigned int ci;
+
+  for (ci = 0; ci < sizeof(cases) / sizeof(*cases); ++ci) {
+    reset(0, ppb);
+    run_once(window_utt, cases[ci].begin, cases[ci].end);
+    CHECK(100 >= abs(iBSPACMuptimeCalibration_ppb() - (int)ppb), "case %u measured %d ppb",
+          ci, iBSPACMuptimeCalibration_ppb());
+    CHECK(cases[ci].schedules == schedules, "case %u scheduled %u alarms", ci, schedules);
+    CHECK(0 == primask_polls, "%u peripheral accesses with interrupts disabled", primask_polls);
+  }
+}
+
+static void
+test_api (void)
+{
+  reset(0, 0);
+  CHECK(0 > iBSPACMuptimeCalibrationStart(0, 0), "zero window accepted");
+  CHECK(0 > iBSPACMuptimeCalibrationStart(1U << 23, 0), "oversize window accepted");
+  CHECK(0 > iBSPACMuptimeCalibrationStart(1000, 999), "short interval accepted");
+  hires_enabled = false;
+  CHECK(0 > iBSPACMuptimeCalibrationStart(1000, 0), "started without hires");
+  hires_enabled = true;
+  xBSPACMuptimeState_.enabled = false;
+  CHECK(0 > iBSPACMuptimeCalibrationStart(1000, 0), "started without uptime");
+  xBSPACMuptimeState_.enabled = true;
+
+  /* Periodic: after a window the next starts an interval after the
+   * previous began; stop cancels it. */
+  CHECK(0 == iBSPACMuptimeCalibrationStart(1000, 5000), "periodic start");
+  CHECK(0 > iBSPACMuptimeCalibrationStart(1000, 5000), "second start accepted");
+  (void)fire();
+  (void)fire();
+  CHECK(calibration.active && calibration.alarm.scheduled_, "periodic not rescheduled");
+  CHECK(calibration.begin_utt + 5000 == calibration.alarm.when_utt, "next window at %d",
+        (int)(calibration.alarm.when_utt - calibration.begin_utt));
+  vBSPACMuptimeCalibrationStop();
+  CHECK(! calibration.active && ! calibration.alarm.scheduled_, "stop did not cancel");
+
+  /* Beyond the plausible range the result is discarded. */
+  reset(0, 1500000);
+  xBSPACMuptimeState_.calibration_q32 = 42;
+  run_once(1000, 0, 0);
+  CHECK(42 == xBSPACMuptimeState_.calibration_q32, "implausible rate accepted");
+
+  /* Losing hires mid-window abandons the measurement. */
+  reset(0, 0);
+  CHECK(0 == iBSPACMuptimeCalibrationStart(1000, 0), "start");
+  (void)fire();
+  hires_enabled = false;
+  (void)fire();
+  CHECK(! calibration.active && ! calibration.measuring, "not abandoned");
+  CHECK(0 == primask_polls, "%u peripheral accesses with interrupts disabled", primask_polls);
+}
+
+int
+main (void)
+{
+  test_accuracy();
+  test_preempt();
+  test_api();
+  if (failures) {
+    printf("%u failures\n", failures);
+    return 1;
+  }
+  printf("All checks passed\n");
+  return 0;
+}
@@ -0,0 +1,235 @@
+/* BSPACM - host test of the nRF51 wall-clock time service
+ *
+ * Written in 2014 by Peter A. Bigot <http://pabigot.github.io/bspacm/>
+ *
+ * To the extent possible under law, the author(s) have dedicated all
+ * copyright and related and neighboring rights to this software to
+ * the public domain worldwide. This software is distributed without
+ * any warranty.
+ *
+ * You should have received a copy of the CC0 Public Domain Dedication
+ * along with this software. If not, see
+ * <http://creativecommons.org/publicdomain/zero/1.0/>.
+ */
+
+/* Builds walltime.c against a simulated uptime clock driven by a
+ * crystal 37.5 ppm slow.  With a synchronization point every hour,
+ * the prediction an hour after each (once a rate has been learned)
+ * must be within 2 us of the reference, and the learned rate within a
+ * few ppb of the truth.  Also checked: the first point adopts the
+ * uptime calibration, a bogus point or one too close to its
+ * predecessor leaves the rate unchanged, times before the last point
+ * convert without correction, a reader interrupted by an update
+ * retries and returns the updated result, and the POSIX clock
+ * functions agree with llBSPACMwalltime_us(). */
+
+#include "walltime.c"
+#include <stdio.h>
+#include <string.h>
+
+unsigned int test_primask;
+void (* test_sleep_hook) (void);
+void (* test_dmb_hook) (void);
+NRF_RTC_Type test_rtc;
+sBSPACMuptimeState xBSPACMuptimeState_;
+
+#define SLOW_PPB 37500
+#define EPOCH_US 1400000000000000LL
+#define HOUR_UTT (3600ULL * BSPACM_UPTIME_Hz)
+
+static unsigned int failures;
+
+#define CHECK(cond_, ...) do {                  \
+    if (! (cond_)) {                            \
+      ++failures;                               \
+      printf("FAIL %s:%d: ", __FILE__, __LINE__); \
+      printf(__VA_ARGS__);                      \
+      putchar('\n');                            \
+    }                                           \
+  } while (0)
+
+static void
+set_now (unsigned long long t)
+{
+  xBSPACMuptimeState_.overflows = (unsigned int)(t >> 24);
+  test_rtc.COUNTER = 0xFFFFFF & (unsigned int)t;
+}
+
+/* Reference time at which the slow uptime clock reaches utt, to the
+ * nearest microsecond. */
+static long long
+reference_us (unsigned long long utt)
+{
+  __int128 const num = (__int128)utt * (1000000000LL + SLOW_PPB) * 1000000;
+  __int128 const den = (__int128)BSPACM_UPTIME_Hz * 1000000000LL;
+
+  return EPOCH_US + (long long)((num + den / 2) / den);
+}
+
+static void
+reset (void)
+{
+  memset(&xBSPACMwalltimeState_, 0, sizeof(xBSPACMwalltimeState_));
+  memset(&xBSPACMuptimeState_, 0, sizeof(xBSPACMuptimeState_));
+  test_dmb_hook = NULL;
+}
+
+static long long
+llabs_ (long long v)
+{
+  return (0 > v) ? -v : v;
+}
+
+static void
+test_drift (void)
+{
+  unsigned long long const t0 = 12345;
+  long long worst = 0;
+  unsigned int k;
+
+  reset();
+  CHECK(! bBSPACMwalltimeValid(), "valid before first sync");
+  for (k = 0; k < 8; ++k) {
+    unsigned long long const sync_utt = t0 + k * HOUR_UTT;
+    unsigned long long const probe_utt = sync_utt + HOUR_UTT;
+    long long err;
+
+    vBSPACMwalltimeSync(sync_utt, reference_us(sync_utt));
+    CHECK(0 == test_primask, "sync left interrupts disabled");
+    CHECK(reference_us(sync_utt) == llBSPACMwalltimeFromUptime_us(sync_utt),
+          "not stepped to reference at sync %u", k);
+    err = llBSPACMwalltimeFromUptime_us(probe_utt) - reference_us(probe_utt);
+    if (0 < k) {
+      if (llabs_(err) > worst) {
+        worst = llabs_(err);
+      }
+    }
+  }
+  CHECK(bBSPACMwalltimeValid(), "not valid after sync");
+  CHECK(2 >= worst, "prediction error %lld us", worst);
+  CHECK(3 >= llabs_(iBSPACMwalltimeRate_ppb() - SLOW_PPB), "learned %d ppb",
+        iBSPACMwalltimeRate_ppb());
+  printf("Hourly sync at %d ppb slow: worst error %lld us, learned %d ppb\n",
+         SLOW_PPB, worst, iBSPACMwalltimeRate_ppb());
+}
+
+static void
+test_rejections (void)
+{
+  unsigned long long const t0 = 1000;
+  long rate_q32;
+  unsigned long long utt;
+
+  reset();
+  /* The first point adopts the uptime calibration. */
+  xBSPACMuptimeState_.calibration_q32 = 123456;
+  vBSPACMwalltimeSync(t0, reference_us(t0));
+  CHECK(123456 == xBSPACMwalltimeState_.rate_q32, "calibration not adopted");
+  vBSPACMwalltimeSync(t0 + HOUR_UTT, reference_us(t0 + HOUR_UTT));
+  rate_q32 = xBSPACMwalltimeState_.rate_q32;
+  CHECK(123456 != rate_q32, "rate not estimated");
+
+  /* A point 10 s wrong an hour later implies 2778 ppm. */
+  utt = t0 + 2 * HOUR_UTT;
+  vBSPACMwalltimeSync(utt, reference_us(utt) + 10000000);
+  CHECK(rate_q32 == xBSPACMwalltimeState_.rate_q32, "bogus point changed rate");
+  CHECK(reference_us(utt) + 10000000 == llBSPACMwalltimeFromUptime_us(utt),
+        "bogus point did not step the offset");
+
+  /* A point too soon after its predecessor only steps the offset. */
+  utt += BSPACM_WALLTIME_RATE_MINIMUM_INTERVAL_UTT - 1;
+  vBSPACMwalltimeSync(utt, reference_us(utt));
+  CHECK(rate_q32 == xBSPACMwalltimeState_.rate_q32, "short interval changed rate");
+  CHECK(reference_us(utt) == llBSPACMwalltimeFromUptime_us(utt), "offset not stepped");
+
+  /* Earlier times convert at the nominal rate. */
+  CHECK(reference_us(utt) - (long long)ullBSPACMuptimeConvert_utt_us(HOUR_UTT)
+        == llBSPACMwalltimeFromUptime_us(utt - HOUR_UTT), "backward conversion");
+}
+
+/* Sequence lock: run a sync from the reader's second barrier, after
+ * it has loaded a now stale snapshot. */
+
+static unsigned long long update_utt;
+static long long update_us;
+static unsigned int dmb_calls;
+static bool writer_saw_even;
+
+static void
+writer_dmb (void)
+{
+  if (0 == (1 & xBSPACMwalltimeState_.sequence)) {
+    writer_saw_even = true;
+  }
+}
+
+static void
+interrupting_dmb (void)
+{
+  if (2 == ++dmb_calls) {
+    test_dmb_hook = writer_dmb;
+    vBSPACMwalltimeSync(update_utt, update_us);
+    test_dmb_hook = interrupting_dmb;
+  }
+}
+
+static void
+test_seqlock (void)
+{
+  unsigned long long const probe_utt = 5 * HOUR_UTT;
+  long long got;
+  long long expect;
+
+  reset();
+  vBSPACMwalltimeSync(1000, EPOCH_US);
+  update_utt = 2000;
+  update_us = EPOCH_US + 99000000;
+  dmb_calls = 0;
+  writer_saw_even = false;
+  test_dmb_hook = interrupting_dmb;
+  got = llBSPACMwalltimeFromUptime_us(probe_utt);
+  test_dmb_hook = NULL;
+  expect = llBSPACMwalltimeFromUptime_us(probe_utt);
+  CHECK(got == expect, "interrupted read returned %lld, expected %lld", got, expect);
+  CHECK(4 == dmb_calls, "reader made %u passes", dmb_calls / 2);
+  CHECK(! writer_saw_even, "sequence even during update");
+  CHECK(0 == (1 & xBSPACMwalltimeState_.sequence), "sequence odd after update");
+}
+
+static void
+test_posix (void)
+{
+  struct timeval tv;
+  struct timespec ts;
+  long long now_us;
+
+  reset();
+  set_now(7 * HOUR_UTT + 12345);
+  vBSPACMwalltimeSync(HOUR_UTT, EPOCH_US + 123456);
+  now_us = llBSPACMwalltime_us();
+  CHECK(0 == _gettimeofday(&tv, NULL), "_gettimeofday failed");
+  CHECK(now_us == (tv.tv_sec * 1000000LL + tv.tv_usec), "_gettimeofday disagrees");
+  CHECK(0 == clock_gettime(CLOCK_REALTIME, &ts), "CLOCK_REALTIME failed");
+  CHECK(now_us * 1000 == (ts.tv_sec * 1000000000LL + ts.tv_nsec), "CLOCK_REALTIME disagrees");
+  CHECK(0 == clock_gettime(CLOCK_MONOTONIC, &ts), "CLOCK_MONOTONIC failed");
+  CHECK(1000 * (long long)ullBSPACMuptimeConvert_utt_us(ullBSPACMuptime())
+        == (ts.tv_sec * 1000000000LL + ts.tv_nsec), "CLOCK_MONOTONIC disagrees");
+  errno = 0;
+  CHECK((-1 == clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts)) && (EINVAL == errno),
+        "unsupported clock accepted");
+}
+
+int
+main (void)
+{
+  test_drift();
+  test_rejections();
+  test_seqlock();
+  test_posix();
+  if (failures) {
+    printf("%u failures\n", failures);
+    return 1;
+  }
+  printf("All checks passed\n");
+  return 0;
+}
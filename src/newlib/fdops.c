@@ -98,6 +98,150 @@ vBSPACMnewlibFDOPSinitializeStdio_ (void)
   }
 }
 
+#if (BSPACM_NEWLIB_FDOPS_DEVICE_INDEX_SIZE & (BSPACM_NEWLIB_FDOPS_DEVICE_INDEX_SIZE - 1))
+#error BSPACM_NEWLIB_FDOPS_DEVICE_INDEX_SIZE must be a power of two
+#endif /* BSPACM_NEWLIB_FDOPS_DEVICE_INDEX_SIZE */
+
+/* Open-addressed hash index into xBSPACMnewlibFDOPSdevice.  A zero
+ * slot is empty; otherwise the slot holds one plus the ordinal of the
+ * device in the table. */
+static uint8_t device_index_[BSPACM_NEWLIB_FDOPS_DEVICE_INDEX_SIZE];
+
+/* Ordinal of the first device that did not fit in device_index_.
+ * Devices from this one on are located by linear search. */
+static uint8_t device_unindexed_;
+
+#define FD_MAP_WORDS ((BSPACM_NEWLIB_FDOPS_FILE_LIMIT + 31) / 32)
+
+/* Bit (31 - (fd % 32)) of word (fd / 32) is set iff descriptor fd is
+ * inactive.  Most-significant-first order means counting leading
+ * zeros yields the least inactive descriptor in a word. */
+static uint32_t fd_map_[FD_MAP_WORDS];
+
+/* The number of descriptors tracked in fd_map_. */
+static unsigned int
+fd_limit_ (void)
+{
+  if (BSPACM_NEWLIB_FDOPS_FILE_LIMIT < nBSPACMnewlibFDOPSfile) {
+    return BSPACM_NEWLIB_FDOPS_FILE_LIMIT;
+  }
+  return nBSPACMnewlibFDOPSfile;
+}
+
+static BSPACM_CORE_INLINE
+void
+fd_map_set_ (unsigned int fd,
+             bool inactive)
+{
+  uint32_t const bit = 0x80000000U >> (fd % 32);
+  if (inactive) {
+    fd_map_[fd / 32] |= bit;
+  } else {
+    fd_map_[fd / 32] &= ~bit;
+  }
+}
+
+/* Rebuild the descriptor map from the handle table. */
+static void
+fd_map_sync_ (void)
+{
+  unsigned int const limit = fd_limit_();
+  unsigned int fd;
+
+  memset(fd_map_, 0, sizeof(fd_map_));
+  for (fd = 0; fd < limit; ++fd) {
+    if (! xBSPACMnewlibFDOPSfile_[fd]) {
+      fd_map_set_(fd, true);
+    }
+  }
+}
+
+/* Return the least inactive descriptor, or -1 if all are active. */
+static int
+fd_map_first_ (void)
+{
+  unsigned int wi;
+
+  for (wi = 0; wi < FD_MAP_WORDS; ++wi) {
+    if (fd_map_[wi]) {
+      return (32 * wi) + __builtin_clz(fd_map_[wi]);
+    }
+  }
+  return -1;
+}
+
+static uint32_t
+path_hash_ (const char * sp)
+{
+  uint32_t h = 5381;
+  while (*sp) {
+    h = ((h << 5) + h) ^ (uint8_t)*sp++;
+  }
+  return h;
+}
+
+/* Inline compare is much smaller than strcmp; see
+ * fBSPACMnewlibFDOPSdriverCONSOLE(). */
+static bool
+path_equal_ (const char * s1,
+             const char * s2)
+{
+  while (*s1 && (*s1 == *s2)) {
+    ++s1;
+    ++s2;
+  }
+  return *s1 == *s2;
+}
+
+static void
+device_index_build_ (void)
+{
+  const sBSPACMnewlibFDOPSdevice * devp = xBSPACMnewlibFDOPSdevice;
+  unsigned int ordinal = 0;
+
+  memset(device_index_, 0, sizeof(device_index_));
+  while ((ordinal < BSPACM_NEWLIB_FDOPS_DEVICE_INDEX_SIZE)
+         && (ordinal < UINT8_MAX)
+         && devp->name) {
+    unsigned int slot = path_hash_(devp->name);
+    while (device_index_[slot %= BSPACM_NEWLIB_FDOPS_DEVICE_INDEX_SIZE]) {
+      ++slot;
+    }
+    device_index_[slot] = ++ordinal;
+    ++devp;
+  }
+  device_unindexed_ = ordinal;
+}
+
+static const sBSPACMnewlibFDOPSdevice *
+device_lookup_ (const char * pathname)
+{
+  const sBSPACMnewlibFDOPSdevice * devp;
+  unsigned int slot = path_hash_(pathname);
+  unsigned int probes = BSPACM_NEWLIB_FDOPS_DEVICE_INDEX_SIZE;
+
+  while (0 < probes--) {
+    unsigned int ordinal = device_index_[slot++ % BSPACM_NEWLIB_FDOPS_DEVICE_INDEX_SIZE];
+    if (! ordinal) {
+      break;
+    }
+    devp = xBSPACMnewlibFDOPSdevice + ordinal - 1;
+    if (path_equal_(devp->name, pathname)) {
+      return devp;
+    }
+  }
+  devp = xBSPACMnewlibFDOPSdevice + device_unindexed_;
+  if (BSPACM_NEWLIB_FDOPS_DEVICE_INDEX_SIZE <= device_unindexed_) {
+    while (devp->name) {
+      if (path_equal_(devp->name, pathname)) {
+        return devp;
+      }
+      ++devp;
+    }
+  }
+  return NULL;
+}
+
 static unsigned char stdio_initialized_;
 
 static void
@@ -105,7 +249,12 @@ initialize_stdio_ ()
 {
   if (! stdio_initialized_) {
     stdio_initialized_ = 1;
+    device_index_build_();
+    fd_map_sync_();
     vBSPACMnewlibFDOPSinitializeStdio_();
+    /* The stdio initializer may reserve descriptors by storing
+     * directly into the handle table. */
+    fd_map_sync_();
   }
 }
 
@@ -123,7 +272,7 @@ validated_handle (int fd)
     initialize_stdio_();
   }
   do {
-    if (fd >= nBSPACMnewlibFDOPSfile) {
+    if ((0 > fd) || (fd >= nBSPACMnewlibFDOPSfile)) {
       errno = EBADF;
       break;
     }
@@ -148,18 +297,33 @@ _open (const char * pathname,
   do {
     int fd;
     const fBSPACMnewlibFDOPSdriver * dp = xBSPACMnewlibFDOPSdriver;
+    const sBSPACMnewlibFDOPSdevice * devp;
     hBSPACMnewlibFDOPSfile fh;
 
-    /* Search for an open descriptor */
-    for (fd = 0; fd < nBSPACMnewlibFDOPSfile; ++fd) {
-      if (! xBSPACMnewlibFDOPSfile_[fd]) {
-        break;
-      }
-    }
-    if (nBSPACMnewlibFDOPSfile <= fd) {
+    /* Find the least inactive descriptor */
+    fd = fd_map_first_();
+    if (0 > fd) {
       errno = ENFILE;
       break;
     }
+    if (! pathname) {
+      errno = EFAULT;
+      break;
+    }
+
+    /* A device registered under this path is the only candidate; its
+     * driver's errno is preserved on failure. */
+    devp = device_lookup_(pathname);
+    if (devp) {
+      fh = devp->driver(pathname, flags);
+      if (fh && fh->ops) {
+        xBSPACMnewlibFDOPSfile_[fd] = fh;
+        fd_map_set_(fd, false);
+        errno = 0;
+        rv = fd;
+      }
+      break;
+    }
 
     /* Search for a driver able to create a handle for the device */
     errno = ENODEV;
@@ -168,6 +332,7 @@ _open (const char * pathname,
       /* Only accept handles that will pass basic validation. */
       if (fh && fh->ops) {
         xBSPACMnewlibFDOPSfile_[fd] = fh;
+        fd_map_set_(fd, false);
         errno = 0;
         rv = fd;
         break;
@@ -192,6 +357,9 @@ _close (int fd)
     /* Remove the descriptor from the table, regardless of
      * success/failure of the close operation. */
     xBSPACMnewlibFDOPSfile_[fd] = 0;
+    if (fd < fd_limit_()) {
+      fd_map_set_(fd, true);
+    }
     if (! fh->ops->op_close) {
       errno = ENOSYS;
       break;
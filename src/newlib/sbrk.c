@@ -73,35 +73,59 @@ _bspacm_sbrk_error (void * brk,
   }
 }
 
+sBSPACMnewlibSbrkStatistics xBSPACMnewlibSbrkStatistics_;
+
 /* Implement allocation with a policy-dependent upper bound. */
 static BSPACM_CORE_INLINE_FORCED
 void *
 common_sbrk (char * const upper_bound,
              ptrdiff_t increment)
 {
-  static char * brk;        /* the current program break */
+  sBSPACMnewlibSbrkStatistics * const sp = &xBSPACMnewlibSbrkStatistics_;
   extern char end;          /* symbol at which heap starts */
+  char * brk = sp->brk;     /* the current program break */
   char * nbrk;
   void * rv;
 
   if (0 == brk) {
-    brk = &end;
+    brk = sp->max_brk = &end;
+  }
+#if (0 < BSPACM_NEWLIB_SBRK_TRACE_LENGTH)
+  sp->trace[sp->calls % BSPACM_NEWLIB_SBRK_TRACE_LENGTH] = increment;
+#endif /* BSPACM_NEWLIB_SBRK_TRACE_LENGTH */
+  sp->calls += 1;
+  if (increment > sp->max_increment) {
+    sp->max_increment = increment;
   }
   nbrk = increment + brk;
-  if (upper_bound < nbrk) {
+  /* A zero increment only queries the break, so it never fails. */
+  if ((0 != increment) && (upper_bound < nbrk)) {
+    sp->brk = brk;
+    sp->failures += 1;
     return _bspacm_sbrk_error(brk, brk - &end, increment);
   }
   rv = brk;
-  brk = nbrk;
+  sp->brk = nbrk;
+  if (nbrk > sp->max_brk) {
+    sp->max_brk = nbrk;
+  }
   return rv;
 }
 
 /** An sbrk() implementation that rejects any attempt to allocate
  * memory dynamically.  The behavior is equivalent to
- * _bspacm_sbrk_heap() with a zero-sized heap. */
+ * _bspacm_sbrk_heap() with a zero-sized heap.  A zero @p increment
+ * only queries the break, and returns the start of the heap. */
 void *
 _bspacm_sbrk_fatal (ptrdiff_t increment)
 {
+  extern char end;          /* symbol at which heap starts */
+
+  xBSPACMnewlibSbrkStatistics_.calls += 1;
+  if (0 == increment) {
+    return &end;
+  }
+  xBSPACMnewlibSbrkStatistics_.failures += 1;
   return _bspacm_sbrk_error(0, 0, increment);
 }
 
@@ -0,0 +1,581 @@
+/* Copyright 2014, Peter A. Bigot
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of the software nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without
+ *   specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/** @file
+ *
+ * @brief Two-Level Segregated Fit memory allocator
+ *
+ * Each block is preceded by a header holding a pointer to the
+ * physically preceding block and the size of the block payload.  The
+ * low bit of the size marks a free block.  Free blocks additionally
+ * hold links for a doubly-linked list in their payload.  Free lists
+ * are segregated by size: the first level by power of two, the second
+ * by a linear subdivision of that power.  Bitmaps over both levels
+ * allow the smallest suitable non-empty list to be located with two
+ * find-first-set operations.
+ *
+ * The heap ends with a zero-sized allocated sentinel block, so every
+ * real block has a physical successor.
+ *
+ * @homepage http://github.com/pabigot/bspacm
+ * @copyright Copyright 2014, Peter A. Bigot.  Licensed under <a href="http://www.opensource.org/licenses/BSD-3-Clause">BSD-3-Clause</a>
+ */
+
+#include <bspacm/newlib/tlsf.h>
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+
+#define ALIGN_LOG2 3
+#define ALIGN_SIZE (1U << ALIGN_LOG2)
+#define SL_LOG2 BSPACM_NEWLIB_TLSF_SL_LOG2
+#define SL_COUNT (1U << SL_LOG2)
+#define FL_SHIFT (SL_LOG2 + ALIGN_LOG2)
+#define FL_COUNT (BSPACM_NEWLIB_TLSF_FL_LOG2 - FL_SHIFT + 1)
+#define SMALL_BLOCK_SIZE (1U << FL_SHIFT)
+
+#define BLOCK_FREE 0x01
+#define BLOCK_SIZE_MASK (~(size_t)(ALIGN_SIZE - 1))
+
+typedef struct sBlock {
+  /* The physically preceding block, or null for the first block */
+  struct sBlock * prev_phys;
+  /* Size of the payload, with BLOCK_FREE in the low bit */
+  size_t size;
+  /* Free list links, valid only while the block is free */
+  struct sBlock * next_free;
+  struct sBlock * prev_free;
+} sBlock;
+
+/* Free list blocks examined per interrupt-disabled section when
+ * vBSPACMnewlibTLSFstatistics() looks for the largest free block, and
+ * the number of times it restarts that search if the heap changes
+ * between sections. */
+#define STATISTICS_CHUNK 8
+#define STATISTICS_RETRIES 4
+
+#define BLOCK_OVERHEAD offsetof(sBlock, next_free)
+#define BLOCK_SIZE_MIN (sizeof(sBlock) - BLOCK_OVERHEAD)
+#define BLOCK_SIZE_MAX ((size_t)1 << BSPACM_NEWLIB_TLSF_FL_LOG2)
+
+static struct sControl {
+  sBlock * first;
+  size_t heap_size;
+  size_t used;
+  size_t max_used;
+  size_t free;
+  unsigned int free_blocks;
+  unsigned int used_blocks;
+  unsigned int failures;
+  /* Incremented on every free list change */
+  unsigned int generation;
+  unsigned int fl_bitmap;
+  unsigned int sl_bitmap[FL_COUNT];
+  sBlock * blocks[FL_COUNT][SL_COUNT];
+} control_;
+
+static BSPACM_CORE_INLINE
+unsigned int
+ffs_ (unsigned int word)
+{
+  return __builtin_ctz(word);
+}
+
+static BSPACM_CORE_INLINE
+unsigned int
+fls_ (size_t word)
+{
+  return (8 * sizeof(unsigned int) - 1) - __builtin_clz(word);
+}
+
+static BSPACM_CORE_INLINE
+size_t
+block_size (const sBlock * bp)
+{
+  return bp->size & BLOCK_SIZE_MASK;
+}
+
+static BSPACM_CORE_INLINE
+void *
+block_payload (sBlock * bp)
+{
+  return BLOCK_OVERHEAD + (char *)bp;
+}
+
+static BSPACM_CORE_INLINE
+sBlock *
+block_from_payload (void * ptr)
+{
+  return (sBlock *)((char *)ptr - BLOCK_OVERHEAD);
+}
+
+static BSPACM_CORE_INLINE
+sBlock *
+block_next (sBlock * bp)
+{
+  return (sBlock *)(block_size(bp) + (char *)block_payload(bp));
+}
+
+static BSPACM_CORE_INLINE
+void
+mapping_insert (size_t size,
+                unsigned int * flp,
+                unsigned int * slp)
+{
+  unsigned int fl;
+  unsigned int sl;
+
+  if (size < SMALL_BLOCK_SIZE) {
+    fl = 0;
+    sl = size / (SMALL_BLOCK_SIZE / SL_COUNT);
+  } else {
+    fl = fls_(size);
+    sl = (size >> (fl - SL_LOG2)) ^ SL_COUNT;
+    fl -= (FL_SHIFT - 1);
+  }
+  *flp = fl;
+  *slp = sl;
+}
+
+/* Like mapping_insert, but rounds up so that any block on the
+ * resulting list (or a larger one) satisfies the request. */
+static BSPACM_CORE_INLINE
+void
+mapping_search (size_t size,
+                unsigned int * flp,
+                unsigned int * slp)
+{
+  if (size >= SMALL_BLOCK_SIZE) {
+    size += (1U << (fls_(size) - SL_LOG2)) - 1;
+  }
+  mapping_insert(size, flp, slp);
+}
+
+static void
+insert_free_block (sBlock * bp)
+{
+  unsigned int fl;
+  unsigned int sl;
+  sBlock * headp;
+
+  mapping_insert(block_size(bp), &fl, &sl);
+  headp = control_.blocks[fl][sl];
+  bp->size |= BLOCK_FREE;
+  bp->next_free = headp;
+  bp->prev_free = 0;
+  if (headp) {
+    headp->prev_free = bp;
+  }
+  control_.blocks[fl][sl] = bp;
+  control_.fl_bitmap |= (1U << fl);
+  control_.sl_bitmap[fl] |= (1U << sl);
+  control_.free += block_size(bp);
+  control_.free_blocks += 1;
+  control_.generation += 1;
+}
+
+static void
+remove_free_block (sBlock * bp)
+{
+  unsigned int fl;
+  unsigned int sl;
+
+  mapping_insert(block_size(bp), &fl, &sl);
+  if (bp->next_free) {
+    bp->next_free->prev_free = bp->prev_free;
+  }
+  if (bp->prev_free) {
+    bp->prev_free->next_free = bp->next_free;
+  } else {
+    control_.blocks[fl][sl] = bp->next_free;
+    if (! bp->next_free) {
+      control_.sl_bitmap[fl] &= ~(1U << sl);
+      if (! control_.sl_bitmap[fl]) {
+        control_.fl_bitmap &= ~(1U << fl);
+      }
+    }
+  }
+  bp->size &= ~BLOCK_FREE;
+  control_.free -= block_size(bp);
+  control_.free_blocks -= 1;
+  control_.generation += 1;
+}
+
+static sBlock *
+search_suitable_block (size_t size)
+{
+  unsigned int fl;
+  unsigned int sl;
+  unsigned int sl_map;
+
+  mapping_search(size, &fl, &sl);
+  if (FL_COUNT <= fl) {
+    return 0;
+  }
+  sl_map = control_.sl_bitmap[fl] & (~0U << sl);
+  if (! sl_map) {
+    unsigned int fl_map = control_.fl_bitmap & (~0U << (fl + 1));
+    if (! fl_map) {
+      return 0;
+    }
+    fl = ffs_(fl_map);
+    sl_map = control_.sl_bitmap[fl];
+  }
+  sl = ffs_(sl_map);
+  return control_.blocks[fl][sl];
+}
+
+/* Absorb the physical successor of bp, which must be free, into bp.
+ * bp must not be on a free list. */
+static void
+merge_next (sBlock * bp)
+{
+  sBlock * np = block_next(bp);
+
+  remove_free_block(np);
+  bp->size += block_size(np) + BLOCK_OVERHEAD;
+  block_next(bp)->prev_phys = bp;
+}
+
+/* Reduce the allocated block bp to size, returning any excess of
+ * sufficient size to the free lists. */
+static void
+trim_used (sBlock * bp,
+           size_t size)
+{
+  size_t bsize = block_size(bp);
+  sBlock * rp;
+
+  if (bsize < (size + sizeof(sBlock))) {
+    return;
+  }
+  rp = (sBlock *)(size + (char *)block_payload(bp));
+  rp->prev_phys = bp;
+  rp->size = bsize - size - BLOCK_OVERHEAD;
+  bp->size = size | (bp->size & ~BLOCK_SIZE_MASK);
+  block_next(rp)->prev_phys = rp;
+  if (BLOCK_FREE & block_next(rp)->size) {
+    merge_next(rp);
+  }
+  insert_free_block(rp);
+}
+
+static BSPACM_CORE_INLINE
+size_t
+adjust_request (size_t size)
+{
+  if (BLOCK_SIZE_MAX <= size) {
+    return 0;
+  }
+  size = (size + ALIGN_SIZE - 1) & BLOCK_SIZE_MASK;
+  if (size < BLOCK_SIZE_MIN) {
+    size = BLOCK_SIZE_MIN;
+  }
+  return size;
+}
+
+/* Claim the reserved heap on first use. */
+static int
+initialize (void)
+{
+  extern char __HeapLimit;  /* symbol placed just past end of heap */
+  char * brk = sbrk(0);
+  uintptr_t start = ((uintptr_t)brk + ALIGN_SIZE - 1) & BLOCK_SIZE_MASK;
+  uintptr_t limit = (uintptr_t)&__HeapLimit & BLOCK_SIZE_MASK;
+  size_t payload;
+  sBlock * bp;
+  sBlock * sentinel;
+
+  /* Need room for one minimal block plus the sentinel header */
+  if ((limit <= start)
+      || ((limit - start) < (sizeof(sBlock) + BLOCK_OVERHEAD))) {
+    return -1;
+  }
+  if ((void *)-1 == sbrk(limit - (uintptr_t)brk)) {
+    return -1;
+  }
+  payload = limit - start - 2 * BLOCK_OVERHEAD;
+  if (BLOCK_SIZE_MAX <= payload) {
+    payload = BLOCK_SIZE_MAX - ALIGN_SIZE;
+  }
+  bp = (sBlock *)start;
+  bp->prev_phys = 0;
+  bp->size = payload;
+  sentinel = block_next(bp);
+  sentinel->prev_phys = bp;
+  sentinel->size = 0;
+  insert_free_block(bp);
+  control_.first = bp;
+  control_.heap_size = (char *)sentinel + BLOCK_OVERHEAD - (char *)bp;
+  return 0;
+}
+
+/* Allocate with interrupts disabled by the caller. */
+static void *
+malloc_ni (size_t size)
+{
+  size_t adjusted = adjust_request(size);
+  sBlock * bp;
+
+  if ((! control_.first) && (0 != initialize())) {
+    return 0;
+  }
+  bp = adjusted ? search_suitable_block(adjusted) : 0;
+  if (! bp) {
+    control_.failures += 1;
+    return 0;
+  }
+  remove_free_block(bp);
+  trim_used(bp, adjusted);
+  control_.used += block_size(bp);
+  control_.used_blocks += 1;
+  if (control_.used > control_.max_used) {
+    control_.max_used = control_.used;
+  }
+  return block_payload(bp);
+}
+
+/* Release with interrupts disabled by the caller. */
+static void
+free_ni (void * ptr)
+{
+  sBlock * bp = block_from_payload(ptr);
+  sBlock * pp = bp->prev_phys;
+
+  control_.used -= block_size(bp);
+  control_.used_blocks -= 1;
+  if (BLOCK_FREE & block_next(bp)->size) {
+    merge_next(bp);
+  }
+  if (pp && (BLOCK_FREE & pp->size)) {
+    remove_free_block(pp);
+    pp->size += block_size(bp) + BLOCK_OVERHEAD;
+    block_next(pp)->prev_phys = pp;
+    bp = pp;
+  }
+  insert_free_block(bp);
+}
+
+void *
+_bspacm_tlsf_malloc (size_t size)
+{
+  BSPACM_CORE_SAVED_INTERRUPT_STATE(istate);
+  void * rv;
+
+  BSPACM_CORE_DISABLE_INTERRUPT();
+  rv = malloc_ni(size);
+  BSPACM_CORE_REENABLE_INTERRUPT(istate);
+  if (! rv) {
+    errno = ENOMEM;
+  }
+  return rv;
+}
+
+void
+_bspacm_tlsf_free (void * ptr)
+{
+  BSPACM_CORE_SAVED_INTERRUPT_STATE(istate);
+
+  if (ptr) {
+    BSPACM_CORE_DISABLE_INTERRUPT();
+    free_ni(ptr);
+    BSPACM_CORE_REENABLE_INTERRUPT(istate);
+  }
+}
+
+void *
+_bspacm_tlsf_realloc (void * ptr,
+                      size_t size)
+{
+  BSPACM_CORE_SAVED_INTERRUPT_STATE(istate);
+  size_t adjusted = adjust_request(size);
+  sBlock * bp;
+  size_t bsize;
+  void * rv = 0;
+
+  if (! ptr) {
+    return _bspacm_tlsf_malloc(size);
+  }
+  if (0 == size) {
+    _bspacm_tlsf_free(ptr);
+    return 0;
+  }
+  if (! adjusted) {
+    errno = ENOMEM;
+    return 0;
+  }
+  bp = block_from_payload(ptr);
+  BSPACM_CORE_DISABLE_INTERRUPT();
+  bsize = block_size(bp);
+  if (adjusted > bsize) {
+    sBlock * np = block_next(bp);
+    if ((BLOCK_FREE & np->size)
+        && ((bsize + BLOCK_OVERHEAD + block_size(np)) >= adjusted)) {
+      merge_next(bp);
+      rv = ptr;
+    }
+  } else {
+    rv = ptr;
+  }
+  if (rv) {
+    /* Resize in place */
+    control_.used -= bsize;
+    trim_used(bp, adjusted);
+    control_.used += block_size(bp);
+    if (control_.used > control_.max_used) {
+      control_.max_used = control_.used;
+    }
+  } else {
+    rv = malloc_ni(size);
+  }
+  BSPACM_CORE_REENABLE_INTERRUPT(istate);
+  if (! rv) {
+    errno = ENOMEM;
+  } else if (rv != ptr) {
+    /* The copy is done with interrupts enabled; the old block remains
+     * allocated until it completes. */
+    memcpy(rv, ptr, bsize);
+    _bspacm_tlsf_free(ptr);
+  }
+  return rv;
+}
+
+void *
+_bspacm_tlsf_calloc (size_t nmemb,
+                     size_t size)
+{
+  size_t total = nmemb * size;
+  void * rv;
+
+  if (size && ((total / size) != nmemb)) {
+    errno = ENOMEM;
+    return 0;
+  }
+  rv = _bspacm_tlsf_malloc(total);
+  if (rv) {
+    memset(rv, 0, total);
+  }
+  return rv;
+}
+
+void *
+_bspacm_tlsf_malloc_r (struct _reent * reent,
+                       size_t size)
+{
+  return _bspacm_tlsf_malloc(size);
+}
+
+void
+_bspacm_tlsf_free_r (struct _reent * reent,
+                     void * ptr)
+{
+  _bspacm_tlsf_free(ptr);
+}
+
+void *
+_bspacm_tlsf_realloc_r (struct _reent * reent,
+                        void * ptr,
+                        size_t size)
+{
+  return _bspacm_tlsf_realloc(ptr, size);
+}
+
+void *
+_bspacm_tlsf_calloc_r (struct _reent * reent,
+                       size_t nmemb,
+                       size_t size)
+{
+  return _bspacm_tlsf_calloc(nmemb, size);
+}
+
+/* Find the size of the largest free block.  It is on the list for
+ * the highest occupied size class, which is scanned a few blocks at a
+ * time so interrupts are never disabled for long.  If the free lists
+ * change between sections the scan restarts; if they keep changing
+ * the largest size seen so far is returned. */
+static size_t
+largest_free (void)
+{
+  BSPACM_CORE_SAVED_INTERRUPT_STATE(istate);
+  size_t rv = 0;
+  unsigned int tries = 0;
+
+  do {
+    sBlock * bp;
+    unsigned int generation;
+
+    BSPACM_CORE_DISABLE_INTERRUPT();
+    if (! control_.fl_bitmap) {
+      BSPACM_CORE_REENABLE_INTERRUPT(istate);
+      return 0;
+    }
+    {
+      unsigned int const fl = fls_(control_.fl_bitmap);
+      bp = control_.blocks[fl][fls_(control_.sl_bitmap[fl])];
+    }
+    generation = control_.generation;
+    rv = 0;
+    while (bp && (generation == control_.generation)) {
+      unsigned int n = STATISTICS_CHUNK;
+      while (bp && (0 < n--)) {
+        if (block_size(bp) > rv) {
+          rv = block_size(bp);
+        }
+        bp = bp->next_free;
+      }
+      BSPACM_CORE_REENABLE_INTERRUPT(istate);
+      BSPACM_CORE_DISABLE_INTERRUPT();
+    }
+    BSPACM_CORE_REENABLE_INTERRUPT(istate);
+    if (! bp) {
+      break;
+    }
+  } while (++tries < STATISTICS_RETRIES);
+  return rv;
+}
+
+void
+vBSPACMnewlibTLSFstatistics (sBSPACMnewlibTLSFstatistics * sp)
+{
+  BSPACM_CORE_SAVED_INTERRUPT_STATE(istate);
+
+  memset(sp, 0, sizeof(*sp));
+  BSPACM_CORE_DISABLE_INTERRUPT();
+  sp->heap_size = control_.heap_size;
+  sp->used = control_.used;
+  sp->max_used = control_.max_used;
+  sp->free = control_.free;
+  sp->free_blocks = control_.free_blocks;
+  sp->used_blocks = control_.used_blocks;
+  sp->failures = control_.failures;
+  BSPACM_CORE_REENABLE_INTERRUPT(istate);
+  sp->largest_free = largest_free();
+}
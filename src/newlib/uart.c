@@ -40,6 +40,9 @@
 #include <bspacm/core.h>
 #include <bspacm/periph/uart.h>
 #include <bspacm/newlib/fdops.h>
+#include <bspacm/newlib/uart.h>
+#include <bspacm/internal/utility/fifo.h>
+#include <bspacm/utility/event.h>
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <stdlib.h>
@@ -48,6 +51,18 @@
 #include <stdarg.h>
 #include <fcntl.h>
 
+/** Descriptor state for UART devices.  The generic state must be
+ * first, so the structure can be recovered from the pointer passed to
+ * the operations. */
+typedef struct sUARTfile {
+  /** The generic descriptor state */
+  sBSPACMnewlibFDOPSfile file;
+
+  /** Timeout for read() in milliseconds; see
+   * #BSPACM_IOCTL_UART_SET_READ_TIMEOUT. */
+  int read_timeout_ms;
+} sUARTfile;
+
 /** State for the console.  This is a little different, since there's
  * a unique device that may be opened multiple times (e.g. once each
  * for stdin, stdout, stderr).  Share the handle, but reference count
@@ -72,7 +87,27 @@ uart_read (struct sBSPACMnewlibFDOPSfile * fp,
            size_t nbyte)
 {
   hBSPACMperiphUART usp = (hBSPACMperiphUART)fp->dev;
-  ssize_t rv = iBSPACMperiphUARTread(usp, buf, nbyte);
+  int remaining_ms = ((sUARTfile *)fp)->read_timeout_ms;
+  ssize_t rv;
+
+  if (0 < remaining_ms) {
+    BSPACM_CORE_ENABLE_CYCCNT();
+  }
+  while (1) {
+    rv = iBSPACMperiphUARTread(usp, buf, nbyte);
+    if ((0 != rv) || (0 == nbyte) || (0 == remaining_ms)) {
+      break;
+    }
+    if (0 < remaining_ms) {
+      BSPACM_CORE_DELAY_CYCLES(SystemCoreClock / 1000U);
+      --remaining_ms;
+    } else {
+      /* Sleep until something shows up in the receive path.  Data
+       * stored after the read above posts the event, so the wakeup is
+       * not missed.  A post from another UART just costs a retry. */
+      (void)uiBSPACMeventWait(&xBSPACMeventSystem, BSPACM_EVENT_UART_RX);
+    }
+  }
   if (0 == rv) {
     errno = EAGAIN;
     rv = -1;
@@ -128,26 +163,95 @@ uart_ioctl (struct sBSPACMnewlibFDOPSfile * fp,
             va_list ap)
 {
   BSPACM_CORE_SAVED_INTERRUPT_STATE(istate);
+  BSPACM_CORE_SAVED_PRIORITY_MASK(pmask);
   hBSPACMperiphUART usp = (hBSPACMperiphUART)fp->dev;
+  sUARTfile * ufp = (sUARTfile *)fp;
   int rv = -1;
 
   do {
-    int flags = 1 + va_arg(ap, int);
-    int fifo_mask = 0;
     if (! usp) {
       errno = EINVAL;
       break;
     }
-    if (_FREAD & flags) {
-      fifo_mask |= eBSPACMperiphUARTfifoState_RX;
-    }
-    if (_FWRITE & flags) {
-      fifo_mask |= eBSPACMperiphUARTfifoState_TX;
+    switch (request) {
+      case BSPACM_IOCTL_FLUSH: {
+        int flags = 1 + va_arg(ap, int);
+        int fifo_mask = 0;
+        if (_FREAD & flags) {
+          fifo_mask |= eBSPACMperiphUARTfifoState_RX;
+        }
+        if (_FWRITE & flags) {
+          fifo_mask |= eBSPACMperiphUARTfifoState_TX;
+        }
+        BSPACM_CORE_DISABLE_INTERRUPT();
+        rv = iBSPACMperiphUARTflush(usp, fifo_mask);
+        BSPACM_CORE_REENABLE_INTERRUPT(istate);
+        break;
+      }
+      case BSPACM_IOCTL_UART_FIFO_LEVELS: {
+        sBSPACMnewlibFDOPSuartFifoLevels * lp = va_arg(ap, sBSPACMnewlibFDOPSuartFifoLevels *);
+        const sFIFO * rxfp = usp->rx_fifo_ni_;
+        const sFIFO * txfp = usp->tx_fifo_ni_;
+        if (! lp) {
+          errno = EFAULT;
+          break;
+        }
+        BSPACM_CORE_MASK_PRIORITY();
+        lp->rx_length = rxfp ? fifo_length(rxfp) : 0;
+        lp->rx_capacity = rxfp ? (rxfp->size - 1) : 0;
+        lp->tx_length = txfp ? fifo_length(txfp) : 0;
+        lp->tx_capacity = txfp ? (txfp->size - 1) : 0;
+        lp->fifo_state = iBSPACMperiphUARTfifoState(usp);
+        BSPACM_CORE_RESTORE_PRIORITY_MASK(pmask);
+        rv = 0;
+        break;
+      }
+      case BSPACM_IOCTL_UART_SET_BAUD: {
+        sBSPACMperiphUARTconfiguration cfg = { .speed_baud = va_arg(ap, unsigned int) };
+        rv = iBSPACMperiphUARTreconfigure(usp, &cfg);
+        if (0 != rv) {
+          errno = EIO;
+          rv = -1;
+        }
+        break;
+      }
+      case BSPACM_IOCTL_UART_SET_ONLCR: {
+        int enable = va_arg(ap, int);
+        rv = !!(BSPACM_PERIPH_UART_FLAG_ONLCR & usp->flags);
+        if (0 < enable) {
+          usp->flags |= BSPACM_PERIPH_UART_FLAG_ONLCR;
+        } else if (0 == enable) {
+          usp->flags &= ~BSPACM_PERIPH_UART_FLAG_ONLCR;
+        }
+        break;
+      }
+      case BSPACM_IOCTL_UART_SET_READ_TIMEOUT:
+        rv = ufp->read_timeout_ms;
+        ufp->read_timeout_ms = va_arg(ap, int);
+        break;
+      case BSPACM_IOCTL_UART_STATISTICS: {
+        sBSPACMnewlibFDOPSuartStatistics * sp = va_arg(ap, sBSPACMnewlibFDOPSuartStatistics *);
+        if (! sp) {
+          errno = EFAULT;
+          break;
+        }
+        BSPACM_CORE_MASK_PRIORITY();
+        sp->rx_count = usp->rx_count;
+        sp->tx_count = usp->tx_count;
+        sp->rx_dropped_errors = usp->rx_dropped_errors;
+        sp->rx_frame_errors = usp->rx_frame_errors;
+        sp->rx_parity_errors = usp->rx_parity_errors;
+        sp->rx_break_errors = usp->rx_break_errors;
+        sp->rx_overrun_errors = usp->rx_overrun_errors;
+        BSPACM_CORE_RESTORE_PRIORITY_MASK(pmask);
+        rv = 0;
+        break;
+      }
+      default:
+        errno = EINVAL;
+        break;
     }
-    BSPACM_CORE_DISABLE_INTERRUPT();
-    rv = iBSPACMperiphUARTflush(usp, fifo_mask);
   } while (0);
-  BSPACM_CORE_REENABLE_INTERRUPT(istate);
   return rv;
 }
 
@@ -161,6 +265,7 @@ static const sBSPACMnewlibFDOPSfileOps xBSPACMnewlibFDOPSopsUART = {
 hBSPACMnewlibFDOPSfile
 hBSPACMnewlibFDOPSdriverUARTbind (hBSPACMperiphUART usp)
 {
+  sUARTfile * ufp;
   sBSPACMnewlibFDOPSfile * fp = 0;
 
   do {
@@ -173,12 +278,14 @@ hBSPACMnewlibFDOPSdriverUARTbind (hBSPACMperiphUART usp)
       errno = EBUSY;
       break;
     }
-    fp = malloc(sizeof(*fp));
-    if (! fp) {
+    ufp = malloc(sizeof(*ufp));
+    if (! ufp) {
       (void)hBSPACMperiphUARTconfigure(usp, 0);
       errno = ENOMEM;
       break;
     }
+    ufp->read_timeout_ms = 0;
+    fp = &ufp->file;
     fp->dev = usp;
     fp->ops = &xBSPACMnewlibFDOPSopsUART;
     if (hBSPACMdefaultUART == usp) {
@@ -221,35 +328,11 @@ const sBSPACMperiphUARTconfiguration xBSPACMnewlibFDOPSconsoleConfiguration = {
 };
 
 sBSPACMnewlibFDOPSfile *
-fBSPACMnewlibFDOPSdriverCONSOLE (const char * pathname,
+fBSPACMnewlibFDOPSdeviceCONSOLE (const char * pathname,
                                  int flags)
 {
   sBSPACMnewlibFDOPSfile * fp = NULL;
-  static const char dev_name[] = "/dev/console";
 
-#if 1
-  { /* Inline compare takes 60 bytes.  Using memcmp for this adds 88
-     * bytes; using strcmp adds over 500 bytes. */
-    const char * dp = dev_name;
-    const char * pp = pathname;
-    while (*dp && pp && (*pp == *dp)) {
-      ++dp;
-      ++pp;
-    }
-    if (*dp || (! pp) || *pp) {
-      return 0;
-    }
-  }
-#elif 0
-  if ((! pathname) || (0 != memcmp(dev_name, pathname, sizeof(dev_name)))) {
-    return 0;
-  }
-#elif 0
-  if ((! pathname) || (0 != strcmp(dev_name, pathname))) {
-    return 0;
-  }
-#else
-#endif
   do {
     fp = console_state.handle;
     if (! fp) {
@@ -280,9 +363,48 @@ fBSPACMnewlibFDOPSdriverCONSOLE (const char * pathname,
   return fp;
 }
 
+sBSPACMnewlibFDOPSfile *
+fBSPACMnewlibFDOPSdriverCONSOLE (const char * pathname,
+                                 int flags)
+{
+  static const char dev_name[] = "/dev/console";
+
+#if 1
+  { /* Inline compare takes 60 bytes.  Using memcmp for this adds 88
+     * bytes; using strcmp adds over 500 bytes. */
+    const char * dp = dev_name;
+    const char * pp = pathname;
+    while (*dp && pp && (*pp == *dp)) {
+      ++dp;
+      ++pp;
+    }
+    if (*dp || (! pp) || *pp) {
+      return 0;
+    }
+  }
+#elif 0
+  if ((! pathname) || (0 != memcmp(dev_name, pathname, sizeof(dev_name)))) {
+    return 0;
+  }
+#elif 0
+  if ((! pathname) || (0 != strcmp(dev_name, pathname))) {
+    return 0;
+  }
+#else
+#endif
+  return fBSPACMnewlibFDOPSdeviceCONSOLE(pathname, flags);
+}
+
 /** Weakly provide file-descriptor support for the console */
 __attribute__((__weak__))
+const sBSPACMnewlibFDOPSdevice xBSPACMnewlibFDOPSdevice[] = {
+  { "/dev/console", fBSPACMnewlibFDOPSdeviceCONSOLE },
+  { 0, 0 }
+};
+
+/** Weakly provide an empty list of pattern-matching drivers; the
+ * console is located through xBSPACMnewlibFDOPSdevice. */
+__attribute__((__weak__))
 const fBSPACMnewlibFDOPSdriver xBSPACMnewlibFDOPSdriver[] = {
-  fBSPACMnewlibFDOPSdriverCONSOLE,
   0
 };
@@ -41,16 +41,16 @@ const hBSPACMperiphUART hBSPACMdefaultUART = 0;
 int
 iBSPACMperiphUARTread (sBSPACMperiphUARTstate * usp, void * buf, size_t count)
 {
-  BSPACM_CORE_SAVED_INTERRUPT_STATE(istate);
+  BSPACM_CORE_SAVED_PRIORITY_MASK(pmask);
   uint8_t * const bps = (uint8_t *)buf;
   int rv = -1;
 
   if (usp->rx_fifo_ni_) {
-    BSPACM_CORE_DISABLE_INTERRUPT();
+    BSPACM_CORE_MASK_PRIORITY();
     do {
       rv = fifo_pop_into_buffer(usp->rx_fifo_ni_, bps, bps+count);
     } while (0);
-    BSPACM_CORE_REENABLE_INTERRUPT(istate);
+    BSPACM_CORE_RESTORE_PRIORITY_MASK(pmask);
   }
   return rv;
 }
@@ -58,7 +58,7 @@ iBSPACMperiphUARTread (sBSPACMperiphUARTstate * usp, void * buf, size_t count)
 int
 iBSPACMperiphUARTwrite (sBSPACMperiphUARTstate * usp, const void * buf,  size_t count)
 {
-  BSPACM_CORE_SAVED_INTERRUPT_STATE(istate);
+  BSPACM_CORE_SAVED_PRIORITY_MASK(pmask);
   const uint8_t * const bps = (const uint8_t *)buf;
   const uint8_t * bp = bps;
   const uint8_t * const bpe = bp + count;
@@ -99,7 +99,7 @@ iBSPACMperiphUARTwrite (sBSPACMperiphUARTstate * usp, const void * buf,  size_t
      * mutex while putting the output onto the SW fifo it there's
      * already data there, or onto the hardware fifo with a fallback
      * to the SW fifo. */
-    BSPACM_CORE_DISABLE_INTERRUPT();
+    BSPACM_CORE_MASK_PRIORITY();
     do {
       int fifo_state = usp->ops->fifo_state(usp);
       if ((eBSPACMperiphUARTfifoState_SWTX & fifo_state)
@@ -126,7 +126,7 @@ iBSPACMperiphUARTwrite (sBSPACMperiphUARTstate * usp, const void * buf,  size_t
       state = next_state;
     }
     usp->tx_state_ = state;
-    BSPACM_CORE_REENABLE_INTERRUPT(istate);
+    BSPACM_CORE_RESTORE_PRIORITY_MASK(pmask);
   }
   return bp - bps;
 }
@@ -163,3 +163,43 @@ int iBSPACMperiphUARTflush (hBSPACMperiphUART usp,
   BSPACM_CORE_REENABLE_INTERRUPT(istate);
   return rv;
 }
+
+int
+iBSPACMperiphUARTreconfigure (hBSPACMperiphUART usp,
+                              const sBSPACMperiphUARTconfiguration * cfgp)
+{
+  BSPACM_CORE_SAVED_INTERRUPT_STATE(istate);
+  int rv;
+
+  if (! (usp && cfgp)) {
+    return -1;
+  }
+
+  /* Drain the software and hardware transmit queues.  This returns
+   * with interrupts disabled, so nothing new can be queued. */
+  BSPACM_CORE_DISABLE_INTERRUPT();
+  rv = iBSPACMperiphUARTflush(usp, (eBSPACMperiphUARTfifoState_SWTX
+                                    | eBSPACMperiphUARTfifoState_HWTX));
+  if (0 <= rv) {
+    sFIFO * const rxfp = usp->rx_fifo_ni_;
+    uint16_t rx_head = 0;
+    uint16_t rx_tail = 0;
+    uint8_t tx_state = usp->tx_state_;
+
+    /* The configure operation resets the FIFO indexes but leaves the
+     * cells intact, so received data survives if the indexes are
+     * restored. */
+    if (rxfp) {
+      rx_head = rxfp->head;
+      rx_tail = rxfp->tail;
+    }
+    rv = usp->ops->configure(usp, cfgp);
+    if (rxfp) {
+      rxfp->head = rx_head;
+      rxfp->tail = rx_tail;
+    }
+    usp->tx_state_ = tx_state;
+  }
+  BSPACM_CORE_REENABLE_INTERRUPT(istate);
+  return (0 > rv) ? rv : 0;
+}
@@ -0,0 +1,83 @@
+/* Copyright 2014, Peter A. Bigot
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of the software nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without
+ *   specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/** @file
+ *
+ * @brief Implementation of aligned buffer allocation
+ *
+ * The buffer is carved from an over-sized block obtained from
+ * malloc(), and the pointer to that block is stored in the word
+ * preceding the aligned buffer so it can be released.
+ *
+ * @homepage http://github.com/pabigot/bspacm
+ * @copyright Copyright 2014, Peter A. Bigot.  Licensed under <a href="http://www.opensource.org/licenses/BSD-3-Clause">BSD-3-Clause</a>
+ */
+
+#include <bspacm/utility/aligned.h>
+#include <stdlib.h>
+#include <errno.h>
+
+void *
+pvBSPACMalignedAllocate (size_t alignment,
+                         size_t size)
+{
+  size_t overhead;
+  uintptr_t addr;
+  void * raw;
+
+  if ((0 == alignment) || (0 != (alignment & (alignment - 1)))) {
+    errno = EINVAL;
+    return 0;
+  }
+  if (alignment < sizeof(void *)) {
+    alignment = sizeof(void *);
+  }
+  overhead = sizeof(void *) + alignment - 1;
+  if ((size + overhead) < size) {
+    errno = ENOMEM;
+    return 0;
+  }
+  raw = malloc(size + overhead);
+  if (! raw) {
+    return 0;
+  }
+  addr = ((uintptr_t)raw + overhead) & ~(uintptr_t)(alignment - 1);
+  ((void **)addr)[-1] = raw;
+  return (void *)addr;
+}
+
+void
+vBSPACMalignedRelease (void * ptr)
+{
+  if (ptr) {
+    free(((void **)ptr)[-1]);
+  }
+}
@@ -0,0 +1,80 @@
+/* Copyright 2014, Peter A. Bigot
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of the software nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without
+ *   specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/** @file
+ *
+ * @brief Implementation of scratch arena setup
+ *
+ * @homepage http://github.com/pabigot/bspacm
+ * @copyright Copyright 2014, Peter A. Bigot.  Licensed under <a href="http://www.opensource.org/licenses/BSD-3-Clause">BSD-3-Clause</a>
+ */
+
+#include <bspacm/utility/arena.h>
+#include <bspacm/utility/pool.h>
+
+void
+vBSPACMarenaInitialize (sBSPACMarena * ap,
+                        void * region,
+                        size_t size)
+{
+  const uintptr_t align_mask = BSPACM_ARENA_ALIGNMENT - 1;
+  uintptr_t start = ((uintptr_t)region + align_mask) & ~align_mask;
+  uintptr_t limit = (uintptr_t)region + size;
+
+  if (limit < start) {
+    limit = start;
+  }
+  ap->base = ap->next = ap->high_water = (uint8_t *)start;
+  ap->limit = (uint8_t *)limit;
+}
+
+int
+iBSPACMarenaInitializeFromPool (sBSPACMarena * ap,
+                                size_t size)
+{
+  void * region = pvBSPACMpoolAllocate(size);
+
+  if (! region) {
+    vBSPACMarenaInitialize(ap, 0, 0);
+    return -1;
+  }
+  vBSPACMarenaInitialize(ap, region, size);
+  return 0;
+}
+
+int
+iBSPACMarenaReleaseToPool (sBSPACMarena * ap)
+{
+  void * region = ap->base;
+
+  vBSPACMarenaInitialize(ap, 0, 0);
+  return iBSPACMpoolRelease(region);
+}
@@ -0,0 +1,241 @@
+/* Copyright 2014, Peter A. Bigot
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of the software nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without
+ *   specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/** @file
+ *
+ * @brief Cycle delays for cores without a cycle counter
+ *
+ * @homepage http://github.com/pabigot/bspacm
+ * @copyright Copyright 2014, Peter A. Bigot.  Licensed under <a href="http://www.opensource.org/licenses/BSD-3-Clause">BSD-3-Clause</a>
+ */
+
+#include <bspacm/core.h>
+
+#if ! (BSPACM_CORE_SUPPORTS_CYCCNT - 0)
+
+#if (BSPACM_DEVICE_SERIES_NRF51 - 0)
+#include <bspacm/utility/hires.h>
+#endif /* BSPACM_DEVICE_SERIES_NRF51 */
+
+/* Number of delay loop iterations timed by calibration. */
+#define CALIBRATION_ITERATIONS 256
+
+/* SysTick periods shorter than this are polled too coarsely to be
+ * used as the delay time base. */
+#define SYSTICK_MINIMUM_PERIOD 256
+
+/* Cost of one delay_loop() iteration in sixteenths of a cycle.  The
+ * initial value is a guess for zero-wait-state flash, used until
+ * calibration completes.  It is never less than one cycle. */
+static unsigned int loop_cost_x16_ = 4 * 16;
+
+/* Delay loop iterations per cycle as a 16-bit binary fraction, and
+ * core cycles per microsecond.  Both are derived at calibration so
+ * that delays need no division, which Cortex-M0 performs in a
+ * library routine costing more than a short delay. */
+static uint32_t iterations_per_cycle_q16_ = (16U << 16) / (4 * 16);
+static uint32_t cycles_per_us_ = 16;
+#if (BSPACM_DEVICE_SERIES_NRF51 - 0)
+/* Delays shorter than this many microseconds use the calibrated loop
+ * rather than vBSPACMhiresSleep_us(), which busy-waits uncalibrated
+ * below 5 us and costs a few microseconds to arm in any case. */
+#define HIRES_SLEEP_MINIMUM_US 20
+
+/* Microseconds per cycle as a 16-bit binary fraction, rounded down. */
+static uint32_t us_per_cycle_q16_ = (1U << 16) / 16;
+#endif /* BSPACM_DEVICE_SERIES_NRF51 */
+
+/* Multiply a 32-bit value by a 16-bit binary fraction no greater
+ * than one using only 32-bit operations. */
+static inline uint32_t
+scale_q16 (uint32_t v,
+           uint32_t q16)
+{
+  return ((v >> 16) * q16) + (((v & 0xFFFF) * q16) >> 16);
+}
+
+static void
+delay_derive (void)
+{
+  cycles_per_us_ = SystemCoreClock / 1000000U;
+  if (0 == cycles_per_us_) {
+    cycles_per_us_ = 1;
+  }
+  iterations_per_cycle_q16_ = (16U << 16) / loop_cost_x16_;
+#if (BSPACM_DEVICE_SERIES_NRF51 - 0)
+  us_per_cycle_q16_ = (1U << 16) / cycles_per_us_;
+#endif /* BSPACM_DEVICE_SERIES_NRF51 */
+}
+
+/* Out of line so every use, including calibration, has the same code
+ * and therefore the same cost.  The empty asm keeps the compiler
+ * from eliding the loop. */
+static void __attribute__((__noinline__))
+delay_loop (uint32_t iterations)
+{
+  while (iterations--) {
+    __asm__ __volatile__("");
+  }
+}
+
+unsigned int
+uiBSPACMcoreDelayCalibrate (void)
+{
+  uint32_t elapsed;
+
+#if (BSPACM_CORE_SUPPORTS_SYSTICK - 0)
+  uint32_t const in_load = SysTick->LOAD;
+  uint32_t t0;
+
+  if (SysTick_CTRL_ENABLE_Msk & SysTick->CTRL) {
+    /* In use by the application; keep the previous measurement. */
+    delay_derive();
+    return loop_cost_x16_;
+  }
+  SysTick->LOAD = SysTick_LOAD_RELOAD_Msk;
+  SysTick->VAL = 0;
+  SysTick->CTRL = SysTick_CTRL_CLKSOURCE_Msk | SysTick_CTRL_ENABLE_Msk;
+  t0 = SysTick->VAL;
+  delay_loop(CALIBRATION_ITERATIONS);
+  elapsed = SysTick_LOAD_RELOAD_Msk & (t0 - SysTick->VAL);
+  SysTick->CTRL = 0;
+  SysTick->LOAD = in_load;
+#elif (BSPACM_DEVICE_SERIES_NRF51 - 0)
+  /* The timer runs from the 16 MHz clock that also drives the core,
+   * so unprescaled ticks are core cycles. */
+  NRF_TIMER_Type * const timer = BSPACM_HIRES_TIMER;
+  uint32_t const in_mode = timer->MODE;
+  uint32_t const in_prescaler = timer->PRESCALER;
+  uint32_t const in_bitmode = timer->BITMODE;
+
+  if (bBSPACMhiresEnabled()) {
+    delay_derive();
+    return loop_cost_x16_;
+  }
+  timer->MODE = (TIMER_MODE_MODE_Timer << TIMER_MODE_MODE_Pos);
+  timer->PRESCALER = 0;
+  timer->BITMODE = (TIMER_BITMODE_BITMODE_16Bit << TIMER_BITMODE_BITMODE_Pos);
+  timer->TASKS_CLEAR = 1;
+  timer->TASKS_START = 1;
+  timer->TASKS_CAPTURE[1] = 1;
+  delay_loop(CALIBRATION_ITERATIONS);
+  timer->TASKS_CAPTURE[2] = 1;
+  timer->TASKS_STOP = 1;
+  elapsed = 0xFFFF & (timer->CC[2] - timer->CC[1]);
+  timer->MODE = in_mode;
+  timer->PRESCALER = in_prescaler;
+  timer->BITMODE = in_bitmode;
+#else /* time base */
+  delay_derive();
+  return loop_cost_x16_;
+#endif /* time base */
+
+  loop_cost_x16_ = ((16 * elapsed) + (CALIBRATION_ITERATIONS / 2)) / CALIBRATION_ITERATIONS;
+  if (16 > loop_cost_x16_) {
+    loop_cost_x16_ = 16;
+  }
+  delay_derive();
+  return loop_cost_x16_;
+}
+
+static void __attribute__((__constructor__))
+delay_calibrate_at_startup (void)
+{
+  (void)uiBSPACMcoreDelayCalibrate();
+}
+
+void
+vBSPACMcoreDelayCycles (uint32_t cycles)
+{
+  /* Sleeping is only safe in thread mode: a handler may mask the
+   * interrupt that would wake the core. */
+  bool const thread_mode = (0 == __get_IPSR());
+
+#if (BSPACM_CORE_SUPPORTS_SYSTICK - 0)
+  {
+    uint32_t const run_mask = SysTick_CTRL_ENABLE_Msk | SysTick_CTRL_CLKSOURCE_Msk;
+    uint32_t const ctrl = SysTick->CTRL;
+    uint32_t const modulus = SysTick->LOAD + 1;
+
+    if ((run_mask == (run_mask & ctrl))
+        && (SYSTICK_MINIMUM_PERIOD <= modulus)) {
+      bool const can_sleep = thread_mode
+        && (SysTick_CTRL_TICKINT_Msk & ctrl)
+        && (! (1U & __get_PRIMASK()));
+      uint32_t prev = SysTick->VAL;
+
+      while (1) {
+        uint32_t const now = SysTick->VAL;
+        uint32_t const delta = (prev >= now) ? (prev - now) : (prev + modulus - now);
+
+        if (delta >= cycles) {
+          break;
+        }
+        cycles -= delta;
+        prev = now;
+        /* The next tick wakes the core before the delay expires. */
+        if (can_sleep && (cycles > modulus)) {
+          BSPACM_CORE_SLEEP();
+        }
+      }
+      return;
+    }
+  }
+#elif (BSPACM_DEVICE_SERIES_NRF51 - 0)
+  /* The sleep ends in the timer interrupt, so it cannot be used with
+   * interrupts disabled. */
+  if (thread_mode
+      && bBSPACMhiresEnabled()
+      && (! (1U & __get_PRIMASK()))) {
+    unsigned long const max_us = uiBSPACMhiresConvert_hrt_us(0x8000);
+    unsigned long us = scale_q16(cycles, us_per_cycle_q16_);
+
+    if (HIRES_SLEEP_MINIMUM_US <= us) {
+      cycles -= us * cycles_per_us_;
+      /* Leave a final sleep of at least the minimum. */
+      while ((max_us + HIRES_SLEEP_MINIMUM_US) < us) {
+        vBSPACMhiresSleep_us(max_us);
+        us -= max_us;
+      }
+      vBSPACMhiresSleep_us(us);
+    }
+  }
+#endif /* BSPACM_CORE_SUPPORTS_SYSTICK */
+  delay_loop(scale_q16(cycles, iterations_per_cycle_q16_));
+}
+
+void
+vBSPACMcoreDelay_us (uint32_t us)
+{
+  vBSPACMcoreDelayCycles(us * cycles_per_us_);
+}
+
+#endif /* BSPACM_CORE_SUPPORTS_CYCCNT */
@@ -0,0 +1,136 @@
+/* Copyright 2014, Peter A. Bigot
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of the software nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without
+ *   specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/** @file
+ *
+ * @brief Implementation of event flags for sleep-driven main loops
+ *
+ * @homepage http://github.com/pabigot/bspacm
+ * @copyright Copyright 2014, Peter A. Bigot.  Licensed under <a href="http://www.opensource.org/licenses/BSD-3-Clause">BSD-3-Clause</a>
+ */
+
+#include <bspacm/utility/event.h>
+#include <bspacm/periph/uart.h>
+#if (BSPACM_DEVICE_SERIES_NRF51 - 0)
+#include <bspacm/utility/uptime.h>
+#endif /* BSPACM_DEVICE_SERIES_NRF51 */
+
+sBSPACMeventGroup xBSPACMeventSystem;
+
+static volatile unsigned int deep_sleep_inhibit_;
+
+void
+vBSPACMeventDeepSleepInhibit (bool inhibit)
+{
+  BSPACM_CORE_SAVED_INTERRUPT_STATE(istate);
+
+  BSPACM_CORE_DISABLE_INTERRUPT();
+  if (inhibit) {
+    ++deep_sleep_inhibit_;
+  } else if (0 < deep_sleep_inhibit_) {
+    --deep_sleep_inhibit_;
+  }
+  BSPACM_CORE_REENABLE_INTERRUPT(istate);
+}
+
+__attribute__((__weak__))
+bool
+bBSPACMeventDeepSleepPermitted (const sBSPACMeventGroup * gp,
+                                uint32_t mask)
+{
+  (void)gp;
+  (void)mask;
+  return false;
+}
+
+/** Return @c true if something BSPACM knows about needs the clocks
+ * that deep sleep would stop. */
+static bool
+deep_sleep_vetoed (const sBSPACMeventGroup * gp,
+                   uint32_t mask)
+{
+  if (0 != deep_sleep_inhibit_) {
+    return true;
+  }
+  if ((&xBSPACMeventSystem == gp) && (BSPACM_EVENT_UART_RX & mask)) {
+    return true;
+  }
+  if (hBSPACMdefaultUART) {
+    int fs = iBSPACMperiphUARTfifoState(hBSPACMdefaultUART);
+    if ((0 <= fs) && (eBSPACMperiphUARTfifoState_TX & fs)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+void
+vBSPACMeventIdle (const sBSPACMeventGroup * gp,
+                  uint32_t mask)
+{
+#if (BSPACM_DEVICE_SERIES_NRF51 - 0)
+  /* nRF51 System ON sleep does not distinguish deep sleep, and the
+   * uptime idle keeps the books on time spent asleep. */
+  if (bBSPACMuptimeEnabled()) {
+    (void)uiBSPACMuptimeIdle();
+    return;
+  }
+#endif /* BSPACM_DEVICE_SERIES_NRF51 */
+  if ((! deep_sleep_vetoed(gp, mask))
+      && bBSPACMeventDeepSleepPermitted(gp, mask)) {
+    BSPACM_CORE_DEEP_SLEEP();
+  } else {
+    BSPACM_CORE_SLEEP();
+  }
+}
+
+uint32_t
+uiBSPACMeventWait (sBSPACMeventGroup * gp,
+                   uint32_t mask)
+{
+  BSPACM_CORE_SAVED_INTERRUPT_STATE(istate);
+  uint32_t rv;
+
+  /* Check and sleep with interrupts disabled so a post between the
+   * check and the sleep still wakes the core.  Enable interrupts
+   * after waking so the handler that caused the wakeup can run. */
+  while (1) {
+    BSPACM_CORE_DISABLE_INTERRUPT();
+    rv = uiBSPACMeventTake(gp, mask);
+    if (rv) {
+      break;
+    }
+    vBSPACMeventIdle(gp, mask);
+    BSPACM_CORE_ENABLE_INTERRUPT();
+  }
+  BSPACM_CORE_REENABLE_INTERRUPT(istate);
+  return rv;
+}
@@ -0,0 +1,303 @@
+/* Copyright 2014, Peter A. Bigot
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of the software nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without
+ *   specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/** @file
+ *
+ * @brief Implementation of table-driven memory dump formatting
+ *
+ * @homepage http://github.com/pabigot/bspacm
+ * @copyright Copyright 2014, Peter A. Bigot.  Licensed under <a href="http://www.opensource.org/licenses/BSD-3-Clause">BSD-3-Clause</a>
+ */
+
+#include <bspacm/utility/hexdump.h>
+#include <bspacm/periph/uart.h>
+#include <bspacm/internal/utility/fifo.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+/* Octet lines are "AAAAAAAA " plus 16 " xx" plus a mid-line space,
+ * two spaces, 16 characters, and a newline. */
+#define LINE_LENGTH_MAX (9 + 16 * 3 + 1 + 2 + 16 + 1)
+
+static const char hex_digit[16] = "0123456789abcdef";
+
+static BSPACM_CORE_INLINE
+char *
+format_octet (char * lp,
+              unsigned int v)
+{
+  *lp++ = hex_digit[0x0F & (v >> 4)];
+  *lp++ = hex_digit[0x0F & v];
+  return lp;
+}
+
+static char *
+format_word (char * lp,
+             uint32_t v)
+{
+  int shift = 28;
+
+  while (0 <= shift) {
+    *lp++ = hex_digit[0x0F & (v >> shift)];
+    shift -= 4;
+  }
+  return lp;
+}
+
+static BSPACM_CORE_INLINE
+char *
+format_address (char * lp,
+                uintptr_t addr)
+{
+  lp = format_word(lp, addr);
+  *lp++ = ' ';
+  return lp;
+}
+
+static BSPACM_CORE_INLINE
+char *
+fill_spaces (char * lp,
+             unsigned int n)
+{
+  while (0 < n--) {
+    *lp++ = ' ';
+  }
+  return lp;
+}
+
+int
+iBSPACMhexdumpOctets (fBSPACMhexdumpSink sink,
+                      void * context,
+                      const uint8_t * dp,
+                      size_t count,
+                      uintptr_t base)
+{
+  const uint8_t * const edp = dp + count;
+  unsigned int skips = base & 0x0F;
+  uintptr_t addr = base - skips;
+  char line[LINE_LENGTH_MAX];
+
+  if (0 == count) {
+    return sink(context, "\n", 1);
+  }
+  while (dp < edp) {
+    const uint8_t * ldp = dp;
+    unsigned int end = skips + (edp - dp);
+    unsigned int pos;
+    char * lp = format_address(line, addr);
+    int rc;
+
+    if (16 < end) {
+      end = 16;
+    }
+    for (pos = 0; pos < 16; ++pos) {
+      if (8 == pos) {
+        *lp++ = ' ';
+      }
+      *lp++ = ' ';
+      if ((pos < skips) || (end <= pos)) {
+        lp = fill_spaces(lp, 2);
+      } else {
+        lp = format_octet(lp, *dp++);
+      }
+    }
+    lp = fill_spaces(lp, 2 + skips);
+    while (ldp < dp) {
+      uint8_t c = *ldp++;
+      *lp++ = ((0x20 <= c) && (c < 0x7F)) ? c : '.';
+    }
+    *lp++ = '\n';
+    rc = sink(context, line, lp - line);
+    if (0 > rc) {
+      return rc;
+    }
+    skips = 0;
+    addr += 16;
+  }
+  return 0;
+}
+
+int
+iBSPACMhexdumpWords (fBSPACMhexdumpSink sink,
+                     void * context,
+                     const uint32_t * dp,
+                     size_t count,
+                     uintptr_t base)
+{
+  const uint32_t * const edp = dp + count;
+  unsigned int skips;
+  uintptr_t addr;
+  char line[LINE_LENGTH_MAX];
+
+  /* Force word alignment.  Otherwise things get ugly with the skip
+   * logic. */
+  base &= ~(uintptr_t)3;
+  skips = (base & 0x0F) / sizeof(*dp);
+  addr = base & ~(uintptr_t)0x0F;
+  if (0 == count) {
+    return sink(context, "\n", 1);
+  }
+  while (dp < edp) {
+    char * lp = format_address(line, addr);
+    unsigned int pos;
+    int rc;
+
+    lp = fill_spaces(lp, 9 * skips);
+    for (pos = skips; (pos < 4) && (dp < edp); ++pos) {
+      *lp++ = ' ';
+      lp = format_word(lp, *dp++);
+    }
+    *lp++ = '\n';
+    rc = sink(context, line, lp - line);
+    if (0 > rc) {
+      return rc;
+    }
+    skips = 0;
+    addr += 16;
+  }
+  return 0;
+}
+
+int
+iBSPACMhexdumpSequence (fBSPACMhexdumpSink sink,
+                        void * context,
+                        const uint8_t * dp,
+                        size_t count)
+{
+  const uint8_t * const edp = dp + count;
+  char line[LINE_LENGTH_MAX];
+
+  while (dp < edp) {
+    char * lp = line;
+    int rc;
+
+    /* Emit in chunks of at most 16 octets */
+    while ((dp < edp) && (lp < (line + 16 * 3))) {
+      lp = format_octet(lp, *dp++);
+      if (dp < edp) {
+        *lp++ = ' ';
+      }
+    }
+    rc = sink(context, line, lp - line);
+    if (0 > rc) {
+      return rc;
+    }
+  }
+  return 0;
+}
+
+int
+iBSPACMhexdumpSinkFILE (void * context,
+                        const char * text,
+                        size_t len)
+{
+  FILE * fp = context ? (FILE *)context : stdout;
+
+  return (len == fwrite(text, 1, len, fp)) ? 0 : -1;
+}
+
+int
+iBSPACMhexdumpSinkFD (void * context,
+                      const char * text,
+                      size_t len)
+{
+  int fd = (int)(intptr_t)context;
+
+  while (0 < len) {
+    ssize_t rc = write(fd, text, len);
+    if (0 >= rc) {
+      return -1;
+    }
+    text += rc;
+    len -= rc;
+  }
+  return 0;
+}
+
+int
+iBSPACMhexdumpSinkUART (void * context,
+                        const char * text,
+                        size_t len)
+{
+  hBSPACMperiphUART usp = (hBSPACMperiphUART)context;
+
+  while (0 < len) {
+    int rc = iBSPACMperiphUARTwrite(usp, text, len);
+    if (0 > rc) {
+      return rc;
+    }
+    if (0 == rc) {
+      (void)iBSPACMperiphUARTflush(usp, eBSPACMperiphUARTfifoState_SWTX);
+    }
+    text += rc;
+    len -= rc;
+  }
+  return 0;
+}
+
+int
+iBSPACMhexdumpSinkBuffer (void * context,
+                          const char * text,
+                          size_t len)
+{
+  sBSPACMhexdumpBuffer * bp = (sBSPACMhexdumpBuffer *)context;
+  size_t avail = bp->size - bp->length;
+  int rv = 0;
+
+  if (len > avail) {
+    len = avail;
+    rv = -1;
+  }
+  memcpy(bp->buffer + bp->length, text, len);
+  bp->length += len;
+  return rv;
+}
+
+int
+iBSPACMhexdumpSinkFIFO (void * context,
+                        const char * text,
+                        size_t len)
+{
+  BSPACM_CORE_SAVED_INTERRUPT_STATE(istate);
+  sFIFO * fp = (sFIFO *)context;
+  const char * const etext = text + len;
+  int rv = 0;
+
+  BSPACM_CORE_DISABLE_INTERRUPT();
+  while (text < etext) {
+    if (0 > fifo_push_head(fp, *text++)) {
+      rv = -1;
+    }
+  }
+  BSPACM_CORE_REENABLE_INTERRUPT(istate);
+  return rv;
+}
@@ -0,0 +1,134 @@
+/* Copyright 2014, Peter A. Bigot
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of the software nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without
+ *   specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/** @file
+ *
+ * @brief Implementation of stack and heap high-water measurement
+ *
+ * @homepage http://github.com/pabigot/bspacm
+ * @copyright Copyright 2014, Peter A. Bigot.  Licensed under <a href="http://www.opensource.org/licenses/BSD-3-Clause">BSD-3-Clause</a>
+ */
+
+#include <bspacm/utility/highwater.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+
+extern char end;            /* symbol at which heap starts */
+extern char __HeapLimit;    /* symbol placed just past end of heap */
+extern char __StackLimit;   /* reserved end of stack */
+extern char __StackTop;     /* initial stack pointer */
+
+/* The lowest word that may be treated as stack: the reserved stack
+ * limit, or the word following the program break if the heap has
+ * grown above that. */
+static uint32_t *
+stack_floor (void)
+{
+  const char * brk = xBSPACMnewlibSbrkStatistics_.max_brk;
+  uintptr_t floor = (uintptr_t)&__StackLimit;
+
+  if ((uintptr_t)brk > floor) {
+    floor = ((uintptr_t)brk + sizeof(uint32_t) - 1) & ~(sizeof(uint32_t) - 1);
+  }
+  return (uint32_t *)floor;
+}
+
+__attribute__((__constructor__,__noinline__))
+void
+vBSPACMhighwaterPaintStack (void)
+{
+  register char * sp __asm__("sp");
+  uint32_t * wp = stack_floor();
+  uint32_t * const ewp = (uint32_t *)((uintptr_t)sp & ~(sizeof(uint32_t) - 1));
+
+  while (wp < ewp) {
+    *wp++ = BSPACM_HIGHWATER_STACK_PAINT;
+  }
+}
+
+void
+vBSPACMhighwaterSnapshot (sBSPACMhighwater * sp)
+{
+  BSPACM_CORE_SAVED_INTERRUPT_STATE(istate);
+  const uint32_t * wp = stack_floor();
+  const uint32_t * const ewp = (const uint32_t *)&__StackTop;
+
+  while ((wp < ewp) && (BSPACM_HIGHWATER_STACK_PAINT == *wp)) {
+    ++wp;
+  }
+  sp->stack_reserved = &__StackTop - &__StackLimit;
+  sp->stack_max_used = (const char *)ewp - (const char *)wp;
+  sp->heap_reserved = &__HeapLimit - &end;
+
+  /* Statistics are updated from whatever context invokes _sbrk(), so
+   * copy them atomically. */
+  BSPACM_CORE_DISABLE_INTERRUPT();
+  memcpy(&sp->sbrk, &xBSPACMnewlibSbrkStatistics_, sizeof(sp->sbrk));
+  BSPACM_CORE_REENABLE_INTERRUPT(istate);
+  sp->heap_used = sp->sbrk.brk ? (sp->sbrk.brk - &end) : 0;
+  sp->heap_max_used = sp->sbrk.max_brk ? (sp->sbrk.max_brk - &end) : 0;
+}
+
+void
+vBSPACMhighwaterReport (const sBSPACMhighwater * sp)
+{
+  sBSPACMhighwater snapshot;
+
+  if (! sp) {
+    vBSPACMhighwaterSnapshot(&snapshot);
+    sp = &snapshot;
+  }
+  printf("Stack: %u of %u used\n",
+         (unsigned int)sp->stack_max_used, (unsigned int)sp->stack_reserved);
+  printf("Heap: %u in use, %u peak, %u reserved\n",
+         (unsigned int)sp->heap_used, (unsigned int)sp->heap_max_used,
+         (unsigned int)sp->heap_reserved);
+  printf("sbrk: %u calls, %u failed, largest %d\n",
+         sp->sbrk.calls, sp->sbrk.failures, (int)sp->sbrk.max_increment);
+#if (0 < BSPACM_NEWLIB_SBRK_TRACE_LENGTH)
+  {
+    unsigned int n = sp->sbrk.calls;
+    unsigned int i;
+
+    if (BSPACM_NEWLIB_SBRK_TRACE_LENGTH < n) {
+      n = BSPACM_NEWLIB_SBRK_TRACE_LENGTH;
+    }
+    if (0 < n) {
+      printf("sbrk recent:");
+      for (i = sp->sbrk.calls - n; i < sp->sbrk.calls; ++i) {
+        printf(" %d", (int)sp->sbrk.trace[i % BSPACM_NEWLIB_SBRK_TRACE_LENGTH]);
+      }
+      putchar('\n');
+    }
+  }
+#endif /* BSPACM_NEWLIB_SBRK_TRACE_LENGTH */
+}
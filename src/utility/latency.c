@@ -0,0 +1,267 @@
+/* Copyright 2014, Peter A. Bigot
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of the software nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without
+ *   specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/** @file
+ *
+ * @brief Implementation of interrupt entry latency measurement
+ *
+ * @homepage http://github.com/pabigot/bspacm
+ * @copyright Copyright 2014, Peter A. Bigot.  Licensed under <a href="http://www.opensource.org/licenses/BSD-3-Clause">BSD-3-Clause</a>
+ */
+
+#include <bspacm/utility/latency.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+
+#if (BSPACM_DEVICE_SERIES_NRF51 - 0)
+#include <bspacm/utility/hires.h>
+
+#if BSPACM_HIRES_TIMER_BASE == BSPACM_LATENCY_TIMER_BASE
+#error Latency measurement cannot share the high-resolution timer
+#endif /* BSPACM_HIRES_TIMER_BASE */
+
+#if NRF_TIMER0_BASE == BSPACM_LATENCY_TIMER_BASE
+#define BSPACM_LATENCY_TIMER NRF_TIMER0
+#define BSPACM_LATENCY_TIMER_IRQn TIMER0_IRQn
+#define BSPACM_LATENCY_TIMER_IRQHandler TIMER0_IRQHandler
+#elif NRF_TIMER1_BASE == BSPACM_LATENCY_TIMER_BASE
+#define BSPACM_LATENCY_TIMER NRF_TIMER1
+#define BSPACM_LATENCY_TIMER_IRQn TIMER1_IRQn
+#define BSPACM_LATENCY_TIMER_IRQHandler TIMER1_IRQHandler
+#elif NRF_TIMER2_BASE == BSPACM_LATENCY_TIMER_BASE
+#define BSPACM_LATENCY_TIMER NRF_TIMER2
+#define BSPACM_LATENCY_TIMER_IRQn TIMER2_IRQn
+#define BSPACM_LATENCY_TIMER_IRQHandler TIMER2_IRQHandler
+#else  /* BSPACM_LATENCY_TIMER_BASE */
+#error Unrecognized latency timer
+#endif /* BSPACM_LATENCY_TIMER_BASE */
+#endif /* BSPACM_DEVICE_SERIES_NRF51 */
+
+static sBSPACMlatencyStatistics statistics_;
+static uint32_t period_;
+static uint32_t jitter_mask_;
+static uint32_t prng_ = 1;
+
+/* Length of the next interval: the base period plus a xorshift
+ * pseudo-random offset. */
+static uint32_t
+next_interval (void)
+{
+  prng_ ^= prng_ << 13;
+  prng_ ^= prng_ >> 17;
+  prng_ ^= prng_ << 5;
+  return period_ + (prng_ & jitter_mask_);
+}
+
+/* Invoked only from the measurement interrupt handler. */
+static void
+record_latency (uint32_t latency)
+{
+  sBSPACMlatencyStatistics * const sp = &statistics_;
+  unsigned int bin = latency / BSPACM_LATENCY_HISTOGRAM_WIDTH;
+
+  if (BSPACM_LATENCY_HISTOGRAM_BINS <= bin) {
+    bin = BSPACM_LATENCY_HISTOGRAM_BINS - 1;
+  }
+  if ((0 == sp->count++) || (latency < sp->min)) {
+    sp->min = latency;
+  }
+  if (latency > sp->max) {
+    sp->max = latency;
+  }
+  sp->total += latency;
+  sp->histogram[bin] += 1;
+}
+
+#if (BSPACM_DEVICE_SERIES_NRF51 - 0)
+
+void
+BSPACM_LATENCY_TIMER_IRQHandler (void)
+{
+  uint32_t now;
+  uint32_t target;
+
+  BSPACM_LATENCY_TIMER->TASKS_CAPTURE[1] = 1;
+  now = BSPACM_LATENCY_TIMER->CC[1];
+  target = BSPACM_LATENCY_TIMER->CC[0];
+  BSPACM_LATENCY_TIMER->EVENTS_COMPARE[0] = 0;
+  record_latency(BSPACM_LATENCY_COUNTER_MASK & (now - target));
+  BSPACM_LATENCY_TIMER->CC[0] = BSPACM_LATENCY_COUNTER_MASK & (target + next_interval());
+}
+
+int
+iBSPACMlatencyStart (unsigned int period_cycles,
+                     unsigned int jitter_mask,
+                     unsigned int priority)
+{
+  NRF_TIMER_Type * const timer = BSPACM_LATENCY_TIMER;
+
+  if ((0 == period_cycles)
+      || (BSPACM_LATENCY_COUNTER_MASK < jitter_mask)
+      || ((BSPACM_LATENCY_COUNTER_MASK - jitter_mask) < period_cycles)) {
+    return -1;
+  }
+  vBSPACMlatencyStop();
+  period_ = period_cycles;
+  jitter_mask_ = jitter_mask;
+  memset(&statistics_, 0, sizeof(statistics_));
+
+  /* Timer runs from the high-frequency clock without prescaling, so
+   * it counts core clock cycles. */
+  if ((CLOCK_HFCLKSTAT_SRC_Xtal << CLOCK_HFCLKSTAT_SRC_Pos)
+      != (CLOCK_HFCLKSTAT_SRC_Msk & NRF_CLOCK->HFCLKSTAT)) {
+    vBSPACMnrf51_HFCLKSTART();
+  }
+  timer->MODE = (TIMER_MODE_MODE_Timer << TIMER_MODE_MODE_Pos);
+  timer->PRESCALER = 0;
+#if (NRF_TIMER0_BASE == BSPACM_LATENCY_TIMER_BASE)
+  timer->BITMODE = (TIMER_BITMODE_BITMODE_32Bit << TIMER_BITMODE_BITMODE_Pos);
+#else /* BSPACM_LATENCY_TIMER_BASE */
+  timer->BITMODE = (TIMER_BITMODE_BITMODE_16Bit << TIMER_BITMODE_BITMODE_Pos);
+#endif /* BSPACM_LATENCY_TIMER_BASE */
+  timer->TASKS_CLEAR = 1;
+  timer->CC[0] = next_interval();
+  timer->EVENTS_COMPARE[0] = 0;
+  timer->INTENSET = TIMER_INTENSET_COMPARE0_Msk;
+  NVIC_ClearPendingIRQ(BSPACM_LATENCY_TIMER_IRQn);
+  NVIC_SetPriority(BSPACM_LATENCY_TIMER_IRQn, priority);
+  NVIC_EnableIRQ(BSPACM_LATENCY_TIMER_IRQn);
+  timer->TASKS_START = 1;
+  return 0;
+}
+
+void
+vBSPACMlatencyStop (void)
+{
+  BSPACM_LATENCY_TIMER->TASKS_STOP = 1;
+  BSPACM_LATENCY_TIMER->INTENCLR = ~0;
+  NVIC_DisableIRQ(BSPACM_LATENCY_TIMER_IRQn);
+  NVIC_ClearPendingIRQ(BSPACM_LATENCY_TIMER_IRQn);
+}
+
+#else /* BSPACM_DEVICE_SERIES_NRF51 */
+
+void
+SysTick_Handler (void)
+{
+  /* The counter is reloaded from LOAD on the cycle after it reaches
+   * zero, which is the cycle in which the interrupt is pended.  LOAD
+   * is rewritten below only after that reload has occurred. */
+  uint32_t const val = SysTick->VAL;
+
+  record_latency(1 + SysTick->LOAD - val);
+  SysTick->LOAD = next_interval() - 1;
+}
+
+int
+iBSPACMlatencyStart (unsigned int period_cycles,
+                     unsigned int jitter_mask,
+                     unsigned int priority)
+{
+  if ((1 >= period_cycles)
+      || (BSPACM_LATENCY_COUNTER_MASK < jitter_mask)
+      || ((BSPACM_LATENCY_COUNTER_MASK - jitter_mask) < period_cycles)) {
+    return -1;
+  }
+  vBSPACMlatencyStop();
+  period_ = period_cycles;
+  jitter_mask_ = jitter_mask;
+  memset(&statistics_, 0, sizeof(statistics_));
+
+  NVIC_SetPriority(SysTick_IRQn, priority);
+  SysTick->LOAD = next_interval() - 1;
+  SysTick->VAL = 0;
+  SysTick->CTRL = (SysTick_CTRL_CLKSOURCE_Msk
+                   | SysTick_CTRL_TICKINT_Msk
+                   | SysTick_CTRL_ENABLE_Msk);
+  return 0;
+}
+
+void
+vBSPACMlatencyStop (void)
+{
+  SysTick->CTRL = 0;
+  SCB->ICSR = SCB_ICSR_PENDSTCLR_Msk;
+}
+
+#endif /* BSPACM_DEVICE_SERIES_NRF51 */
+
+void
+vBSPACMlatencySnapshot (sBSPACMlatencyStatistics * sp,
+                        bool reset)
+{
+  BSPACM_CORE_SAVED_INTERRUPT_STATE(istate);
+
+  BSPACM_CORE_DISABLE_INTERRUPT();
+  do {
+    *sp = statistics_;
+    if (reset) {
+      memset(&statistics_, 0, sizeof(statistics_));
+    }
+  } while (0);
+  BSPACM_CORE_REENABLE_INTERRUPT(istate);
+}
+
+uint32_t
+uiBSPACMlatencyCount (void)
+{
+  return *(volatile uint32_t *)&statistics_.count;
+}
+
+void
+vBSPACMlatencyReport (const sBSPACMlatencyStatistics * sp)
+{
+  sBSPACMlatencyStatistics snapshot;
+  unsigned int i;
+
+  if (! sp) {
+    vBSPACMlatencySnapshot(&snapshot, false);
+    sp = &snapshot;
+  }
+  printf("Latency: %" PRIu32 " samples", sp->count);
+  if (0 < sp->count) {
+    printf(", min %" PRIu32 " max %" PRIu32 " avg %" PRIu32 " jitter %" PRIu32 " cycles",
+           sp->min, sp->max, (uint32_t)(sp->total / sp->count), sp->max - sp->min);
+  }
+  putchar('\n');
+  for (i = 0; i < BSPACM_LATENCY_HISTOGRAM_BINS; ++i) {
+    if (sp->histogram[i]) {
+      unsigned int lo = i * BSPACM_LATENCY_HISTOGRAM_WIDTH;
+      if ((i + 1) < BSPACM_LATENCY_HISTOGRAM_BINS) {
+        printf("  %4u-%-4u: %" PRIu32 "\n", lo, lo + BSPACM_LATENCY_HISTOGRAM_WIDTH - 1,
+               sp->histogram[i]);
+      } else {
+        printf("  %4u+    : %" PRIu32 "\n", lo, sp->histogram[i]);
+      }
+    }
+  }
+}
@@ -38,39 +38,13 @@
  */
 
 #include <bspacm/utility/misc.h>
-#include <inttypes.h>
-#include <stdio.h>
-#include <ctype.h>
+#include <bspacm/utility/hexdump.h>
 
 void
 vBSPACMconsoleDisplayOctets (const uint8_t * dp,
                              size_t count)
 {
-  const uint8_t * const edp = dp + count;
-  while (dp < edp) {
-    printf("%02x", *dp++);
-    if (dp < edp) {
-      putchar(' ');
-    }
-  }
-}
-
-static void BSPACM_CORE_INLINE
-emit_address (uintptr_t addr)
-{
-  printf("%08" PRIxPTR " ", addr);
-}
-
-
-static unsigned int
-align_base (uintptr_t base)
-{
-  unsigned int offset = base & 0x0F;
-  if (0 != offset) {
-    emit_address(base - offset);
-    return offset;
-  }
-  return 0;
+  (void)iBSPACMhexdumpSequence(iBSPACMhexdumpSinkFILE, 0, dp, count);
 }
 
 void
@@ -78,65 +52,7 @@ vBSPACMconsoleDisplayMemoryOctets (const uint8_t * dp,
                                    size_t count,
                                    uintptr_t base)
 {
-  static const char data_text_spacer[] = "  ";
-  const uint8_t * const edp = dp + count;
-  const uint8_t * adp = dp;
-  bool with_nl = false;
-  unsigned int skips = align_base(base);
-
-  /* If the base is not 16-byte aligned, backfill for the material
-   * that belongs in the first partial line. */
-  if (skips) {
-    unsigned int n;
-    for (n = 0; n < skips; ++n) {
-      unsigned int nsp = 3 + (8 == n);
-      while (0 < nsp--) {
-        putchar(' ');
-      }
-    }
-    with_nl = true;
-  }
-  while (dp < edp) {
-    if (0 == (base & 0x0F)) {
-      if (adp < dp) {
-        printf(data_text_spacer);
-        while (skips) {
-          putchar(' ');
-          --skips;
-        }
-        while (adp < dp) {
-          putchar(isprint(*adp) ? *adp : '.');
-          ++adp;
-        }
-      }
-      adp = dp;
-      if (with_nl) {
-        putchar('\n');
-      } else {
-        with_nl = true;
-      }
-      emit_address(base);
-    } else if (0 == (base & 0x07)) {
-      putchar(' ');
-    }
-    printf(" %02x", *dp++);
-    ++base;
-  }
-  if (adp < dp) {
-    while (base & 0x0F) {
-      if (0 == (base & 0x07)) {
-        putchar(' ');
-      }
-      printf("   ");
-      ++base;
-    }
-    printf("  ");
-    while (adp < dp) {
-      putchar(isprint(*adp) ? *adp : '.');
-      ++adp;
-    }
-  }
-  putchar('\n');
+  (void)iBSPACMhexdumpOctets(iBSPACMhexdumpSinkFILE, 0, dp, count, base);
 }
 
 void
@@ -144,36 +60,5 @@ vBSPACMconsoleDisplayMemoryWords (const uint32_t * dp,
                                   size_t count,
                                   uintptr_t base)
 {
-  const uint32_t * const edp = dp + count;
-  bool with_nl = false;
-  unsigned int skips;
-
-  /* Force word alignment.  Otherwise things get ugly with the skip
-   * logic. */
-  base &= ~(uintptr_t)3;
-  skips = align_base(base);
-  if (skips) {
-    unsigned int n;
-    skips /= 4;
-    for (n = 0; n < skips; ++n) {
-      unsigned int nsp = 9;
-      while (0 < nsp--) {
-        putchar(' ');
-      }
-    }
-    with_nl = true;
-  }
-  while (dp < edp) {
-    if (0 == (base & 0x0F)) {
-      if (with_nl) {
-        putchar('\n');
-      } else {
-        with_nl = true;
-      }
-      emit_address(base);
-    }
-    printf(" %08" PRIx32, *dp++);
-    base += sizeof(*dp);
-  }
-  putchar('\n');
+  (void)iBSPACMhexdumpWords(iBSPACMhexdumpSinkFILE, 0, dp, count, base);
 }
@@ -0,0 +1,224 @@
+/* Copyright 2014, Peter A. Bigot
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of the software nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without
+ *   specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/** @file
+ *
+ * @brief Implementation of fixed-block memory pools
+ *
+ * @homepage http://github.com/pabigot/bspacm
+ * @copyright Copyright 2014, Peter A. Bigot.  Licensed under <a href="http://www.opensource.org/licenses/BSD-3-Clause">BSD-3-Clause</a>
+ */
+
+#include <bspacm/utility/pool.h>
+#include <unistd.h>
+
+/* Free blocks are linked through their first word. */
+typedef struct sPoolBlock {
+  struct sPoolBlock * next;
+} sPoolBlock;
+
+/* State for one block-size class.  Blocks for the class occupy the
+ * contiguous region [base, limit). */
+typedef struct sPoolClass {
+  sPoolBlock * free;
+  uint8_t * base;
+  uint8_t * limit;
+  uint16_t block_size;
+  uint16_t block_count;
+  uint16_t in_use;
+  uint16_t max_in_use;
+  uint16_t overflows;
+  uint16_t failures;
+} sPoolClass;
+
+static sPoolClass pool_[BSPACM_POOL_CLASS_LIMIT];
+
+/* Number of initialized classes.  This is set only after all classes
+ * are ready, so a zero value inhibits allocation. */
+static unsigned int npool_;
+
+__attribute__((__weak__))
+void
+vBSPACMpoolAllocationFailure (size_t size)
+{
+}
+
+int
+iBSPACMpoolInitialize (const sBSPACMpoolClassConfiguration * classes,
+                       unsigned int nclasses)
+{
+  extern char __HeapLimit;  /* symbol placed just past end of heap */
+  const uintptr_t align_mask = BSPACM_POOL_ALIGNMENT - 1;
+  unsigned int ci;
+  uint16_t last_size = 0;
+  uintptr_t total = 0;
+  uintptr_t start;
+  char * brk;
+  uint8_t * bp;
+
+  if ((0 != npool_) || (! classes)
+      || (0 == nclasses) || (BSPACM_POOL_CLASS_LIMIT < nclasses)) {
+    return -1;
+  }
+  for (ci = 0; ci < nclasses; ++ci) {
+    uintptr_t block_size = (classes[ci].block_size + align_mask) & ~align_mask;
+    if ((0 == block_size) || (UINT16_MAX < block_size)
+        || (block_size <= last_size)
+        || (0 == classes[ci].block_count)) {
+      return -1;
+    }
+    last_size = block_size;
+    total += block_size * classes[ci].block_count;
+  }
+
+  /* Check the space before calling sbrk(), since the sbrk error
+   * policy may not return. */
+  brk = sbrk(0);
+  start = ((uintptr_t)brk + align_mask) & ~align_mask;
+  if ((start < (uintptr_t)brk)
+      || (((uintptr_t)&__HeapLimit - start) < total)
+      || ((uintptr_t)&__HeapLimit < start)) {
+    return -1;
+  }
+  if ((void *)-1 == sbrk((start - (uintptr_t)brk) + total)) {
+    return -1;
+  }
+
+  bp = (uint8_t *)start;
+  for (ci = 0; ci < nclasses; ++ci) {
+    sPoolClass * const pp = pool_ + ci;
+    sPoolBlock * * linkp = &pp->free;
+    unsigned int bi;
+
+    pp->block_size = (classes[ci].block_size + align_mask) & ~align_mask;
+    pp->block_count = classes[ci].block_count;
+    pp->base = bp;
+    for (bi = 0; bi < pp->block_count; ++bi) {
+      *linkp = (sPoolBlock *)bp;
+      linkp = &(*linkp)->next;
+      bp += pp->block_size;
+    }
+    *linkp = 0;
+    pp->limit = bp;
+  }
+  npool_ = nclasses;
+  return 0;
+}
+
+void *
+pvBSPACMpoolAllocate (size_t size)
+{
+  BSPACM_CORE_SAVED_INTERRUPT_STATE(istate);
+  sPoolClass * pp = pool_;
+  sPoolClass * const epp = pool_ + npool_;
+  sPoolClass * tpp;
+  sPoolBlock * rv = 0;
+
+  /* Locate the preferred class.  This is bounded by the class limit
+   * and does not require interrupts be disabled. */
+  while ((pp < epp) && (pp->block_size < size)) {
+    ++pp;
+  }
+  if (pp == epp) {
+    vBSPACMpoolAllocationFailure(size);
+    return 0;
+  }
+  tpp = pp;
+  BSPACM_CORE_DISABLE_INTERRUPT();
+  do {
+    rv = pp->free;
+    if (rv) {
+      pp->free = rv->next;
+      if (++pp->in_use > pp->max_in_use) {
+        pp->max_in_use = pp->in_use;
+      }
+      break;
+    }
+  } while (++pp < epp);
+  if (! rv) {
+    tpp->failures += 1;
+  } else if (pp != tpp) {
+    tpp->overflows += 1;
+  }
+  BSPACM_CORE_REENABLE_INTERRUPT(istate);
+  if (! rv) {
+    vBSPACMpoolAllocationFailure(size);
+  }
+  return rv;
+}
+
+int
+iBSPACMpoolRelease (void * ptr)
+{
+  BSPACM_CORE_SAVED_INTERRUPT_STATE(istate);
+  uint8_t * const bp = ptr;
+  sPoolClass * pp = pool_;
+  sPoolClass * const epp = pool_ + npool_;
+
+  if (! bp) {
+    return 0;
+  }
+  while ((pp < epp) && (bp >= pp->limit)) {
+    ++pp;
+  }
+  if ((pp == epp) || (bp < pp->base)
+      || (0 != ((bp - pp->base) % pp->block_size))) {
+    return -1;
+  }
+  BSPACM_CORE_DISABLE_INTERRUPT();
+  ((sPoolBlock *)bp)->next = pp->free;
+  pp->free = (sPoolBlock *)bp;
+  pp->in_use -= 1;
+  BSPACM_CORE_REENABLE_INTERRUPT(istate);
+  return 0;
+}
+
+int
+iBSPACMpoolClassStatistics (unsigned int cls,
+                            sBSPACMpoolClassStatistics * sp)
+{
+  BSPACM_CORE_SAVED_INTERRUPT_STATE(istate);
+  const sPoolClass * pp;
+
+  if ((npool_ <= cls) || (! sp)) {
+    return -1;
+  }
+  pp = pool_ + cls;
+  BSPACM_CORE_DISABLE_INTERRUPT();
+  sp->block_size = pp->block_size;
+  sp->block_count = pp->block_count;
+  sp->in_use = pp->in_use;
+  sp->max_in_use = pp->max_in_use;
+  sp->overflows = pp->overflows;
+  sp->failures = pp->failures;
+  BSPACM_CORE_REENABLE_INTERRUPT(istate);
+  return 0;
+}
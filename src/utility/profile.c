@@ -0,0 +1,157 @@
+/* Copyright 2014, Peter A. Bigot
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of the software nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without
+ *   specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/** @file
+ *
+ * @brief Implementation of named profiling probes
+ *
+ * @homepage http://github.com/pabigot/bspacm
+ * @copyright Copyright 2014, Peter A. Bigot.  Licensed under <a href="http://www.opensource.org/licenses/BSD-3-Clause">BSD-3-Clause</a>
+ */
+
+#include <bspacm/utility/profile.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+
+/* Bounds of the probe section, provided by the linker script. */
+extern sBSPACMprofileProbe __bspacm_profile_start[];
+extern sBSPACMprofileProbe __bspacm_profile_end[];
+
+int
+iBSPACMprofileInitialize (void)
+{
+#if (BSPACM_PROFILE_SOURCE_CYCCNT == BSPACM_PROFILE_SOURCE)
+  BSPACM_CORE_ENABLE_CYCCNT();
+#elif (BSPACM_PROFILE_SOURCE_HIRES == BSPACM_PROFILE_SOURCE)
+  if (! bBSPACMhiresEnabled()) {
+    return -1;
+  }
+#elif (BSPACM_PROFILE_SOURCE_SYSTICK == BSPACM_PROFILE_SOURCE)
+  SysTick->CTRL = 0;
+  SysTick->LOAD = SysTick_LOAD_RELOAD_Msk;
+  SysTick->VAL = 0;
+  SysTick->CTRL = SysTick_CTRL_CLKSOURCE_Msk | SysTick_CTRL_ENABLE_Msk;
+#endif /* BSPACM_PROFILE_SOURCE */
+  return 0;
+}
+
+void
+vBSPACMprofileRecord_ (sBSPACMprofileProbe * pp,
+                       uint32_t end)
+{
+  BSPACM_CORE_SAVED_INTERRUPT_STATE(istate);
+  sBSPACMprofileStatistics * const sp = &pp->statistics;
+  uint32_t const duration = (end - pp->start) & BSPACM_PROFILE_TIMESTAMP_MASK;
+
+  BSPACM_CORE_DISABLE_INTERRUPT();
+  do {
+    if ((0 == sp->count++) || (duration < sp->min)) {
+      sp->min = duration;
+    }
+    if (duration > sp->max) {
+      sp->max = duration;
+    }
+    sp->total += duration;
+    if (pp->histogram) {
+      pp->histogram[1 + iBSPACMbitsFindLastSet(duration)] += 1;
+    }
+  } while (0);
+  BSPACM_CORE_REENABLE_INTERRUPT(istate);
+}
+
+sBSPACMprofileProbe *
+pxBSPACMprofileProbes (unsigned int * countp)
+{
+  *countp = __bspacm_profile_end - __bspacm_profile_start;
+  return __bspacm_profile_start;
+}
+
+void
+vBSPACMprofileSnapshot (sBSPACMprofileProbe * pp,
+                        sBSPACMprofileStatistics * sp,
+                        uint32_t * histogram,
+                        bool reset)
+{
+  BSPACM_CORE_SAVED_INTERRUPT_STATE(istate);
+  const size_t histogram_size = BSPACM_PROFILE_HISTOGRAM_BINS * sizeof(*histogram);
+
+  BSPACM_CORE_DISABLE_INTERRUPT();
+  do {
+    *sp = pp->statistics;
+    if (histogram) {
+      if (pp->histogram) {
+        memcpy(histogram, pp->histogram, histogram_size);
+      } else {
+        memset(histogram, 0, histogram_size);
+      }
+    }
+    if (reset) {
+      memset(&pp->statistics, 0, sizeof(pp->statistics));
+      if (pp->histogram) {
+        memset(pp->histogram, 0, histogram_size);
+      }
+    }
+  } while (0);
+  BSPACM_CORE_REENABLE_INTERRUPT(istate);
+}
+
+void
+vBSPACMprofileReport (bool reset)
+{
+  unsigned int count;
+  sBSPACMprofileProbe * pp = pxBSPACMprofileProbes(&count);
+  sBSPACMprofileProbe * const epp = pp + count;
+
+  printf("%u profile probes, durations in " BSPACM_PROFILE_TIMESTAMP_UNITS "\n", count);
+  while (pp < epp) {
+    sBSPACMprofileStatistics stats;
+    uint32_t histogram[BSPACM_PROFILE_HISTOGRAM_BINS];
+    unsigned int i;
+
+    vBSPACMprofileSnapshot(pp, &stats, histogram, reset);
+    printf("%s: %" PRIu32 " passes", pp->name, stats.count);
+    if (0 < stats.count) {
+      /* newlib-nano printf does not support 64-bit integers */
+      printf(", min %" PRIu32 " max %" PRIu32 " avg %" PRIu32,
+             stats.min, stats.max, (uint32_t)(stats.total / stats.count));
+    }
+    putchar('\n');
+    if (pp->histogram) {
+      for (i = 0; i < BSPACM_PROFILE_HISTOGRAM_BINS; ++i) {
+        if (histogram[i]) {
+          printf("  < 2^%u: %" PRIu32 "\n", i, histogram[i]);
+        }
+      }
+    }
+    ++pp;
+  }
+}
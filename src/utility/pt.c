@@ -0,0 +1,115 @@
+/* Copyright 2014, Peter A. Bigot
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of the software nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without
+ *   specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/** @file
+ *
+ * @brief Implementation of protothread idle and deadline support
+ *
+ * @homepage http://github.com/pabigot/bspacm
+ * @copyright Copyright 2014, Peter A. Bigot.  Licensed under <a href="http://www.opensource.org/licenses/BSD-3-Clause">BSD-3-Clause</a>
+ */
+
+#include <bspacm/utility/pt.h>
+
+#if (BSPACM_DEVICE_SERIES_NRF51 - 0)
+
+/* True when the wakeup alarm has fired since the last return from
+ * uiBSPACMptIdle(). */
+static volatile bool wakeup_;
+
+static void
+wakeup_flih (int ccidx,
+             hBSPACMuptimeAlarm ap)
+{
+  (void)ccidx;
+  (void)ap;
+  wakeup_ = true;
+}
+
+static sBSPACMuptimeAlarm wakeup_alarm_ = {
+  .callback_flih = wakeup_flih,
+};
+
+bool
+bBSPACMptDeadlineReached (unsigned int deadline_utt)
+{
+  BSPACM_CORE_SAVED_INTERRUPT_STATE(istate);
+  bool rv = false;
+
+  BSPACM_CORE_DISABLE_INTERRUPT();
+  do {
+    unsigned int const now_utt = uiBSPACMuptime();
+    int const remaining_utt = (int)(deadline_utt - now_utt);
+
+    if (0 >= remaining_utt) {
+      rv = true;
+      break;
+    }
+    if (wakeup_alarm_.scheduled_
+        && (0 <= (int)(deadline_utt - wakeup_alarm_.when_utt))) {
+      break;
+    }
+    (void)bBSPACMuptimeAlarmCancel(&wakeup_alarm_);
+    (void)iBSPACMuptimeAlarmSchedule(deadline_utt, &wakeup_alarm_);
+  } while (0);
+  BSPACM_CORE_REENABLE_INTERRUPT(istate);
+  return rv;
+}
+
+#define WAKEUP_PENDING() wakeup_
+#define WAKEUP_CLEAR() do { wakeup_ = false; } while (0)
+
+#else /* BSPACM_DEVICE_SERIES_NRF51 */
+
+#define WAKEUP_PENDING() false
+#define WAKEUP_CLEAR() do { } while (0)
+
+#endif /* BSPACM_DEVICE_SERIES_NRF51 */
+
+uint32_t
+uiBSPACMptIdle (uint32_t mask)
+{
+  BSPACM_CORE_SAVED_INTERRUPT_STATE(istate);
+  uint32_t rv;
+
+  while (1) {
+    BSPACM_CORE_DISABLE_INTERRUPT();
+    rv = mask & xBSPACMeventSystem.flags;
+    if (rv || WAKEUP_PENDING()) {
+      break;
+    }
+    vBSPACMeventIdle(&xBSPACMeventSystem, mask);
+    BSPACM_CORE_ENABLE_INTERRUPT();
+  }
+  WAKEUP_CLEAR();
+  BSPACM_CORE_REENABLE_INTERRUPT(istate);
+  return rv;
+}
@@ -0,0 +1,127 @@
+/* Copyright 2014, Peter A. Bigot
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of the software nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without
+ *   specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/** @file
+ *
+ * @brief Implementation of run-to-completion tasks
+ *
+ * @homepage http://github.com/pabigot/bspacm
+ * @copyright Copyright 2014, Peter A. Bigot.  Licensed under <a href="http://www.opensource.org/licenses/BSD-3-Clause">BSD-3-Clause</a>
+ */
+
+#include <bspacm/utility/task.h>
+
+#if (32 < BSPACM_TASK_PRIORITY_LEVELS)
+#error BSPACM_TASK_PRIORITY_LEVELS exceeds 32
+#endif /* BSPACM_TASK_PRIORITY_LEVELS */
+
+/* Bit p is set iff head_[p] is not null. */
+static volatile uint32_t ready_;
+static hBSPACMtask head_[BSPACM_TASK_PRIORITY_LEVELS];
+static hBSPACMtask tail_[BSPACM_TASK_PRIORITY_LEVELS];
+
+/* True once PendSV has been placed at the lowest priority.  This is
+ * deferred until tasks are actually used, so that an application
+ * which merely links a driver referencing iBSPACMtaskPost() keeps
+ * whatever PendSV configuration it established. */
+static bool pendsv_configured_;
+
+static void
+pendsv_configure (void)
+{
+  if (! pendsv_configured_) {
+    NVIC_SetPriority(PendSV_IRQn, (1U << __NVIC_PRIO_BITS) - 1);
+    pendsv_configured_ = true;
+  }
+}
+
+int
+iBSPACMtaskPost (hBSPACMtask tp)
+{
+  BSPACM_CORE_SAVED_INTERRUPT_STATE(istate);
+  unsigned int const pri = tp->priority;
+  int rv = 0;
+
+  if (BSPACM_TASK_PRIORITY_LEVELS <= pri) {
+    return -1;
+  }
+  BSPACM_CORE_DISABLE_INTERRUPT();
+  do {
+    if (tp->queued_) {
+      break;
+    }
+    pendsv_configure();
+    tp->queued_ = 1;
+    tp->next_ = NULL;
+    if (head_[pri]) {
+      tail_[pri]->next_ = tp;
+    } else {
+      head_[pri] = tp;
+      ready_ |= (1U << pri);
+    }
+    tail_[pri] = tp;
+    rv = 1;
+  } while (0);
+  BSPACM_CORE_REENABLE_INTERRUPT(istate);
+  if (rv) {
+    SCB->ICSR = SCB_ICSR_PENDSVSET_Msk;
+  }
+  return rv;
+}
+
+unsigned int
+uiBSPACMtaskDispatch (void)
+{
+  BSPACM_CORE_SAVED_INTERRUPT_STATE(istate);
+  unsigned int rv = 0;
+
+  while (1) {
+    hBSPACMtask tp;
+    int pri;
+
+    BSPACM_CORE_DISABLE_INTERRUPT();
+    pri = iBSPACMbitsFindLastSet(ready_);
+    if (0 > pri) {
+      BSPACM_CORE_REENABLE_INTERRUPT(istate);
+      break;
+    }
+    tp = head_[pri];
+    head_[pri] = tp->next_;
+    if (! head_[pri]) {
+      ready_ &= ~(1U << pri);
+    }
+    tp->queued_ = 0;
+    BSPACM_CORE_REENABLE_INTERRUPT(istate);
+    tp->function(tp);
+    ++rv;
+  }
+  return rv;
+}